@@ -1,6 +1,8 @@
 #include <Arduino.h>
 #include <driver/i2s.h>
 
+#include "serial_frame.h"
+
 #define I2S_BCLK 12
 #define I2S_WS   11
 #define I2S_SD   10
@@ -8,23 +10,85 @@
 
 static const int SAMPLE_RATE = 16000;
 static const int FRAMES = 256;
-
-static int32_t i2s_buf[FRAMES * 2];
-static int16_t pcm16_buf[FRAMES];
-
-static bool recording = false;
+// UART driver TX ring, drained by the UART ISR while i2s_read runs.
+// ~80 ms of link time at 1 Mbaud.
+static const size_t TX_RING_BYTES = 8192;
+
+// Capture on core 1 above loop(); the sender owns Serial0 on core 0.
+static const int CAPTURE_CORE = 1;
+static const int CAPTURE_PRIO = 5;
+static const int SENDER_CORE = 0;
+static const int SENDER_PRIO = 4;
+
+// Items on the sender queue, in wire order.
+enum {
+  TX_BUF0 = 0,
+  TX_BUF1 = 1,
+  TX_STRT,
+  TX_STOP,
+  TX_RDY,
+};
+
+// bytes: valid PCM bytes in pcm16_buf[type] (audio items only). A short
+// i2s_read must not send the stale tail of the buffer.
+typedef struct {
+  uint8_t type;
+  uint16_t bytes;
+} tx_item_t;
+
+static int32_t i2s_buf[FRAMES];
+// Ping-pong: capture fills one while the sender drains the other.
+static int16_t pcm16_buf[2][FRAMES];
+static volatile bool pcm16_busy[2] = {false, false};
+static uint8_t tx_frame[SF_ENCODED_MAX(SF_HEADER_LEN + FRAMES * 2 + SF_CRC_LEN)];
+static uint16_t tx_seq = 0;
+
+static QueueHandle_t tx_queue = NULL;
+static QueueHandle_t i2s_events = NULL;
+
+// RDY payload, so the host can see link and capture pressure.
+static struct {
+  uint32_t tx_drops;     // frames the UART ring could not take
+  uint32_t dma_overruns; // I2S DMA queue overflows
+  uint32_t buf_overruns; // blocks dropped because the sender still held both buffers
+  uint32_t queue_drops;  // control items the full sender queue could not take
+} stats = {0, 0, 0, 0};
+
+// Button state is requested by loop() and applied by the capture task at
+// a block boundary, so STRT/STOP are ordered with the audio.
+static volatile bool want_recording = false;
 static uint32_t lastBtnMs = 0;
 static uint32_t lastRdyMs = 0;
 
-static void send4(const char* s) { Serial0.write((const uint8_t*)s, 4); }
-static void sendSTRT() { send4("STRT"); Serial0.flush(); }
-static void sendSTOP() { send4("STOP"); Serial0.flush(); }
-static void sendRDY()  { send4("RDY!"); Serial0.flush(); }
+// Audio frames never block: if the TX ring cannot take the whole frame it
+// is dropped (the seq gap tells the host). Control frames always go out.
+static bool sendPacket(uint8_t type, const uint8_t* payload, uint16_t len, bool droppable) {
+  size_t n = sf_encode(type, tx_seq++, payload, len, tx_frame);
+  if (n == 0) return false;
+  if (droppable && (size_t)Serial0.availableForWrite() < n) {
+    stats.tx_drops++;
+    return false;
+  }
+  Serial0.write(tx_frame, n);
+  return true;
+}
+
+static void sendSTRT() { sendPacket(SF_TYPE_STRT, NULL, 0, false); }
+static void sendSTOP() { sendPacket(SF_TYPE_STOP, NULL, 0, false); }
+static void sendRDY()  { sendPacket(SF_TYPE_RDY, (const uint8_t*)&stats, sizeof(stats), false); }
 
 static void sendFrame(const uint8_t* payload, uint16_t len) {
-  send4("AUD0");
-  Serial0.write((uint8_t*)&len, 2);
-  Serial0.write(payload, len);
+  sendPacket(SF_TYPE_AUD0, payload, len, true);
+}
+
+// Never blocks the capture task: a full queue drops the item and counts it.
+static bool postTx(uint8_t type) {
+  tx_item_t item = {type, 0};
+  if (xQueueSend(tx_queue, &item, 0) != pdTRUE) {
+    stats.queue_drops++;
+    return false;
+  }
+  return true;
 }
 
 static bool buttonPressedEdge() {
@@ -35,7 +99,70 @@ static bool buttonPressedEdge() {
   return false;
 }
 
+static void countDmaOverruns() {
+  i2s_event_t evt;
+  while (xQueueReceive(i2s_events, &evt, 0) == pdTRUE) {
+    if (evt.type == I2S_EVENT_RX_Q_OVF) stats.dma_overruns++;
+  }
+}
+
+// Reads continuously so the DMA ring never backs up, even when idle.
+static void captureTask(void*) {
+  bool recording = false;
+  int w = 0;
+  while (true) {
+    size_t bytes_read = 0;
+    i2s_read(I2S_NUM_0, i2s_buf, sizeof(i2s_buf), &bytes_read, portMAX_DELAY);
+    countDmaOverruns();
+
+    // A dropped STRT/STOP leaves the state alone, so the next block retries.
+    bool want = want_recording;
+    if (want != recording) {
+      if (!postTx(want ? TX_STRT : TX_STOP)) continue;
+      recording = want;
+      if (recording) continue; // drop the block captured before the press
+    }
+    if (!recording) continue;
+
+    if (pcm16_busy[w]) {
+      stats.buf_overruns++;
+      continue;
+    }
+    int frames = bytes_read / 4;
+    if (frames == 0) continue;
+    for (int i = 0; i < frames; i++) {
+      pcm16_buf[w][i] = (int16_t)(i2s_buf[i] >> 13); // chống clipping
+    }
+    pcm16_busy[w] = true;
+    tx_item_t item = {(uint8_t)w, (uint16_t)(frames * sizeof(int16_t))};
+    if (xQueueSend(tx_queue, &item, 0) != pdTRUE) {
+      pcm16_busy[w] = false;
+      stats.buf_overruns++;
+      continue;
+    }
+    w ^= 1;
+  }
+}
+
+static void senderTask(void*) {
+  while (true) {
+    tx_item_t item;
+    if (xQueueReceive(tx_queue, &item, portMAX_DELAY) != pdTRUE) continue;
+    switch (item.type) {
+      case TX_BUF0:
+      case TX_BUF1:
+        sendFrame((const uint8_t*)pcm16_buf[item.type], item.bytes);
+        pcm16_busy[item.type] = false;
+        break;
+      case TX_STRT: sendSTRT(); break;
+      case TX_STOP: sendSTOP(); break;
+      case TX_RDY:  sendRDY(); break;
+    }
+  }
+}
+
 void setup() {
+  Serial0.setTxBufferSize(TX_RING_BYTES);
   Serial0.begin(1000000);
   delay(300);
 
@@ -45,10 +172,11 @@ void setup() {
   cfg.mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX);
   cfg.sample_rate = SAMPLE_RATE;
   cfg.bits_per_sample = I2S_BITS_PER_SAMPLE_32BIT;
-  cfg.channel_format = I2S_CHANNEL_FMT_RIGHT_LEFT;
+  // INMP411 L/R tied low: only the left slot carries data.
+  cfg.channel_format = I2S_CHANNEL_FMT_ONLY_LEFT;
   cfg.communication_format = I2S_COMM_FORMAT_I2S_MSB;
-  cfg.dma_buf_count = 16;
-  cfg.dma_buf_len = 256;
+  cfg.dma_buf_count = 8;
+  cfg.dma_buf_len = FRAMES;
 
   i2s_pin_config_t pins = {};
   pins.bck_io_num = I2S_BCLK;
@@ -56,44 +184,27 @@ void setup() {
   pins.data_out_num = -1;
   pins.data_in_num  = I2S_SD;
 
-  i2s_driver_install(I2S_NUM_0, &cfg, 0, NULL);
+  i2s_driver_install(I2S_NUM_0, &cfg, 4, &i2s_events);
   i2s_set_pin(I2S_NUM_0, &pins);
-  i2s_set_clk(I2S_NUM_0, SAMPLE_RATE, I2S_BITS_PER_SAMPLE_32BIT, I2S_CHANNEL_STEREO);
+  i2s_set_clk(I2S_NUM_0, SAMPLE_RATE, I2S_BITS_PER_SAMPLE_32BIT, I2S_CHANNEL_MONO);
 
   i2s_zero_dma_buffer(I2S_NUM_0);
   i2s_start(I2S_NUM_0);
+
+  tx_queue = xQueueCreate(8, sizeof(tx_item_t));
+  xTaskCreatePinnedToCore(senderTask, "sender", 4096, NULL, SENDER_PRIO, NULL, SENDER_CORE);
+  xTaskCreatePinnedToCore(captureTask, "capture", 4096, NULL, CAPTURE_PRIO, NULL, CAPTURE_CORE);
 }
 
 void loop() {
   if (buttonPressedEdge()) {
-    recording = !recording;
-    if (recording) {
-      i2s_zero_dma_buffer(I2S_NUM_0);
-      sendSTRT();
-      delay(30);
-    } else {
-      sendSTOP();
-      delay(30);
-    }
+    want_recording = !want_recording;
   }
 
-  if (!recording) {
-    if (millis() - lastRdyMs > 500) {
-      lastRdyMs = millis();
-      sendRDY();
-    }
-    delay(5);
-    return;
+  if (!want_recording && millis() - lastRdyMs > 500) {
+    lastRdyMs = millis();
+    tx_item_t item = {TX_RDY, 0};
+    xQueueSend(tx_queue, &item, 0);
   }
-
-  size_t bytes_read = 0;
-  i2s_read(I2S_NUM_0, i2s_buf, sizeof(i2s_buf), &bytes_read, portMAX_DELAY);
-  int frames = (bytes_read / 4) / 2;
-
-  for (int i = 0; i < frames; i++) {
-    int32_t L = i2s_buf[i * 2 + 0];
-    pcm16_buf[i] = (int16_t)(L >> 13); // chống clipping
-  }
-
-  sendFrame((uint8_t*)pcm16_buf, (uint16_t)(frames * 2));
+  delay(5);
 }
@@ -19,6 +19,7 @@ class TcpAudioRecorder:
         sample_rate: int = 16000,
         silence_timeout_s: float = 6.0,
         whisper_worker=None,
+        credit_window: int = 65536,
     ) -> None:
         self.host = host
         self.port = port
@@ -37,6 +38,14 @@ class TcpAudioRecorder:
         self._last_drop_log = 0.0
         self._whisper = whisper_worker
         self._current_path: str | None = None
+        self._mel = None
+        self._mel_path: str | None = None
+        # Receive-side flow control: payload bytes granted beyond those
+        # consumed (CRED in apps/iot/main/smart_home_mqtt/audio_stream.h).
+        # 0 sends no CRED and leaves the device unthrottled.
+        self.credit_window = credit_window
+        self._consumed = 0
+        self._granted = None
 
     def start(self) -> None:
         if self._thread:
@@ -85,7 +94,7 @@ class TcpAudioRecorder:
         self._current_path = path
         logger.info("Recording started: %s", path)
 
-    def _close_wav(self) -> None:
+    def _close_wav(self, discard: bool = False) -> None:
         if not self._wav:
             return
         try:
@@ -93,15 +102,35 @@ class TcpAudioRecorder:
         except Exception:
             pass
         self._wav = None
+        submit_path = self._current_path
+        if self._mel:
+            # Log-mel session: the WAV stayed empty, Whisper reads the .mel.
+            self._mel.close()
+            self._mel = None
+            try:
+                os.remove(self._current_path)
+            except OSError:
+                pass
+            self._current_path = self._mel_path
+            submit_path = self._mel_path
+            self._mel_path = None
         self._recording = False
         self._expected_seq = None
         self._last_payload_len = 0
         self._drop_count = 0
         self._last_drop_log = 0.0
-        if self._whisper and self._current_path:
-            self._whisper.submit(self._current_path)
+        if discard and self._current_path:
+            try:
+                os.remove(self._current_path)
+            except OSError:
+                pass
+            logger.info("Recording cancelled (handled on device)")
+        elif self._whisper and submit_path:
+            self._whisper.submit(submit_path)
+            logger.info("Recording finished")
+        else:
+            logger.info("Recording finished")
         self._current_path = None
-        logger.info("Recording finished")
 
     def _handle_audio_payload(self, payload: bytes, seq: int | None) -> None:
         if not self._wav or not payload:
@@ -129,6 +158,21 @@ class TcpAudioRecorder:
         self._last_payload_len = len(payload)
         self._last_packet_ts = time.time()
 
+    def _handle_mel_payload(self, payload: bytes, seq: int) -> None:
+        # MEL0: int16 log2 mel frames (see apps/iot/main/smart_home_mqtt/audio_stream.h).
+        if not self._wav or not payload:
+            return
+        if not self._mel:
+            self._mel_path = os.path.splitext(self._current_path)[0] + ".mel"
+            self._mel = open(self._mel_path, "wb")
+        if self._expected_seq is not None and seq > self._expected_seq and self._last_payload_len > 0:
+            # Lost packets become floor frames; Whisper clamps them to silence.
+            self._mel.write(b"\x00\x80" * ((seq - self._expected_seq) * self._last_payload_len // 2))
+        self._expected_seq = (seq + 1) & 0xFFFFFFFF
+        self._mel.write(payload)
+        self._last_payload_len = len(payload)
+        self._last_packet_ts = time.time()
+
     def _process_buffer(self, buf: bytearray) -> bytearray:
         while True:
             if len(buf) < 4:
@@ -137,6 +181,8 @@ class TcpAudioRecorder:
             if tag == b"STRT":
                 self._open_wav()
                 self._recording = True
+                self._consumed = 0
+                self._granted = None
                 self._last_packet_ts = time.time()
                 del buf[:4]
                 continue
@@ -144,7 +190,17 @@ class TcpAudioRecorder:
                 self._close_wav()
                 del buf[:4]
                 continue
-            if tag == b"AUD0":
+            if tag == b"CANC":
+                self._close_wav(discard=True)
+                del buf[:4]
+                continue
+            if tag == b"TIME":
+                # Device timestamps for latency benchmarks; not needed here.
+                if len(buf) < 20:
+                    return buf
+                del buf[:20]
+                continue
+            if tag == b"AUD0" or tag == b"MEL0":
                 if len(buf) < 10:
                     return buf
                 seq = struct.unpack_from("<I", buf, 4)[0]
@@ -152,12 +208,27 @@ class TcpAudioRecorder:
                 if len(buf) < 10 + length:
                     return buf
                 payload = bytes(buf[10:10 + length])
-                self._handle_audio_payload(payload, seq)
+                if tag == b"MEL0":
+                    self._handle_mel_payload(payload, seq)
+                else:
+                    self._handle_audio_payload(payload, seq)
+                self._consumed += length
                 del buf[:10 + length]
                 continue
             del buf[:1]
         return buf
 
+    def _send_credit(self, conn: socket.socket) -> None:
+        # Re-grant once a quarter of the window has been consumed, so a
+        # CRED goes out every few packets rather than after each one.
+        if not self.credit_window or not self._recording:
+            return
+        total = self._consumed + self.credit_window
+        if self._granted is not None and total - self._granted < self.credit_window // 4:
+            return
+        conn.sendall(b"CRED" + struct.pack("<I", total & 0xFFFFFFFF))
+        self._granted = total
+
     def _check_timeout(self) -> None:
         if not self._recording:
             return
@@ -185,6 +256,7 @@ class TcpAudioRecorder:
                             break
                         buf.extend(data)
                         buf = self._process_buffer(buf)
+                        self._send_credit(conn)
                     except socket.timeout:
                         self._check_timeout()
                         continue
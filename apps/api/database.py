@@ -71,7 +71,7 @@ def get_latest_device_data(device_id: str):
             cursor = conn.cursor()
             cursor.execute('''
                 SELECT payload, timestamp FROM device_data 
-                WHERE device_id = ? 
+                WHERE device_id = ? AND message_type != 'summary'
                 ORDER BY timestamp DESC 
                 LIMIT 1
             ''', (device_id,))
@@ -128,6 +128,32 @@ def get_latest_sensor_with_values(device_id: str):
     finally:
         conn.close()
 
+def get_latest_sensor_aggregates(device_id: str):
+    conn = get_db_connection()
+    if not conn:
+        return None
+    try:
+        cursor = conn.cursor()
+        cursor.execute('''
+            SELECT payload, timestamp FROM device_data
+            WHERE device_id = ? AND message_type = 'summary'
+            ORDER BY timestamp DESC
+            LIMIT 1
+        ''', (device_id,))
+        row = cursor.fetchone()
+        if not row:
+            return None
+        try:
+            data = json.loads(row['payload'])
+        except json.JSONDecodeError:
+            return None
+        return {"timestamp": row['timestamp'], "data": data}
+    except sqlite3.Error as e:
+        logger.error(f"Failed to fetch sensor aggregates: {e}")
+        return None
+    finally:
+        conn.close()
+
 def get_device_data_history(device_id: str, limit: int = 100):
     conn = get_db_connection()
     if not conn:
@@ -12,6 +12,7 @@ from database import (
     get_latest_sensor_with_values,
     get_device_data_history,
     get_sensor_summary,
+    get_latest_sensor_aggregates,
 )
 import logging
 import os
@@ -69,6 +70,7 @@ if os.getenv("WHISPER_ENABLED", "1") != "0":
         task=os.getenv("WHISPER_TASK", "transcribe"),
         on_result=_store_device_chat,
     )
+    mqtt_client.on_wake = lambda _event: whisper_worker.warm_up()
 
 tcp_recorder = TcpAudioRecorder(
     host=os.getenv("AUDIO_TCP_HOST", "0.0.0.0"),
@@ -77,6 +79,7 @@ tcp_recorder = TcpAudioRecorder(
     sample_rate=int(os.getenv("AUDIO_SAMPLE_RATE", "16000")),
     silence_timeout_s=float(os.getenv("AUDIO_SILENCE_TIMEOUT_S", "6.0")),
     whisper_worker=whisper_worker,
+    credit_window=int(os.getenv("AUDIO_TCP_CREDIT_WINDOW", "65536")),
 )
 
 # class ACControlParams(BaseModel):
@@ -224,6 +227,14 @@ def get_sensor_summary_endpoint(device_id: str = "esp32-main", hours: int = 24):
         raise HTTPException(status_code=404, detail="No sensor data found")
     return {"device_id": device_id, "hours": hours, "summary": summary}
 
+@app.get("/sensor/aggregates")
+def get_sensor_aggregates(device_id: str = "esp32-main"):
+    # 1 min / 15 min / 1 h windows computed on the device; no raw-sample scan.
+    data = get_latest_sensor_aggregates(device_id)
+    if not data:
+        raise HTTPException(status_code=404, detail="No sensor aggregates found")
+    return {"device_id": device_id, **data}
+
 # @app.get("/")
 # def read_root():
 #     return {"Hello": "Smart Home API", "Status": "MQTT Service Running"}
@@ -23,6 +23,10 @@ class MQTTClient:
         self.tls_insecure = os.getenv("MQTT_TLS_INSECURE", "false").lower() in {"1", "true", "yes"}
         self.sensor_topic = os.getenv("MQTT_SENSOR_TOPIC", "sensor/temp_humid_msa_assign1")
         self.control_topic = os.getenv("MQTT_CONTROL_TOPIC", "sensor/control_msa_assign1")
+        self.wake_topic = os.getenv("MQTT_WAKE_TOPIC", "sensor/wake_trigger_msa_assign1")
+        self.summary_topic = os.getenv("MQTT_SUMMARY_TOPIC", "sensor/summary_msa_assign1")
+        # Called with the event dict when the device reports a wake word.
+        self.on_wake = None
 
         self.client.on_connect = self.on_connect
         self.client.on_message = self.on_message
@@ -31,6 +35,10 @@ class MQTTClient:
             f"{self.sensor_topic},smart-home/+/+/+/+"
         )
         self.topics = [t.strip() for t in topics_env.split(",") if t.strip()]
+        if self.wake_topic and self.wake_topic not in self.topics:
+            self.topics.append(self.wake_topic)
+        if self.summary_topic and self.summary_topic not in self.topics:
+            self.topics.append(self.summary_topic)
 
     def on_connect(self, client, userdata, flags, rc):
         if rc == 0:
@@ -59,6 +67,33 @@ class MQTTClient:
                     logger.error("Failed to decode JSON from sensor")
                 return
 
+            # Sliding-window aggregates computed on the device:
+            # {"t": S, "1m": {"span_s": N, "temperature": {"n", "min", "max", "mean", "p50", "p95"}, ...}, "15m": ..., "1h": ...}
+            if msg.topic == self.summary_topic:
+                try:
+                    data = json.loads(payload)
+                except json.JSONDecodeError:
+                    logger.error("Failed to decode JSON from sensor summary")
+                    return
+                insert_device_data("living-room", "sensor", "esp32-main", "summary", data)
+                return
+
+            # Session events from the device event bus:
+            # {"event": "wake", "session": N, "t_us": T, "value": V, "text": "..."}
+            if msg.topic == self.wake_topic:
+                try:
+                    data = json.loads(payload)
+                except json.JSONDecodeError:
+                    logger.error("Failed to decode JSON from device event")
+                    return
+                if data.get("event") == "wake" and self.on_wake:
+                    try:
+                        self.on_wake(data)
+                    except Exception:
+                        logger.exception("on_wake callback failed")
+                insert_device_data("living-room", "sensor", "esp32-main", "event", data)
+                return
+
             # Basic parsing of topic structure for other devices
             # Topic: smart-home/{zone}/{device_type}/{device_id}/{msg_type}
             parts = msg.topic.split("/")
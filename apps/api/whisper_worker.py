@@ -1,4 +1,5 @@
 import logging
+import math
 import queue
 import threading
 
@@ -6,6 +7,12 @@ from gemini_client import gemini_generate
 
 logger = logging.getLogger(__name__)
 
+# Device log-mel frames (.mel files from audio_tcp.py): int16 log2 mel power
+# in Q8 on int16 PCM with a 512-point FFT. The offset maps them onto
+# Whisper's log10 mel of float PCM with a 400-point FFT.
+MEL_BINS = 80
+MEL_LOG10_OFFSET = 2 * math.log10(32768.0) + math.log10(512 / 400)
+
 class WhisperWorker:
     def __init__(
         self,
@@ -21,6 +28,7 @@ class WhisperWorker:
         self._thread: threading.Thread | None = None
         self._stop = threading.Event()
         self._model = None
+        self._warm = threading.Event()
         self._on_result = on_result
 
     def start(self) -> None:
@@ -38,6 +46,12 @@ class WhisperWorker:
     def submit(self, wav_path: str) -> None:
         self._queue.put(wav_path)
 
+    def warm_up(self) -> None:
+        # Called on the device wake event so the model is loaded while the
+        # user is still speaking. Loading happens on the worker thread.
+        if self._model is None:
+            self._warm.set()
+
     def queue_size(self) -> int:
         return self._queue.qsize()
 
@@ -47,22 +61,57 @@ class WhisperWorker:
         self._model = whisper.load_model(self.model_name)
         logger.info("Whisper model loaded: %s", self.model_name)
 
+    def _transcribe_mel(self, mel_path: str) -> dict:
+        import numpy as np
+        import torch
+        import whisper
+
+        if self._model.dims.n_mels != MEL_BINS:
+            raise ValueError(f"model expects {self._model.dims.n_mels} mel bins, device sends {MEL_BINS}")
+        q = np.fromfile(mel_path, dtype="<i2")
+        mel = q[: len(q) // MEL_BINS * MEL_BINS].reshape(-1, MEL_BINS).T.astype(np.float32)
+        mel = mel / 256.0 * math.log10(2.0) - MEL_LOG10_OFFSET
+        # Same normalization as whisper.log_mel_spectrogram; padding is the
+        # clamped floor, i.e. silence.
+        mel = np.maximum(mel, mel.max() - 8.0)
+        mel = (mel + 4.0) / 4.0
+        frames = whisper.audio.N_FRAMES
+        if mel.shape[1] < frames:
+            mel = np.pad(mel, ((0, 0), (0, frames - mel.shape[1])), constant_values=mel.min())
+        mel = torch.from_numpy(np.ascontiguousarray(mel[:, :frames])).to(self._model.device)
+        options = whisper.DecodingOptions(
+            language=self.language or None,
+            task=self.task,
+            temperature=0.0,
+            fp16=False,
+        )
+        return {"text": whisper.decode(self._model, mel, options).text}
+
     def _run(self) -> None:
         while not self._stop.is_set():
             try:
                 wav_path = self._queue.get(timeout=0.5)
             except queue.Empty:
+                if self._warm.is_set() and self._model is None:
+                    try:
+                        self._load_model()
+                    except Exception:
+                        logger.exception("Whisper warm-up failed")
+                    self._warm.clear()
                 continue
             try:
                 if self._model is None:
                     self._load_model()
-                result = self._model.transcribe(
-                    wav_path,
-                    language=self.language or None,
-                    task=self.task,
-                    temperature=0.0,
-                    fp16=False,
-                )
+                if wav_path.endswith(".mel"):
+                    result = self._transcribe_mel(wav_path)
+                else:
+                    result = self._model.transcribe(
+                        wav_path,
+                        language=self.language or None,
+                        task=self.task,
+                        temperature=0.0,
+                        fp16=False,
+                    )
                 text = (result.get("text") or "").strip()
                 logger.info("Whisper text: %s", text)
                 if text:
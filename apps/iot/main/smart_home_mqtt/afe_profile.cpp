@@ -0,0 +1,202 @@
+#include "afe_profile.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sdkconfig.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+
+#include "task_plan.h"
+
+static const char *TAG = "afe_profile";
+
+static const char *AFE_NVS_NS = TASK_PLAN_AFE_NVS_NS;
+static const char *AFE_NVS_KEY_MODE = "mode";
+static const char *AFE_NVS_KEY_MEM = "mem";
+static const char *AFE_NVS_KEY_RINGBUF = "ringbuf";
+static const char *AFE_NVS_KEY_VAD = "vad";
+static const char *AFE_NVS_KEY_NS = "ns";
+
+void afe_profile_defaults(afe_profile_t *profile) {
+    if (!profile) {
+        return;
+    }
+#if CONFIG_SMART_HOME_AFE_MODE_HIGH_PERF
+    profile->mode = AFE_MODE_HIGH_PERF;
+#else
+    profile->mode = AFE_MODE_LOW_COST;
+#endif
+    // Placement is task_plan's, NVS override included.
+    const task_spec_t *spec = task_plan_get(TASK_ID_AFE);
+    profile->core = spec->core;
+    profile->priority = spec->priority;
+#if CONFIG_SMART_HOME_AFE_MEM_MORE_INTERNAL
+    profile->memory_alloc_mode = AFE_MEMORY_ALLOC_MORE_INTERNAL;
+#elif CONFIG_SMART_HOME_AFE_MEM_BALANCE
+    profile->memory_alloc_mode = AFE_MEMORY_ALLOC_INTERNAL_PSRAM_BALANCE;
+#else
+    profile->memory_alloc_mode = AFE_MEMORY_ALLOC_MORE_PSRAM;
+#endif
+    profile->ringbuf_size = CONFIG_SMART_HOME_AFE_RINGBUF_SIZE;
+#if CONFIG_SMART_HOME_AFE_VAD
+    profile->vad_init = true;
+#else
+    profile->vad_init = false;
+#endif
+#if CONFIG_SMART_HOME_AFE_NS
+    profile->ns_init = true;
+#else
+    profile->ns_init = false;
+#endif
+}
+
+bool afe_profile_load(afe_profile_t *profile) {
+    if (!profile) {
+        return false;
+    }
+    nvs_handle_t handle;
+    if (nvs_open(AFE_NVS_NS, NVS_READONLY, &handle) != ESP_OK) {
+        return false;
+    }
+    bool changed = false;
+    uint8_t u8 = 0;
+    int32_t i32 = 0;
+    if (nvs_get_u8(handle, AFE_NVS_KEY_MODE, &u8) == ESP_OK) {
+        profile->mode = u8 ? AFE_MODE_HIGH_PERF : AFE_MODE_LOW_COST;
+        changed = true;
+    }
+    if (nvs_get_u8(handle, AFE_NVS_KEY_MEM, &u8) == ESP_OK &&
+        u8 >= AFE_MEMORY_ALLOC_MORE_INTERNAL && u8 <= AFE_MEMORY_ALLOC_MORE_PSRAM) {
+        profile->memory_alloc_mode = (afe_memory_alloc_mode_t)u8;
+        changed = true;
+    }
+    if (nvs_get_i32(handle, AFE_NVS_KEY_RINGBUF, &i32) == ESP_OK && i32 > 0) {
+        profile->ringbuf_size = i32;
+        changed = true;
+    }
+    if (nvs_get_u8(handle, AFE_NVS_KEY_VAD, &u8) == ESP_OK) {
+        profile->vad_init = u8 != 0;
+        changed = true;
+    }
+    if (nvs_get_u8(handle, AFE_NVS_KEY_NS, &u8) == ESP_OK) {
+        profile->ns_init = u8 != 0;
+        changed = true;
+    }
+    nvs_close(handle);
+    return changed;
+}
+
+void afe_profile_apply(const afe_profile_t *profile, afe_config_t *config) {
+    if (!profile || !config) {
+        return;
+    }
+    config->afe_mode = profile->mode;
+    config->afe_perferred_core = profile->core;
+    config->afe_perferred_priority = profile->priority;
+    config->memory_alloc_mode = profile->memory_alloc_mode;
+    config->afe_ringbuf_size = profile->ringbuf_size;
+    config->vad_init = profile->vad_init;
+    config->ns_init = profile->ns_init;
+    config->wakenet_init = true;
+}
+
+const char *afe_profile_mode_name(afe_mode_t mode) {
+    return mode == AFE_MODE_HIGH_PERF ? "HIGH_PERF" : "LOW_COST";
+}
+
+void afe_profile_log(const char *prefix, const afe_profile_t *profile) {
+    if (!profile) {
+        return;
+    }
+    ESP_LOGI(TAG, "%s: mode=%s core=%d prio=%d mem=%d ringbuf=%d vad=%d ns=%d",
+             prefix ? prefix : "AFE profile", afe_profile_mode_name(profile->mode),
+             profile->core, profile->priority, (int)profile->memory_alloc_mode,
+             profile->ringbuf_size, profile->vad_init ? 1 : 0, profile->ns_init ? 1 : 0);
+}
+
+static void afe_benchmark_mode(srmodel_list_t *models, const afe_profile_t *base, afe_mode_t mode, int frames) {
+    afe_profile_t profile = *base;
+    profile.mode = mode;
+
+    size_t internal_before = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    size_t psram_before = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    int64_t create_start = esp_timer_get_time();
+
+    afe_config_t *config = afe_config_init("M", models, AFE_TYPE_SR, mode);
+    if (!config) {
+        ESP_LOGW(TAG, "Benchmark %s: config init failed", afe_profile_mode_name(mode));
+        return;
+    }
+    afe_profile_apply(&profile, config);
+    esp_afe_sr_iface_t *handle = (esp_afe_sr_iface_t *)esp_afe_handle_from_config(config);
+    esp_afe_sr_data_t *data = handle ? handle->create_from_config(config) : NULL;
+    afe_config_free(config);
+    if (!data) {
+        ESP_LOGW(TAG, "Benchmark %s: AFE create failed", afe_profile_mode_name(mode));
+        return;
+    }
+    int create_us = (int)(esp_timer_get_time() - create_start);
+    size_t internal_used = internal_before - heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    size_t psram_used = psram_before - heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+
+    int feed_chunk = handle->get_feed_chunksize(data);
+    int sample_rate = handle->get_samp_rate(data);
+    int chunk = feed_chunk * handle->get_channel_num(data);
+    int16_t *buf = (int16_t *)malloc(chunk * sizeof(int16_t));
+    if (!buf) {
+        handle->destroy(data);
+        return;
+    }
+    // Low-level noise keeps VAD/NS on their normal code paths.
+    uint32_t lfsr = 0xACE1u;
+    int64_t feed_total = 0;
+    int64_t fetch_total = 0;
+    int feed_max = 0;
+    int fetch_max = 0;
+    int fetched = 0;
+    for (int f = 0; f < frames; f++) {
+        for (int i = 0; i < chunk; i++) {
+            lfsr = (lfsr >> 1) ^ (-(lfsr & 1u) & 0xB400u);
+            buf[i] = (int16_t)((int)(lfsr & 0xFF) - 128);
+        }
+        int64_t t0 = esp_timer_get_time();
+        handle->feed(data, buf);
+        int64_t t1 = esp_timer_get_time();
+        afe_fetch_result_t *res = handle->fetch(data);
+        int64_t t2 = esp_timer_get_time();
+        int feed_us = (int)(t1 - t0);
+        int fetch_us = (int)(t2 - t1);
+        feed_total += feed_us;
+        fetch_total += fetch_us;
+        if (feed_us > feed_max) feed_max = feed_us;
+        if (fetch_us > fetch_max) fetch_max = fetch_us;
+        if (res && res->ret_value != ESP_FAIL) fetched++;
+    }
+    free(buf);
+    handle->destroy(data);
+
+    int frame_us = sample_rate > 0 ? (int)(((int64_t)feed_chunk * 1000000) / sample_rate) : 0;
+    int avg_feed = frames > 0 ? (int)(feed_total / frames) : 0;
+    int avg_fetch = frames > 0 ? (int)(fetch_total / frames) : 0;
+    ESP_LOGI(TAG, "Benchmark %s: create=%dus feed avg/max=%d/%dus fetch avg/max=%d/%dus "
+             "frame=%dus rt=%d%% fetched=%d/%d heap internal=%u psram=%u",
+             afe_profile_mode_name(mode), create_us, avg_feed, feed_max, avg_fetch, fetch_max,
+             frame_us, frame_us > 0 ? ((avg_feed + avg_fetch) * 100) / frame_us : 0,
+             fetched, frames, (unsigned)internal_used, (unsigned)psram_used);
+}
+
+void afe_profile_benchmark(srmodel_list_t *models, const afe_profile_t *base, int frames) {
+    if (!models || !base || frames <= 0) {
+        return;
+    }
+    afe_profile_log("Benchmark base", base);
+    afe_benchmark_mode(models, base, AFE_MODE_LOW_COST, frames);
+    afe_benchmark_mode(models, base, AFE_MODE_HIGH_PERF, frames);
+    ESP_LOGI(TAG, "Benchmark done, free internal=%u psram=%u",
+             (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+             (unsigned)heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+
+extern "C" {
+#include "esp_afe_sr_iface.h"
+#include "esp_afe_sr_models.h"
+}
+
+// AFE settings that used to be hard-coded in esp_sr_init. Defaults come
+// from Kconfig and can be overridden per board from the "afe" NVS namespace.
+// core and priority are the exception: they come from
+// task_plan_get(TASK_ID_AFE), which owns their "core"/"prio" override.
+typedef struct {
+    afe_mode_t mode;
+    int core;
+    int priority;
+    afe_memory_alloc_mode_t memory_alloc_mode;
+    int ringbuf_size;
+    bool vad_init;
+    bool ns_init;
+} afe_profile_t;
+
+void afe_profile_defaults(afe_profile_t *profile);
+bool afe_profile_load(afe_profile_t *profile);
+void afe_profile_apply(const afe_profile_t *profile, afe_config_t *config);
+void afe_profile_log(const char *prefix, const afe_profile_t *profile);
+const char *afe_profile_mode_name(afe_mode_t mode);
+
+// Creates a throw-away AFE instance per mode and reports feed/fetch timing
+// and heap cost. Runs before the real AFE is created.
+void afe_profile_benchmark(srmodel_list_t *models, const afe_profile_t *base, int frames);
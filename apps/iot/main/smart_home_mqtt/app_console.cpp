@@ -0,0 +1,122 @@
+#include "app_console.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_console.h"
+#include "esp_log.h"
+
+#include "audio_deadline.h"
+#include "ota_update.h"
+#include "params.h"
+#include "power_profile.h"
+#include "task_plan.h"
+
+static const char *TAG = "console";
+
+static int cmd_deadline(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        audio_deadline_reset();
+        printf("deadline stats reset\n");
+        return 0;
+    }
+    static audio_deadline_stats_t stats;
+    audio_deadline_snapshot(&stats);
+    printf("budget=%luus chunks=%lu late=%lu dropped=%lu max=%luus\n",
+           (unsigned long)stats.budget_us, (unsigned long)stats.chunks, (unsigned long)stats.late,
+           (unsigned long)stats.dropped, (unsigned long)stats.max_latency_us);
+    for (int i = 0; i < AUDIO_DEADLINE_BUCKETS; i++) {
+        if (i < AUDIO_DEADLINE_BUCKETS - 1) {
+            printf("  <=%6luus %lu\n", (unsigned long)stats.bucket_edges_us[i], (unsigned long)stats.buckets[i]);
+        } else {
+            printf("  > %6luus %lu\n", (unsigned long)stats.bucket_edges_us[i - 1], (unsigned long)stats.buckets[i]);
+        }
+    }
+    for (int c = DEADLINE_CAUSE_NONE; c < DEADLINE_CAUSE_COUNT; c++) {
+        printf("  late[%s]=%lu\n", audio_deadline_cause_name((deadline_cause_t)c),
+               (unsigned long)stats.late_by_cause[c]);
+    }
+    for (int i = 0; i < stats.event_count; i++) {
+        const deadline_event_t *ev = &stats.events[i];
+        printf("  #%d t=%lums chunk=%lu %s latency=%luus cause=%s\n", i, (unsigned long)ev->timestamp_ms,
+               (unsigned long)ev->chunk, ev->dropped ? "DROP" : "LATE", (unsigned long)ev->latency_us,
+               audio_deadline_cause_name((deadline_cause_t)ev->cause));
+    }
+    return 0;
+}
+
+static int cmd_power(int argc, char **argv) {
+    if (argc > 1) {
+        power_profile_t profile;
+        if (!power_profile_parse(argv[1], &profile)) {
+            printf("usage: power [performance|balanced|min_modem]\n");
+            return 1;
+        }
+        power_profile_set(profile, true);
+    }
+    static char buf[640];
+    power_profile_format_json(buf, sizeof(buf));
+    printf("%s\n", buf);
+    return 0;
+}
+
+static int cmd_param(int argc, char **argv) {
+    if (argc > 1) {
+        // Re-join the arguments: "param silence_ms=1500 agg_frames=4".
+        char text[256];
+        int n = 0;
+        for (int i = 1; i < argc && n < (int)sizeof(text); i++) {
+            n += snprintf(text + n, sizeof(text) - n, "%s%s", i > 1 ? " " : "", argv[i]);
+        }
+        if (n >= (int)sizeof(text) || !params_apply_text(text, strlen(text), true)) {
+            printf("usage: param [name=value ...|reset]\n");
+            return 1;
+        }
+    }
+    static char buf[768];
+    params_format_json(buf, sizeof(buf));
+    printf("%s\n", buf);
+    return 0;
+}
+
+static int cmd_ota(int argc, char **argv) {
+    int rc = 0;
+    if (argc > 1 && !ota_update_start(argv[1], strlen(argv[1]))) {
+        printf("update not started (one already running, or URL too long)\n");
+        rc = 1;
+    }
+    static char buf[256];
+    ota_update_format_json(buf, sizeof(buf));
+    printf("%s\n", buf);
+    return rc;
+}
+
+static void console_register(const char *name, const char *help, esp_console_cmd_func_t fn) {
+    esp_console_cmd_t cmd = {};
+    cmd.command = name;
+    cmd.help = help;
+    cmd.func = fn;
+    if (esp_console_cmd_register(&cmd) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to register '%s'", name);
+    }
+}
+
+void app_console_start(void) {
+    const task_spec_t *spec = task_plan_get(TASK_ID_CONSOLE);
+    esp_console_repl_t *repl = NULL;
+    esp_console_repl_config_t repl_config = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+    repl_config.prompt = "smart>";
+    repl_config.task_stack_size = spec->stack;
+    repl_config.task_priority = spec->priority;
+    repl_config.task_core_id = spec->core;
+    esp_console_dev_uart_config_t uart_config = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
+    if (esp_console_new_repl_uart(&uart_config, &repl_config, &repl) != ESP_OK) {
+        ESP_LOGW(TAG, "Console init failed");
+        return;
+    }
+    console_register("deadline", "Audio frame deadline histogram and overruns ('deadline reset' clears)", cmd_deadline);
+    console_register("power", "Show power profile stats, or switch and persist ('power balanced')", cmd_power);
+    console_register("ota", "Show OTA update state, or update from a delta URL ('ota https://host/fw.delta')", cmd_ota);
+    console_register("param", "Show tuning parameters, or set and persist ('param silence_ms=1500')", cmd_param);
+    esp_console_start_repl(repl);
+}
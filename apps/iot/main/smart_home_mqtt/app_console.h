@@ -0,0 +1,5 @@
+#pragma once
+
+// Serial console (UART REPL) with diagnostic commands. Runs on the
+// network core at low priority.
+void app_console_start(void);
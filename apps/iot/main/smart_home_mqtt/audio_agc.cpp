@@ -0,0 +1,80 @@
+#include "audio_agc.h"
+
+static const int32_t AGC_TARGET_PEAK = 16000; // about -6 dBFS
+static const int32_t AGC_LIMIT = 30000;
+static const int32_t AGC_NOISE_FLOOR = 48;
+static const int32_t AGC_MIN_GAIN_Q8 = 64;    // -12 dB
+static const int32_t AGC_MAX_GAIN_Q8 = 4096;  // +24 dB
+static const int32_t AGC_RELEASE_SHIFT = 3;
+
+void audio_agc_init(audio_agc_t *agc, int32_t initial_gain_q8) {
+    if (!agc) {
+        return;
+    }
+    agc->target_peak = AGC_TARGET_PEAK;
+    agc->limit = AGC_LIMIT;
+    agc->noise_floor = AGC_NOISE_FLOOR;
+    agc->min_gain_q8 = AGC_MIN_GAIN_Q8;
+    agc->max_gain_q8 = AGC_MAX_GAIN_Q8;
+    agc->release_shift = AGC_RELEASE_SHIFT;
+    if (initial_gain_q8 < agc->min_gain_q8) initial_gain_q8 = agc->min_gain_q8;
+    if (initial_gain_q8 > agc->max_gain_q8) initial_gain_q8 = agc->max_gain_q8;
+    agc->gain_q8 = initial_gain_q8;
+    agc->last_peak = 0;
+    agc->frames = 0;
+    agc->limited_frames = 0;
+    agc->clip_samples = 0;
+    agc->input_clip_samples = 0;
+}
+
+int32_t audio_agc_process(audio_agc_t *agc, const audio_frame_ops_t *ops, const int32_t *in, int16_t *out,
+                          int samples) {
+    if (!agc || !ops || !in || !out || samples <= 0) {
+        return agc ? agc->gain_q8 : 256;
+    }
+
+    // Pass 1: I2S -> 16-bit and block peak. The whole chunk is known
+    // before any output is written, which gives the limiter its look-ahead.
+    uint32_t input_clips = 0;
+    int32_t peak = ops->scan(in, out, samples, &input_clips);
+
+    int32_t prev_gain = agc->gain_q8;
+    int32_t gain = prev_gain;
+    bool limited = false;
+    if (peak > agc->noise_floor) {
+        int32_t desired = (int32_t)(((int64_t)agc->target_peak << 8) / peak);
+        if (desired > agc->max_gain_q8) desired = agc->max_gain_q8;
+        if (desired < agc->min_gain_q8) desired = agc->min_gain_q8;
+        if (desired > gain) {
+            gain += (desired - gain) >> agc->release_shift;
+            if (gain == prev_gain) gain++;
+        } else {
+            gain = desired;
+        }
+        if ((int64_t)peak * gain > ((int64_t)agc->limit << 8)) {
+            gain = (int32_t)(((int64_t)agc->limit << 8) / peak);
+            limited = true;
+        }
+    }
+
+    // Pass 2: apply the gain. A rising gain is ramped across the block to
+    // avoid zipper noise; a falling gain takes effect at the first sample
+    // so the block peak never exceeds the limit.
+    int32_t step_q16 = 0;
+    int32_t g_q16 = gain << 8;
+    if (gain > prev_gain) {
+        step_q16 = ((gain - prev_gain) << 8) / samples;
+        g_q16 = prev_gain << 8;
+    }
+    uint32_t clips = ops->apply_gain(out, samples, g_q16, step_q16);
+
+    agc->gain_q8 = gain;
+    agc->last_peak = peak;
+    agc->frames++;
+    agc->clip_samples += clips;
+    agc->input_clip_samples += input_clips;
+    if (limited) {
+        agc->limited_frames++;
+    }
+    return gain;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "audio_frame.h"
+
+// Block-based fixed-point AGC for the I2S -> AFE conversion pass.
+// Gains are Q8 (256 = 0 dB). Each call processes one feed chunk in two
+// linear passes with a single division, so the cost per chunk is fixed.
+typedef struct {
+    int32_t target_peak;     // block peak the AGC steers towards
+    int32_t limit;           // look-ahead limiter ceiling
+    int32_t noise_floor;     // below this input peak the gain is held
+    int32_t min_gain_q8;
+    int32_t max_gain_q8;
+    int32_t release_shift;   // gain rises by (desired - gain) >> release_shift per block
+    int32_t gain_q8;         // gain applied to the last block
+    int32_t last_peak;       // input peak of the last block (16-bit scale)
+    uint32_t frames;
+    uint32_t limited_frames; // blocks where the limiter pulled the gain down
+    uint32_t clip_samples;   // output samples that still had to be saturated
+    uint32_t input_clip_samples; // input samples already at full scale
+} audio_agc_t;
+
+void audio_agc_init(audio_agc_t *agc, int32_t initial_gain_q8);
+
+// Converts I2S samples to 16-bit PCM with gain applied, using the scan and
+// apply_gain kernels from audio_frame_select(). Returns the gain (Q8) used
+// at the end of the block.
+int32_t audio_agc_process(audio_agc_t *agc, const audio_frame_ops_t *ops, const int32_t *in, int16_t *out,
+                          int samples);
@@ -0,0 +1,187 @@
+#include "audio_deadline.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Bucket edges as a fraction of the frame budget (percent).
+static const uint32_t DEADLINE_BUCKET_PCT[AUDIO_DEADLINE_BUCKETS - 1] = {25, 50, 75, 100, 150, 200, 400};
+
+static const char *DEADLINE_CAUSE_NAMES[DEADLINE_CAUSE_COUNT] = {"none", "afe", "lcd", "net", "i2s", "mel"};
+
+static uint32_t budget_us = 0;
+static uint32_t bucket_edges_us[AUDIO_DEADLINE_BUCKETS - 1];
+
+// Chunk state, only touched by the owning audio task.
+static TaskHandle_t owner_task = NULL;
+static int64_t chunk_capture_us = 0;
+static int64_t section_us[DEADLINE_CAUSE_COUNT];
+
+static std::atomic<uint32_t> chunks{0};
+static std::atomic<uint32_t> late{0};
+static std::atomic<uint32_t> dropped{0};
+static std::atomic<uint32_t> max_latency_us{0};
+static std::atomic<uint32_t> buckets[AUDIO_DEADLINE_BUCKETS];
+static std::atomic<uint32_t> late_by_cause[DEADLINE_CAUSE_COUNT];
+
+static portMUX_TYPE events_lock = portMUX_INITIALIZER_UNLOCKED;
+static deadline_event_t events[AUDIO_DEADLINE_EVENTS];
+static int events_head = 0;
+static int events_count = 0;
+
+static void deadline_push_event(uint32_t latency, deadline_cause_t cause, bool was_dropped) {
+    deadline_event_t ev;
+    ev.timestamp_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    ev.latency_us = latency;
+    ev.chunk = chunks.load(std::memory_order_relaxed);
+    ev.cause = (uint8_t)cause;
+    ev.dropped = was_dropped ? 1 : 0;
+    portENTER_CRITICAL(&events_lock);
+    events[events_head] = ev;
+    events_head = (events_head + 1) % AUDIO_DEADLINE_EVENTS;
+    if (events_count < AUDIO_DEADLINE_EVENTS) {
+        events_count++;
+    }
+    portEXIT_CRITICAL(&events_lock);
+}
+
+void audio_deadline_init(uint32_t budget) {
+    budget_us = budget;
+    for (int i = 0; i < AUDIO_DEADLINE_BUCKETS - 1; i++) {
+        bucket_edges_us[i] = (budget * DEADLINE_BUCKET_PCT[i]) / 100;
+    }
+    owner_task = xTaskGetCurrentTaskHandle();
+    audio_deadline_reset();
+}
+
+void audio_deadline_begin(int64_t capture_us) {
+    chunk_capture_us = capture_us;
+    memset(section_us, 0, sizeof(section_us));
+}
+
+void audio_deadline_account(deadline_cause_t cause, int64_t elapsed_us) {
+    if (chunk_capture_us == 0 || cause >= DEADLINE_CAUSE_COUNT || xTaskGetCurrentTaskHandle() != owner_task) {
+        return;
+    }
+    section_us[cause] += elapsed_us;
+}
+
+void audio_deadline_end(void) {
+    if (chunk_capture_us == 0) {
+        return;
+    }
+    int64_t elapsed = esp_timer_get_time() - chunk_capture_us;
+    chunk_capture_us = 0;
+    uint32_t latency = elapsed > 0 ? (uint32_t)elapsed : 0;
+
+    int bucket = AUDIO_DEADLINE_BUCKETS - 1;
+    for (int i = 0; i < AUDIO_DEADLINE_BUCKETS - 1; i++) {
+        if (latency <= bucket_edges_us[i]) {
+            bucket = i;
+            break;
+        }
+    }
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    chunks.fetch_add(1, std::memory_order_relaxed);
+    if (latency > max_latency_us.load(std::memory_order_relaxed)) {
+        max_latency_us.store(latency, std::memory_order_relaxed);
+    }
+
+    if (latency > budget_us) {
+        deadline_cause_t cause = DEADLINE_CAUSE_NONE;
+        int64_t worst = 0;
+        for (int c = DEADLINE_CAUSE_NONE + 1; c < DEADLINE_CAUSE_COUNT; c++) {
+            if (section_us[c] > worst) {
+                worst = section_us[c];
+                cause = (deadline_cause_t)c;
+            }
+        }
+        late.fetch_add(1, std::memory_order_relaxed);
+        late_by_cause[cause].fetch_add(1, std::memory_order_relaxed);
+        deadline_push_event(latency, cause, false);
+    }
+}
+
+void audio_deadline_dropped(deadline_cause_t cause) {
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    deadline_push_event(0, cause, true);
+}
+
+void audio_deadline_reset(void) {
+    chunks.store(0);
+    late.store(0);
+    dropped.store(0);
+    max_latency_us.store(0);
+    for (int i = 0; i < AUDIO_DEADLINE_BUCKETS; i++) {
+        buckets[i].store(0);
+    }
+    for (int i = 0; i < DEADLINE_CAUSE_COUNT; i++) {
+        late_by_cause[i].store(0);
+    }
+    portENTER_CRITICAL(&events_lock);
+    events_head = 0;
+    events_count = 0;
+    portEXIT_CRITICAL(&events_lock);
+}
+
+uint32_t audio_deadline_late_count(void) {
+    return late.load(std::memory_order_relaxed);
+}
+
+void audio_deadline_snapshot(audio_deadline_stats_t *out) {
+    if (!out) {
+        return;
+    }
+    out->budget_us = budget_us;
+    out->chunks = chunks.load(std::memory_order_relaxed);
+    out->late = late.load(std::memory_order_relaxed);
+    out->dropped = dropped.load(std::memory_order_relaxed);
+    out->max_latency_us = max_latency_us.load(std::memory_order_relaxed);
+    memcpy(out->bucket_edges_us, bucket_edges_us, sizeof(bucket_edges_us));
+    for (int i = 0; i < AUDIO_DEADLINE_BUCKETS; i++) {
+        out->buckets[i] = buckets[i].load(std::memory_order_relaxed);
+    }
+    for (int i = 0; i < DEADLINE_CAUSE_COUNT; i++) {
+        out->late_by_cause[i] = late_by_cause[i].load(std::memory_order_relaxed);
+    }
+    portENTER_CRITICAL(&events_lock);
+    out->event_count = events_count;
+    for (int i = 0; i < events_count; i++) {
+        int idx = (events_head - 1 - i + AUDIO_DEADLINE_EVENTS) % AUDIO_DEADLINE_EVENTS;
+        out->events[i] = events[idx];
+    }
+    portEXIT_CRITICAL(&events_lock);
+}
+
+const char *audio_deadline_cause_name(deadline_cause_t cause) {
+    if (cause >= DEADLINE_CAUSE_COUNT) {
+        return "?";
+    }
+    return DEADLINE_CAUSE_NAMES[cause];
+}
+
+int audio_deadline_format_json(char *buf, size_t len) {
+    static audio_deadline_stats_t stats;
+    audio_deadline_snapshot(&stats);
+    int n = snprintf(buf, len, "{\"budget_us\":%lu,\"chunks\":%lu,\"late\":%lu,\"dropped\":%lu,\"max_us\":%lu,\"hist\":[",
+                     (unsigned long)stats.budget_us, (unsigned long)stats.chunks, (unsigned long)stats.late,
+                     (unsigned long)stats.dropped, (unsigned long)stats.max_latency_us);
+    for (int i = 0; i < AUDIO_DEADLINE_BUCKETS && n < (int)len; i++) {
+        n += snprintf(buf + n, len - n, "%s%lu", i > 0 ? "," : "", (unsigned long)stats.buckets[i]);
+    }
+    if (n < (int)len) {
+        n += snprintf(buf + n, len - n, "],\"late_by\":{");
+    }
+    for (int c = 0; c < DEADLINE_CAUSE_COUNT && n < (int)len; c++) {
+        n += snprintf(buf + n, len - n, "%s\"%s\":%lu", c > 0 ? "," : "",
+                      DEADLINE_CAUSE_NAMES[c], (unsigned long)stats.late_by_cause[c]);
+    }
+    if (n < (int)len) {
+        n += snprintf(buf + n, len - n, "}}");
+    }
+    return n;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Per-chunk real-time accounting for audio_task. A chunk opens when I2S
+// hands over data and closes when processing is done; anything slower
+// than the frame budget is counted as late and logged with the section
+// (AFE, LCD, network, log-mel) that consumed most of the chunk.
+typedef enum {
+    DEADLINE_CAUSE_NONE = 0,
+    DEADLINE_CAUSE_AFE,
+    DEADLINE_CAUSE_LCD,
+    DEADLINE_CAUSE_NET,
+    DEADLINE_CAUSE_I2S,
+    DEADLINE_CAUSE_MEL,
+    DEADLINE_CAUSE_COUNT,
+} deadline_cause_t;
+
+#define AUDIO_DEADLINE_BUCKETS 8
+#define AUDIO_DEADLINE_EVENTS 16
+
+typedef struct {
+    uint32_t timestamp_ms;
+    uint32_t latency_us;
+    uint32_t chunk;
+    uint8_t cause;
+    uint8_t dropped;
+} deadline_event_t;
+
+typedef struct {
+    uint32_t budget_us;
+    uint32_t chunks;
+    uint32_t late;
+    uint32_t dropped;
+    uint32_t max_latency_us;
+    uint32_t bucket_edges_us[AUDIO_DEADLINE_BUCKETS - 1];
+    uint32_t buckets[AUDIO_DEADLINE_BUCKETS];
+    uint32_t late_by_cause[DEADLINE_CAUSE_COUNT];
+    int event_count;
+    deadline_event_t events[AUDIO_DEADLINE_EVENTS]; // newest first
+} audio_deadline_stats_t;
+
+void audio_deadline_init(uint32_t budget_us);
+void audio_deadline_begin(int64_t capture_us);
+void audio_deadline_account(deadline_cause_t cause, int64_t elapsed_us);
+void audio_deadline_end(void);
+void audio_deadline_dropped(deadline_cause_t cause);
+void audio_deadline_reset(void);
+
+uint32_t audio_deadline_late_count(void);
+void audio_deadline_snapshot(audio_deadline_stats_t *out);
+const char *audio_deadline_cause_name(deadline_cause_t cause);
+int audio_deadline_format_json(char *buf, size_t len);
@@ -0,0 +1,160 @@
+#include "audio_flow.h"
+
+#include <string.h>
+
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "mem_arena.h"
+#include "metrics.h"
+
+static const char *TAG = "audio_flow";
+
+static const size_t BACKLOG_BYTES = (size_t)CONFIG_SMART_HOME_AUDIO_BACKLOG_KB * 1024;
+
+// Backlog records are 4-byte aligned. A record that does not fit before
+// the end of the ring starts at 0, and a len of 0 marks the skipped end.
+typedef struct {
+    uint16_t len;     // packet bytes
+    uint16_t payload; // bytes counted against the credit
+} flow_record_t;
+
+static uint8_t *ring = NULL;
+static size_t ring_size = 0;
+static size_t head = 0;
+static size_t tail = 0;
+static size_t used = 0; // records, headers and skipped ends
+
+static bool credit_mode = false;
+static uint32_t granted = 0;
+static uint32_t sent = 0;
+static int64_t stall_start_us = 0; // 0: not stalled
+static int64_t progress_us = 0;    // stall start or the last credit since
+
+static size_t record_size(size_t len) {
+    return (sizeof(flow_record_t) + len + 3) & ~(size_t)3;
+}
+
+size_t audio_flow_memory_bytes(void) {
+    return BACKLOG_BYTES ? mem_arena_round(BACKLOG_BYTES) : 0;
+}
+
+bool audio_flow_init(void) {
+    if (ring || BACKLOG_BYTES == 0) {
+        return true;
+    }
+    ring = (uint8_t *)mem_arena_alloc(MEM_REGION_SPIRAM, BACKLOG_BYTES);
+    if (!ring) {
+        ESP_LOGE(TAG, "No memory for a %u byte audio backlog", (unsigned)BACKLOG_BYTES);
+        return false;
+    }
+    ring_size = BACKLOG_BYTES & ~(size_t)3;
+    return true;
+}
+
+static void stall_end(void) {
+    if (stall_start_us) {
+        metrics_histogram_observe(METRIC_AUDIO_CREDIT_STALL_US, (uint32_t)(esp_timer_get_time() - stall_start_us));
+        stall_start_us = 0;
+    }
+}
+
+void audio_flow_reset(void) {
+    stall_end();
+    head = tail = used = 0;
+    credit_mode = false;
+    granted = sent = 0;
+    metrics_gauge_set(METRIC_AUDIO_BACKLOG_BYTES, 0);
+}
+
+void audio_flow_credit(uint32_t total) {
+    if (!credit_mode || (int32_t)(total - granted) > 0) {
+        progress_us = esp_timer_get_time();
+    }
+    credit_mode = true;
+    granted = total;
+}
+
+bool audio_flow_can_send(uint16_t payload_bytes) {
+    return !credit_mode || (int32_t)(granted - sent - payload_bytes) >= 0;
+}
+
+void audio_flow_sent(uint16_t payload_bytes) {
+    sent += payload_bytes;
+    // Without a backlog a stall ends with the first packet sent again.
+    if (used == 0) {
+        stall_end();
+    }
+}
+
+bool audio_flow_enqueue(const uint8_t *packet, size_t len, uint16_t payload_bytes) {
+    if (!stall_start_us) {
+        stall_start_us = progress_us = esp_timer_get_time();
+        metrics_counter_inc(METRIC_AUDIO_CREDIT_STALLS);
+    }
+    size_t need = record_size(len);
+    size_t skip = ring_size - tail < need ? ring_size - tail : 0;
+    if (!ring || len > UINT16_MAX || used + skip + need > ring_size) {
+        metrics_counter_inc(METRIC_AUDIO_BACKLOG_DROPS);
+        return false;
+    }
+    if (skip) {
+        ((flow_record_t *)&ring[tail])->len = 0;
+        used += skip;
+        tail = 0;
+    }
+    flow_record_t *rec = (flow_record_t *)&ring[tail];
+    rec->len = (uint16_t)len;
+    rec->payload = payload_bytes;
+    memcpy(rec + 1, packet, len);
+    used += need;
+    tail += need;
+    if (tail == ring_size) {
+        tail = 0;
+    }
+    metrics_gauge_set(METRIC_AUDIO_BACKLOG_BYTES, (int32_t)used);
+    return true;
+}
+
+const uint8_t *audio_flow_peek(size_t *len, uint16_t *payload_bytes) {
+    if (used == 0) {
+        return NULL;
+    }
+    flow_record_t *rec = (flow_record_t *)&ring[head];
+    if (rec->len == 0) {
+        used -= ring_size - head;
+        head = 0;
+        rec = (flow_record_t *)ring;
+    }
+    *len = rec->len;
+    *payload_bytes = rec->payload;
+    return (const uint8_t *)(rec + 1);
+}
+
+void audio_flow_pop(void) {
+    size_t len;
+    uint16_t payload;
+    if (!audio_flow_peek(&len, &payload)) {
+        return;
+    }
+    size_t size = record_size(len);
+    used -= size;
+    head += size;
+    if (head == ring_size) {
+        head = 0;
+    }
+    if (used == 0) {
+        head = tail = 0;
+        stall_end();
+    }
+    metrics_gauge_set(METRIC_AUDIO_BACKLOG_BYTES, (int32_t)used);
+}
+
+size_t audio_flow_backlog_bytes(void) {
+    return used;
+}
+
+int64_t audio_flow_stalled_us(int64_t now_us) {
+    return stall_start_us ? now_us - progress_us : 0;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Receiver-driven flow control for the audio stream. The server grants
+// payload bytes with CRED messages (audio_stream.h); a connection stays
+// unlimited until the first CRED, so servers without credits see the old
+// behaviour. Packets the credit does not cover wait in a PSRAM backlog and
+// go out, oldest first, as credits arrive; the session keeps recording
+// instead of blocking in send() until SO_SNDTIMEO aborts it. A packet that
+// does not fit the backlog is dropped, and the server fills its sequence
+// gap with silence.
+//
+// The state is per connection: audio_close_socket() resets it. Stalls
+// (a packet queued for lack of credit until the backlog is empty again)
+// are counted and timed in metrics.h, along with the backlog size and
+// dropped packets.
+
+size_t audio_flow_memory_bytes(void);
+// Takes the backlog from MEM_REGION_SPIRAM; without it every packet the
+// credit does not cover is dropped.
+bool audio_flow_init(void);
+void audio_flow_reset(void);
+
+// total is the payload byte count granted since STRT (wraps at 2^32).
+void audio_flow_credit(uint32_t total);
+bool audio_flow_can_send(uint16_t payload_bytes);
+void audio_flow_sent(uint16_t payload_bytes);
+
+// Copies a packet into the backlog; false when it had to be dropped.
+bool audio_flow_enqueue(const uint8_t *packet, size_t len, uint16_t payload_bytes);
+// Oldest queued packet, NULL when the backlog is empty.
+const uint8_t *audio_flow_peek(size_t *len, uint16_t *payload_bytes);
+void audio_flow_pop(void);
+size_t audio_flow_backlog_bytes(void);
+
+// How long the current stall has gone without a new credit; 0 when not
+// stalled.
+int64_t audio_flow_stalled_us(int64_t now_us);
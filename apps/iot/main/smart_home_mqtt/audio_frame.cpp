@@ -0,0 +1,200 @@
+#include "audio_frame.h"
+
+#include <utility>
+
+// Builds on the host as well (apps/iot/scripts/audio_frame_bench.cpp), so
+// nothing here depends on ESP-IDF.
+
+// Chunk 0 and gain shift -1 mean "taken from the arguments": the generic
+// instantiation.
+static const int RUNTIME_CHUNK = 0;
+static const int RUNTIME_GAIN = -1;
+
+template <audio_input_format_t F>
+struct input_traits;
+
+// 24 significant bits at the top of the slot; PCM16 is the top 16.
+template <>
+struct input_traits<AUDIO_INPUT_S24_IN_32> {
+    static const int PCM16_SHIFT = 16;
+};
+
+// Compiles to CLAMPS on Xtensa and to min/max on the host.
+static inline int32_t sat16(int32_t s) {
+    return s > 32767 ? 32767 : (s < -32768 ? -32768 : s);
+}
+
+static inline int32_t abs32(int32_t s) {
+    return s < 0 ? -s : s;
+}
+
+template <audio_input_format_t F, int Chunk>
+static int32_t scan_kernel(const int32_t *in, int16_t *out, int samples, uint32_t *full_scale) {
+    if constexpr (Chunk != RUNTIME_CHUNK) {
+        if (samples != Chunk) {
+            return scan_kernel<F, RUNTIME_CHUNK>(in, out, samples, full_scale);
+        }
+    }
+    int32_t peak = 0;
+    uint32_t clips = 0;
+    if constexpr (Chunk == RUNTIME_CHUNK) {
+        // The original loop: with a runtime bound the compiler does no
+        // better with the branch-free form.
+        for (int i = 0; i < samples; i++) {
+            int32_t s = in[i] >> input_traits<F>::PCM16_SHIFT;
+            out[i] = (int16_t)s;
+            int32_t a = abs32(s);
+            if (a > peak) peak = a;
+            if (a >= 32767) clips++;
+        }
+    } else {
+#pragma GCC unroll 8
+        for (int i = 0; i < Chunk; i++) {
+            int32_t s = in[i] >> input_traits<F>::PCM16_SHIFT;
+            out[i] = (int16_t)s;
+            int32_t a = abs32(s);
+            peak = a > peak ? a : peak;
+            clips += a >= 32767;
+        }
+    }
+    *full_scale += clips;
+    return peak;
+}
+
+template <int Chunk>
+static uint32_t apply_gain_kernel(int16_t *buf, int samples, int32_t gain_q16, int32_t step_q16) {
+    if constexpr (Chunk != RUNTIME_CHUNK) {
+        if (samples != Chunk) {
+            return apply_gain_kernel<RUNTIME_CHUNK>(buf, samples, gain_q16, step_q16);
+        }
+    }
+    uint32_t clips = 0;
+    if constexpr (Chunk == RUNTIME_CHUNK) {
+        for (int i = 0; i < samples; i++) {
+            gain_q16 += step_q16;
+            int32_t s = (int32_t)(((int64_t)buf[i] * gain_q16) >> 16);
+            if (s > 32767) {
+                s = 32767;
+                clips++;
+            } else if (s < -32768) {
+                s = -32768;
+                clips++;
+            }
+            buf[i] = (int16_t)s;
+        }
+    } else {
+#pragma GCC unroll 8
+        for (int i = 0; i < Chunk; i++) {
+            gain_q16 += step_q16;
+            int32_t s = (int32_t)(((int64_t)buf[i] * gain_q16) >> 16);
+            int32_t c = sat16(s);
+            clips += c != s;
+            buf[i] = (int16_t)c;
+        }
+    }
+    return clips;
+}
+
+template <audio_input_format_t F, int Chunk, int GainShift>
+static void convert_kernel(const int32_t *in, int16_t *out, int samples, int gain_shift) {
+    if constexpr (Chunk != RUNTIME_CHUNK) {
+        if (samples != Chunk) {
+            convert_kernel<F, RUNTIME_CHUNK, GainShift>(in, out, samples, gain_shift);
+            return;
+        }
+    }
+    const int n = Chunk != RUNTIME_CHUNK ? Chunk : samples;
+    const int shift = GainShift != RUNTIME_GAIN ? GainShift : gain_shift;
+#pragma GCC unroll 8
+    for (int i = 0; i < n; i++) {
+        int32_t s = (in[i] >> input_traits<F>::PCM16_SHIFT) << shift;
+        out[i] = (int16_t)sat16(s);
+    }
+}
+
+template <int Chunk>
+static int32_t energy_kernel(const int16_t *in, int samples) {
+    if constexpr (Chunk != RUNTIME_CHUNK) {
+        static_assert(Chunk % 4 == 0, "energy decimates by 4");
+        if (samples != Chunk) {
+            return energy_kernel<RUNTIME_CHUNK>(in, samples);
+        }
+        // Chunk / 4 samples of at most 32768 fit 32 bits; the division is
+        // by a constant.
+        int32_t acc = 0;
+#pragma GCC unroll 8
+        for (int i = 0; i < Chunk; i += 4) {
+            acc += abs32(in[i]);
+        }
+        return acc / (Chunk / 4);
+    } else {
+        // Every 4th sample (count + 1 of them when samples is not a
+        // multiple of 4), divided by samples / 4. Below 2^16 samples of at
+        // most 32768 the sum fits 32 bits, which covers any real chunk.
+        int count = samples / 4;
+        if (count > 0 && count < (1 << 16) - 1) {
+            int32_t acc = 0;
+            for (int i = 0; i < samples; i += 4) {
+                acc += abs32(in[i]);
+            }
+            return acc / count;
+        }
+        int step = count > 0 ? 4 : 1;
+        count = count > 0 ? count : samples;
+        if (count <= 0) {
+            return 0;
+        }
+        int64_t acc = 0;
+        for (int i = 0; i < samples; i += step) {
+            acc += abs32(in[i]);
+        }
+        return (int32_t)(acc / count);
+    }
+}
+
+typedef void (*convert_fn)(const int32_t *, int16_t *, int, int);
+
+template <audio_input_format_t F, int Chunk, int... G>
+static const convert_fn *convert_table(std::integer_sequence<int, G...>) {
+    static const convert_fn table[] = {convert_kernel<F, Chunk, G>...};
+    return table;
+}
+
+template <audio_input_format_t F, int Chunk>
+static void select_chunk(audio_frame_ops_t *ops, int gain_shift) {
+    ops->scan = scan_kernel<F, Chunk>;
+    ops->apply_gain = apply_gain_kernel<Chunk>;
+    ops->energy = energy_kernel<Chunk>;
+    if (gain_shift >= 0 && gain_shift <= AUDIO_FRAME_MAX_GAIN_SHIFT) {
+        ops->convert = convert_table<F, Chunk>(std::make_integer_sequence<int, AUDIO_FRAME_MAX_GAIN_SHIFT + 1>())
+            [gain_shift];
+    } else {
+        ops->convert = convert_kernel<F, Chunk, RUNTIME_GAIN>;
+    }
+}
+
+template <audio_input_format_t F>
+static bool select_format(audio_frame_ops_t *ops, int chunk, int gain_shift) {
+    switch (chunk) {
+    case 512:
+        select_chunk<F, 512>(ops, gain_shift);
+        return true;
+    case 480:
+        select_chunk<F, 480>(ops, gain_shift);
+        return true;
+    default:
+        ops->scan = scan_kernel<F, RUNTIME_CHUNK>;
+        ops->apply_gain = apply_gain_kernel<RUNTIME_CHUNK>;
+        ops->convert = convert_kernel<F, RUNTIME_CHUNK, RUNTIME_GAIN>;
+        ops->energy = energy_kernel<RUNTIME_CHUNK>;
+        return false;
+    }
+}
+
+bool audio_frame_select(audio_frame_ops_t *ops, audio_input_format_t format, int chunk, int gain_shift) {
+    switch (format) {
+    case AUDIO_INPUT_S24_IN_32:
+    default:
+        return select_format<AUDIO_INPUT_S24_IN_32>(ops, chunk, gain_shift);
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Per-chunk sample kernels of audio_task: the I2S conversion (fixed gain
+// shift, or the two AGC passes) and the speech energy estimate. Each
+// kernel is a template over the input format, the chunk size and, for the
+// fixed-gain conversion, the gain shift. Instantiations with all of them
+// known at compile time have constant trip counts (unrolled by 8, no
+// remainder), 32-bit accumulators and saturating min/max instead of
+// branches.
+//
+// audio_frame_select() picks the instantiations for the running
+// configuration once; a chunk size without one, or a short block at run
+// time, goes to the generic instantiation, which is the original
+// runtime-bounded loop. apps/iot/scripts/audio_frame_bench.cpp checks every
+// specialisation against that loop bit for bit and times both.
+
+// Chunk sizes with compiled kernels are ESP-SR's 32 ms and 30 ms feed
+// chunks (512 and 480 samples); gain shifts 0..AUDIO_FRAME_MAX_GAIN_SHIFT
+// (the gain_shift parameter's range) have their own conversion.
+#define AUDIO_FRAME_MAX_GAIN_SHIFT 6
+
+typedef enum {
+    AUDIO_INPUT_S24_IN_32 = 0, // INMP441 / INMP411: 24 bits left-justified in 32
+    AUDIO_INPUT_FORMAT_COUNT,
+} audio_input_format_t;
+
+typedef struct {
+    // in -> 16-bit PCM without gain. Returns the block peak |s| and adds
+    // the number of full-scale input samples to *full_scale.
+    int32_t (*scan)(const int32_t *in, int16_t *out, int samples, uint32_t *full_scale);
+    // buf = buf * gain, saturated. The Q16 gain advances by step_q16 before
+    // each sample. Returns the number of samples that were saturated.
+    uint32_t (*apply_gain)(int16_t *buf, int samples, int32_t gain_q16, int32_t step_q16);
+    // in -> 16-bit PCM << gain_shift, saturated (the path without AGC).
+    void (*convert)(const int32_t *in, int16_t *out, int samples, int gain_shift);
+    // Mean |s| over every 4th sample (every sample below 4).
+    int32_t (*energy)(const int16_t *in, int samples);
+} audio_frame_ops_t;
+
+// Fills ops for the configuration. Returns false when chunk has no
+// specialisation and ops holds the generic kernels (chunk 0 always does).
+bool audio_frame_select(audio_frame_ops_t *ops, audio_input_format_t format, int chunk, int gain_shift);
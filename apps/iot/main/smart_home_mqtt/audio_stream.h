@@ -0,0 +1,171 @@
+#pragma once
+
+// Wire format of the TCP audio stream (one connection per session),
+// shared by the firmware and the host tools in apps/iot/scripts.
+//
+//   STRT                                   session start
+//   TIME kind:u8 pad:3 value:u32 t_us:u64  device timestamp (optional)
+//   AUD0 seq:u32 len:u16 pcm[len]          16 kHz mono int16 audio
+//   MEL0 seq:u32 len:u16 mel[len]          log-mel frames instead of PCM
+//   STOP / CANC                            end / discard the session
+//   CRED total:u32                         server -> device: credit
+//
+// All fields little endian. With timestamps enabled every AUD0 is
+// preceded by a TIME(audio) for the same seq, STRT is followed by
+// TIME(wake) and TIME(start), and STOP is preceded by TIME(stop).
+//
+// CRED is the only message in the other direction. total counts the
+// AUD0/MEL0 payload bytes the server accepts since STRT (mod 2^32); the
+// device sends no payload beyond it. A device that never sees a CRED
+// sends without limit, and a server that sends none gets the old stream.
+//
+// MEL0 (CONFIG_SMART_HOME_AUDIO_LOG_MEL) replaces AUD0 in a session and
+// uses the same sequencing. Each frame is AUDIO_STREAM_MEL_BINS int16
+// values covering AUDIO_STREAM_MEL_HOP samples: log2 of the mel power in
+// Q8, on int16 PCM with a 512-point FFT. Whisper's log10 mel (float PCM,
+// 400-point FFT) is q / 256 * log10(2) - 2 * log10(32768) - log10(512 / 400).
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define AUDIO_STREAM_TAG_LEN 4
+#define AUDIO_STREAM_AUD0_LEN 10
+#define AUDIO_STREAM_TIME_LEN 20
+#define AUDIO_STREAM_CRED_LEN 8
+#define AUDIO_STREAM_MEL_BINS 80
+#define AUDIO_STREAM_MEL_HOP 160
+
+// TIME kinds. value is the session for wake/start, the AUD0 seq for
+// audio and the last seq + 1 for stop; t_us is esp_timer time.
+typedef enum {
+    AUDIO_TIME_WAKE = 0,
+    AUDIO_TIME_START = 1,
+    AUDIO_TIME_AUDIO = 2,
+    AUDIO_TIME_STOP = 3,
+} audio_time_kind_t;
+
+typedef enum {
+    AUDIO_MSG_NONE = 0,
+    AUDIO_MSG_STRT,
+    AUDIO_MSG_STOP,
+    AUDIO_MSG_CANC,
+    AUDIO_MSG_AUD0,
+    AUDIO_MSG_TIME,
+    AUDIO_MSG_MEL0,
+    AUDIO_MSG_CRED,
+} audio_msg_type_t;
+
+typedef struct {
+    audio_msg_type_t type;
+    uint8_t kind;          // TIME
+    uint32_t value;        // TIME value / AUD0 seq / CRED total
+    int64_t t_us;          // TIME
+    const uint8_t *pcm;    // AUD0 / MEL0 payload, points into the parsed buffer
+    uint16_t len;          // AUD0 / MEL0
+} audio_msg_t;
+
+static inline void audio_stream_put_u32(uint8_t *out, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static inline uint32_t audio_stream_get_u32(const uint8_t *in) {
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+static inline uint8_t *audio_stream_put_tag(uint8_t *out, const char *tag) {
+    memcpy(out, tag, AUDIO_STREAM_TAG_LEN);
+    return out + AUDIO_STREAM_TAG_LEN;
+}
+
+static inline uint8_t *audio_stream_put_time(uint8_t *out, uint8_t kind, uint32_t value, int64_t t_us) {
+    memcpy(out, "TIME", 4);
+    out[4] = kind;
+    out[5] = out[6] = out[7] = 0;
+    audio_stream_put_u32(out + 8, value);
+    audio_stream_put_u32(out + 12, (uint32_t)((uint64_t)t_us & 0xffffffffu));
+    audio_stream_put_u32(out + 16, (uint32_t)((uint64_t)t_us >> 32));
+    return out + AUDIO_STREAM_TIME_LEN;
+}
+
+// Writes an AUD0 / MEL0 header; the payload follows it directly.
+static inline uint8_t *audio_stream_put_data(uint8_t *out, const char *tag, uint32_t seq, uint16_t bytes) {
+    memcpy(out, tag, 4);
+    audio_stream_put_u32(out + 4, seq);
+    out[8] = (uint8_t)(bytes & 0xff);
+    out[9] = (uint8_t)((bytes >> 8) & 0xff);
+    return out + AUDIO_STREAM_AUD0_LEN;
+}
+
+static inline uint8_t *audio_stream_put_aud0(uint8_t *out, uint32_t seq, uint16_t bytes) {
+    return audio_stream_put_data(out, "AUD0", seq, bytes);
+}
+
+static inline uint8_t *audio_stream_put_mel0(uint8_t *out, uint32_t seq, uint16_t bytes) {
+    return audio_stream_put_data(out, "MEL0", seq, bytes);
+}
+
+static inline uint8_t *audio_stream_put_cred(uint8_t *out, uint32_t total) {
+    memcpy(out, "CRED", 4);
+    audio_stream_put_u32(out + 4, total);
+    return out + AUDIO_STREAM_CRED_LEN;
+}
+
+// Parses one message from the front of buf. Returns the bytes consumed:
+// 0 when more data is needed, 1 with AUDIO_MSG_NONE for an unknown byte
+// (the receiver skips it and resynchronizes, as audio_tcp.py does).
+static inline size_t audio_stream_parse(const uint8_t *buf, size_t len, audio_msg_t *msg) {
+    msg->type = AUDIO_MSG_NONE;
+    if (len < AUDIO_STREAM_TAG_LEN) {
+        return 0;
+    }
+    if (memcmp(buf, "STRT", 4) == 0) {
+        msg->type = AUDIO_MSG_STRT;
+        return 4;
+    }
+    if (memcmp(buf, "STOP", 4) == 0) {
+        msg->type = AUDIO_MSG_STOP;
+        return 4;
+    }
+    if (memcmp(buf, "CANC", 4) == 0) {
+        msg->type = AUDIO_MSG_CANC;
+        return 4;
+    }
+    if (memcmp(buf, "CRED", 4) == 0) {
+        if (len < AUDIO_STREAM_CRED_LEN) {
+            return 0;
+        }
+        msg->type = AUDIO_MSG_CRED;
+        msg->value = audio_stream_get_u32(buf + 4);
+        return AUDIO_STREAM_CRED_LEN;
+    }
+    if (memcmp(buf, "TIME", 4) == 0) {
+        if (len < AUDIO_STREAM_TIME_LEN) {
+            return 0;
+        }
+        msg->type = AUDIO_MSG_TIME;
+        msg->kind = buf[4];
+        msg->value = audio_stream_get_u32(buf + 8);
+        msg->t_us = (int64_t)((uint64_t)audio_stream_get_u32(buf + 12) | ((uint64_t)audio_stream_get_u32(buf + 16) << 32));
+        return AUDIO_STREAM_TIME_LEN;
+    }
+    bool mel = memcmp(buf, "MEL0", 4) == 0;
+    if (mel || memcmp(buf, "AUD0", 4) == 0) {
+        if (len < AUDIO_STREAM_AUD0_LEN) {
+            return 0;
+        }
+        uint16_t bytes = (uint16_t)(buf[8] | (buf[9] << 8));
+        if (len < AUDIO_STREAM_AUD0_LEN + (size_t)bytes) {
+            return 0;
+        }
+        msg->type = mel ? AUDIO_MSG_MEL0 : AUDIO_MSG_AUD0;
+        msg->value = audio_stream_get_u32(buf + 4);
+        msg->pcm = buf + AUDIO_STREAM_AUD0_LEN;
+        msg->len = bytes;
+        return AUDIO_STREAM_AUD0_LEN + bytes;
+    }
+    return 1;
+}
@@ -0,0 +1,110 @@
+#include "event_bus.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "task_plan.h"
+
+static const char *TAG = "event_bus";
+
+// Power of two so indices wrap with a mask.
+static const uint32_t EVENT_RING_SIZE = 32;
+
+static const char *EVENT_NAMES[APP_EVENT_COUNT] = {"wake", "record_start", "record_stop", "net_error", "local_command"};
+
+static app_event_t ring[EVENT_RING_SIZE];
+static std::atomic<uint32_t> ring_head{0}; // written by producer
+static std::atomic<uint32_t> ring_tail{0}; // written by consumer
+static std::atomic<uint32_t> dropped{0};
+
+// Set by event_task itself. audio_task may post before the task exists
+// (it starts before the network); those events wait in the ring and the
+// task drains them when it starts.
+static std::atomic<TaskHandle_t> event_task_handle{NULL};
+static esp_mqtt_client_handle_t bus_client = NULL;
+static const char *bus_event_topic = NULL;
+static const char *bus_control_topic = NULL;
+
+bool event_bus_post(app_event_type_t type, uint32_t session, int32_t value, const char *text) {
+    uint32_t head = ring_head.load(std::memory_order_relaxed);
+    uint32_t tail = ring_tail.load(std::memory_order_acquire);
+    if (head - tail >= EVENT_RING_SIZE) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    app_event_t *ev = &ring[head & (EVENT_RING_SIZE - 1)];
+    ev->type = type;
+    ev->session = session;
+    ev->timestamp_us = esp_timer_get_time();
+    ev->value = value;
+    if (text) {
+        strncpy(ev->text, text, sizeof(ev->text) - 1);
+        ev->text[sizeof(ev->text) - 1] = '\0';
+    } else {
+        ev->text[0] = '\0';
+    }
+    ring_head.store(head + 1, std::memory_order_release);
+    // Pairs with the fence in event_task: either the task sees this event
+    // in its first drain or this post sees the handle and notifies.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    TaskHandle_t task = event_task_handle.load(std::memory_order_relaxed);
+    if (task) {
+        xTaskNotifyGive(task);
+    }
+    return true;
+}
+
+uint32_t event_bus_dropped(void) {
+    return dropped.load(std::memory_order_relaxed);
+}
+
+static void event_publish(const app_event_t *ev) {
+    if (!bus_client) {
+        return;
+    }
+    if (ev->type == APP_EVENT_LOCAL_COMMAND && bus_control_topic && strlen(bus_control_topic) > 0) {
+        esp_mqtt_client_enqueue(bus_client, bus_control_topic, ev->text, 0, 1, 0, true);
+    }
+    if (!bus_event_topic || strlen(bus_event_topic) == 0) {
+        return;
+    }
+    char payload[160];
+    int len = snprintf(payload, sizeof(payload),
+                       "{\"event\":\"%s\",\"session\":%lu,\"t_us\":%lld,\"value\":%ld,\"text\":\"%s\"}",
+                       EVENT_NAMES[ev->type], (unsigned long)ev->session, (long long)ev->timestamp_us,
+                       (long)ev->value, ev->text);
+    if (len > 0 && len < (int)sizeof(payload)) {
+        // Wake is what the backend warms up on, so it gets QoS 1.
+        int qos = ev->type == APP_EVENT_WAKE ? 1 : 0;
+        esp_mqtt_client_enqueue(bus_client, bus_event_topic, payload, len, qos, 0, true);
+    }
+}
+
+static void event_task(void *pvParameters) {
+    event_task_handle.store(xTaskGetCurrentTaskHandle(), std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    while (true) {
+        uint32_t tail = ring_tail.load(std::memory_order_relaxed);
+        while (tail != ring_head.load(std::memory_order_acquire)) {
+            app_event_t ev = ring[tail & (EVENT_RING_SIZE - 1)];
+            ring_tail.store(++tail, std::memory_order_release);
+            event_publish(&ev);
+        }
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+void event_bus_start(esp_mqtt_client_handle_t client, const char *event_topic, const char *control_topic) {
+    bus_client = client;
+    bus_event_topic = event_topic;
+    bus_control_topic = control_topic;
+    if (!task_plan_create(TASK_ID_EVENTS, event_task, NULL, NULL)) {
+        ESP_LOGW(TAG, "Event task not started, events will be dropped");
+    }
+}
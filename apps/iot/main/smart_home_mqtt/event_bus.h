@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mqtt_client.h"
+
+// Session events from audio_task to MQTT. audio_task is the only producer:
+// posting writes into a single-producer/single-consumer ring and never
+// blocks. The event task on the network core drains the ring and hands
+// the payloads to esp_mqtt_client_enqueue. Posting may start before
+// event_bus_start(); up to the ring size of those events are published
+// once the task runs.
+typedef enum {
+    APP_EVENT_WAKE = 0,
+    APP_EVENT_RECORD_START,
+    APP_EVENT_RECORD_STOP,
+    APP_EVENT_NET_ERROR,
+    APP_EVENT_LOCAL_COMMAND,
+    APP_EVENT_COUNT,
+} app_event_type_t;
+
+#define APP_EVENT_TEXT_LEN 24
+
+typedef struct {
+    app_event_type_t type;
+    uint32_t session;
+    int64_t timestamp_us;  // esp_timer, monotonic since boot
+    int32_t value;         // event specific: duration ms, seq count
+    char text[APP_EVENT_TEXT_LEN];
+} app_event_t;
+
+void event_bus_start(esp_mqtt_client_handle_t client, const char *event_topic, const char *control_topic);
+bool event_bus_post(app_event_type_t type, uint32_t session, int32_t value, const char *text);
+uint32_t event_bus_dropped(void);
@@ -0,0 +1,222 @@
+#include "i2s_capture.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+
+#include "driver/i2s_std.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+
+static const char *TAG = "i2s_capture";
+
+#define I2S_CAPTURE_PORT I2S_NUM_0
+
+// Power of two and at least the largest descriptor count.
+static const uint32_t CAPTURE_RING_SIZE = 16;
+// Total DMA depth in frames (~256 ms at 16 kHz), split into blocks.
+static const int CAPTURE_DMA_FRAMES_TOTAL = 4096;
+static const int CAPTURE_DESC_MIN = 4;
+static const int CAPTURE_DESC_MAX = 16;
+// A DMA buffer is limited to 4092 bytes.
+static const int CAPTURE_DMA_BUF_MAX = 4092;
+
+typedef struct {
+    int32_t *buf;
+    uint32_t seq;
+    int64_t timestamp_us;
+} capture_entry_t;
+
+static i2s_chan_handle_t rx_handle = NULL;
+static uint32_t desc_num = 0;
+static int block_samples = 0;
+
+// ISR is the producer, the consumer task drains.
+static capture_entry_t ring[CAPTURE_RING_SIZE];
+static std::atomic<uint32_t> ring_head{0};
+static std::atomic<uint32_t> ring_tail{0};
+static std::atomic<uint32_t> dma_seq{0}; // blocks completed by the DMA engine
+static std::atomic<TaskHandle_t> consumer_task{NULL};
+
+static std::atomic<uint32_t> blocks{0};
+static std::atomic<uint32_t> overflows{0};
+static std::atomic<uint32_t> late_releases{0};
+static std::atomic<uint32_t> timeouts{0};
+static std::atomic<uint32_t> max_outstanding{0};
+
+// Block seq's descriptor is refilled once the DMA has completed
+// desc_num - 1 further blocks and moved on to it.
+static bool capture_overwritten(uint32_t seq) {
+    return dma_seq.load(std::memory_order_acquire) - seq >= desc_num - 1;
+}
+
+static bool IRAM_ATTR capture_on_recv(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx) {
+    uint32_t seq = dma_seq.load(std::memory_order_relaxed) + 1;
+    dma_seq.store(seq, std::memory_order_release);
+
+    uint32_t head = ring_head.load(std::memory_order_relaxed);
+    uint32_t tail = ring_tail.load(std::memory_order_acquire);
+    if (head - tail >= CAPTURE_RING_SIZE) {
+        overflows.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        capture_entry_t *e = &ring[head & (CAPTURE_RING_SIZE - 1)];
+        e->buf = (int32_t *)event->dma_buf;
+        e->seq = seq;
+        e->timestamp_us = esp_timer_get_time();
+        ring_head.store(head + 1, std::memory_order_release);
+    }
+
+    BaseType_t woken = pdFALSE;
+    TaskHandle_t task = consumer_task.load(std::memory_order_relaxed);
+    if (task) {
+        vTaskNotifyGiveFromISR(task, &woken);
+    }
+    return woken == pdTRUE;
+}
+
+bool i2s_capture_init(gpio_num_t bclk, gpio_num_t ws, gpio_num_t din, uint32_t sample_rate, int frames_per_block) {
+    if (frames_per_block <= 0 || frames_per_block * (int)sizeof(int32_t) > CAPTURE_DMA_BUF_MAX) {
+        ESP_LOGE(TAG, "Unsupported block size %d frames", frames_per_block);
+        return false;
+    }
+    int descs = CAPTURE_DMA_FRAMES_TOTAL / frames_per_block;
+    if (descs < CAPTURE_DESC_MIN) descs = CAPTURE_DESC_MIN;
+    if (descs > CAPTURE_DESC_MAX) descs = CAPTURE_DESC_MAX;
+    desc_num = (uint32_t)descs;
+    block_samples = frames_per_block;
+
+    i2s_chan_config_t chan_cfg = {};
+    chan_cfg.id = I2S_CAPTURE_PORT;
+    chan_cfg.role = I2S_ROLE_MASTER;
+    chan_cfg.dma_desc_num = desc_num;
+    chan_cfg.dma_frame_num = (uint32_t)frames_per_block;
+    chan_cfg.auto_clear = true;
+    chan_cfg.auto_clear_before_cb = false;
+    chan_cfg.allow_pd = false;
+    chan_cfg.intr_priority = 0;
+
+    if (i2s_new_channel(&chan_cfg, NULL, &rx_handle) != ESP_OK) {
+        ESP_LOGE(TAG, "i2s_new_channel failed");
+        return false;
+    }
+
+    i2s_std_config_t std_cfg;
+    memset(&std_cfg, 0, sizeof(std_cfg));
+    std_cfg.clk_cfg.sample_rate_hz = sample_rate;
+    std_cfg.clk_cfg.clk_src = I2S_CLK_SRC_DEFAULT;
+#if SOC_I2S_HW_VERSION_2
+    std_cfg.clk_cfg.ext_clk_freq_hz = 0;
+#endif
+    std_cfg.clk_cfg.mclk_multiple = I2S_MCLK_MULTIPLE_256;
+    std_cfg.clk_cfg.bclk_div = 8;
+
+    std_cfg.slot_cfg.data_bit_width = I2S_DATA_BIT_WIDTH_32BIT;
+    std_cfg.slot_cfg.slot_bit_width = I2S_SLOT_BIT_WIDTH_AUTO;
+    std_cfg.slot_cfg.slot_mode = I2S_SLOT_MODE_MONO;
+    std_cfg.slot_cfg.slot_mask = I2S_STD_SLOT_LEFT;
+    std_cfg.slot_cfg.ws_width = I2S_DATA_BIT_WIDTH_32BIT;
+    std_cfg.slot_cfg.ws_pol = false;
+    std_cfg.slot_cfg.bit_shift = true;
+#if SOC_I2S_HW_VERSION_1
+    std_cfg.slot_cfg.msb_right = false;
+#else
+    std_cfg.slot_cfg.left_align = true;
+    std_cfg.slot_cfg.big_endian = false;
+    std_cfg.slot_cfg.bit_order_lsb = false;
+#endif
+    std_cfg.gpio_cfg.mclk = I2S_GPIO_UNUSED;
+    std_cfg.gpio_cfg.bclk = bclk;
+    std_cfg.gpio_cfg.ws = ws;
+    std_cfg.gpio_cfg.dout = I2S_GPIO_UNUSED;
+    std_cfg.gpio_cfg.din = din;
+    std_cfg.gpio_cfg.invert_flags.mclk_inv = false;
+    std_cfg.gpio_cfg.invert_flags.bclk_inv = false;
+    std_cfg.gpio_cfg.invert_flags.ws_inv = false;
+
+    if (i2s_channel_init_std_mode(rx_handle, &std_cfg) != ESP_OK) {
+        ESP_LOGE(TAG, "i2s_channel_init_std_mode failed");
+        return false;
+    }
+    // on_recv_q_ovf is not registered: nothing calls i2s_channel_read, so
+    // the driver's own queue is always full and would report every block.
+    // Overflow is tracked against the descriptor ring instead.
+    i2s_event_callbacks_t cbs = {};
+    cbs.on_recv = capture_on_recv;
+    if (i2s_channel_register_event_callback(rx_handle, &cbs, NULL) != ESP_OK) {
+        ESP_LOGE(TAG, "i2s callback registration failed");
+        return false;
+    }
+    if (i2s_channel_enable(rx_handle) != ESP_OK) {
+        ESP_LOGE(TAG, "i2s_channel_enable failed");
+        return false;
+    }
+    ESP_LOGI(TAG, "Capture: %d descriptors x %d frames", descs, frames_per_block);
+    return true;
+}
+
+bool i2s_capture_acquire(i2s_block_t *block, TickType_t wait) {
+    consumer_task.store(xTaskGetCurrentTaskHandle(), std::memory_order_relaxed);
+    while (true) {
+        uint32_t tail = ring_tail.load(std::memory_order_relaxed);
+        while (tail != ring_head.load(std::memory_order_acquire)) {
+            capture_entry_t e = ring[tail & (CAPTURE_RING_SIZE - 1)];
+            ring_tail.store(++tail, std::memory_order_release);
+            if (capture_overwritten(e.seq)) {
+                overflows.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            uint32_t lag = dma_seq.load(std::memory_order_relaxed) - e.seq + 1;
+            if (lag > max_outstanding.load(std::memory_order_relaxed)) {
+                max_outstanding.store(lag, std::memory_order_relaxed);
+            }
+            blocks.fetch_add(1, std::memory_order_relaxed);
+            block->samples = e.buf;
+            block->count = block_samples;
+            block->seq = e.seq;
+            block->timestamp_us = e.timestamp_us;
+            return true;
+        }
+        // A block completing between the check and the take leaves the
+        // notification pending, so this cannot miss a wake-up.
+        if (ulTaskNotifyTake(pdTRUE, wait) == 0) {
+            timeouts.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+}
+
+bool i2s_capture_release(const i2s_block_t *block) {
+    if (!block || !block->samples) {
+        return false;
+    }
+    if (capture_overwritten(block->seq)) {
+        late_releases.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void i2s_capture_snapshot(i2s_capture_stats_t *out) {
+    if (!out) {
+        return;
+    }
+    out->blocks = blocks.load(std::memory_order_relaxed);
+    out->overflows = overflows.load(std::memory_order_relaxed);
+    out->late_releases = late_releases.load(std::memory_order_relaxed);
+    out->timeouts = timeouts.load(std::memory_order_relaxed);
+    out->max_outstanding = max_outstanding.load(std::memory_order_relaxed);
+    out->desc_num = desc_num;
+    out->block_samples = (uint32_t)block_samples;
+}
+
+int i2s_capture_format_json(char *buf, size_t len) {
+    i2s_capture_stats_t s;
+    i2s_capture_snapshot(&s);
+    return snprintf(buf, len,
+                    "{\"blocks\":%lu,\"overflows\":%lu,\"late_release\":%lu,\"timeouts\":%lu,"
+                    "\"max_lag\":%lu,\"desc\":%lu,\"block_samples\":%lu}",
+                    (unsigned long)s.blocks, (unsigned long)s.overflows, (unsigned long)s.late_releases,
+                    (unsigned long)s.timeouts, (unsigned long)s.max_outstanding, (unsigned long)s.desc_num,
+                    (unsigned long)s.block_samples);
+}
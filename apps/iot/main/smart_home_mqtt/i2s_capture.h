@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+
+// Callback-driven I2S RX. The driver's on_recv ISR hands each completed
+// DMA block to the consumer by reference; nothing is copied and the
+// consumer sleeps on a task notification instead of polling reads.
+//
+// A block is owned by the consumer between acquire and release. The DMA
+// engine keeps cycling through its descriptors regardless, so a block
+// held for longer than the descriptor ring can absorb gets overwritten:
+// acquire skips such blocks and release reports whether the data changed
+// underneath the consumer. Both are counted as overflows.
+typedef struct {
+    const int32_t *samples;
+    int count;
+    uint32_t seq;
+    int64_t timestamp_us; // esp_timer time the block completed
+} i2s_block_t;
+
+typedef struct {
+    uint32_t blocks;
+    uint32_t overflows;      // blocks lost before the consumer reached them
+    uint32_t late_releases;  // blocks overwritten while still owned
+    uint32_t timeouts;
+    uint32_t max_outstanding;
+    uint32_t desc_num;
+    uint32_t block_samples;
+} i2s_capture_stats_t;
+
+// One block is frames_per_block mono 32-bit samples; size it to the AFE
+// feed chunk so a block is exactly one frame of work.
+bool i2s_capture_init(gpio_num_t bclk, gpio_num_t ws, gpio_num_t din, uint32_t sample_rate, int frames_per_block);
+bool i2s_capture_acquire(i2s_block_t *block, TickType_t wait);
+bool i2s_capture_release(const i2s_block_t *block);
+
+void i2s_capture_snapshot(i2s_capture_stats_t *out);
+int i2s_capture_format_json(char *buf, size_t len);
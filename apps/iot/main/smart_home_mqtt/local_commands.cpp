@@ -0,0 +1,224 @@
+#include "local_commands.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+
+#include "sdkconfig.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+extern "C" {
+#include "esp_mn_iface.h"
+#include "esp_mn_models.h"
+#include "esp_mn_speech_commands.h"
+}
+
+static const char *TAG = "local_cmd";
+
+static const int LOCAL_CMD_MAX = 16;
+static const int LOCAL_CMD_TEXT_LEN = 48;
+
+typedef struct {
+    char phrase[LOCAL_CMD_TEXT_LEN];
+    char action[LOCAL_CMD_TEXT_LEN];
+} local_cmd_t;
+
+static local_cmd_t commands[LOCAL_CMD_MAX];
+static int command_count = 0;
+
+static esp_mn_iface_t *multinet = NULL;
+static model_iface_data_t *mn_data = NULL;
+static int mn_chunk = 0;
+static int16_t *mn_buf = NULL;
+static int mn_fill = 0;
+
+static local_cmd_state_t state = LOCAL_CMD_IDLE;
+static int64_t window_start_us = 0;
+static int matched_id = -1;
+static int matched_latency_ms = 0;
+
+// Set last by local_commands_init(), which may run on the loader task.
+static std::atomic<bool> ready{false};
+static std::atomic<uint32_t> stat_sessions{0};
+static std::atomic<uint32_t> stat_hits{0};
+static std::atomic<uint32_t> stat_low_conf{0};
+static std::atomic<uint32_t> stat_timeouts{0};
+static std::atomic<uint32_t> stat_local_ms_total{0};
+static std::atomic<uint32_t> stat_saved_ms_total{0};
+static std::atomic<uint32_t> stream_ms_avg{0};
+
+// Parses "phrase=ACTION;phrase=ACTION" from Kconfig.
+static void local_commands_parse(const char *list) {
+    command_count = 0;
+    const char *p = list;
+    while (p && *p && command_count < LOCAL_CMD_MAX) {
+        const char *end = strchr(p, ';');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        const char *eq = (const char *)memchr(p, '=', len);
+        if (eq && eq > p && (size_t)(eq - p) < LOCAL_CMD_TEXT_LEN && len - (eq - p) - 1 < LOCAL_CMD_TEXT_LEN) {
+            local_cmd_t *c = &commands[command_count];
+            memcpy(c->phrase, p, eq - p);
+            c->phrase[eq - p] = '\0';
+            size_t action_len = len - (eq - p) - 1;
+            memcpy(c->action, eq + 1, action_len);
+            c->action[action_len] = '\0';
+            command_count++;
+        } else if (len > 0) {
+            ESP_LOGW(TAG, "Ignoring malformed command entry (%d chars)", (int)len);
+        }
+        p = end ? end + 1 : NULL;
+    }
+}
+
+bool local_commands_init(srmodel_list_t *models) {
+#if CONFIG_SMART_HOME_LOCAL_COMMANDS
+    char *mn_name = esp_srmodel_filter(models, ESP_MN_PREFIX, ESP_MN_ENGLISH);
+    if (!mn_name) {
+        ESP_LOGW(TAG, "No English MultiNet model in partition, local commands disabled");
+        return false;
+    }
+    multinet = esp_mn_handle_from_name(mn_name);
+    if (!multinet) {
+        ESP_LOGW(TAG, "MultiNet handle unavailable for %s", mn_name);
+        return false;
+    }
+    mn_data = multinet->create(mn_name, CONFIG_SMART_HOME_LOCAL_COMMAND_WINDOW_MS);
+    if (!mn_data) {
+        ESP_LOGW(TAG, "MultiNet create failed");
+        return false;
+    }
+    local_commands_parse(CONFIG_SMART_HOME_LOCAL_COMMAND_LIST);
+    esp_mn_commands_alloc(multinet, mn_data);
+    esp_mn_commands_clear();
+    for (int i = 0; i < command_count; i++) {
+        esp_mn_commands_add(i, commands[i].phrase);
+    }
+    if (esp_mn_commands_update() != NULL) {
+        ESP_LOGW(TAG, "Some command phrases were rejected by MultiNet");
+    }
+    mn_chunk = multinet->get_samp_chunksize(mn_data);
+    mn_buf = (int16_t *)heap_caps_malloc(mn_chunk * sizeof(int16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!mn_buf) {
+        ESP_LOGW(TAG, "MultiNet buffer alloc failed");
+        multinet->destroy(mn_data);
+        mn_data = NULL;
+        return false;
+    }
+    ready.store(command_count > 0, std::memory_order_release);
+    ESP_LOGI(TAG, "MultiNet %s ready: %d commands, chunk=%d", mn_name, command_count, mn_chunk);
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool local_commands_ready(void) {
+    return ready.load(std::memory_order_acquire);
+}
+
+void local_commands_begin(int64_t wake_us) {
+    if (!local_commands_ready()) {
+        return;
+    }
+    multinet->clean(mn_data);
+    mn_fill = 0;
+    matched_id = -1;
+    window_start_us = wake_us;
+    state = LOCAL_CMD_LISTENING;
+    stat_sessions.fetch_add(1, std::memory_order_relaxed);
+}
+
+void local_commands_cancel(void) {
+    state = LOCAL_CMD_IDLE;
+}
+
+static local_cmd_state_t local_commands_detect(void) {
+    esp_mn_state_t mn_state = multinet->detect(mn_data, mn_buf);
+    if (mn_state == ESP_MN_STATE_DETECTING) {
+        return LOCAL_CMD_LISTENING;
+    }
+    if (mn_state == ESP_MN_STATE_TIMEOUT) {
+        stat_timeouts.fetch_add(1, std::memory_order_relaxed);
+        return LOCAL_CMD_TIMEOUT;
+    }
+    esp_mn_results_t *results = multinet->get_results(mn_data);
+    int id = results && results->num > 0 ? results->command_id[0] : -1;
+    float prob = results && results->num > 0 ? results->prob[0] : 0.0f;
+    if (id < 0 || id >= command_count || prob * 100.0f < CONFIG_SMART_HOME_LOCAL_COMMAND_MIN_PROB) {
+        ESP_LOGI(TAG, "Low confidence match id=%d prob=%.2f, streaming instead", id, prob);
+        stat_low_conf.fetch_add(1, std::memory_order_relaxed);
+        return LOCAL_CMD_LOW_CONFIDENCE;
+    }
+    matched_id = id;
+    matched_latency_ms = (int)((esp_timer_get_time() - window_start_us) / 1000);
+    stat_hits.fetch_add(1, std::memory_order_relaxed);
+    stat_local_ms_total.fetch_add(matched_latency_ms, std::memory_order_relaxed);
+    uint32_t stream_ms = stream_ms_avg.load(std::memory_order_relaxed);
+    if (stream_ms > (uint32_t)matched_latency_ms) {
+        stat_saved_ms_total.fetch_add(stream_ms - matched_latency_ms, std::memory_order_relaxed);
+    }
+    ESP_LOGI(TAG, "Local command '%s' -> %s (prob=%.2f, %dms after wake)", commands[id].phrase,
+             commands[id].action, prob, matched_latency_ms);
+    return LOCAL_CMD_MATCHED;
+}
+
+local_cmd_state_t local_commands_feed(const int16_t *pcm, int samples) {
+    if (state != LOCAL_CMD_LISTENING || !pcm || samples <= 0) {
+        return state;
+    }
+    // AFE and MultiNet chunk sizes usually match; re-block when they don't.
+    int used = 0;
+    while (used < samples && state == LOCAL_CMD_LISTENING) {
+        int take = mn_chunk - mn_fill;
+        if (take > samples - used) {
+            take = samples - used;
+        }
+        memcpy(&mn_buf[mn_fill], &pcm[used], take * sizeof(int16_t));
+        mn_fill += take;
+        used += take;
+        if (mn_fill == mn_chunk) {
+            mn_fill = 0;
+            state = local_commands_detect();
+        }
+    }
+    return state;
+}
+
+const char *local_commands_action(void) {
+    return matched_id >= 0 ? commands[matched_id].action : NULL;
+}
+
+const char *local_commands_phrase(void) {
+    return matched_id >= 0 ? commands[matched_id].phrase : NULL;
+}
+
+int local_commands_latency_ms(void) {
+    return matched_latency_ms;
+}
+
+void local_commands_note_streamed(int64_t wake_us, int64_t stop_us) {
+    if (stop_us <= wake_us) {
+        return;
+    }
+    uint32_t ms = (uint32_t)((stop_us - wake_us) / 1000);
+    uint32_t avg = stream_ms_avg.load(std::memory_order_relaxed);
+    stream_ms_avg.store(avg == 0 ? ms : (avg * 7 + ms) / 8, std::memory_order_relaxed);
+}
+
+int local_commands_format_json(char *buf, size_t len) {
+    uint32_t sessions = stat_sessions.load(std::memory_order_relaxed);
+    uint32_t hits = stat_hits.load(std::memory_order_relaxed);
+    return snprintf(buf, len,
+                    "{\"enabled\":%s,\"sessions\":%lu,\"hits\":%lu,\"hit_pct\":%lu,\"low_conf\":%lu,"
+                    "\"timeouts\":%lu,\"avg_local_ms\":%lu,\"avg_stream_ms\":%lu,\"saved_ms\":%lu}",
+                    local_commands_ready() ? "true" : "false", (unsigned long)sessions, (unsigned long)hits,
+                    (unsigned long)(sessions > 0 ? (hits * 100) / sessions : 0),
+                    (unsigned long)stat_low_conf.load(std::memory_order_relaxed),
+                    (unsigned long)stat_timeouts.load(std::memory_order_relaxed),
+                    (unsigned long)(hits > 0 ? stat_local_ms_total.load(std::memory_order_relaxed) / hits : 0),
+                    (unsigned long)stream_ms_avg.load(std::memory_order_relaxed),
+                    (unsigned long)stat_saved_ms_total.load(std::memory_order_relaxed));
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+extern "C" {
+#include "esp_afe_sr_models.h"
+}
+
+// On-device MultiNet stage that runs on AFE output right after the wake
+// word. Confident matches are handled locally; anything else falls back
+// to the TCP stream that is already running in parallel.
+typedef enum {
+    LOCAL_CMD_IDLE = 0,
+    LOCAL_CMD_LISTENING,
+    LOCAL_CMD_MATCHED,
+    LOCAL_CMD_LOW_CONFIDENCE,
+    LOCAL_CMD_TIMEOUT,
+} local_cmd_state_t;
+
+bool local_commands_init(srmodel_list_t *models);
+bool local_commands_ready(void);
+
+void local_commands_begin(int64_t wake_us);
+void local_commands_cancel(void);
+local_cmd_state_t local_commands_feed(const int16_t *pcm, int samples);
+
+// Valid after LOCAL_CMD_MATCHED.
+const char *local_commands_action(void);
+const char *local_commands_phrase(void);
+int local_commands_latency_ms(void);
+
+// Wake -> STOP duration of a streamed session, the minimum the cloud path
+// costs before ASR even starts. Used to estimate latency saved.
+void local_commands_note_streamed(int64_t wake_us, int64_t stop_us);
+int local_commands_format_json(char *buf, size_t len);
@@ -0,0 +1,354 @@
+#include "log_mel.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// Builds on the host as well (apps/iot/scripts/log_mel_check.cpp), so
+// everything ESP-specific stays behind ESP_PLATFORM.
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+#if CONFIG_SMART_HOME_LOG_MEL_ESP_DSP
+#include "dsps_fft2r.h"
+#endif
+#endif
+
+#if defined(ESP_PLATFORM) && CONFIG_SMART_HOME_LOG_MEL_ESP_DSP
+#define LOG_MEL_USE_ESP_DSP 1
+#else
+#define LOG_MEL_USE_ESP_DSP 0
+#endif
+
+#define LOG_MEL_FFT_BITS 9
+#define LOG_MEL_SPECTRUM (LOG_MEL_FFT_SIZE / 2 + 1)
+// Windowed samples are normalized to this many bits before the FFT.
+// esp-dsp's sc16 FFT halves in every stage (gain 2^-LOG_MEL_FFT_BITS); the
+// C path is block floating point and only halves when a stage could
+// overflow, which keeps about 20 dB more resolution on quiet bins.
+#define LOG_MEL_HEADROOM_BITS 14
+// Slaney filters have at most this many non-zero weights in total.
+#define LOG_MEL_MAX_WEIGHTS (2 * LOG_MEL_SPECTRUM + LOG_MEL_BINS)
+
+typedef struct {
+    uint16_t start; // first FFT bin
+    uint16_t count;
+    uint16_t offset; // into mel_weights
+    int16_t norm_q8; // log2 of the Slaney area normalization, Q8
+} mel_filter_t;
+
+static int16_t window_q15[LOG_MEL_WINDOW];
+static int16_t twiddle_q15[LOG_MEL_FFT_SIZE]; // cos, sin pairs for k < N/2
+static mel_filter_t mel_filters[LOG_MEL_BINS];
+static uint16_t mel_weights[LOG_MEL_MAX_WEIGHTS]; // triangle height, Q15
+static uint8_t log2_frac_q8[256];
+
+// Interleaved re/im; esp-dsp wants 16-byte alignment.
+static int16_t fft_buf[2 * LOG_MEL_FFT_SIZE] __attribute__((aligned(16)));
+static uint32_t power[LOG_MEL_SPECTRUM];
+
+static int16_t history[LOG_MEL_WINDOW];
+static int history_fill = 0;
+static bool ready = false;
+static bool use_esp_dsp = false; // only after esp_dsp_matches_c()
+
+static uint32_t frames = 0;
+static uint64_t cycles_total = 0;
+static uint32_t cycles_max = 0;
+
+#ifdef ESP_PLATFORM
+static const char *TAG = "log_mel";
+#endif
+
+static double hz_to_mel(double hz) {
+    const double f_sp = 200.0 / 3.0;
+    const double min_log_hz = 1000.0;
+    const double min_log_mel = min_log_hz / f_sp;
+    const double logstep = log(6.4) / 27.0;
+    return hz < min_log_hz ? hz / f_sp : min_log_mel + log(hz / min_log_hz) / logstep;
+}
+
+static double mel_to_hz(double mel) {
+    const double f_sp = 200.0 / 3.0;
+    const double min_log_hz = 1000.0;
+    const double min_log_mel = min_log_hz / f_sp;
+    const double logstep = log(6.4) / 27.0;
+    return mel < min_log_mel ? mel * f_sp : min_log_hz * exp(logstep * (mel - min_log_mel));
+}
+
+static bool build_filters(void) {
+    double edges[LOG_MEL_BINS + 2];
+    double mel_max = hz_to_mel(LOG_MEL_SAMPLE_RATE / 2.0);
+    for (int i = 0; i < LOG_MEL_BINS + 2; i++) {
+        edges[i] = mel_to_hz(mel_max * i / (LOG_MEL_BINS + 1));
+    }
+    int used = 0;
+    for (int m = 0; m < LOG_MEL_BINS; m++) {
+        mel_filter_t *f = &mel_filters[m];
+        f->start = 0;
+        f->count = 0;
+        f->offset = (uint16_t)used;
+        for (int k = 0; k < LOG_MEL_SPECTRUM; k++) {
+            double hz = (double)k * LOG_MEL_SAMPLE_RATE / LOG_MEL_FFT_SIZE;
+            double lower = (hz - edges[m]) / (edges[m + 1] - edges[m]);
+            double upper = (edges[m + 2] - hz) / (edges[m + 2] - edges[m + 1]);
+            double w = lower < upper ? lower : upper;
+            if (w <= 0) {
+                if (f->count > 0) {
+                    break;
+                }
+                continue;
+            }
+            if (used >= LOG_MEL_MAX_WEIGHTS) {
+                return false;
+            }
+            if (f->count == 0) {
+                f->start = (uint16_t)k;
+            }
+            mel_weights[used++] = (uint16_t)lrint(w * 32767.0);
+            f->count++;
+        }
+        f->norm_q8 = (int16_t)lrint(256.0 * log2(2.0 / (edges[m + 2] - edges[m])));
+    }
+    return true;
+}
+
+#if LOG_MEL_USE_ESP_DSP
+static void compute_frame(int16_t *out, bool esp_dsp);
+
+// Bins within 30 dB of the loudest must agree to 1 dB (log2 Q8 units).
+static const int32_t SELF_CHECK_RANGE_Q8 = 2551;
+static const int32_t SELF_CHECK_TOL_Q8 = 85;
+
+// The esp-dsp path assumes dsps_fft2r_sc16 halves in every stage, which
+// comes from its documentation. One synthetic frame through both FFTs
+// checks that on the running build before the stream depends on it.
+static bool esp_dsp_matches_c(void) {
+    for (int i = 0; i < LOG_MEL_WINDOW; i++) {
+        double t = (double)i / LOG_MEL_SAMPLE_RATE;
+        history[i] = (int16_t)lrint(16384.0 * sin(2.0 * M_PI * 1000.0 * t) + 3277.0 * sin(2.0 * M_PI * 250.0 * t));
+    }
+    int16_t want[LOG_MEL_BINS];
+    int16_t got[LOG_MEL_BINS];
+    compute_frame(want, false);
+    compute_frame(got, true);
+    int32_t top = INT16_MIN;
+    for (int m = 0; m < LOG_MEL_BINS; m++) {
+        top = want[m] > top ? want[m] : top;
+    }
+    for (int m = 0; m < LOG_MEL_BINS; m++) {
+        int32_t err = got[m] - want[m];
+        if (top - want[m] <= SELF_CHECK_RANGE_Q8 && (err > SELF_CHECK_TOL_Q8 || err < -SELF_CHECK_TOL_Q8)) {
+            ESP_LOGW(TAG, "Bin %d: esp-dsp %d, C %d (log2 Q8)", m, got[m], want[m]);
+            return false;
+        }
+    }
+    return true;
+}
+#endif
+
+bool log_mel_init(void) {
+    if (ready) {
+        return true;
+    }
+    // Periodic Hann, as torch.hann_window(400) in Whisper.
+    for (int i = 0; i < LOG_MEL_WINDOW; i++) {
+        window_q15[i] = (int16_t)lrint(32767.0 * 0.5 * (1.0 - cos(2.0 * M_PI * i / LOG_MEL_WINDOW)));
+    }
+    for (int k = 0; k < LOG_MEL_FFT_SIZE / 2; k++) {
+        twiddle_q15[2 * k] = (int16_t)lrint(32767.0 * cos(2.0 * M_PI * k / LOG_MEL_FFT_SIZE));
+        twiddle_q15[2 * k + 1] = (int16_t)lrint(32767.0 * sin(2.0 * M_PI * k / LOG_MEL_FFT_SIZE));
+    }
+    for (int i = 0; i < 256; i++) {
+        log2_frac_q8[i] = (uint8_t)lrint(256.0 * log2(1.0 + i / 256.0));
+    }
+    if (!build_filters()) {
+        return false;
+    }
+#if LOG_MEL_USE_ESP_DSP
+    if (dsps_fft2r_init_sc16(NULL, LOG_MEL_FFT_SIZE) != ESP_OK) {
+        ESP_LOGW(TAG, "esp-dsp FFT init failed, using the C FFT");
+    } else if (!esp_dsp_matches_c()) {
+        ESP_LOGW(TAG, "esp-dsp FFT disagrees with the C FFT, using the C FFT");
+    } else {
+        use_esp_dsp = true;
+    }
+#endif
+    history_fill = 0;
+    ready = true;
+#ifdef ESP_PLATFORM
+    ESP_LOGI(TAG, "log-mel ready (%d bins, %s FFT)", LOG_MEL_BINS, use_esp_dsp ? "esp-dsp" : "C");
+#endif
+    return true;
+}
+
+void log_mel_reset(void) {
+    history_fill = 0;
+}
+
+// Radix-2 DIT, in place. peak is the OR of all input magnitudes; returns
+// the total right shift applied (output = DFT / 2^shift).
+static int fft_q15(int16_t *x, uint32_t peak) {
+    const int n = LOG_MEL_FFT_SIZE;
+    for (int i = 1, j = 0; i < n; i++) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            int16_t tr = x[2 * i], ti = x[2 * i + 1];
+            x[2 * i] = x[2 * j];
+            x[2 * i + 1] = x[2 * j + 1];
+            x[2 * j] = tr;
+            x[2 * j + 1] = ti;
+        }
+    }
+    int scaled = 0;
+    for (int half = 1, step = n / 2; half < n; half <<= 1, step >>= 1) {
+        // |a| + |t| <= 2 * sqrt(2) * peak, so below 2^13 the stage cannot
+        // overflow; one halving covers 2^14, two anything up to 2^15.
+        int sh = peak >= (1u << 14) ? 2 : (peak >= (1u << 13) ? 1 : 0);
+        int32_t rnd = (1 << sh) >> 1;
+        uint32_t next_peak = 0;
+        for (int k = 0; k < half; k++) {
+            int32_t wr = twiddle_q15[2 * k * step];
+            int32_t wi = -twiddle_q15[2 * k * step + 1];
+            for (int a = k; a < n; a += 2 * half) {
+                int b = a + half;
+                int32_t br = x[2 * b], bi = x[2 * b + 1];
+                // Rounded, so nine stages do not pile up a negative bias.
+                int32_t tr = (br * wr - bi * wi + (1 << 14)) >> 15;
+                int32_t ti = (br * wi + bi * wr + (1 << 14)) >> 15;
+                int32_t ar = x[2 * a], ai = x[2 * a + 1];
+                int32_t v0 = (ar + tr + rnd) >> sh;
+                int32_t v1 = (ai + ti + rnd) >> sh;
+                int32_t v2 = (ar - tr + rnd) >> sh;
+                int32_t v3 = (ai - ti + rnd) >> sh;
+                x[2 * a] = (int16_t)v0;
+                x[2 * a + 1] = (int16_t)v1;
+                x[2 * b] = (int16_t)v2;
+                x[2 * b + 1] = (int16_t)v3;
+                next_peak |= (uint32_t)(v0 < 0 ? -v0 : v0) | (uint32_t)(v1 < 0 ? -v1 : v1) |
+                             (uint32_t)(v2 < 0 ? -v2 : v2) | (uint32_t)(v3 < 0 ? -v3 : v3);
+            }
+        }
+        scaled += sh;
+        peak = next_peak;
+    }
+    return scaled;
+}
+
+static int32_t log2_q8(uint64_t v) {
+    if (v == 0) {
+        v = 1;
+    }
+    int e = 63 - __builtin_clzll(v);
+    uint32_t mant = e >= 8 ? (uint32_t)(v >> (e - 8)) : (uint32_t)(v << (8 - e));
+    return e * 256 + log2_frac_q8[mant & 0xff];
+}
+
+static void compute_frame(int16_t *out, bool esp_dsp) {
+    // Window in 32 bits, then shift so the peak lands just under
+    // LOG_MEL_HEADROOM_BITS; the shift comes back as an exponent.
+    int32_t windowed[LOG_MEL_WINDOW];
+    uint32_t peak = 0;
+    for (int i = 0; i < LOG_MEL_WINDOW; i++) {
+        int32_t v = (int32_t)history[i] * window_q15[i];
+        windowed[i] = v;
+        uint32_t a = v < 0 ? (uint32_t)-v : (uint32_t)v;
+        peak |= a;
+    }
+    int peak_bits = peak ? 32 - __builtin_clz(peak) : 0;
+    int shift = peak_bits > LOG_MEL_HEADROOM_BITS ? peak_bits - LOG_MEL_HEADROOM_BITS : 0;
+    for (int i = 0; i < LOG_MEL_WINDOW; i++) {
+        fft_buf[2 * i] = (int16_t)(windowed[i] >> shift);
+        fft_buf[2 * i + 1] = 0;
+    }
+    peak >>= shift;
+    memset(&fft_buf[2 * LOG_MEL_WINDOW], 0, sizeof(int16_t) * 2 * (LOG_MEL_FFT_SIZE - LOG_MEL_WINDOW));
+
+#if LOG_MEL_USE_ESP_DSP
+    int scaled;
+    if (esp_dsp) {
+        dsps_fft2r_sc16(fft_buf, LOG_MEL_FFT_SIZE);
+        dsps_bit_rev_sc16_ansi(fft_buf, LOG_MEL_FFT_SIZE);
+        scaled = LOG_MEL_FFT_BITS;
+    } else {
+        scaled = fft_q15(fft_buf, peak);
+    }
+#else
+    (void)esp_dsp;
+    int scaled = fft_q15(fft_buf, peak);
+#endif
+
+    for (int k = 0; k < LOG_MEL_SPECTRUM; k++) {
+        int32_t re = fft_buf[2 * k], im = fft_buf[2 * k + 1];
+        power[k] = (uint32_t)(re * re) + (uint32_t)(im * im);
+    }
+
+    // fft = windowed_true * 2^(15 - shift) / 2^scaled, so
+    // power_true = power * 2^(2 * scaled - 2 * (15 - shift)), and the Q15
+    // weights add 2^-15: log2(mel) = log2(acc) + norm + 2 * (shift + scaled) - 45.
+    int32_t exp_q8 = 256 * (2 * (shift + scaled) - 45);
+    for (int m = 0; m < LOG_MEL_BINS; m++) {
+        const mel_filter_t *f = &mel_filters[m];
+        const uint16_t *w = &mel_weights[f->offset];
+        const uint32_t *p = &power[f->start];
+        uint64_t acc = 0;
+        for (int i = 0; i < f->count; i++) {
+            acc += (uint64_t)w[i] * p[i];
+        }
+        int32_t q = log2_q8(acc) + f->norm_q8 + exp_q8;
+        out[m] = (int16_t)(q < INT16_MIN ? INT16_MIN : (q > INT16_MAX ? INT16_MAX : q));
+    }
+}
+
+int log_mel_push(const int16_t *pcm, int count, int16_t *out) {
+    if (!ready) {
+        return 0;
+    }
+    int produced = 0;
+    while (count > 0) {
+        int take = LOG_MEL_WINDOW - history_fill;
+        if (take > count) {
+            take = count;
+        }
+        memcpy(&history[history_fill], pcm, take * sizeof(int16_t));
+        history_fill += take;
+        pcm += take;
+        count -= take;
+        if (history_fill < LOG_MEL_WINDOW) {
+            break;
+        }
+#ifdef ESP_PLATFORM
+        uint32_t start = esp_cpu_get_cycle_count();
+#endif
+        compute_frame(out + produced * LOG_MEL_BINS, use_esp_dsp);
+#ifdef ESP_PLATFORM
+        uint32_t cycles = esp_cpu_get_cycle_count() - start;
+        cycles_total += cycles;
+        if (cycles > cycles_max) {
+            cycles_max = cycles;
+        }
+#endif
+        frames++;
+        produced++;
+        memmove(history, &history[LOG_MEL_HOP], (LOG_MEL_WINDOW - LOG_MEL_HOP) * sizeof(int16_t));
+        history_fill = LOG_MEL_WINDOW - LOG_MEL_HOP;
+    }
+    return produced;
+}
+
+int log_mel_format_json(char *buf, size_t len) {
+    uint32_t budget = 0;
+#ifdef ESP_PLATFORM
+    // One hop of audio at the session CPU frequency (sessions run at max).
+    budget = (uint32_t)((uint64_t)CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ * 1000000 * LOG_MEL_HOP / LOG_MEL_SAMPLE_RATE);
+#endif
+    return snprintf(buf, len, "{\"fft\":\"%s\",\"frames\":%lu,\"avg_cycles\":%lu,\"max_cycles\":%lu,\"budget_cycles\":%lu}",
+                    use_esp_dsp ? "esp-dsp" : "c", (unsigned long)frames,
+                    (unsigned long)(frames > 0 ? cycles_total / frames : 0), (unsigned long)cycles_max,
+                    (unsigned long)budget);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed-point log-mel front end for the MEL0 stream: 25 ms Hann window,
+// 10 ms hop, 512-point Q15 FFT, 80 Slaney mel bins (Whisper's layout).
+// Each output value is log2(mel power) in Q8, with the power taken on
+// int16 PCM units and a 512-bin filterbank; audio_stream.h documents the
+// conversion to Whisper's log10 mel. The host reference and accuracy check
+// live in apps/iot/scripts/log_mel_check.cpp.
+#define LOG_MEL_BINS 80
+#define LOG_MEL_FFT_SIZE 512
+#define LOG_MEL_WINDOW 400
+#define LOG_MEL_HOP 160
+#define LOG_MEL_SAMPLE_RATE 16000
+
+bool log_mel_init(void);
+// Drops buffered audio; call at the start of a session.
+void log_mel_reset(void);
+
+// Upper bound of frames one log_mel_push() of count samples can produce.
+static inline int log_mel_max_frames(int count) {
+    return count / LOG_MEL_HOP + 1;
+}
+
+// Consumes count samples and writes each completed frame (LOG_MEL_BINS
+// values) to out. Returns the number of frames written; out must hold
+// log_mel_max_frames(count) frames.
+int log_mel_push(const int16_t *pcm, int count, int16_t *out);
+
+int log_mel_format_json(char *buf, size_t len);
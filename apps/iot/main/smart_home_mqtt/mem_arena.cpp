@@ -0,0 +1,85 @@
+#include "mem_arena.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+static const char *TAG = "mem_arena";
+
+typedef struct {
+    const char *name;
+    uint32_t caps;
+    uint8_t *base;
+    size_t size;
+    size_t used;
+} mem_arena_t;
+
+static mem_arena_t arenas[MEM_REGION_COUNT] = {
+    {"fast", MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, NULL, 0, 0},
+    {"spiram", MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT, NULL, 0, 0},
+};
+
+size_t mem_arena_round(size_t bytes) {
+    return (bytes + MEM_ARENA_ALIGN - 1) & ~(size_t)(MEM_ARENA_ALIGN - 1);
+}
+
+bool mem_arena_reserve(mem_region_t region, size_t bytes) {
+    if (region >= MEM_REGION_COUNT || bytes == 0) {
+        return false;
+    }
+    mem_arena_t *arena = &arenas[region];
+    if (arena->base) {
+        ESP_LOGW(TAG, "Region %s already reserved", arena->name);
+        return false;
+    }
+    bytes = mem_arena_round(bytes);
+    arena->base = (uint8_t *)heap_caps_aligned_alloc(MEM_ARENA_ALIGN, bytes, arena->caps);
+    if (!arena->base && region == MEM_REGION_SPIRAM) {
+        // Boards without PSRAM still run, just with less headroom.
+        ESP_LOGW(TAG, "PSRAM unavailable, spiram region falls back to internal RAM");
+        arena->base = (uint8_t *)heap_caps_aligned_alloc(MEM_ARENA_ALIGN, bytes, MALLOC_CAP_8BIT);
+    }
+    if (!arena->base) {
+        ESP_LOGE(TAG, "Region %s: %u bytes unavailable", arena->name, (unsigned)bytes);
+        return false;
+    }
+    arena->size = bytes;
+    arena->used = 0;
+    return true;
+}
+
+void *mem_arena_alloc(mem_region_t region, size_t bytes) {
+    if (region >= MEM_REGION_COUNT || bytes == 0) {
+        return NULL;
+    }
+    mem_arena_t *arena = &arenas[region];
+    bytes = mem_arena_round(bytes);
+    if (!arena->base || arena->used + bytes > arena->size) {
+        ESP_LOGE(TAG, "Region %s exhausted (%u + %u > %u)", arena->name, (unsigned)arena->used,
+                 (unsigned)bytes, (unsigned)arena->size);
+        return NULL;
+    }
+    void *p = arena->base + arena->used;
+    arena->used += bytes;
+    return p;
+}
+
+int mem_arena_format_json(char *buf, size_t len) {
+    int n = snprintf(buf, len, "{");
+    for (int r = 0; r < MEM_REGION_COUNT && n < (int)len; r++) {
+        n += snprintf(buf + n, len - n, "%s\"%s\":[%u,%u]", r > 0 ? "," : "", arenas[r].name,
+                      (unsigned)arenas[r].used, (unsigned)arenas[r].size);
+    }
+    if (n < (int)len) {
+        n += snprintf(buf + n, len - n, "}");
+    }
+    return n;
+}
+
+void mem_arena_log(void) {
+    for (int r = 0; r < MEM_REGION_COUNT; r++) {
+        ESP_LOGI(TAG, "%s: %u/%u bytes", arenas[r].name, (unsigned)arenas[r].used, (unsigned)arenas[r].size);
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Boot-time arenas carved from capability-tagged heaps. Each region is a
+// single allocation reserved in app_main; after that, buffers are handed
+// out by bumping a cache-line aligned offset and are never freed, so the
+// steady state does no heap allocation. DMA buffers belong to the I2S
+// driver (i2s_capture.h), so there is no DMA region.
+typedef enum {
+    MEM_REGION_FAST = 0, // internal, CPU hot path
+    MEM_REGION_SPIRAM,   // PSRAM, bulk audio
+    MEM_REGION_COUNT,
+} mem_region_t;
+
+#define MEM_ARENA_ALIGN 64
+
+bool mem_arena_reserve(mem_region_t region, size_t bytes);
+void *mem_arena_alloc(mem_region_t region, size_t bytes);
+size_t mem_arena_round(size_t bytes);
+
+int mem_arena_format_json(char *buf, size_t len);
+void mem_arena_log(void);
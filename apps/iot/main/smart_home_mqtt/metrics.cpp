@@ -0,0 +1,255 @@
+#include "metrics.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "task_plan.h"
+
+static const char *TAG = "metrics";
+
+// Rows sharing a name form one family; the labels tell them apart.
+typedef struct {
+    const char *name;
+    const char *labels;
+    const char *help;
+} metric_desc_t;
+
+typedef struct {
+    const char *name;
+    const char *help;
+    uint32_t edges_us[METRICS_HISTOGRAM_BUCKETS - 1];
+} metric_histogram_desc_t;
+
+static const metric_desc_t COUNTERS[METRIC_COUNTER_COUNT] = {
+    {"smart_home_audio_chunks_total", NULL, "AFE feed chunks processed by audio_task"},
+    {"smart_home_audio_sessions_total", NULL, "Recording sessions started by the wake word"},
+    {"smart_home_audio_packets_total", NULL, "AUD0/MEL0 packets sent to the audio server"},
+    {"smart_home_audio_bytes_total", NULL, "Audio payload bytes sent to the audio server"},
+    {"smart_home_audio_agc_limited_total", NULL, "Blocks where the AGC limiter pulled the gain down"},
+    {"smart_home_audio_clip_samples_total", NULL, "Output samples saturated after the AGC"},
+    {"smart_home_i2s_stalls_total", NULL, "I2S acquire timeouts (stalled clock)"},
+    {"smart_home_tcp_failures_total", "op=\"connect\"", "Audio TCP failures: connect, send, credit timeout"},
+    {"smart_home_tcp_failures_total", "op=\"send\"", "Audio TCP failures: connect, send, credit timeout"},
+    {"smart_home_tcp_failures_total", "op=\"credit\"", "Audio TCP failures: connect, send, credit timeout"},
+    {"smart_home_mqtt_sensor_publishes_total", NULL, "Sensor readings published over MQTT"},
+    {"smart_home_mqtt_publish_failures_total", NULL, "Sensor publishes rejected by the MQTT client"},
+    {"smart_home_mqtt_payload_truncated_total", NULL, "Sensor and summary payloads too long for their buffer, not published"},
+    {"smart_home_mqtt_events_total", "event=\"disconnected\"", "MQTT client disconnects and errors"},
+    {"smart_home_mqtt_events_total", "event=\"error\"", "MQTT client disconnects and errors"},
+    {"smart_home_sensor_read_failures_total", "sensor=\"dht11\"", "Failed sensor reads"},
+    {"smart_home_sensor_read_failures_total", "sensor=\"mq135\"", "Failed sensor reads"},
+    {"smart_home_sensor_reports_total", "reason=\"suppressed\"", "Sensor report decisions"},
+    {"smart_home_sensor_reports_total", "reason=\"change\"", "Sensor report decisions"},
+    {"smart_home_sensor_reports_total", "reason=\"heartbeat\"", "Sensor report decisions"},
+    {"smart_home_sensor_reports_total", "reason=\"alert\"", "Sensor report decisions"},
+    {"smart_home_sensor_reports_total", "reason=\"clear\"", "Sensor report decisions"},
+    {"smart_home_audio_credit_stalls_total", NULL, "Credit stalls: audio held back until the server granted more"},
+    {"smart_home_audio_backlog_dropped_total", NULL, "Audio packets dropped with the PSRAM backlog full"},
+    {"smart_home_ota_updates_total", "result=\"ok\"", "Delta OTA updates by result"},
+    {"smart_home_ota_updates_total", "result=\"failed\"", "Delta OTA updates by result"},
+};
+
+static const metric_desc_t GAUGES[METRIC_GAUGE_COUNT] = {
+    {"smart_home_audio_agc_gain_q8", NULL, "AGC gain applied to the last block (Q8)"},
+    {"smart_home_audio_peak", NULL, "Input peak of the last block (16-bit scale)"},
+    {"smart_home_heap_free_bytes", NULL, "Free heap at scrape time"},
+    {"smart_home_heap_min_free_bytes", NULL, "Lowest free heap since boot"},
+    {"smart_home_uptime_seconds", NULL, "Seconds since boot"},
+    {"smart_home_sr_stage_microseconds", "stage=\"partition_map\"", "ESP-SR startup stage duration (sr_models.h)"},
+    {"smart_home_sr_stage_microseconds", "stage=\"index_check\"", "ESP-SR startup stage duration (sr_models.h)"},
+    {"smart_home_sr_stage_microseconds", "stage=\"model_parse\"", "ESP-SR startup stage duration (sr_models.h)"},
+    {"smart_home_sr_stage_microseconds", "stage=\"afe_config\"", "ESP-SR startup stage duration (sr_models.h)"},
+    {"smart_home_sr_stage_microseconds", "stage=\"afe_create\"", "ESP-SR startup stage duration (sr_models.h)"},
+    {"smart_home_sr_stage_microseconds", "stage=\"deferred\"", "ESP-SR startup stage duration (sr_models.h)"},
+    {"smart_home_sr_wake_ready_milliseconds", NULL, "Boot to the first AFE fetch with WakeNet running"},
+    {"smart_home_audio_backlog_bytes", NULL, "Audio waiting in the PSRAM backlog for server credit"},
+    {"smart_home_ota_written_bytes", NULL, "New image bytes written by the current or last OTA update"},
+    {"smart_home_ota_duration_milliseconds", NULL, "Duration of the current or last OTA update"},
+    {"smart_home_ota_audio_late_chunks", NULL, "Audio chunks past their deadline during the current or last OTA update"},
+};
+
+static const metric_histogram_desc_t HISTOGRAMS[METRIC_HISTOGRAM_COUNT] = {
+    {"smart_home_tcp_send_seconds", "Time to hand one audio packet to lwIP",
+     {500, 1000, 2000, 5000, 10000, 50000, 200000}},
+    {"smart_home_sensor_read_seconds", "DHT11 measurement, start to median result",
+     {10000, 25000, 50000, 100000, 250000, 500000, 1000000}},
+    {"smart_home_audio_credit_stall_seconds", "Audio credit stall, first held packet to an empty backlog",
+     {50000, 100000, 250000, 500000, 1000000, 2000000, 5000000}},
+    {"smart_home_ota_flash_write_seconds", "One OTA block written to flash, erase included",
+     {1000, 2000, 5000, 10000, 20000, 50000, 100000}},
+};
+
+static std::atomic<uint32_t> counters[portNUM_PROCESSORS][METRIC_COUNTER_COUNT];
+static std::atomic<int32_t> gauges[METRIC_GAUGE_COUNT];
+static std::atomic<uint32_t> hist_buckets[portNUM_PROCESSORS][METRIC_HISTOGRAM_COUNT][METRICS_HISTOGRAM_BUCKETS];
+// 64-bit: 2^32 us is only 72 minutes of summed durations.
+static std::atomic<uint64_t> hist_sum_us[portNUM_PROCESSORS][METRIC_HISTOGRAM_COUNT];
+
+static httpd_handle_t server = NULL;
+
+void metrics_counter_add(metric_counter_t id, uint32_t n) {
+    if (id >= METRIC_COUNTER_COUNT) {
+        return;
+    }
+    counters[xPortGetCoreID()][id].fetch_add(n, std::memory_order_relaxed);
+}
+
+uint32_t metrics_counter_get(metric_counter_t id) {
+    uint32_t total = 0;
+    if (id >= METRIC_COUNTER_COUNT) {
+        return 0;
+    }
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        total += counters[core][id].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void metrics_gauge_set(metric_gauge_t id, int32_t value) {
+    if (id >= METRIC_GAUGE_COUNT) {
+        return;
+    }
+    gauges[id].store(value, std::memory_order_relaxed);
+}
+
+void metrics_histogram_observe(metric_histogram_t id, uint32_t value_us) {
+    if (id >= METRIC_HISTOGRAM_COUNT) {
+        return;
+    }
+    int b = 0;
+    while (b < METRICS_HISTOGRAM_BUCKETS - 1 && value_us > HISTOGRAMS[id].edges_us[b]) {
+        b++;
+    }
+    int core = xPortGetCoreID();
+    hist_buckets[core][id][b].fetch_add(1, std::memory_order_relaxed);
+    hist_sum_us[core][id].fetch_add(value_us, std::memory_order_relaxed);
+}
+
+static int metrics_format_header(char *buf, size_t len, const char *name, const char *help, const char *type) {
+    return snprintf(buf, len, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static int metrics_format_sample(char *buf, size_t len, const metric_desc_t *desc, long long value) {
+    if (desc->labels) {
+        return snprintf(buf, len, "%s{%s} %lld\n", desc->name, desc->labels, value);
+    }
+    return snprintf(buf, len, "%s %lld\n", desc->name, value);
+}
+
+static int metrics_format_histogram(char *buf, size_t len, metric_histogram_t id) {
+    const metric_histogram_desc_t *desc = &HISTOGRAMS[id];
+    uint32_t cumulative = 0;
+    uint64_t sum_us = 0;
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        sum_us += hist_sum_us[core][id].load(std::memory_order_relaxed);
+    }
+    int n = metrics_format_header(buf, len, desc->name, desc->help, "histogram");
+    for (int b = 0; b < METRICS_HISTOGRAM_BUCKETS && n < (int)len; b++) {
+        for (int core = 0; core < portNUM_PROCESSORS; core++) {
+            cumulative += hist_buckets[core][id][b].load(std::memory_order_relaxed);
+        }
+        if (b < METRICS_HISTOGRAM_BUCKETS - 1) {
+            n += snprintf(buf + n, len - n, "%s_bucket{le=\"%g\"} %u\n", desc->name, desc->edges_us[b] / 1e6,
+                          (unsigned)cumulative);
+        } else {
+            n += snprintf(buf + n, len - n, "%s_bucket{le=\"+Inf\"} %u\n", desc->name, (unsigned)cumulative);
+        }
+    }
+    if (n < (int)len) {
+        n += snprintf(buf + n, len - n, "%s_sum %.6f\n%s_count %u\n", desc->name, sum_us / 1e6, desc->name,
+                      (unsigned)cumulative);
+    }
+    return n;
+}
+
+static esp_err_t metrics_send(httpd_req_t *req, const char *buf, size_t size, int n) {
+    if (n >= (int)size) {
+        ESP_LOGW(TAG, "Metric family needs %d of %u bytes, truncated", n, (unsigned)size);
+        n = (int)size - 1;
+    }
+    return httpd_resp_send_chunk(req, buf, n);
+}
+
+// One family per chunk keeps the buffer small; the response is chunked.
+// httpd runs handlers on its one task, so the buffer can be static.
+static esp_err_t metrics_get_handler(httpd_req_t *req) {
+    static char buf[METRICS_CHUNK_MAX];
+    int n = 0;
+    metrics_gauge_set(METRIC_HEAP_FREE, (int32_t)esp_get_free_heap_size());
+    metrics_gauge_set(METRIC_HEAP_MIN_FREE, (int32_t)esp_get_minimum_free_heap_size());
+    metrics_gauge_set(METRIC_UPTIME_S, (int32_t)(esp_timer_get_time() / 1000000));
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+
+    for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+        const metric_desc_t *desc = &COUNTERS[i];
+        if ((i == 0 || strcmp(desc->name, COUNTERS[i - 1].name) != 0) && n < (int)sizeof(buf)) {
+            n += metrics_format_header(buf + n, sizeof(buf) - n, desc->name, desc->help, "counter");
+        }
+        if (n < (int)sizeof(buf)) {
+            n += metrics_format_sample(buf + n, sizeof(buf) - n, desc, metrics_counter_get((metric_counter_t)i));
+        }
+        bool family_end = i + 1 == METRIC_COUNTER_COUNT || strcmp(desc->name, COUNTERS[i + 1].name) != 0;
+        if (family_end) {
+            if (metrics_send(req, buf, sizeof(buf), n) != ESP_OK) {
+                return ESP_FAIL;
+            }
+            n = 0;
+        }
+    }
+    for (int i = 0; i < METRIC_GAUGE_COUNT; i++) {
+        const metric_desc_t *desc = &GAUGES[i];
+        if ((i == 0 || strcmp(desc->name, GAUGES[i - 1].name) != 0) && n < (int)sizeof(buf)) {
+            n += metrics_format_header(buf + n, sizeof(buf) - n, desc->name, desc->help, "gauge");
+        }
+        if (n < (int)sizeof(buf)) {
+            n += metrics_format_sample(buf + n, sizeof(buf) - n, desc, gauges[i].load(std::memory_order_relaxed));
+        }
+        bool family_end = i + 1 == METRIC_GAUGE_COUNT || strcmp(desc->name, GAUGES[i + 1].name) != 0;
+        if (family_end) {
+            if (metrics_send(req, buf, sizeof(buf), n) != ESP_OK) {
+                return ESP_FAIL;
+            }
+            n = 0;
+        }
+    }
+    for (int i = 0; i < METRIC_HISTOGRAM_COUNT; i++) {
+        n = metrics_format_histogram(buf, sizeof(buf), (metric_histogram_t)i);
+        if (metrics_send(req, buf, sizeof(buf), n) != ESP_OK) {
+            return ESP_FAIL;
+        }
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+bool metrics_http_start(uint16_t port) {
+    if (server) {
+        return true;
+    }
+    const task_spec_t *spec = task_plan_get(TASK_ID_METRICS);
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = port;
+    config.max_uri_handlers = 1;
+    config.stack_size = spec->stack;
+    config.task_priority = spec->priority;
+    config.core_id = spec->core;
+    if (httpd_start(&server, &config) != ESP_OK) {
+        ESP_LOGW(TAG, "HTTP server start failed on port %u", (unsigned)port);
+        server = NULL;
+        return false;
+    }
+    httpd_uri_t uri = {};
+    uri.uri = "/metrics";
+    uri.method = HTTP_GET;
+    uri.handler = metrics_get_handler;
+    httpd_register_uri_handler(server, &uri);
+    ESP_LOGI(TAG, "Serving /metrics on port %u", (unsigned)port);
+    return true;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Statically registered metrics, served as Prometheus text exposition on
+// GET /metrics. Counters and histograms keep one slot per core and are
+// updated with a relaxed atomic add, so hot paths never lock, format text
+// or contend with the other core; a scrape sums the slots. Gauges hold
+// the last value set.
+//
+// Counters are 32-bit and wrap; Prometheus' rate() treats a wrap like a
+// restart. Adding a metric means an enum entry here and a row in the
+// matching table in metrics.cpp. Names are at most METRICS_NAME_MAX
+// characters and help texts METRICS_HELP_MAX, which size the scrape buffer
+// (apps/iot/scripts/metrics_check.cpp checks both).
+typedef enum {
+    METRIC_AUDIO_CHUNKS = 0,
+    METRIC_AUDIO_SESSIONS,
+    METRIC_AUDIO_PACKETS,
+    METRIC_AUDIO_BYTES,
+    METRIC_AUDIO_AGC_LIMITED,
+    METRIC_AUDIO_CLIP_SAMPLES,
+    METRIC_I2S_STALLS,
+    METRIC_TCP_CONNECT_FAILURES,
+    METRIC_TCP_SEND_FAILURES,
+    METRIC_TCP_CREDIT_TIMEOUTS,
+    METRIC_MQTT_SENSOR_PUBLISHES,
+    METRIC_MQTT_PUBLISH_FAILURES,
+    METRIC_MQTT_PAYLOAD_TRUNCATED,
+    METRIC_MQTT_DISCONNECTS,
+    METRIC_MQTT_ERRORS,
+    METRIC_SENSOR_DHT11_FAILURES,
+    METRIC_SENSOR_MQ135_FAILURES,
+    METRIC_SENSOR_REPORTS_SUPPRESSED,
+    METRIC_SENSOR_REPORTS_CHANGE,
+    METRIC_SENSOR_REPORTS_HEARTBEAT,
+    METRIC_SENSOR_REPORTS_ALERT,
+    METRIC_SENSOR_REPORTS_CLEAR,
+    METRIC_AUDIO_CREDIT_STALLS,
+    METRIC_AUDIO_BACKLOG_DROPS,
+    METRIC_OTA_UPDATES_OK,
+    METRIC_OTA_UPDATES_FAILED,
+    METRIC_COUNTER_COUNT,
+} metric_counter_t;
+
+typedef enum {
+    METRIC_AUDIO_AGC_GAIN_Q8 = 0,
+    METRIC_AUDIO_PEAK,
+    METRIC_HEAP_FREE,
+    METRIC_HEAP_MIN_FREE,
+    METRIC_UPTIME_S,
+    METRIC_SR_PARTITION_MAP_US, // one per sr_stage_t, same order
+    METRIC_SR_INDEX_CHECK_US,
+    METRIC_SR_MODEL_PARSE_US,
+    METRIC_SR_AFE_CONFIG_US,
+    METRIC_SR_AFE_CREATE_US,
+    METRIC_SR_DEFERRED_US,
+    METRIC_SR_WAKE_READY_MS,
+    METRIC_AUDIO_BACKLOG_BYTES,
+    METRIC_OTA_WRITTEN_BYTES,   // current or last update (ota_update.h)
+    METRIC_OTA_DURATION_MS,
+    METRIC_OTA_AUDIO_LATE,
+    METRIC_GAUGE_COUNT,
+} metric_gauge_t;
+
+// Observations are in microseconds and exported in seconds.
+typedef enum {
+    METRIC_TCP_SEND_US = 0,
+    METRIC_SENSOR_READ_US,
+    METRIC_AUDIO_CREDIT_STALL_US,
+    METRIC_OTA_FLASH_WRITE_US,
+    METRIC_HISTOGRAM_COUNT,
+} metric_histogram_t;
+
+#define METRICS_HISTOGRAM_BUCKETS 8 // last bucket is +Inf
+
+#define METRICS_NAME_MAX 64
+#define METRICS_HELP_MAX 96
+
+// One family per scrape chunk. A histogram is the largest: HELP and TYPE
+// (2 names + help + 27), a bucket line per bucket (name + 38 with a %g
+// edge and a %u count), _sum of a 64-bit total (name + 27) and _count
+// (name + 18).
+#define METRICS_CHUNK_MAX \
+    (4 * METRICS_NAME_MAX + METRICS_HELP_MAX + 80 + METRICS_HISTOGRAM_BUCKETS * (METRICS_NAME_MAX + 40))
+
+void metrics_counter_add(metric_counter_t id, uint32_t n);
+static inline void metrics_counter_inc(metric_counter_t id) {
+    metrics_counter_add(id, 1);
+}
+uint32_t metrics_counter_get(metric_counter_t id);
+
+void metrics_gauge_set(metric_gauge_t id, int32_t value);
+
+void metrics_histogram_observe(metric_histogram_t id, uint32_t value_us);
+
+// Starts the HTTP server; call once the network stack is up.
+bool metrics_http_start(uint16_t port);
@@ -0,0 +1,288 @@
+#include "ota_delta.h"
+
+#include <string.h>
+
+// Builds on the host as well (apps/iot/scripts/ota_delta.cpp), so nothing
+// here depends on ESP-IDF.
+
+enum {
+    ST_HEADER = 0,
+    ST_OP,
+    ST_ARGS,
+    ST_COPY,
+    ST_RUN,  // ADD run header
+    ST_SAME, // ADD run, unchanged bytes
+    ST_DIFF, // ADD run, patched bytes
+    ST_INSERT,
+    ST_END,
+};
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static ota_delta_status_t fail(ota_delta_t *d, ota_delta_status_t status) {
+    d->status = status;
+    return status;
+}
+
+static void expect(ota_delta_t *d, int state, size_t need) {
+    d->state = state;
+    d->arg_len = 0;
+    d->arg_need = need;
+}
+
+// Collects d->arg_need bytes into d->arg; true once they are all there.
+static bool gather(ota_delta_t *d, const uint8_t *data, size_t len, size_t *pos) {
+    size_t n = d->arg_need - d->arg_len;
+    if (n > len - *pos) {
+        n = len - *pos;
+    }
+    memcpy(d->arg + d->arg_len, data + *pos, n);
+    d->arg_len += n;
+    *pos += n;
+    return d->arg_len == d->arg_need;
+}
+
+static bool flush_if_full(ota_delta_t *d) {
+    if (d->fill < OTA_DELTA_BLOCK) {
+        return true;
+    }
+    if (!d->io.write_new(d->io.ctx, d->out, d->fill)) {
+        return false;
+    }
+    d->written += d->fill;
+    d->fill = 0;
+    return true;
+}
+
+// Reads the old bytes for the rest of the output block (or the op).
+static bool stage(ota_delta_t *d) {
+    if (d->staged > 0) {
+        return true;
+    }
+    size_t n = OTA_DELTA_BLOCK - d->fill;
+    if (n > d->op_left) {
+        n = d->op_left;
+    }
+    if (!d->io.read_old(d->io.ctx, d->old_off, d->out + d->fill, n)) {
+        return false;
+    }
+    d->old_off += n;
+    d->staged = n;
+    return true;
+}
+
+// Moves n staged bytes into the finished part of the block.
+static void commit(ota_delta_t *d, size_t n) {
+    d->fill += n;
+    d->staged -= n;
+    d->op_left -= n;
+}
+
+static void next_after_run(ota_delta_t *d) {
+    if (d->op_left == 0) {
+        expect(d, ST_OP, 1);
+    } else {
+        expect(d, ST_RUN, 4);
+    }
+}
+
+static ota_delta_status_t start_op(ota_delta_t *d) {
+    uint32_t len = d->op == 'I' ? get_u32(d->arg) : get_u32(d->arg + 4);
+    uint64_t end_new = (uint64_t)d->written + d->fill + len;
+    if (end_new > d->header.new_size) {
+        return fail(d, OTA_DELTA_ERR_RANGE);
+    }
+    d->op_left = len;
+    if (d->op == 'I') {
+        d->state = ST_INSERT;
+        return OTA_DELTA_MORE;
+    }
+    d->old_off = get_u32(d->arg);
+    if ((uint64_t)d->old_off + len > d->header.old_size) {
+        return fail(d, OTA_DELTA_ERR_RANGE);
+    }
+    if (d->op == 'C') {
+        d->state = ST_COPY;
+    } else {
+        next_after_run(d);
+    }
+    return OTA_DELTA_MORE;
+}
+
+void ota_delta_init(ota_delta_t *d, const ota_delta_io_t *io) {
+    memset(d, 0, sizeof(*d));
+    d->io = *io;
+    d->status = OTA_DELTA_MORE;
+    expect(d, ST_HEADER, OTA_DELTA_HEADER_LEN);
+}
+
+ota_delta_status_t ota_delta_feed(ota_delta_t *d, const uint8_t *data, size_t len) {
+    size_t pos = 0;
+    while (d->status == OTA_DELTA_MORE) {
+        switch (d->state) {
+        case ST_HEADER:
+            if (!gather(d, data, len, &pos)) {
+                return OTA_DELTA_MORE;
+            }
+            if (memcmp(d->arg, OTA_DELTA_MAGIC, 4) != 0) {
+                return fail(d, OTA_DELTA_ERR_FORMAT);
+            }
+            d->header.old_size = get_u32(d->arg + 4);
+            d->header.new_size = get_u32(d->arg + 8);
+            memcpy(d->header.old_sha256, d->arg + 12, 32);
+            memcpy(d->header.new_sha256, d->arg + 44, 32);
+            if (d->io.begin && !d->io.begin(d->io.ctx, &d->header)) {
+                return fail(d, OTA_DELTA_ERR_IO);
+            }
+            expect(d, ST_OP, 1);
+            break;
+        case ST_OP:
+            if (!gather(d, data, len, &pos)) {
+                return OTA_DELTA_MORE;
+            }
+            d->op = d->arg[0];
+            if (d->op == 'C' || d->op == 'A') {
+                expect(d, ST_ARGS, 8);
+            } else if (d->op == 'I') {
+                expect(d, ST_ARGS, 4);
+            } else if (d->op == 'E') {
+                d->state = ST_END;
+            } else {
+                return fail(d, OTA_DELTA_ERR_FORMAT);
+            }
+            break;
+        case ST_ARGS:
+            if (!gather(d, data, len, &pos)) {
+                return OTA_DELTA_MORE;
+            }
+            start_op(d);
+            break;
+        case ST_COPY:
+            while (d->op_left > 0) {
+                if (!stage(d)) {
+                    return fail(d, OTA_DELTA_ERR_IO);
+                }
+                commit(d, d->staged);
+                if (!flush_if_full(d)) {
+                    return fail(d, OTA_DELTA_ERR_IO);
+                }
+            }
+            expect(d, ST_OP, 1);
+            break;
+        case ST_RUN:
+            if (!gather(d, data, len, &pos)) {
+                return OTA_DELTA_MORE;
+            }
+            d->same_left = get_u16(d->arg);
+            d->diff_left = get_u16(d->arg + 2);
+            if (d->same_left + d->diff_left > d->op_left) {
+                return fail(d, OTA_DELTA_ERR_FORMAT);
+            }
+            d->state = ST_SAME;
+            break;
+        case ST_SAME:
+            while (d->same_left > 0) {
+                if (!stage(d)) {
+                    return fail(d, OTA_DELTA_ERR_IO);
+                }
+                size_t n = d->staged < d->same_left ? d->staged : d->same_left;
+                commit(d, n);
+                d->same_left -= n;
+                if (!flush_if_full(d)) {
+                    return fail(d, OTA_DELTA_ERR_IO);
+                }
+            }
+            if (d->diff_left > 0) {
+                d->state = ST_DIFF;
+            } else {
+                next_after_run(d);
+            }
+            break;
+        case ST_DIFF:
+            while (d->diff_left > 0) {
+                if (pos == len) {
+                    return OTA_DELTA_MORE;
+                }
+                if (!stage(d)) {
+                    return fail(d, OTA_DELTA_ERR_IO);
+                }
+                size_t n = d->staged < d->diff_left ? d->staged : d->diff_left;
+                if (n > len - pos) {
+                    n = len - pos;
+                }
+                uint8_t *out = d->out + d->fill;
+                for (size_t i = 0; i < n; i++) {
+                    out[i] = (uint8_t)(out[i] + data[pos + i]);
+                }
+                pos += n;
+                commit(d, n);
+                d->diff_left -= n;
+                if (!flush_if_full(d)) {
+                    return fail(d, OTA_DELTA_ERR_IO);
+                }
+            }
+            next_after_run(d);
+            break;
+        case ST_INSERT:
+            while (d->op_left > 0) {
+                if (pos == len) {
+                    return OTA_DELTA_MORE;
+                }
+                size_t n = OTA_DELTA_BLOCK - d->fill;
+                if (n > d->op_left) {
+                    n = d->op_left;
+                }
+                if (n > len - pos) {
+                    n = len - pos;
+                }
+                memcpy(d->out + d->fill, data + pos, n);
+                pos += n;
+                d->fill += n;
+                d->op_left -= n;
+                if (!flush_if_full(d)) {
+                    return fail(d, OTA_DELTA_ERR_IO);
+                }
+            }
+            expect(d, ST_OP, 1);
+            break;
+        case ST_END:
+            if (d->written + d->fill != d->header.new_size) {
+                return fail(d, OTA_DELTA_ERR_FORMAT);
+            }
+            if (d->fill > 0 && !d->io.write_new(d->io.ctx, d->out, d->fill)) {
+                return fail(d, OTA_DELTA_ERR_IO);
+            }
+            d->written += d->fill;
+            d->fill = 0;
+            d->status = OTA_DELTA_DONE;
+            break;
+        }
+    }
+    return d->status;
+}
+
+uint32_t ota_delta_progress(const ota_delta_t *d) {
+    return d->written + (uint32_t)d->fill;
+}
+
+const char *ota_delta_status_name(ota_delta_status_t status) {
+    switch (status) {
+    case OTA_DELTA_MORE:
+        return "more";
+    case OTA_DELTA_DONE:
+        return "done";
+    case OTA_DELTA_ERR_FORMAT:
+        return "format";
+    case OTA_DELTA_ERR_RANGE:
+        return "range";
+    case OTA_DELTA_ERR_IO:
+        return "io";
+    }
+    return "?";
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming binary delta between two firmware images, produced by
+// apps/iot/scripts/ota_delta.cpp and applied by ota_update.cpp. The new
+// image is written strictly in order, so it can go straight into an OTA
+// slot; the old image (the running slot) is only read.
+//
+//   header  "SHD1" old_size:u32 new_size:u32 old_sha256[32] new_sha256[32]
+//   COPY    'C' off:u32 len:u32           new += old[off, off + len)
+//   ADD     'A' off:u32 len:u32 runs      new += old[off, off + len) + runs
+//   INSERT  'I' len:u32 data[len]         new += data
+//   END     'E'
+//
+// All fields little endian. The runs of an ADD cover its len bytes in
+// order as {same:u16 n:u16 diff[n]}: same bytes copied unchanged, then n
+// bytes where new = old + diff (mod 256). Relinked code differs from the
+// old image mostly in scattered address bytes, which ADD carries without
+// repeating the bytes around them.
+//
+// The decoder is push-driven: feed it the delta in pieces of any size.
+// It holds one OTA_DELTA_BLOCK of output and never reads ahead in the
+// stream. It builds on the host as well, for the generator's self-check.
+
+#define OTA_DELTA_MAGIC "SHD1"
+#define OTA_DELTA_HEADER_LEN 76
+#define OTA_DELTA_BLOCK 4096
+
+typedef struct {
+    uint32_t old_size;
+    uint32_t new_size;
+    uint8_t old_sha256[32];
+    uint8_t new_sha256[32];
+} ota_delta_header_t;
+
+typedef struct {
+    // Called once the header is in, before any output; false aborts.
+    bool (*begin)(void *ctx, const ota_delta_header_t *header);
+    // Reads len bytes of the old image at off.
+    bool (*read_old)(void *ctx, uint32_t off, uint8_t *buf, size_t len);
+    // Takes the next len bytes of the new image.
+    bool (*write_new)(void *ctx, const uint8_t *buf, size_t len);
+    void *ctx;
+} ota_delta_io_t;
+
+typedef enum {
+    OTA_DELTA_MORE = 0,  // consumed everything, waiting for more
+    OTA_DELTA_DONE,      // END seen and the new image complete
+    OTA_DELTA_ERR_FORMAT,
+    OTA_DELTA_ERR_RANGE, // an op reaches outside either image
+    OTA_DELTA_ERR_IO,    // a callback failed
+} ota_delta_status_t;
+
+typedef struct {
+    ota_delta_io_t io;
+    ota_delta_header_t header;
+    int state;
+    uint8_t op;
+    uint8_t arg[OTA_DELTA_HEADER_LEN];
+    size_t arg_len;
+    size_t arg_need;
+    uint32_t old_off;   // next old byte of the current op
+    uint32_t op_left;   // new bytes left in the current op
+    uint32_t same_left; // of the current ADD run
+    uint32_t diff_left;
+    uint32_t written;   // new bytes handed to write_new
+    size_t fill;        // finished bytes in out
+    size_t staged;      // old bytes in out after fill, not yet final
+    ota_delta_status_t status;
+    uint8_t out[OTA_DELTA_BLOCK];
+} ota_delta_t;
+
+void ota_delta_init(ota_delta_t *d, const ota_delta_io_t *io);
+// Returns MORE until the delta is complete, then DONE. After an error or
+// DONE every further call returns the same status.
+ota_delta_status_t ota_delta_feed(ota_delta_t *d, const uint8_t *data, size_t len);
+// Output bytes of the new image so far (including the block not yet
+// handed to write_new).
+uint32_t ota_delta_progress(const ota_delta_t *d);
+const char *ota_delta_status_name(ota_delta_status_t status);
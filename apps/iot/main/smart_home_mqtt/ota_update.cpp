@@ -0,0 +1,377 @@
+#include "ota_update.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+
+#include "sdkconfig.h"
+#include "esp_crt_bundle.h"
+#include "esp_heap_caps.h"
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mbedtls/sha256.h"
+
+#include "audio_deadline.h"
+#include "metrics.h"
+#include "ota_delta.h"
+#include "power_profile.h"
+#include "task_plan.h"
+
+static const char *TAG = "ota_update";
+
+static const int OTA_URL_MAX = 256;
+static const int OTA_TOPIC_MAX = 96;
+static const int OTA_RX_BYTES = 2048;
+static const int OTA_HTTP_TIMEOUT_MS = 15000;
+static const int OTA_SESSION_POLL_MS = 200;
+static const int OTA_REBOOT_DELAY_MS = 1000;
+
+typedef enum {
+    OTA_STATE_IDLE = 0,
+    OTA_STATE_RUNNING,
+    OTA_STATE_DONE, // boot slot switched, reboot pending
+    OTA_STATE_FAILED,
+} ota_state_t;
+
+static const char *const STATE_NAMES[] = {"idle", "running", "done", "failed"};
+
+// Lives on the heap only while an update runs.
+typedef struct {
+    ota_delta_t delta;
+    uint8_t rx[OTA_RX_BYTES];
+    mbedtls_sha256_context sha;
+    const esp_partition_t *running;
+    const esp_partition_t *target;
+    const uint8_t *old_image; // the running slot, memory-mapped
+    esp_partition_mmap_handle_t old_map;
+    bool mapped;
+    esp_ota_handle_t handle;
+    bool begun;
+    const char *error;
+} ota_job_t;
+
+static char ota_url[OTA_URL_MAX];
+static std::atomic<int> state{OTA_STATE_IDLE};
+static std::atomic<uint32_t> new_size{0};
+static std::atomic<uint32_t> written{0};
+static std::atomic<uint32_t> delta_bytes{0};
+static std::atomic<uint32_t> duration_ms{0};
+static std::atomic<uint32_t> audio_late{0};
+static std::atomic<const char *> last_error{""};
+static int64_t start_us = 0;
+static uint32_t late_at_start = 0;
+
+static esp_mqtt_client_handle_t ota_client = NULL;
+static char state_topic[OTA_TOPIC_MAX];
+static char set_topic[OTA_TOPIC_MAX];
+
+// Flash erase and write stall instruction fetch on both cores. Between
+// sessions the I2S DMA ring absorbs that; during one nothing is written.
+static void wait_for_idle_audio(void) {
+    while (power_profile_in_session()) {
+        vTaskDelay(pdMS_TO_TICKS(OTA_SESSION_POLL_MS));
+    }
+}
+
+// Duration and audio deadline misses so far, mirrored to the gauges.
+static void note_progress(void) {
+    uint32_t late = audio_deadline_late_count();
+    // 'deadline reset' on the console restarts the count.
+    late = late >= late_at_start ? late - late_at_start : late;
+    duration_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+    audio_late = late;
+    metrics_gauge_set(METRIC_OTA_DURATION_MS, (int32_t)duration_ms.load());
+    metrics_gauge_set(METRIC_OTA_AUDIO_LATE, (int32_t)late);
+    metrics_gauge_set(METRIC_OTA_WRITTEN_BYTES, (int32_t)written.load());
+}
+
+static bool job_begin(void *ctx, const ota_delta_header_t *header) {
+    ota_job_t *job = (ota_job_t *)ctx;
+    if (header->old_size == 0 || header->old_size > job->running->size || header->new_size > job->target->size) {
+        job->error = "size";
+        return false;
+    }
+    const void *map = NULL;
+    if (esp_partition_mmap(job->running, 0, header->old_size, ESP_PARTITION_MMAP_DATA, &map, &job->old_map) !=
+        ESP_OK) {
+        job->error = "map";
+        return false;
+    }
+    job->mapped = true;
+    job->old_image = (const uint8_t *)map;
+
+    // A delta only fits the exact build it was made against.
+    uint8_t digest[32];
+    mbedtls_sha256_starts(&job->sha, 0);
+    mbedtls_sha256_update(&job->sha, job->old_image, header->old_size);
+    mbedtls_sha256_finish(&job->sha, digest);
+    if (memcmp(digest, header->old_sha256, sizeof(digest)) != 0) {
+        job->error = "base";
+        return false;
+    }
+
+    // Sequential writes erase sector by sector instead of the whole slot
+    // up front, so no single flash operation runs long.
+    wait_for_idle_audio();
+    if (esp_ota_begin(job->target, OTA_WITH_SEQUENTIAL_WRITES, &job->handle) != ESP_OK) {
+        job->error = "begin";
+        return false;
+    }
+    job->begun = true;
+    mbedtls_sha256_starts(&job->sha, 0);
+    new_size = header->new_size;
+    ESP_LOGI(TAG, "Applying delta: %lu -> %lu bytes into %s", (unsigned long)header->old_size,
+             (unsigned long)header->new_size, job->target->label);
+    return true;
+}
+
+static bool job_read_old(void *ctx, uint32_t off, uint8_t *buf, size_t len) {
+    ota_job_t *job = (ota_job_t *)ctx;
+    memcpy(buf, job->old_image + off, len);
+    return true;
+}
+
+static bool job_write_new(void *ctx, const uint8_t *buf, size_t len) {
+    ota_job_t *job = (ota_job_t *)ctx;
+    wait_for_idle_audio();
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = esp_ota_write(job->handle, buf, len);
+    metrics_histogram_observe(METRIC_OTA_FLASH_WRITE_US, (uint32_t)(esp_timer_get_time() - t0));
+    if (err != ESP_OK) {
+        job->error = "write";
+        return false;
+    }
+    mbedtls_sha256_update(&job->sha, buf, len);
+    written += len;
+    note_progress();
+    if (CONFIG_SMART_HOME_OTA_WRITE_PAUSE_MS > 0) {
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_SMART_HOME_OTA_WRITE_PAUSE_MS));
+    }
+    return true;
+}
+
+static bool ota_stream(ota_job_t *job, esp_http_client_handle_t http) {
+    ota_delta_io_t io = {job_begin, job_read_old, job_write_new, job};
+    ota_delta_init(&job->delta, &io);
+    ota_delta_status_t status = OTA_DELTA_MORE;
+    while (status == OTA_DELTA_MORE) {
+        int n = esp_http_client_read(http, (char *)job->rx, sizeof(job->rx));
+        if (n <= 0) {
+            job->error = n < 0 ? "read" : "truncated";
+            return false;
+        }
+        delta_bytes += n;
+        status = ota_delta_feed(&job->delta, job->rx, (size_t)n);
+    }
+    if (status != OTA_DELTA_DONE) {
+        if (!job->error) {
+            job->error = ota_delta_status_name(status);
+        }
+        return false;
+    }
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&job->sha, digest);
+    if (memcmp(digest, job->delta.header.new_sha256, sizeof(digest)) != 0) {
+        job->error = "sha256";
+        return false;
+    }
+    // Also checks the image header, segments and the image's own hash.
+    job->begun = false;
+    if (esp_ota_end(job->handle) != ESP_OK) {
+        job->error = "image";
+        return false;
+    }
+    if (esp_ota_set_boot_partition(job->target) != ESP_OK) {
+        job->error = "boot";
+        return false;
+    }
+    return true;
+}
+
+static bool ota_run(ota_job_t *job, const char *url) {
+    job->running = esp_ota_get_running_partition();
+    job->target = esp_ota_get_next_update_partition(NULL);
+    if (!job->running || !job->target) {
+        job->error = "partition";
+        return false;
+    }
+    esp_http_client_config_t config = {};
+    config.url = url;
+    config.timeout_ms = OTA_HTTP_TIMEOUT_MS;
+    config.crt_bundle_attach = esp_crt_bundle_attach;
+    esp_http_client_handle_t http = esp_http_client_init(&config);
+    if (!http) {
+        job->error = "http";
+        return false;
+    }
+    bool ok = false;
+    if (esp_http_client_open(http, 0) != ESP_OK) {
+        job->error = "connect";
+    } else if (esp_http_client_fetch_headers(http) < 0 || esp_http_client_get_status_code(http) != 200) {
+        job->error = "http";
+    } else {
+        ok = ota_stream(job, http);
+    }
+    esp_http_client_close(http);
+    esp_http_client_cleanup(http);
+    return ok;
+}
+
+static void ota_publish_state(void) {
+    if (!ota_client) {
+        return;
+    }
+    char buf[256];
+    int len = ota_update_format_json(buf, sizeof(buf));
+    if (len > 0 && len < (int)sizeof(buf)) {
+        esp_mqtt_client_publish(ota_client, state_topic, buf, len, 1, 0);
+    }
+}
+
+static void ota_task(void *arg) {
+    ota_job_t *job = (ota_job_t *)heap_caps_calloc(1, sizeof(ota_job_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    bool ok = false;
+    if (!job) {
+        last_error = "memory";
+    } else {
+        mbedtls_sha256_init(&job->sha);
+        ok = ota_run(job, ota_url);
+        if (job->begun) {
+            esp_ota_abort(job->handle);
+        }
+        if (job->mapped) {
+            esp_partition_munmap(job->old_map);
+        }
+        mbedtls_sha256_free(&job->sha);
+        if (!ok) {
+            last_error = job->error ? job->error : "unknown";
+        }
+        heap_caps_free(job);
+    }
+    note_progress();
+    metrics_counter_inc(ok ? METRIC_OTA_UPDATES_OK : METRIC_OTA_UPDATES_FAILED);
+    state = ok ? OTA_STATE_DONE : OTA_STATE_FAILED;
+    if (ok) {
+        ESP_LOGI(TAG, "Update written in %lu ms (%lu delta bytes, %lu late audio chunks)",
+                 (unsigned long)duration_ms.load(), (unsigned long)delta_bytes.load(),
+                 (unsigned long)audio_late.load());
+    } else {
+        ESP_LOGE(TAG, "Update failed (%s) after %lu ms", last_error.load(), (unsigned long)duration_ms.load());
+    }
+    ota_publish_state();
+    if (ok) {
+        wait_for_idle_audio();
+        vTaskDelay(pdMS_TO_TICKS(OTA_REBOOT_DELAY_MS));
+        ESP_LOGI(TAG, "Rebooting into the new image");
+        esp_restart();
+    }
+    vTaskDelete(NULL);
+}
+
+bool ota_update_start(const char *url, size_t len) {
+    if (!url || len == 0 || len >= sizeof(ota_url)) {
+        return false;
+    }
+#ifndef CONFIG_SMART_HOME_OTA_ALLOW_HTTP
+    // Images are not signed; TLS to a verified server is the only check
+    // on where the bytes come from.
+    if (len < 8 || strncmp(url, "https://", 8) != 0) {
+        ESP_LOGW(TAG, "Rejected a non-HTTPS update URL");
+        return false;
+    }
+#endif
+    int expected = state.load();
+    if (expected == OTA_STATE_RUNNING || expected == OTA_STATE_DONE ||
+        !state.compare_exchange_strong(expected, OTA_STATE_RUNNING)) {
+        return false;
+    }
+    memcpy(ota_url, url, len);
+    ota_url[len] = '\0';
+    new_size = 0;
+    written = 0;
+    delta_bytes = 0;
+    last_error = "";
+    start_us = esp_timer_get_time();
+    late_at_start = audio_deadline_late_count();
+    note_progress();
+    if (!task_plan_create(TASK_ID_OTA, ota_task, NULL, NULL)) {
+        last_error = "task";
+        state = OTA_STATE_FAILED;
+        return false;
+    }
+    ESP_LOGI(TAG, "Update from %s", ota_url);
+    ota_publish_state();
+    return true;
+}
+
+int ota_update_format_json(char *buf, size_t len) {
+    int s = state.load();
+    uint32_t ms = duration_ms.load();
+    uint32_t late = audio_late.load();
+    // Live figures while running; the gauges stay with ota_task.
+    if (s == OTA_STATE_RUNNING) {
+        ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+        late = audio_deadline_late_count();
+        late = late >= late_at_start ? late - late_at_start : late;
+    }
+    return snprintf(buf, len,
+                    "{\"state\":\"%s\",\"written\":%lu,\"size\":%lu,\"delta_bytes\":%lu,\"duration_ms\":%lu,"
+                    "\"audio_late\":%lu,\"error\":\"%s\"}",
+                    STATE_NAMES[s], (unsigned long)written.load(), (unsigned long)new_size.load(),
+                    (unsigned long)delta_bytes.load(), (unsigned long)ms, (unsigned long)late,
+                    last_error.load());
+}
+
+// With bootloader rollback enabled, a new image stays on probation until
+// it reaches the broker; otherwise its state is never pending.
+static void ota_confirm_image(void) {
+    esp_ota_img_states_t img_state;
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    if (running && esp_ota_get_state_partition(running, &img_state) == ESP_OK &&
+        img_state == ESP_OTA_IMG_PENDING_VERIFY) {
+        esp_ota_mark_app_valid_cancel_rollback();
+        ESP_LOGI(TAG, "New image confirmed");
+    }
+}
+
+static void ota_mqtt_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data) {
+    esp_mqtt_event_handle_t event = (esp_mqtt_event_handle_t)event_data;
+    switch (event->event_id) {
+        case MQTT_EVENT_CONNECTED:
+            ota_confirm_image();
+            esp_mqtt_client_subscribe(ota_client, set_topic, 1);
+            break;
+        case MQTT_EVENT_DATA:
+            if (event->topic_len != (int)strlen(set_topic) ||
+                strncmp(event->topic, set_topic, event->topic_len) != 0) {
+                break;
+            }
+            if (event->data_len != event->total_data_len) {
+                ESP_LOGW(TAG, "Fragmented request ignored (%d bytes)", event->total_data_len);
+                break;
+            }
+            if (!ota_update_start(event->data, (size_t)event->data_len)) {
+                ESP_LOGW(TAG, "Update request rejected (%s)", STATE_NAMES[state.load()]);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void ota_update_mqtt_start(esp_mqtt_client_handle_t client, const char *topic) {
+    if (!client || !topic || strlen(topic) == 0) {
+        return;
+    }
+    snprintf(state_topic, sizeof(state_topic), "%s", topic);
+    snprintf(set_topic, sizeof(set_topic), "%s/set", topic);
+    ota_client = client;
+    esp_mqtt_client_register_event(client, MQTT_EVENT_ANY, ota_mqtt_handler, NULL);
+    ESP_LOGI(TAG, "Update requests on %s", set_topic);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "mqtt_client.h"
+
+// Delta OTA into the inactive app slot (app0/app1 in partitions.csv).
+// The delta (ota_delta.h, made by apps/iot/scripts/ota_delta.cpp) is
+// streamed over HTTP and applied on the fly against the memory-mapped
+// running slot, so RAM use is one output block and one receive buffer
+// whatever the image size. The running image must be the delta's base
+// (SHA-256 checked before anything is erased); the new image is hashed as
+// it is written and only becomes the boot slot when the digest matches
+// and esp_ota_end() accepts it. The board reboots into it at the next
+// point without a recording session.
+//
+// The update runs on a priority-1 task on the network core and holds off
+// flash writes while a recording session is live, since erase and write
+// stall instruction fetch on both cores. Duration, flash write times and
+// the audio deadline misses during the update are exported (metrics.h)
+// and in the status JSON.
+//
+// Start one by publishing the delta URL to <topic>/set or with the
+// console command 'ota <url>'; progress and the result go to <topic>.
+// Images are not signed: the hashes in the delta only prove it applies
+// to the running image and arrived intact. What gets flashed rests on
+// who may publish to <topic>/set (restrict it with a broker ACL) and on
+// the server, which must be HTTPS with a certificate in the ESP-IDF
+// bundle unless SMART_HOME_OTA_ALLOW_HTTP is set. Rollback is enabled, so
+// an image that never reaches the broker is replaced by the previous one
+// at the next reset.
+void ota_update_mqtt_start(esp_mqtt_client_handle_t client, const char *topic);
+
+// False while an update runs or waits for its reboot, or for a bad URL.
+bool ota_update_start(const char *url, size_t len);
+
+int ota_update_format_json(char *buf, size_t len);
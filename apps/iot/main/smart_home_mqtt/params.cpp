@@ -0,0 +1,373 @@
+#include "params.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "nvs.h"
+
+static const char *TAG = "params";
+
+static const char *PARAMS_NVS_NS = "params";
+static const int PARAMS_TEXT_MAX = 512;
+static const int PARAMS_TOPIC_MAX = 96;
+
+// Names double as NVS keys (15 characters at most).
+typedef struct {
+    const char *name;
+    param_type_t type;
+    float def;
+    float min;
+    float max;
+} param_desc_t;
+
+static const param_desc_t PARAMS[PARAM_COUNT] = {
+    {"silence_ms",    PARAM_TYPE_INT,   2000,    300,    10000},
+    {"max_record_ms", PARAM_TYPE_INT,   20000,   1000,   60000},
+    {"energy_thresh", PARAM_TYPE_INT,   250,     0,      32767},
+    {"gain_shift",    PARAM_TYPE_INT,   2,       0,      6},
+    {"agg_frames",    PARAM_TYPE_INT,   3,       1,      6},
+    {"sensor_pub_ms", PARAM_TYPE_INT,   10000,   1000,   3600000},
+    {"summary_ms",    PARAM_TYPE_INT,   60000,   10000,  3600000},
+    {"report_hb_ms",  PARAM_TYPE_INT,   60000,   10000,  3600000},
+    {"db_temp",       PARAM_TYPE_FLOAT, 1.0f,    0.0f,   20.0f},
+    {"db_humidity",   PARAM_TYPE_FLOAT, 2.0f,    0.0f,   50.0f},
+    {"db_gas_raw",    PARAM_TYPE_FLOAT, 20.0f,   0.0f,   4095.0f},
+    {"db_ppm_abs",    PARAM_TYPE_FLOAT, 1.0f,    0.0f,   10000.0f},
+    {"db_ppm_rel",    PARAM_TYPE_FLOAT, 0.10f,   0.0f,   1.0f},
+    {"gas_poll_ms",   PARAM_TYPE_INT,   1000,    200,    60000},
+    {"alert_ratio",   PARAM_TYPE_FLOAT, 1.0f,    0.0f,   100.0f},
+    {"alert_ppm",     PARAM_TYPE_FLOAT, 1000.0f, 0.0f,   100000.0f},
+    {"alert_slope",   PARAM_TYPE_FLOAT, 0.10f,   0.0f,   10.0f},
+    {"dht_samples",   PARAM_TYPE_INT,   3,       1,      7},
+    {"mq135_rl",      PARAM_TYPE_FLOAT, 10000.0f, 100.0f, 1000000.0f},
+    {"mq135_clean",   PARAM_TYPE_FLOAT, 3.6f,    0.1f,   100.0f},
+    {"mq135_nh3_a",   PARAM_TYPE_FLOAT, 102.2f,  0.0f,   100000.0f},
+    {"mq135_nh3_b",   PARAM_TYPE_FLOAT, -2.473f, -10.0f, 0.0f},
+    {"mq135_co_a",    PARAM_TYPE_FLOAT, 605.18f, 0.0f,   100000.0f},
+    {"mq135_co_b",    PARAM_TYPE_FLOAT, -3.937f, -10.0f, 0.0f},
+    {"mq135_co2_a",   PARAM_TYPE_FLOAT, 110.47f, 0.0f,   100000.0f},
+    {"mq135_co2_b",   PARAM_TYPE_FLOAT, -2.862f, -10.0f, 0.0f},
+};
+
+// Generation g lives in buffers[g & 1]; a writer fills the other half and
+// then publishes g + 1. Each half has its own write sequence, odd while the
+// half is being written, so a reader that was overtaken by two publishes
+// sees the rewrite and retries instead of returning a torn set.
+static param_value_t buffers[2][PARAM_COUNT];
+static std::atomic<uint32_t> buffer_seq[2];
+static std::atomic<uint32_t> generation{0};
+static SemaphoreHandle_t write_lock = NULL;
+
+static esp_mqtt_client_handle_t params_client = NULL;
+static char state_topic[PARAMS_TOPIC_MAX];
+static char set_topic[PARAMS_TOPIC_MAX];
+
+static void params_defaults(param_value_t *values) {
+    for (int i = 0; i < PARAM_COUNT; i++) {
+        if (PARAMS[i].type == PARAM_TYPE_INT) {
+            values[i].i = (int32_t)PARAMS[i].def;
+        } else {
+            values[i].f = PARAMS[i].def;
+        }
+    }
+}
+
+static int params_find(const char *name, size_t len) {
+    for (int i = 0; i < PARAM_COUNT; i++) {
+        if (strlen(PARAMS[i].name) == len && strncmp(PARAMS[i].name, name, len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static bool params_parse_value(int id, const char *text, param_value_t *out) {
+    char *end = NULL;
+    const param_desc_t *desc = &PARAMS[id];
+    if (desc->type == PARAM_TYPE_INT) {
+        long v = strtol(text, &end, 10);
+        if (end == text || *end != '\0' || v < (long)desc->min || v > (long)desc->max) {
+            return false;
+        }
+        out->i = (int32_t)v;
+    } else {
+        float v = strtof(text, &end);
+        if (end == text || *end != '\0' || !isfinite(v) || v < desc->min || v > desc->max) {
+            return false;
+        }
+        out->f = v;
+    }
+    return true;
+}
+
+static void params_persist(const param_value_t *values, const bool *changed) {
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(PARAMS_NVS_NS, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "NVS open failed: %d", (int)err);
+        return;
+    }
+    for (int i = 0; i < PARAM_COUNT; i++) {
+        if (!changed[i]) {
+            continue;
+        }
+        if (PARAMS[i].type == PARAM_TYPE_INT) {
+            err = nvs_set_i32(handle, PARAMS[i].name, values[i].i);
+        } else {
+            err = nvs_set_blob(handle, PARAMS[i].name, &values[i].f, sizeof(float));
+        }
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "NVS set %s failed: %d", PARAMS[i].name, (int)err);
+        }
+    }
+    nvs_commit(handle);
+    nvs_close(handle);
+}
+
+// Caller holds write_lock.
+static void params_publish(const param_value_t *values) {
+    uint32_t next = generation.load(std::memory_order_relaxed) + 1;
+    std::atomic<uint32_t> &seq = buffer_seq[next & 1];
+    uint32_t s = seq.load(std::memory_order_relaxed);
+    seq.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(buffers[next & 1], values, sizeof(buffers[0]));
+    seq.store(s + 2, std::memory_order_release);
+    generation.store(next, std::memory_order_release);
+}
+
+static void params_publish_state(void) {
+    if (!params_client || state_topic[0] == '\0') {
+        return;
+    }
+    char payload[768];
+    int len = params_format_json(payload, sizeof(payload));
+    if (len > 0 && len < (int)sizeof(payload)) {
+        esp_mqtt_client_publish(params_client, state_topic, payload, len, 1, 1);
+    }
+}
+
+void params_init(void) {
+    param_value_t values[PARAM_COUNT];
+    params_defaults(values);
+    if (!write_lock) {
+        write_lock = xSemaphoreCreateMutex();
+    }
+    nvs_handle_t handle;
+    int loaded = 0;
+    if (nvs_open(PARAMS_NVS_NS, NVS_READONLY, &handle) == ESP_OK) {
+        for (int i = 0; i < PARAM_COUNT; i++) {
+            const param_desc_t *desc = &PARAMS[i];
+            if (desc->type == PARAM_TYPE_INT) {
+                int32_t v = 0;
+                if (nvs_get_i32(handle, desc->name, &v) == ESP_OK && v >= (int32_t)desc->min &&
+                    v <= (int32_t)desc->max) {
+                    values[i].i = v;
+                    loaded++;
+                }
+            } else {
+                float v = 0.0f;
+                size_t len = sizeof(v);
+                if (nvs_get_blob(handle, desc->name, &v, &len) == ESP_OK && len == sizeof(v) && isfinite(v) &&
+                    v >= desc->min && v <= desc->max) {
+                    values[i].f = v;
+                    loaded++;
+                }
+            }
+        }
+        nvs_close(handle);
+    }
+    xSemaphoreTake(write_lock, portMAX_DELAY);
+    params_publish(values);
+    xSemaphoreGive(write_lock);
+    ESP_LOGI(TAG, "%d of %d parameters loaded from NVS", loaded, (int)PARAM_COUNT);
+}
+
+// Copies the newest set without blocking; returns its generation.
+static uint32_t params_copy(param_value_t *values) {
+    while (true) {
+        uint32_t gen = generation.load(std::memory_order_acquire);
+        std::atomic<uint32_t> &seq = buffer_seq[gen & 1];
+        uint32_t before = seq.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue; // a second publish is rewriting this half
+        }
+        memcpy(values, buffers[gen & 1], sizeof(buffers[0]));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq.load(std::memory_order_relaxed) == before) {
+            return gen;
+        }
+    }
+}
+
+bool params_refresh(params_snapshot_t *snap) {
+    if (generation.load(std::memory_order_acquire) == snap->generation) {
+        return false;
+    }
+    snap->generation = params_copy(snap->values);
+    return true;
+}
+
+int32_t params_max_int(param_id_t id) {
+    if (id >= PARAM_COUNT) {
+        return 0;
+    }
+    return (int32_t)PARAMS[id].max;
+}
+
+bool params_apply_text(const char *text, size_t len, bool persist) {
+    if (!text || !write_lock) {
+        return false;
+    }
+    if (len >= (size_t)PARAMS_TEXT_MAX) {
+        ESP_LOGW(TAG, "Update too long (%u bytes)", (unsigned)len);
+        return false;
+    }
+    char buf[PARAMS_TEXT_MAX];
+    memcpy(buf, text, len);
+    buf[len] = '\0';
+    // Flat JSON reads as name:value pairs once braces and quotes are gone.
+    for (char *p = buf; *p; p++) {
+        if (*p == '{' || *p == '}' || *p == '"' || *p == ',') {
+            *p = ' ';
+        }
+    }
+
+    xSemaphoreTake(write_lock, portMAX_DELAY);
+    uint32_t gen = generation.load(std::memory_order_relaxed);
+    param_value_t values[PARAM_COUNT];
+    memcpy(values, buffers[gen & 1], sizeof(values));
+    bool changed[PARAM_COUNT] = {};
+    bool ok = true;
+    int count = 0;
+    char *p = buf;
+    while (ok) {
+        while (*p && isspace((unsigned char)*p)) p++;
+        if (!*p) {
+            break;
+        }
+        char *name = p;
+        while (*p && (isalnum((unsigned char)*p) || *p == '_')) p++;
+        size_t name_len = (size_t)(p - name);
+        while (*p && isspace((unsigned char)*p)) p++;
+        if (name_len == 5 && strncmp(name, "reset", 5) == 0 && *p != '=' && *p != ':') {
+            xSemaphoreGive(write_lock);
+            return params_reset();
+        }
+        if (*p != '=' && *p != ':') {
+            ESP_LOGW(TAG, "Expected name=value near '%.16s'", name);
+            ok = false;
+            break;
+        }
+        p++;
+        while (*p && isspace((unsigned char)*p)) p++;
+        char *value = p;
+        while (*p && !isspace((unsigned char)*p)) p++;
+        if (*p) {
+            *p++ = '\0';
+        }
+        int id = params_find(name, name_len);
+        param_value_t v;
+        if (id < 0) {
+            ESP_LOGW(TAG, "Unknown parameter '%.*s'", (int)name_len, name);
+            ok = false;
+        } else if (!params_parse_value(id, value, &v)) {
+            ESP_LOGW(TAG, "Bad value for %s: '%s'", PARAMS[id].name, value);
+            ok = false;
+        } else {
+            values[id] = v;
+            changed[id] = true;
+            count++;
+        }
+    }
+    if (ok && count > 0) {
+        params_publish(values);
+        if (persist) {
+            params_persist(values, changed);
+        }
+    }
+    xSemaphoreGive(write_lock);
+    if (ok && count > 0) {
+        ESP_LOGI(TAG, "Applied %d parameter(s)", count);
+        params_publish_state();
+    }
+    return ok && count > 0;
+}
+
+bool params_reset(void) {
+    if (!write_lock) {
+        return false;
+    }
+    param_value_t values[PARAM_COUNT];
+    params_defaults(values);
+    xSemaphoreTake(write_lock, portMAX_DELAY);
+    params_publish(values);
+    nvs_handle_t handle;
+    if (nvs_open(PARAMS_NVS_NS, NVS_READWRITE, &handle) == ESP_OK) {
+        nvs_erase_all(handle);
+        nvs_commit(handle);
+        nvs_close(handle);
+    }
+    xSemaphoreGive(write_lock);
+    ESP_LOGI(TAG, "Parameters reset to defaults");
+    params_publish_state();
+    return true;
+}
+
+int params_format_json(char *buf, size_t len) {
+    param_value_t values[PARAM_COUNT];
+    params_copy(values);
+    int n = snprintf(buf, len, "{");
+    for (int i = 0; i < PARAM_COUNT && n < (int)len; i++) {
+        if (PARAMS[i].type == PARAM_TYPE_INT) {
+            n += snprintf(buf + n, len - n, "%s\"%s\":%ld", i ? "," : "", PARAMS[i].name, (long)values[i].i);
+        } else {
+            n += snprintf(buf + n, len - n, "%s\"%s\":%g", i ? "," : "", PARAMS[i].name, (double)values[i].f);
+        }
+    }
+    if (n < (int)len) {
+        n += snprintf(buf + n, len - n, "}");
+    }
+    return n;
+}
+
+static void params_mqtt_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data) {
+    esp_mqtt_event_handle_t event = (esp_mqtt_event_handle_t)event_data;
+    switch (event->event_id) {
+        case MQTT_EVENT_CONNECTED:
+            esp_mqtt_client_subscribe(params_client, set_topic, 1);
+            params_publish_state();
+            break;
+        case MQTT_EVENT_DATA:
+            if (event->topic_len != (int)strlen(set_topic) ||
+                strncmp(event->topic, set_topic, event->topic_len) != 0) {
+                break;
+            }
+            if (event->data_len != event->total_data_len) {
+                ESP_LOGW(TAG, "Fragmented update ignored (%d bytes)", event->total_data_len);
+                break;
+            }
+            params_apply_text(event->data, (size_t)event->data_len, true);
+            break;
+        default:
+            break;
+    }
+}
+
+void params_mqtt_start(esp_mqtt_client_handle_t client, const char *topic) {
+    if (!client || !topic || strlen(topic) == 0) {
+        return;
+    }
+    snprintf(state_topic, sizeof(state_topic), "%s", topic);
+    snprintf(set_topic, sizeof(set_topic), "%s/set", topic);
+    params_client = client;
+    esp_mqtt_client_register_event(client, MQTT_EVENT_ANY, params_mqtt_handler, NULL);
+    ESP_LOGI(TAG, "Updates on %s", set_topic);
+}
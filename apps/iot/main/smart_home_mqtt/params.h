@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mqtt_client.h"
+
+// Runtime tuning parameters. Defaults live in the table in params.cpp;
+// values set over MQTT or the console are persisted in NVS (namespace
+// "params") and override them from the next boot on.
+//
+// Writers publish a complete new set at once into the inactive half of a
+// double buffer and bump a generation counter. Readers keep their own
+// params_snapshot_t and call params_refresh() at a point where a change
+// is safe: it is one atomic load when nothing changed and never blocks or
+// touches NVS. audio_task refreshes between frames while idle, so a
+// recording keeps the values it started with; the sensor task refreshes
+// once per cycle.
+typedef enum {
+    PARAM_SILENCE_TIMEOUT_MS = 0,
+    PARAM_MAX_RECORD_MS,
+    PARAM_ENERGY_THRESHOLD,
+    PARAM_AUDIO_GAIN_SHIFT,      // fixed gain, or the AGC's starting gain (boot only)
+    PARAM_AGG_FRAMES,            // AFE chunks per audio packet
+    PARAM_SENSOR_PUBLISH_MS,     // full sample period; publishes are change-driven
+    PARAM_SUMMARY_PUBLISH_MS,    // sliding-window aggregates (sensor_agg.h)
+    PARAM_REPORT_HEARTBEAT_MS,   // deadbands and alerts: sensor_report.h
+    PARAM_DEADBAND_TEMP,
+    PARAM_DEADBAND_HUMIDITY,
+    PARAM_DEADBAND_GAS_RAW,
+    PARAM_DEADBAND_PPM_ABS,
+    PARAM_DEADBAND_PPM_REL,
+    PARAM_GAS_POLL_MS,
+    PARAM_ALERT_RATIO,
+    PARAM_ALERT_PPM,
+    PARAM_ALERT_SLOPE,
+    PARAM_DHT_SAMPLE_COUNT,
+    PARAM_MQ135_RL_OHMS,
+    PARAM_MQ135_CLEAN_AIR_RATIO,
+    PARAM_MQ135_NH3_A,
+    PARAM_MQ135_NH3_B,
+    PARAM_MQ135_CO_A,
+    PARAM_MQ135_CO_B,
+    PARAM_MQ135_CO2_A,
+    PARAM_MQ135_CO2_B,
+    PARAM_COUNT,
+} param_id_t;
+
+typedef enum {
+    PARAM_TYPE_INT = 0,
+    PARAM_TYPE_FLOAT,
+} param_type_t;
+
+typedef union {
+    int32_t i;
+    float f;
+} param_value_t;
+
+typedef struct {
+    uint32_t generation;
+    param_value_t values[PARAM_COUNT];
+} params_snapshot_t;
+
+// Loads NVS over the defaults; call after nvs_flash_init().
+void params_init(void);
+
+// Copies the current set into snap if it changed since the last call.
+// Returns true when snap was updated.
+bool params_refresh(params_snapshot_t *snap);
+
+static inline int32_t params_int(const params_snapshot_t *snap, param_id_t id) {
+    return snap->values[id].i;
+}
+
+static inline float params_float(const params_snapshot_t *snap, param_id_t id) {
+    return snap->values[id].f;
+}
+
+// Upper bound of an integer parameter, for sizing buffers at boot.
+int32_t params_max_int(param_id_t id);
+
+// Applies "name=value" pairs separated by spaces, commas or newlines, or
+// a flat JSON object, as one update; "reset" restores the defaults. The
+// whole update is rejected if any pair is unknown or out of range.
+bool params_apply_text(const char *text, size_t len, bool persist);
+bool params_reset(void);
+
+int params_format_json(char *buf, size_t len);
+
+// Subscribes to <topic>/set and publishes the current values (retained)
+// on <topic> after every connect and change.
+void params_mqtt_start(esp_mqtt_client_handle_t client, const char *topic);
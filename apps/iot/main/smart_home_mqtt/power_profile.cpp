@@ -0,0 +1,320 @@
+#include "power_profile.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "nvs.h"
+#if CONFIG_PM_ENABLE
+#include "esp_pm.h"
+#endif
+
+#include "audio_deadline.h"
+#include "task_plan.h"
+
+static const char *TAG = "power";
+
+static const char *POWER_NVS_NS = "power";
+static const char *POWER_NVS_KEY_PROFILE = "profile";
+
+// I2S holds the APB frequency lock while capturing, so DFS cannot go
+// below 80 MHz anyway.
+static const int POWER_MIN_CPU_MHZ = 80;
+
+static const char *PROFILE_NAMES[POWER_PROFILE_COUNT] = {"performance", "balanced", "min_modem"};
+
+typedef struct {
+    wifi_ps_type_t ps;
+    bool cpu_max;
+} profile_spec_t;
+
+static const profile_spec_t PROFILE_SPECS[POWER_PROFILE_COUNT] = {
+    {WIFI_PS_NONE, true},
+    {WIFI_PS_MIN_MODEM, true},
+    {WIFI_PS_MIN_MODEM, false},
+};
+
+typedef struct {
+    uint64_t active_us;
+    uint64_t radio_on_us; // modem sleep off
+    uint64_t cpu_max_us;  // CPU frequency lock held
+    uint64_t idle_pct10_ms[2];
+    uint64_t idle_ms;
+    uint32_t sessions;
+    uint32_t late_chunks;
+    uint32_t w2s_count;
+    uint32_t w2s_total_ms;
+    uint32_t w2s_max_ms;
+} profile_stats_t;
+
+static SemaphoreHandle_t apply_lock = NULL;
+static TaskHandle_t power_task_handle = NULL;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Guarded by stats_lock.
+static power_profile_t base_profile = POWER_PROFILE_BALANCED;
+static bool in_session = false;
+static wifi_ps_type_t applied_ps = WIFI_PS_MIN_MODEM;
+static bool applied_cpu_max = true;
+static int64_t last_account_us = 0;
+static uint32_t last_late = 0;
+static profile_stats_t stats[POWER_PROFILE_COUNT];
+
+#if CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t cpu_lock = NULL;
+#endif
+static bool cpu_lock_held = false;
+
+static void power_account_locked(int64_t now) {
+    profile_stats_t *s = &stats[base_profile];
+    uint64_t dt = last_account_us > 0 ? (uint64_t)(now - last_account_us) : 0;
+    s->active_us += dt;
+    if (applied_ps == WIFI_PS_NONE) {
+        s->radio_on_us += dt;
+    }
+    if (applied_cpu_max) {
+        s->cpu_max_us += dt;
+    }
+    uint32_t late = audio_deadline_late_count();
+    s->late_chunks += late - last_late;
+    last_late = late;
+    last_account_us = now;
+}
+
+static void power_set_cpu_max(bool hold) {
+    if (hold == cpu_lock_held) {
+        return;
+    }
+#if CONFIG_PM_ENABLE
+    if (cpu_lock) {
+        if (hold) {
+            esp_pm_lock_acquire(cpu_lock);
+        } else {
+            esp_pm_lock_release(cpu_lock);
+        }
+    }
+#endif
+    cpu_lock_held = hold;
+}
+
+// Brings radio and CPU in line with the base profile and session state.
+static void power_apply(void) {
+    if (apply_lock) {
+        xSemaphoreTake(apply_lock, portMAX_DELAY);
+    }
+    portENTER_CRITICAL(&stats_lock);
+    const profile_spec_t *spec = &PROFILE_SPECS[in_session ? POWER_PROFILE_PERFORMANCE : base_profile];
+    wifi_ps_type_t prev_ps = applied_ps;
+    power_account_locked(esp_timer_get_time());
+    applied_ps = spec->ps;
+    applied_cpu_max = spec->cpu_max;
+    portEXIT_CRITICAL(&stats_lock);
+
+    if (spec->ps != prev_ps) {
+        esp_wifi_set_ps(spec->ps);
+    }
+    power_set_cpu_max(spec->cpu_max);
+    if (apply_lock) {
+        xSemaphoreGive(apply_lock);
+    }
+}
+
+// esp_wifi_set_ps() and the PM lock can block, so session changes from
+// audio_task only flip in_session and wake this task. Notifications
+// coalesce; power_apply() reads the latest state.
+static void power_task(void *arg) {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        power_apply();
+    }
+}
+
+static void power_apply_async(void) {
+    if (power_task_handle) {
+        xTaskNotifyGive(power_task_handle);
+    } else {
+        power_apply();
+    }
+}
+
+const char *power_profile_name(power_profile_t profile) {
+    return profile < POWER_PROFILE_COUNT ? PROFILE_NAMES[profile] : "unknown";
+}
+
+bool power_profile_parse(const char *name, power_profile_t *out) {
+    for (int i = 0; i < POWER_PROFILE_COUNT; i++) {
+        if (name && strcmp(name, PROFILE_NAMES[i]) == 0) {
+            *out = (power_profile_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static power_profile_t power_default_profile(void) {
+#if CONFIG_SMART_HOME_POWER_PROFILE_PERFORMANCE
+    power_profile_t profile = POWER_PROFILE_PERFORMANCE;
+#elif CONFIG_SMART_HOME_POWER_PROFILE_MIN_MODEM
+    power_profile_t profile = POWER_PROFILE_MIN_MODEM;
+#else
+    power_profile_t profile = POWER_PROFILE_BALANCED;
+#endif
+    nvs_handle_t handle;
+    if (nvs_open(POWER_NVS_NS, NVS_READONLY, &handle) == ESP_OK) {
+        uint8_t u8 = 0;
+        if (nvs_get_u8(handle, POWER_NVS_KEY_PROFILE, &u8) == ESP_OK && u8 < POWER_PROFILE_COUNT) {
+            profile = (power_profile_t)u8;
+        }
+        nvs_close(handle);
+    }
+    return profile;
+}
+
+void power_profile_init(void) {
+    apply_lock = xSemaphoreCreateMutex();
+#if CONFIG_PM_ENABLE
+    esp_pm_config_t pm_cfg = {};
+    pm_cfg.max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+    pm_cfg.min_freq_mhz = POWER_MIN_CPU_MHZ;
+    pm_cfg.light_sleep_enable = false;
+    if (esp_pm_configure(&pm_cfg) != ESP_OK ||
+        esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "power_cpu", &cpu_lock) != ESP_OK) {
+        ESP_LOGW(TAG, "esp_pm setup failed, CPU stays at max frequency");
+        cpu_lock = NULL;
+    }
+#else
+    ESP_LOGW(TAG, "CONFIG_PM_ENABLE is off: profiles only change modem sleep");
+#endif
+    wifi_ps_type_t ps = WIFI_PS_MIN_MODEM;
+    esp_wifi_get_ps(&ps);
+    portENTER_CRITICAL(&stats_lock);
+    base_profile = power_default_profile();
+    applied_ps = ps;
+    applied_cpu_max = false;
+    last_account_us = esp_timer_get_time();
+    last_late = audio_deadline_late_count();
+    portEXIT_CRITICAL(&stats_lock);
+    power_apply();
+    if (!task_plan_create(TASK_ID_POWER, power_task, NULL, &power_task_handle)) {
+        ESP_LOGW(TAG, "No power task, session changes apply inline");
+        power_task_handle = NULL;
+    }
+    ESP_LOGI(TAG, "Power profile: %s", power_profile_name(base_profile));
+}
+
+bool power_profile_set(power_profile_t profile, bool persist) {
+    if (profile >= POWER_PROFILE_COUNT) {
+        return false;
+    }
+    portENTER_CRITICAL(&stats_lock);
+    power_account_locked(esp_timer_get_time());
+    base_profile = profile;
+    portEXIT_CRITICAL(&stats_lock);
+    power_apply();
+    if (persist) {
+        nvs_handle_t handle;
+        if (nvs_open(POWER_NVS_NS, NVS_READWRITE, &handle) != ESP_OK) {
+            return false;
+        }
+        nvs_set_u8(handle, POWER_NVS_KEY_PROFILE, (uint8_t)profile);
+        nvs_commit(handle);
+        nvs_close(handle);
+    }
+    ESP_LOGI(TAG, "Power profile -> %s", power_profile_name(profile));
+    return true;
+}
+
+power_profile_t power_profile_get(void) {
+    return base_profile;
+}
+
+void power_profile_session_begin(void) {
+    portENTER_CRITICAL(&stats_lock);
+    bool was = in_session;
+    in_session = true;
+    if (!was) {
+        stats[base_profile].sessions++;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+    if (!was) {
+        power_apply_async();
+    }
+}
+
+void power_profile_session_end(void) {
+    portENTER_CRITICAL(&stats_lock);
+    bool was = in_session;
+    in_session = false;
+    portEXIT_CRITICAL(&stats_lock);
+    if (was) {
+        power_apply_async();
+    }
+}
+
+bool power_profile_in_session(void) {
+    portENTER_CRITICAL(&stats_lock);
+    bool session = in_session;
+    portEXIT_CRITICAL(&stats_lock);
+    return session;
+}
+
+void power_profile_note_wake_to_stream(uint32_t ms) {
+    portENTER_CRITICAL(&stats_lock);
+    profile_stats_t *s = &stats[base_profile];
+    s->w2s_count++;
+    s->w2s_total_ms += ms;
+    if (ms > s->w2s_max_ms) {
+        s->w2s_max_ms = ms;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+void power_profile_note_idle(uint32_t idle0_pct10, uint32_t idle1_pct10, uint32_t period_ms) {
+    portENTER_CRITICAL(&stats_lock);
+    profile_stats_t *s = &stats[base_profile];
+    s->idle_pct10_ms[0] += (uint64_t)idle0_pct10 * period_ms;
+    s->idle_pct10_ms[1] += (uint64_t)idle1_pct10 * period_ms;
+    s->idle_ms += period_ms;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+int power_profile_format_json(char *buf, size_t len) {
+    profile_stats_t snap[POWER_PROFILE_COUNT];
+    portENTER_CRITICAL(&stats_lock);
+    power_account_locked(esp_timer_get_time());
+    memcpy(snap, stats, sizeof(snap));
+    power_profile_t profile = base_profile;
+    bool session = in_session;
+    portEXIT_CRITICAL(&stats_lock);
+
+    int n = snprintf(buf, len, "{\"profile\":\"%s\",\"session\":%s,\"profiles\":[", power_profile_name(profile),
+                     session ? "true" : "false");
+    for (int i = 0; i < POWER_PROFILE_COUNT && n < (int)len; i++) {
+        const profile_stats_t *s = &snap[i];
+        uint64_t active_ms = s->active_us / 1000;
+        uint32_t radio_pct = active_ms > 0 ? (uint32_t)(s->radio_on_us / 10 / active_ms) : 0;
+        uint32_t cpu_max_pct = active_ms > 0 ? (uint32_t)(s->cpu_max_us / 10 / active_ms) : 0;
+        uint32_t idle0 = s->idle_ms > 0 ? (uint32_t)(s->idle_pct10_ms[0] / s->idle_ms) : 0;
+        uint32_t idle1 = s->idle_ms > 0 ? (uint32_t)(s->idle_pct10_ms[1] / s->idle_ms) : 0;
+        n += snprintf(buf + n, len - n,
+                      "%s{\"name\":\"%s\",\"active_s\":%lu,\"radio_on_pct\":%lu,\"cpu_max_pct\":%lu,"
+                      "\"idle0\":%lu.%lu,\"idle1\":%lu.%lu,\"sessions\":%lu,\"w2s_avg_ms\":%lu,"
+                      "\"w2s_max_ms\":%lu,\"late\":%lu}",
+                      i > 0 ? "," : "", PROFILE_NAMES[i], (unsigned long)(active_ms / 1000),
+                      (unsigned long)radio_pct, (unsigned long)cpu_max_pct, (unsigned long)(idle0 / 10),
+                      (unsigned long)(idle0 % 10), (unsigned long)(idle1 / 10), (unsigned long)(idle1 % 10),
+                      (unsigned long)s->sessions,
+                      (unsigned long)(s->w2s_count > 0 ? s->w2s_total_ms / s->w2s_count : 0),
+                      (unsigned long)s->w2s_max_ms, (unsigned long)s->late_chunks);
+    }
+    if (n < (int)len) {
+        n += snprintf(buf + n, len - n, "]}");
+    }
+    return n;
+}
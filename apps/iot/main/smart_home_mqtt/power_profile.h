@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Power profiles. The base profile applies while listening for the wake
+// word; a recording session always runs as performance and returns to
+// the base profile when it ends.
+//   performance  modem sleep off, CPU held at max frequency
+//   balanced     modem sleep (min), CPU held at max frequency
+//   min_modem    modem sleep (min), CPU scales down via DFS while
+//                listening; the AFE then runs at the minimum frequency
+typedef enum {
+    POWER_PROFILE_PERFORMANCE = 0,
+    POWER_PROFILE_BALANCED,
+    POWER_PROFILE_MIN_MODEM,
+    POWER_PROFILE_COUNT,
+} power_profile_t;
+
+// Call once WiFi is started. Profile comes from NVS, then Kconfig.
+void power_profile_init(void);
+bool power_profile_set(power_profile_t profile, bool persist);
+power_profile_t power_profile_get(void);
+const char *power_profile_name(power_profile_t profile);
+bool power_profile_parse(const char *name, power_profile_t *out);
+
+// audio_task: wake word -> begin, session over (any reason) -> end. These
+// only set the session flag; the "power" task applies the change.
+void power_profile_session_begin(void);
+void power_profile_session_end(void);
+bool power_profile_in_session(void);
+
+// Measurements attributed to the current base profile.
+void power_profile_note_wake_to_stream(uint32_t ms);
+void power_profile_note_idle(uint32_t idle0_pct10, uint32_t idle1_pct10, uint32_t period_ms);
+
+int power_profile_format_json(char *buf, size_t len);
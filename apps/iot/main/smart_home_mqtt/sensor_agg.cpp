@@ -0,0 +1,269 @@
+#include "sensor_agg.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// Builds on the host as well (apps/iot/scripts/sensor_agg_check.cpp), where
+// the state comes from the heap instead of the spiram arena.
+#ifdef ESP_PLATFORM
+#include "esp_log.h"
+
+#include "mem_arena.h"
+
+static const char *TAG = "sensor_agg";
+#else
+#include <stdlib.h>
+#endif
+
+static const uint32_t WINDOW_SECONDS[SENSOR_AGG_WINDOWS] = {60, 900, 3600};
+static const char *WINDOW_NAMES[SENSOR_AGG_WINDOWS] = {"1m", "15m", "1h"};
+
+// Histogram range per metric; log bins span lo..hi in log10 units.
+typedef struct {
+    const char *name;
+    float lo;
+    float hi;
+    bool log_scale;
+} metric_desc_t;
+
+static const metric_desc_t METRICS[SENSOR_METRIC_COUNT] = {
+    {"temperature", -10.0f, 54.0f,   false}, // 1 degree bins, DHT11 resolution
+    {"humidity",    0.0f,   100.0f,  false},
+    {"gas_raw",     0.0f,   4096.0f, false},
+    {"nh3",         -2.0f,  4.0f,    true},  // 0.01 .. 10000 ppm
+    {"co",          -2.0f,  4.0f,    true},
+    {"co2",         -2.0f,  4.0f,    true},
+};
+
+// Ring indices of candidate extremes, oldest first.
+typedef struct {
+    uint16_t idx[SENSOR_AGG_CAPACITY];
+    uint16_t head;
+    uint16_t len;
+} agg_deque_t;
+
+typedef struct {
+    agg_deque_t min_q;
+    agg_deque_t max_q;
+    double sum;
+    uint32_t count;
+    uint16_t hist[SENSOR_AGG_BINS];
+} agg_series_t;
+
+typedef struct {
+    uint32_t t_s[SENSOR_AGG_CAPACITY];
+    float values[SENSOR_AGG_CAPACITY][SENSOR_METRIC_COUNT]; // NaN = no reading
+    uint32_t next_seq;                                      // samples pushed so far
+    uint32_t tail_seq[SENSOR_AGG_WINDOWS];                  // oldest sample in each window
+    agg_series_t series[SENSOR_AGG_WINDOWS][SENSOR_METRIC_COUNT];
+} agg_state_t;
+
+static agg_state_t *agg = NULL;
+
+static inline uint16_t ring_index(uint32_t seq) {
+    return (uint16_t)(seq % SENSOR_AGG_CAPACITY);
+}
+
+static inline uint16_t deque_at(const agg_deque_t *q, int i) {
+    return q->idx[(q->head + i) % SENSOR_AGG_CAPACITY];
+}
+
+// Drops entries from the back that the new value dominates, then appends.
+static void deque_push(agg_deque_t *q, int metric, uint16_t idx, float v, bool is_max) {
+    while (q->len > 0) {
+        float back = agg->values[deque_at(q, q->len - 1)][metric];
+        if (is_max ? back > v : back < v) {
+            break;
+        }
+        q->len--;
+    }
+    q->idx[(q->head + q->len) % SENSOR_AGG_CAPACITY] = idx;
+    q->len++;
+}
+
+static void deque_expire(agg_deque_t *q, uint16_t idx) {
+    if (q->len > 0 && deque_at(q, 0) == idx) {
+        q->head = (q->head + 1) % SENSOR_AGG_CAPACITY;
+        q->len--;
+    }
+}
+
+static int metric_bin(int metric, float v) {
+    const metric_desc_t *desc = &METRICS[metric];
+    float x = v;
+    if (desc->log_scale) {
+        x = v > 0.0f ? log10f(v) : desc->lo;
+    }
+    int bin = (int)((x - desc->lo) * SENSOR_AGG_BINS / (desc->hi - desc->lo));
+    if (bin < 0) return 0;
+    if (bin >= SENSOR_AGG_BINS) return SENSOR_AGG_BINS - 1;
+    return bin;
+}
+
+static float metric_bin_value(int metric, float pos) {
+    const metric_desc_t *desc = &METRICS[metric];
+    float x = desc->lo + pos * (desc->hi - desc->lo) / SENSOR_AGG_BINS;
+    return desc->log_scale ? powf(10.0f, x) : x;
+}
+
+static void window_expire_oldest(int w) {
+    uint32_t seq = agg->tail_seq[w];
+    uint16_t idx = ring_index(seq);
+    for (int m = 0; m < SENSOR_METRIC_COUNT; m++) {
+        float v = agg->values[idx][m];
+        if (isnan(v)) {
+            continue;
+        }
+        agg_series_t *s = &agg->series[w][m];
+        s->sum -= v;
+        s->count--;
+        s->hist[metric_bin(m, v)]--;
+        deque_expire(&s->min_q, idx);
+        deque_expire(&s->max_q, idx);
+    }
+    agg->tail_seq[w] = seq + 1;
+}
+
+size_t sensor_agg_memory_bytes(void) {
+#ifdef ESP_PLATFORM
+    return mem_arena_round(sizeof(agg_state_t));
+#else
+    return sizeof(agg_state_t);
+#endif
+}
+
+bool sensor_agg_init(void) {
+    if (agg) {
+        return true;
+    }
+#ifdef ESP_PLATFORM
+    agg = (agg_state_t *)mem_arena_alloc(MEM_REGION_SPIRAM, sizeof(agg_state_t));
+    if (!agg) {
+        ESP_LOGE(TAG, "No memory for %u byte aggregation state", (unsigned)sizeof(agg_state_t));
+        return false;
+    }
+#else
+    agg = (agg_state_t *)malloc(sizeof(agg_state_t));
+    if (!agg) {
+        return false;
+    }
+#endif
+    memset(agg, 0, sizeof(*agg));
+    return true;
+}
+
+void sensor_agg_push(const sensor_reading_t *r, uint32_t t_s) {
+    if (!agg || !r) {
+        return;
+    }
+    uint32_t seq = agg->next_seq;
+    // The slot being reused must have left every window first.
+    for (int w = 0; w < SENSOR_AGG_WINDOWS; w++) {
+        while (seq - agg->tail_seq[w] >= SENSOR_AGG_CAPACITY) {
+            window_expire_oldest(w);
+        }
+    }
+
+    uint16_t idx = ring_index(seq);
+    float *values = agg->values[idx];
+    values[SENSOR_METRIC_TEMPERATURE] = r->dht_ok ? (float)r->temperature : NAN;
+    values[SENSOR_METRIC_HUMIDITY] = r->dht_ok ? (float)r->humidity : NAN;
+    values[SENSOR_METRIC_GAS_RAW] = r->gas_raw >= 0 ? (float)r->gas_raw : NAN;
+    values[SENSOR_METRIC_NH3] = r->gas_ok ? r->nh3 : NAN;
+    values[SENSOR_METRIC_CO] = r->gas_ok ? r->co : NAN;
+    values[SENSOR_METRIC_CO2] = r->gas_ok ? r->co2 : NAN;
+    agg->t_s[idx] = t_s;
+    agg->next_seq = seq + 1;
+
+    for (int w = 0; w < SENSOR_AGG_WINDOWS; w++) {
+        for (int m = 0; m < SENSOR_METRIC_COUNT; m++) {
+            float v = values[m];
+            if (isnan(v)) {
+                continue;
+            }
+            agg_series_t *s = &agg->series[w][m];
+            s->sum += v;
+            s->count++;
+            s->hist[metric_bin(m, v)]++;
+            deque_push(&s->min_q, m, idx, v, false);
+            deque_push(&s->max_q, m, idx, v, true);
+        }
+        // The newest sample always stays.
+        while (agg->tail_seq[w] < seq && t_s - agg->t_s[ring_index(agg->tail_seq[w])] >= WINDOW_SECONDS[w]) {
+            window_expire_oldest(w);
+        }
+    }
+}
+
+bool sensor_agg_get(int window, sensor_metric_t metric, sensor_agg_stats_t *out) {
+    if (!agg || window < 0 || window >= SENSOR_AGG_WINDOWS || metric >= SENSOR_METRIC_COUNT || !out) {
+        return false;
+    }
+    const agg_series_t *s = &agg->series[window][metric];
+    memset(out, 0, sizeof(*out));
+    out->n = s->count;
+    if (s->count == 0) {
+        return false;
+    }
+    out->min = agg->values[deque_at(&s->min_q, 0)][metric];
+    out->max = agg->values[deque_at(&s->max_q, 0)][metric];
+    out->mean = (float)(s->sum / s->count);
+
+    const float quantiles[2] = {0.50f, 0.95f};
+    float *results[2] = {&out->p50, &out->p95};
+    for (int q = 0; q < 2; q++) {
+        float target = quantiles[q] * s->count;
+        uint32_t cumulative = 0;
+        float v = out->max;
+        for (int b = 0; b < SENSOR_AGG_BINS; b++) {
+            if (s->hist[b] == 0) {
+                continue;
+            }
+            if (cumulative + s->hist[b] >= target) {
+                v = metric_bin_value(metric, b + (target - cumulative) / s->hist[b]);
+                break;
+            }
+            cumulative += s->hist[b];
+        }
+        *results[q] = v < out->min ? out->min : (v > out->max ? out->max : v);
+    }
+    return true;
+}
+
+static double json_value(float v) {
+    if (v > SENSOR_AGG_JSON_VALUE_MAX) {
+        return SENSOR_AGG_JSON_VALUE_MAX;
+    }
+    return v < -SENSOR_AGG_JSON_VALUE_MAX ? -SENSOR_AGG_JSON_VALUE_MAX : v;
+}
+
+int sensor_agg_format_json(char *buf, size_t len) {
+    if (!agg || agg->next_seq == 0) {
+        return snprintf(buf, len, "{}");
+    }
+    uint32_t newest = agg->t_s[ring_index(agg->next_seq - 1)];
+    int n = snprintf(buf, len, "{\"t\":%lu", (unsigned long)newest);
+    for (int w = 0; w < SENSOR_AGG_WINDOWS && n < (int)len; w++) {
+        uint32_t span = newest - agg->t_s[ring_index(agg->tail_seq[w])];
+        n += snprintf(buf + n, len - n, ",\"%s\":{\"span_s\":%lu", WINDOW_NAMES[w], (unsigned long)span);
+        for (int m = 0; m < SENSOR_METRIC_COUNT && n < (int)len; m++) {
+            sensor_agg_stats_t st;
+            if (!sensor_agg_get(w, (sensor_metric_t)m, &st)) {
+                n += snprintf(buf + n, len - n, ",\"%s\":null", METRICS[m].name);
+                continue;
+            }
+            n += snprintf(buf + n, len - n,
+                          ",\"%s\":{\"n\":%lu,\"min\":%.2f,\"max\":%.2f,\"mean\":%.2f,\"p50\":%.2f,\"p95\":%.2f}",
+                          METRICS[m].name, (unsigned long)st.n, json_value(st.min), json_value(st.max),
+                          json_value(st.mean), json_value(st.p50), json_value(st.p95));
+        }
+        if (n < (int)len) {
+            n += snprintf(buf + n, len - n, "}");
+        }
+    }
+    if (n < (int)len) {
+        n += snprintf(buf + n, len - n, "}");
+    }
+    return n;
+}
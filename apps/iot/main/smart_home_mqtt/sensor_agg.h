@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sensor_payload.h"
+
+// Sliding-window aggregates of the sensor readings over 1 min, 15 min and
+// 1 h, published on the summary topic so consumers need not query raw
+// samples. Per window and metric:
+//   min / max   monotonic deques over the sample ring, O(1) amortized
+//   mean        running sum and count
+//   p50 / p95   fixed 64-bin histogram, decremented as samples expire;
+//               linear bins for temperature, humidity and gas_raw,
+//               log10 bins for the ppm channels, clamped to min/max
+//
+// Samples live in one ring of SENSOR_AGG_CAPACITY entries (1 h at the
+// default 10 s period). With a faster sensor period the 1 h window is cut
+// to the newest SENSOR_AGG_CAPACITY samples; span_s in the summary shows
+// the time actually covered. Only the sensor task touches this module.
+typedef enum {
+    SENSOR_METRIC_TEMPERATURE = 0,
+    SENSOR_METRIC_HUMIDITY,
+    SENSOR_METRIC_GAS_RAW,
+    SENSOR_METRIC_NH3,
+    SENSOR_METRIC_CO,
+    SENSOR_METRIC_CO2,
+    SENSOR_METRIC_COUNT,
+} sensor_metric_t;
+
+#define SENSOR_AGG_WINDOWS 3
+#define SENSOR_AGG_CAPACITY 360
+#define SENSOR_AGG_BINS 64
+
+typedef struct {
+    uint32_t n;
+    float min;
+    float max;
+    float mean;
+    float p50;
+    float p95;
+} sensor_agg_stats_t;
+
+// Bytes sensor_agg_init() takes from the spiram arena.
+size_t sensor_agg_memory_bytes(void);
+bool sensor_agg_init(void);
+
+// Readings that failed (dht_ok / gas_ok false, gas_raw < 0) are skipped
+// per metric. t_s is seconds since boot.
+void sensor_agg_push(const sensor_reading_t *r, uint32_t t_s);
+
+bool sensor_agg_get(int window, sensor_metric_t metric, sensor_agg_stats_t *out);
+
+// Summary values are clamped to +-SENSOR_AGG_JSON_VALUE_MAX, so a summary
+// always fits SENSOR_AGG_JSON_MAX bytes: "t", then per window its name and
+// span_s, then per metric up to 11 name characters, n and five %.2f
+// values of at most 11 characters each.
+#define SENSOR_AGG_JSON_VALUE_MAX 1000000.0f
+#define SENSOR_AGG_JSON_MAX (16 + SENSOR_AGG_WINDOWS * (32 + SENSOR_METRIC_COUNT * 128) + 2)
+int sensor_agg_format_json(char *buf, size_t len);
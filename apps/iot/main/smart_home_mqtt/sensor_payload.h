@@ -0,0 +1,56 @@
+#pragma once
+
+// JSON published on the sensor topic, shared by the firmware and the host
+// load generator (apps/iot/scripts/load_generator.cpp). Failed readings are
+// sent as null so the backend keeps the row.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+typedef struct {
+    bool dht_ok;
+    int temperature;
+    int humidity;
+    bool gas_ok;
+    int gas_raw;
+    float nh3;
+    float co;
+    float co2;
+    float rs;
+    float ratio;
+} sensor_reading_t;
+
+static inline int sensor_payload_format(char *buf, size_t len, const sensor_reading_t *r) {
+    if (r->dht_ok) {
+        if (r->gas_ok) {
+            return snprintf(buf, len,
+                            "{\"temperature\":%d,\"humidity\":%d,\"gas\":%.1f,\"gas_raw\":%d,"
+                            "\"nh3\":%.1f,\"co\":%.1f,\"co2\":%.1f,\"rs\":%.1f,\"ratio\":%.3f}",
+                            r->temperature, r->humidity, r->co2, r->gas_raw, r->nh3, r->co, r->co2, r->rs,
+                            r->ratio);
+        }
+        return snprintf(buf, len,
+                        "{\"temperature\":%d,\"humidity\":%d,\"gas\":null,\"gas_raw\":%d,"
+                        "\"nh3\":null,\"co\":null,\"co2\":null,\"rs\":null,\"ratio\":null}",
+                        r->temperature, r->humidity, r->gas_raw);
+    }
+    if (r->gas_ok) {
+        return snprintf(buf, len,
+                        "{\"temperature\":null,\"humidity\":null,\"gas\":%.1f,\"gas_raw\":%d,"
+                        "\"nh3\":%.1f,\"co\":%.1f,\"co2\":%.1f,\"rs\":%.1f,\"ratio\":%.3f}",
+                        r->co2, r->gas_raw, r->nh3, r->co, r->co2, r->rs, r->ratio);
+    }
+    return snprintf(buf, len,
+                    "{\"temperature\":null,\"humidity\":null,\"gas\":null,\"gas_raw\":%d,"
+                    "\"nh3\":null,\"co\":null,\"co2\":null,\"rs\":null,\"ratio\":null}",
+                    r->gas_raw);
+}
+
+// Appends "report":"<reason>" to a payload formatted above.
+static inline int sensor_payload_tag(char *buf, size_t len, int n, const char *report) {
+    if (n < 1 || n >= (int)len || buf[n - 1] != '}') {
+        return n;
+    }
+    return n - 1 + snprintf(buf + n - 1, len - n + 1, ",\"report\":\"%s\"}", report);
+}
@@ -0,0 +1,143 @@
+#include "sensor_report.h"
+
+#include <math.h>
+
+#include "metrics.h"
+#include "sensor_agg.h"
+
+static const float ALERT_HYSTERESIS = 0.10f;
+
+static const char *REPORT_NAMES[] = {"none", "change", "heartbeat", "alert", "clear"};
+
+static const metric_counter_t REPORT_COUNTERS[] = {
+    METRIC_SENSOR_REPORTS_SUPPRESSED, METRIC_SENSOR_REPORTS_CHANGE, METRIC_SENSOR_REPORTS_HEARTBEAT,
+    METRIC_SENSOR_REPORTS_ALERT,      METRIC_SENSOR_REPORTS_CLEAR,
+};
+
+static bool has_published = false;
+static float published[SENSOR_METRIC_COUNT];
+static int64_t published_us = 0;
+
+static bool alert_active = false;
+static float prev_ratio = -1.0f;
+static int64_t prev_ratio_us = 0;
+static int64_t slope_until_us = 0;
+
+static void report_values(const sensor_reading_t *r, float *values) {
+    values[SENSOR_METRIC_TEMPERATURE] = r->dht_ok ? (float)r->temperature : NAN;
+    values[SENSOR_METRIC_HUMIDITY] = r->dht_ok ? (float)r->humidity : NAN;
+    values[SENSOR_METRIC_GAS_RAW] = r->gas_raw >= 0 ? (float)r->gas_raw : NAN;
+    values[SENSOR_METRIC_NH3] = r->gas_ok ? r->nh3 : NAN;
+    values[SENSOR_METRIC_CO] = r->gas_ok ? r->co : NAN;
+    values[SENSOR_METRIC_CO2] = r->gas_ok ? r->co2 : NAN;
+}
+
+static float report_deadband(const params_snapshot_t *p, int metric, float last) {
+    switch (metric) {
+    case SENSOR_METRIC_TEMPERATURE:
+        return params_float(p, PARAM_DEADBAND_TEMP);
+    case SENSOR_METRIC_HUMIDITY:
+        return params_float(p, PARAM_DEADBAND_HUMIDITY);
+    case SENSOR_METRIC_GAS_RAW:
+        return params_float(p, PARAM_DEADBAND_GAS_RAW);
+    default:
+        return fmaxf(params_float(p, PARAM_DEADBAND_PPM_ABS), params_float(p, PARAM_DEADBAND_PPM_REL) * fabsf(last));
+    }
+}
+
+static bool report_changed(const params_snapshot_t *p, const sensor_reading_t *r) {
+    if (!has_published) {
+        return true;
+    }
+    float values[SENSOR_METRIC_COUNT];
+    report_values(r, values);
+    for (int m = 0; m < SENSOR_METRIC_COUNT; m++) {
+        float last = published[m];
+        if (isnan(last) != isnan(values[m])) {
+            return true;
+        }
+        if (!isnan(last) && fabsf(values[m] - last) > report_deadband(p, m, last)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Updates the alert state from the MQ135 part of r; returns ALERT or CLEAR
+// on a transition. A failed read keeps the current state.
+static sensor_report_t report_update_alert(const params_snapshot_t *p, const sensor_reading_t *r, int64_t now_us) {
+    if (!r->gas_ok) {
+        prev_ratio = -1.0f;
+        return SENSOR_REPORT_NONE;
+    }
+    float ratio_limit = params_float(p, PARAM_ALERT_RATIO);
+    float ppm_limit = params_float(p, PARAM_ALERT_PPM);
+    float slope_limit = params_float(p, PARAM_ALERT_SLOPE);
+    if (alert_active) {
+        ratio_limit *= 1.0f + ALERT_HYSTERESIS;
+        ppm_limit *= 1.0f - ALERT_HYSTERESIS;
+    }
+
+    bool over = false;
+    if (ratio_limit > 0.0f && r->ratio < ratio_limit) {
+        over = true;
+    }
+    if (ppm_limit > 0.0f && r->co2 > ppm_limit) {
+        over = true;
+    }
+    if (slope_limit > 0.0f && prev_ratio > 0.0f && now_us > prev_ratio_us) {
+        float dt_s = (float)(now_us - prev_ratio_us) / 1e6f;
+        float drop_per_s = (prev_ratio - r->ratio) / prev_ratio / dt_s;
+        if (drop_per_s > slope_limit) {
+            slope_until_us = now_us + (int64_t)params_int(p, PARAM_SENSOR_PUBLISH_MS) * 1000;
+        }
+    }
+    prev_ratio = r->ratio;
+    prev_ratio_us = now_us;
+    if (now_us < slope_until_us) {
+        over = true;
+    }
+
+    if (over == alert_active) {
+        return SENSOR_REPORT_NONE;
+    }
+    alert_active = over;
+    return over ? SENSOR_REPORT_ALERT : SENSOR_REPORT_CLEAR;
+}
+
+sensor_report_t sensor_report_sample(const params_snapshot_t *p, const sensor_reading_t *r, int64_t now_us) {
+    sensor_report_t report = report_update_alert(p, r, now_us);
+    if (report == SENSOR_REPORT_NONE) {
+        if (alert_active) {
+            report = SENSOR_REPORT_ALERT;
+        } else if (report_changed(p, r)) {
+            report = SENSOR_REPORT_CHANGE;
+        } else if (now_us - published_us >= (int64_t)params_int(p, PARAM_REPORT_HEARTBEAT_MS) * 1000) {
+            report = SENSOR_REPORT_HEARTBEAT;
+        }
+    }
+    metrics_counter_inc(REPORT_COUNTERS[report]);
+    return report;
+}
+
+sensor_report_t sensor_report_poll(const params_snapshot_t *p, const sensor_reading_t *r, int64_t now_us) {
+    sensor_report_t report = report_update_alert(p, r, now_us);
+    if (report != SENSOR_REPORT_NONE) {
+        metrics_counter_inc(REPORT_COUNTERS[report]);
+    }
+    return report;
+}
+
+void sensor_report_published(const sensor_reading_t *r, int64_t now_us) {
+    report_values(r, published);
+    published_us = now_us;
+    has_published = true;
+}
+
+int sensor_report_qos(sensor_report_t report) {
+    return report == SENSOR_REPORT_ALERT || report == SENSOR_REPORT_CLEAR ? 1 : 0;
+}
+
+const char *sensor_report_name(sensor_report_t report) {
+    return REPORT_NAMES[report];
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "params.h"
+#include "sensor_payload.h"
+
+// Decides when a sensor reading is worth publishing. A full sample (DHT11
+// + MQ135, every sensor_pub_ms) is published when any metric moved out of
+// its deadband around the last published value, and at least every
+// report_hb_ms regardless so the backend can tell the device is alive.
+// Deadbands are absolute for temperature, humidity and gas_raw and
+// max(db_ppm_abs, db_ppm_rel * |last|) for the ppm channels; a reading
+// turning valid or failed always counts as a change.
+//
+// Between samples the MQ135 is polled every gas_poll_ms. A poll never
+// publishes on its own unless the gas alert changes state: the ratio
+// falling below alert_ratio, CO2 rising above alert_ppm, or the ratio
+// dropping faster than alert_slope (fraction per second). Alerts publish
+// at QoS 1 right away, and every sample while the alert holds is
+// published at QoS 1 too; leaving the alert (10% hysteresis, slope alerts
+// held for one sample period) publishes a "clear". A zero threshold
+// disables that trigger. Only the sensor task touches this module.
+typedef enum {
+    SENSOR_REPORT_NONE = 0,  // suppressed
+    SENSOR_REPORT_CHANGE,
+    SENSOR_REPORT_HEARTBEAT,
+    SENSOR_REPORT_ALERT,
+    SENSOR_REPORT_CLEAR,
+} sensor_report_t;
+
+sensor_report_t sensor_report_sample(const params_snapshot_t *p, const sensor_reading_t *r, int64_t now_us);
+sensor_report_t sensor_report_poll(const params_snapshot_t *p, const sensor_reading_t *r, int64_t now_us);
+
+// Call after the broker accepted the publish, so a failed one is retried
+// on the next sample.
+void sensor_report_published(const sensor_reading_t *r, int64_t now_us);
+
+int sensor_report_qos(sensor_report_t report);
+const char *sensor_report_name(sensor_report_t report);
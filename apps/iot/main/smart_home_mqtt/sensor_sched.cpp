@@ -0,0 +1,128 @@
+#include "sensor_sched.h"
+
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#endif
+
+typedef struct {
+    const sensor_driver_t *driver;
+    int64_t period_us;
+    int64_t next_start_us;
+    int64_t started_us;
+    int64_t ended_us;
+    int64_t poll_us;
+    bool busy;
+} sched_entry_t;
+
+static sched_entry_t entries[SENSOR_SCHED_MAX];
+static int entry_count = 0;
+
+int sensor_sched_register(const sensor_driver_t *driver, uint32_t period_ms) {
+    if (!driver || !driver->start || !driver->poll || entry_count >= SENSOR_SCHED_MAX) {
+        return -1;
+    }
+    sched_entry_t *e = &entries[entry_count];
+    memset(e, 0, sizeof(*e));
+    e->driver = driver;
+    e->period_us = (int64_t)period_ms * 1000;
+    e->next_start_us = INT64_MIN;
+    return entry_count++;
+}
+
+static void sched_plan_next(sched_entry_t *e) {
+    int64_t by_period = e->started_us + e->period_us;
+    int64_t by_interval = e->ended_us + (int64_t)e->driver->min_interval_ms * 1000;
+    e->next_start_us = by_period > by_interval ? by_period : by_interval;
+}
+
+void sensor_sched_set_period(int id, uint32_t period_ms) {
+    if (id < 0 || id >= entry_count) {
+        return;
+    }
+    sched_entry_t *e = &entries[id];
+    int64_t period_us = (int64_t)period_ms * 1000;
+    if (period_us == e->period_us) {
+        return;
+    }
+    // Re-anchor an idle sensor on its last start so a shorter period
+    // takes effect now rather than after the old one ran out.
+    e->period_us = period_us;
+    if (!e->busy && e->next_start_us != INT64_MIN) {
+        sched_plan_next(e);
+    }
+}
+
+static void sched_complete(int id, int64_t now_us, sensor_sample_t *out) {
+    sched_entry_t *e = &entries[id];
+    e->busy = false;
+    e->ended_us = now_us;
+    sched_plan_next(e);
+    out->sensor = (uint8_t)id;
+    out->t_us = now_us;
+    out->duration_us = (uint32_t)(now_us - e->started_us);
+}
+
+bool sensor_sched_step(int64_t now_us, sensor_sample_t *out, int64_t *next_us) {
+    while (true) {
+        // Running measurements first: their timing is usually tighter.
+        int due = -1;
+        for (int i = 0; i < entry_count; i++) {
+            if (entries[i].busy && entries[i].poll_us <= now_us &&
+                (due < 0 || entries[i].poll_us < entries[due].poll_us)) {
+                due = i;
+            }
+        }
+        if (due >= 0) {
+            sched_entry_t *e = &entries[due];
+            memset(out, 0, sizeof(*out));
+            if (e->driver->poll(e->driver->ctx, now_us, &e->poll_us, out) == SENSOR_STEP_DONE) {
+                sched_complete(due, now_us, out);
+                return true;
+            }
+            continue;
+        }
+
+        for (int i = 0; i < entry_count; i++) {
+            if (!entries[i].busy && entries[i].next_start_us <= now_us &&
+                (due < 0 || entries[i].next_start_us < entries[due].next_start_us)) {
+                due = i;
+            }
+        }
+        if (due < 0) {
+            break;
+        }
+        sched_entry_t *e = &entries[due];
+        e->started_us = now_us;
+        if (!e->driver->start(e->driver->ctx, now_us, &e->poll_us)) {
+            memset(out, 0, sizeof(*out));
+            sched_complete(due, now_us, out);
+            return true;
+        }
+        e->busy = true;
+    }
+
+    int64_t next = INT64_MAX;
+    for (int i = 0; i < entry_count; i++) {
+        int64_t t = entries[i].busy ? entries[i].poll_us : entries[i].next_start_us;
+        if (t < next) {
+            next = t;
+        }
+    }
+    *next_us = next;
+    return false;
+}
+
+#ifdef ESP_PLATFORM
+void sensor_sched_wait(sensor_sample_t *out) {
+    int64_t next_us = 0;
+    while (!sensor_sched_step(esp_timer_get_time(), out, &next_us)) {
+        int64_t wait_us = next_us == INT64_MAX ? 1000000 : next_us - esp_timer_get_time();
+        TickType_t ticks = wait_us > 0 ? pdMS_TO_TICKS((wait_us + 999) / 1000) : 0;
+        vTaskDelay(ticks > 0 ? ticks : 1);
+    }
+}
+#endif
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Sensor drivers and a deadline scheduler that runs them all on the sensor
+// task. A driver never sleeps: start() begins a measurement and poll()
+// advances it, and both say when they want to run next, so one sensor's
+// wait (the DHT11's 18 ms start pulse, its second between reads) is time
+// the others can use. Finished measurements come out as one stream of
+// timestamped samples.
+//
+// Each sensor has a period (how often a measurement is wanted; can change
+// at run time) and a min_interval_ms the part needs between the end of one
+// measurement and the start of the next. A measurement starts at
+// max(last start + period, last end + min interval); a sensor that fell
+// behind starts once instead of catching up. Running measurements are
+// polled before new ones start, each in deadline order.
+//
+// The scheduler takes the time as an argument and does not sleep itself,
+// so it also runs on the host (scripts/sensor_sched_check.cpp).
+
+#define SENSOR_SCHED_MAX 8
+#define SENSOR_SAMPLE_VALUES 6
+
+typedef struct {
+    uint8_t sensor;                    // id from sensor_sched_register()
+    bool ok;
+    int64_t t_us;                      // when the measurement completed
+    uint32_t duration_us;              // start to completion
+    float values[SENSOR_SAMPLE_VALUES]; // meaning is up to the driver
+} sensor_sample_t;
+
+typedef enum {
+    SENSOR_STEP_PENDING = 0, // poll again at *poll_us
+    SENSOR_STEP_DONE,        // out is filled in
+} sensor_step_t;
+
+typedef struct {
+    const char *name;
+    uint32_t min_interval_ms;
+    // false fails the measurement at once (a sample with ok == false).
+    bool (*start)(void *ctx, int64_t now_us, int64_t *poll_us);
+    // Sets out->ok and out->values on DONE; the scheduler fills the rest.
+    sensor_step_t (*poll)(void *ctx, int64_t now_us, int64_t *poll_us, sensor_sample_t *out);
+    void *ctx;
+} sensor_driver_t;
+
+// Returns the sensor id, or -1 when the registry is full. The driver
+// struct must outlive the scheduler. The first measurement starts on the
+// next step.
+int sensor_sched_register(const sensor_driver_t *driver, uint32_t period_ms);
+void sensor_sched_set_period(int id, uint32_t period_ms);
+
+// Runs what is due at now_us. Returns true with *out set when a
+// measurement completed (call again at once, more may be due); otherwise
+// sets *next_us to when something is due next (INT64_MAX when idle).
+bool sensor_sched_step(int64_t now_us, sensor_sample_t *out, int64_t *next_us);
+
+#ifdef ESP_PLATFORM
+// Sleeps until the next sample is out.
+void sensor_sched_wait(sensor_sample_t *out);
+#endif
@@ -5,7 +5,6 @@
 
 #include "sdkconfig.h"
 #include "driver/i2c_master.h"
-#include "driver/i2s_std.h"
 #include "esp_event.h"
 #include "esp_log.h"
 #include "esp_err.h"
@@ -16,7 +15,6 @@
 #include "esp_netif_ip_addr.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
-#include "freertos/semphr.h"
 #include "freertos/task.h"
 #include "mqtt_client.h"
 #include "esp_adc/adc_oneshot.h"
@@ -27,9 +25,32 @@
 #include "lwip/sockets.h"
 #include "lwip/tcp.h"
 
+#include "afe_profile.h"
+#include "app_console.h"
+#include "audio_agc.h"
+#include "audio_deadline.h"
+#include "audio_flow.h"
+#include "audio_frame.h"
+#include "audio_stream.h"
+#include "event_bus.h"
+#include "i2s_capture.h"
+#include "local_commands.h"
+#include "log_mel.h"
+#include "mem_arena.h"
+#include "metrics.h"
+#include "ota_update.h"
+#include "params.h"
+#include "sensor_agg.h"
+#include "sensor_report.h"
+#include "sensor_sched.h"
+#include "sr_models.h"
+#include "power_profile.h"
+#include "sensor_payload.h"
+#include "task_monitor.h"
+#include "task_plan.h"
+#include "wifi_manager.h"
+
 extern "C" {
-#include "esp_afe_sr_iface.h"
-#include "esp_afe_sr_models.h"
 #include "esp_mn_iface.h"
 #include "esp_mn_models.h"
 }
@@ -44,12 +65,17 @@ static const char *MQTT_BROKER_URI = CONFIG_SMART_HOME_MQTT_BROKER_URI;
 static const char *MQTT_USERNAME = CONFIG_SMART_HOME_MQTT_USERNAME;
 static const char *MQTT_PASSWORD = CONFIG_SMART_HOME_MQTT_PASSWORD;
 static const char *MQTT_TOPIC_SENSOR = CONFIG_SMART_HOME_MQTT_TOPIC_SENSOR;
+static const char *MQTT_TOPIC_STATUS = CONFIG_SMART_HOME_MQTT_TOPIC_STATUS;
+static const char *MQTT_TOPIC_CONTROL = CONFIG_SMART_HOME_MQTT_TOPIC_CONTROL;
+static const char *MQTT_TOPIC_WAKE = CONFIG_SMART_HOME_MQTT_TOPIC_WAKE;
+static const char *MQTT_TOPIC_PARAMS = CONFIG_SMART_HOME_MQTT_TOPIC_PARAMS;
+static const char *MQTT_TOPIC_SUMMARY = CONFIG_SMART_HOME_MQTT_TOPIC_SUMMARY;
+static const char *MQTT_TOPIC_OTA = CONFIG_SMART_HOME_MQTT_TOPIC_OTA;
 
 // INMP411 wiring (from INMP411.c)
 static const gpio_num_t I2S_SCK = GPIO_NUM_12; // BCLK
 static const gpio_num_t I2S_WS = GPIO_NUM_11;
 static const gpio_num_t I2S_SD = GPIO_NUM_10;
-#define I2S_PORT I2S_NUM_0
 
 // I2C LCD wiring
 static const i2c_port_num_t I2C_PORT = I2C_NUM_0;
@@ -59,44 +85,46 @@ static const uint32_t I2C_CLK_HZ = 100000;
 static const gpio_num_t LED_PIN = GPIO_NUM_6;
 static const gpio_num_t DHT11_PIN = GPIO_NUM_15;
 static const gpio_num_t MQ135_PIN = GPIO_NUM_2;
+static const int LOCAL_LIGHT_GPIO = CONFIG_SMART_HOME_LOCAL_LIGHT_GPIO; // -1 = no local light
 
 static const int SAMPLE_RATE = 16000;
-static const int SILENCE_TIMEOUT_MS = 2000;
-static const int MAX_RECORD_MS = 20000;
+static const int I2S_STALL_MS = 200;
 static const int LISTENING_ANIM_MS = 500;
-static const int ENERGY_THRESHOLD = 250;
-static const uint32_t UDP_AUDIO_HEADER = 10;
-static const int AUDIO_GAIN_SHIFT = 2; // +12dB (x4)
-static const int UDP_AGG_FRAMES = 3;   // aggregate frames to reduce UDP packet rate
-static const int SENSOR_PUBLISH_MS = 10000;
-static const int DHT_SAMPLE_COUNT = 3;
+static const uint32_t UDP_AUDIO_HEADER = AUDIO_STREAM_AUD0_LEN;
+// Room reserved in front of the PCM in each audio packet.
+#if CONFIG_SMART_HOME_AUDIO_TIMESTAMPS
+static const uint32_t AUDIO_PACKET_PREFIX = AUDIO_STREAM_TIME_LEN + UDP_AUDIO_HEADER;
+#else
+static const uint32_t AUDIO_PACKET_PREFIX = UDP_AUDIO_HEADER;
+#endif
+static const int AUDIO_CREDIT_STALL_MS = 5000; // no new credit for this long ends the session
+// Tuning values (timeouts, thresholds, gain, aggregation, sensor curves)
+// are runtime parameters; see params.cpp for defaults and ranges.
+static const int DHT_SAMPLE_MAX = 7; // upper bound of PARAM_DHT_SAMPLE_COUNT
 static const int DHT_SAMPLE_DELAY_MS = 1200;
+static const int DHT_MIN_INTERVAL_MS = 1000; // datasheet: one read per second
+static const int64_t DHT_START_PULSE_US = 18000;
 static const int MQ135_CALIB_SAMPLES = 10;
 static const int MQ135_CALIB_DELAY_MS = 200;
-static const float MQ135_RL_OHMS = 10000.0f;
-static const float MQ135_CLEAN_AIR_RATIO = 3.6f;
 static const bool MQ135_FORCE_RECALIBRATE = false;
-static const float MQ135_NH3_A = 102.2f;
-static const float MQ135_NH3_B = -2.473f;
-static const float MQ135_CO_A = 605.18f;
-static const float MQ135_CO_B = -3.937f;
-// CO2 curve (approx, from datasheet fit).
-static const float MQ135_CO2_A = 110.47f;
-static const float MQ135_CO2_B = -2.862f;
-
-static i2s_chan_handle_t rx_handle = NULL;
+// The datasheet curves end at 10000 ppm; beyond that (a rail-high ADC
+// reading) the power law only extrapolates, so values are capped there.
+static const float MQ135_PPM_MAX = 10000.0f;
+
 static int audio_sock = -1;
 static struct sockaddr_in audio_target = {};
+static uint8_t audio_rx[4 * AUDIO_STREAM_CRED_LEN]; // CRED from the server
+static size_t audio_rx_len = 0;
+static bool audio_credit_timeout = false;
 
-static EventGroupHandle_t wifi_event_group;
-static const int WIFI_CONNECTED_BIT = BIT0;
 static EventGroupHandle_t mqtt_event_group;
 static const int MQTT_CONNECTED_BIT = BIT0;
 
+static audio_agc_t audio_agc;
+
 static esp_afe_sr_iface_t *afe_handle = NULL;
 static esp_afe_sr_data_t *afe_data = NULL;
 
-static SemaphoreHandle_t lcd_mutex = NULL;
 static bool lcd_ready = false;
 static uint8_t lcd_addr = 0x27;
 static bool lcd_backlight = true;
@@ -107,6 +135,8 @@ static adc_oneshot_unit_handle_t adc_handle = NULL;
 static adc_unit_t mq135_unit = ADC_UNIT_1;
 static adc_channel_t mq135_channel = ADC_CHANNEL_1;
 static float mq135_r0 = 10000.0f;
+// Sensor task's parameter snapshot, refreshed before every sample.
+static params_snapshot_t sensor_params;
 static const char *MQ135_NVS_NS = "mq135";
 static const char *MQ135_NVS_KEY_R0 = "r0";
 static const char *MQ135_NVS_KEY_FORCE = "force";
@@ -115,61 +145,6 @@ static const char *MQ135_NVS_KEY_FORCE = "force";
 #define LCD_EN 0x04
 #define LCD_BL 0x08
 
-static bool wifi_config_valid(void) {
-    return WIFI_SSID && WIFI_PASS && strlen(WIFI_SSID) > 0 && strlen(WIFI_PASS) > 0;
-}
-
-static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data) {
-    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        esp_wifi_connect();
-    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        esp_wifi_connect();
-        xEventGroupClearBits(wifi_event_group, WIFI_CONNECTED_BIT);
-    } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
-        xEventGroupSetBits(wifi_event_group, WIFI_CONNECTED_BIT);
-    }
-}
-
-static bool wifi_init_sta(void) {
-    if (!wifi_config_valid()) {
-        ESP_LOGE(TAG, "WiFi credentials not set. Configure SMART_HOME_WIFI_SSID/PASSWORD.");
-        return false;
-    }
-
-    wifi_event_group = xEventGroupCreate();
-    esp_netif_init();
-    esp_event_loop_create_default();
-    esp_netif_create_default_wifi_sta();
-
-    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    esp_wifi_init(&cfg);
-
-    esp_event_handler_instance_t instance_any_id;
-    esp_event_handler_instance_t instance_got_ip;
-    esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL, &instance_any_id);
-    esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_event_handler, NULL, &instance_got_ip);
-
-    wifi_config_t wifi_config = {};
-    strncpy((char *)wifi_config.sta.ssid, WIFI_SSID, sizeof(wifi_config.sta.ssid) - 1);
-    wifi_config.sta.ssid[sizeof(wifi_config.sta.ssid) - 1] = '\0';
-    strncpy((char *)wifi_config.sta.password, WIFI_PASS, sizeof(wifi_config.sta.password) - 1);
-    wifi_config.sta.password[sizeof(wifi_config.sta.password) - 1] = '\0';
-    wifi_config.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
-
-    esp_wifi_set_mode(WIFI_MODE_STA);
-    esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
-    esp_wifi_start();
-
-    xEventGroupWaitBits(wifi_event_group, WIFI_CONNECTED_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
-
-    esp_netif_ip_info_t ip_info;
-    esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
-    if (netif && esp_netif_get_ip_info(netif, &ip_info) == ESP_OK) {
-        ESP_LOGI(TAG, "WiFi IP: " IPSTR, IP2STR(&ip_info.ip));
-    }
-    return true;
-}
-
 static void mqtt_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data) {
     esp_mqtt_event_handle_t event = (esp_mqtt_event_handle_t)event_data;
     switch (event->event_id) {
@@ -181,12 +156,14 @@ static void mqtt_event_handler(void *arg, esp_event_base_t event_base, int32_t e
             break;
         case MQTT_EVENT_DISCONNECTED:
             ESP_LOGW(TAG, "MQTT disconnected");
+            metrics_counter_inc(METRIC_MQTT_DISCONNECTS);
             if (mqtt_event_group) {
                 xEventGroupClearBits(mqtt_event_group, MQTT_CONNECTED_BIT);
             }
             break;
         case MQTT_EVENT_ERROR:
             ESP_LOGW(TAG, "MQTT error");
+            metrics_counter_inc(METRIC_MQTT_ERRORS);
             break;
         default:
             break;
@@ -251,14 +228,14 @@ static int dht_measure_level(gpio_num_t pin, int level, int timeout_us) {
     return (int)(esp_timer_get_time() - start);
 }
 
-static bool dht11_read(int *temperature, int *humidity) {
-    if (!temperature || !humidity) {
-        return false;
-    }
-
+// Start signal: the line is held low for at least 18 ms; the scheduler
+// sleeps through that and calls dht11_read_response() afterwards.
+static void dht11_start_pulse(void) {
     gpio_set_direction(DHT11_PIN, GPIO_MODE_OUTPUT_OD);
     gpio_set_level(DHT11_PIN, 0);
-    esp_rom_delay_us(18000);
+}
+
+static bool dht11_read_response(int *temperature, int *humidity) {
     gpio_set_level(DHT11_PIN, 1);
     esp_rom_delay_us(40);
     gpio_set_direction(DHT11_PIN, GPIO_MODE_INPUT);
@@ -303,36 +280,68 @@ static void sort_ints(int *values, int count) {
     }
 }
 
-static bool dht11_read_median(int *temperature, int *humidity) {
-    if (!temperature || !humidity) {
-        return false;
-    }
-    int temps[DHT_SAMPLE_COUNT];
-    int hums[DHT_SAMPLE_COUNT];
-    int ok = 0;
-    for (int i = 0; i < DHT_SAMPLE_COUNT; i++) {
-        int t = 0;
-        int h = 0;
-        if (dht11_read(&t, &h)) {
-            temps[ok] = t;
-            hums[ok] = h;
-            ok++;
-        }
-        if (i + 1 < DHT_SAMPLE_COUNT) {
-            vTaskDelay(pdMS_TO_TICKS(DHT_SAMPLE_DELAY_MS));
-        }
-    }
-
-    if (ok == 0) {
-        return false;
-    }
-    sort_ints(temps, ok);
-    sort_ints(hums, ok);
-    *temperature = temps[ok / 2];
-    *humidity = hums[ok / 2];
+// One measurement is the median of dht_samples reads, DHT_SAMPLE_DELAY_MS
+// apart. Sample values: temperature, humidity.
+typedef struct {
+    int wanted;
+    int done;
+    int ok;
+    bool pulsing;
+    int temps[DHT_SAMPLE_MAX];
+    int hums[DHT_SAMPLE_MAX];
+} dht11_measurement_t;
+
+static dht11_measurement_t dht11_measurement;
+
+static bool dht11_driver_start(void *ctx, int64_t now_us, int64_t *poll_us) {
+    dht11_measurement_t *m = (dht11_measurement_t *)ctx;
+    m->wanted = params_int(&sensor_params, PARAM_DHT_SAMPLE_COUNT);
+    if (m->wanted > DHT_SAMPLE_MAX) {
+        m->wanted = DHT_SAMPLE_MAX;
+    }
+    m->done = 0;
+    m->ok = 0;
+    m->pulsing = true;
+    dht11_start_pulse();
+    *poll_us = now_us + DHT_START_PULSE_US;
     return true;
 }
 
+static sensor_step_t dht11_driver_poll(void *ctx, int64_t now_us, int64_t *poll_us, sensor_sample_t *out) {
+    dht11_measurement_t *m = (dht11_measurement_t *)ctx;
+    if (!m->pulsing) {
+        m->pulsing = true;
+        dht11_start_pulse();
+        *poll_us = now_us + DHT_START_PULSE_US;
+        return SENSOR_STEP_PENDING;
+    }
+    int t = 0;
+    int h = 0;
+    if (dht11_read_response(&t, &h)) {
+        m->temps[m->ok] = t;
+        m->hums[m->ok] = h;
+        m->ok++;
+    }
+    m->done++;
+    if (m->done < m->wanted) {
+        m->pulsing = false;
+        *poll_us = now_us + (int64_t)DHT_SAMPLE_DELAY_MS * 1000 - DHT_START_PULSE_US;
+        return SENSOR_STEP_PENDING;
+    }
+    out->ok = m->ok > 0;
+    if (out->ok) {
+        sort_ints(m->temps, m->ok);
+        sort_ints(m->hums, m->ok);
+        out->values[0] = (float)m->temps[m->ok / 2];
+        out->values[1] = (float)m->hums[m->ok / 2];
+    }
+    return SENSOR_STEP_DONE;
+}
+
+static const sensor_driver_t DHT11_DRIVER = {
+    "dht11", DHT_MIN_INTERVAL_MS, dht11_driver_start, dht11_driver_poll, &dht11_measurement,
+};
+
 static bool adc_init(void) {
     if (adc_handle) {
         return true;
@@ -368,7 +377,7 @@ static float mq135_raw_to_rs(int raw) {
     if (raw >= 4095) {
         raw = 4095;
     }
-    return MQ135_RL_OHMS * ((4095.0f / (float)raw) - 1.0f);
+    return params_float(&sensor_params, PARAM_MQ135_RL_OHMS) * ((4095.0f / (float)raw) - 1.0f);
 }
 
 static bool mq135_load_r0(void) {
@@ -450,7 +459,7 @@ static void mq135_calibrate(void) {
     }
     if (count > 0) {
         float rs_avg = rs_sum / (float)count;
-        mq135_r0 = rs_avg / MQ135_CLEAN_AIR_RATIO;
+        mq135_r0 = rs_avg / params_float(&sensor_params, PARAM_MQ135_CLEAN_AIR_RATIO);
         mq135_save_r0(mq135_r0);
     }
     ESP_LOGI(TAG, "MQ135 R0=%.2f (samples=%d)", mq135_r0, count);
@@ -458,10 +467,10 @@ static void mq135_calibrate(void) {
 
 static float mq135_ratio_to_ppm(float ratio, float a, float b) {
     float ppm = a * powf(ratio, b);
-    if (ppm < 0.0f) {
+    if (!(ppm >= 0.0f)) {
         ppm = 0.0f;
     }
-    return ppm;
+    return ppm > MQ135_PPM_MAX ? MQ135_PPM_MAX : ppm;
 }
 
 static bool mq135_raw_to_ppm(int raw, float *ppm_nh3, float *ppm_co, float *ppm_co2,
@@ -478,18 +487,64 @@ static bool mq135_raw_to_ppm(int raw, float *ppm_nh3, float *ppm_co, float *ppm_
         *out_ratio = ratio;
     }
     if (ppm_nh3) {
-        *ppm_nh3 = mq135_ratio_to_ppm(ratio, MQ135_NH3_A, MQ135_NH3_B);
+        *ppm_nh3 = mq135_ratio_to_ppm(ratio, params_float(&sensor_params, PARAM_MQ135_NH3_A),
+                                      params_float(&sensor_params, PARAM_MQ135_NH3_B));
     }
     if (ppm_co) {
-        *ppm_co = mq135_ratio_to_ppm(ratio, MQ135_CO_A, MQ135_CO_B);
+        *ppm_co = mq135_ratio_to_ppm(ratio, params_float(&sensor_params, PARAM_MQ135_CO_A),
+                                     params_float(&sensor_params, PARAM_MQ135_CO_B));
     }
     if (ppm_co2) {
-        *ppm_co2 = mq135_ratio_to_ppm(ratio, MQ135_CO2_A, MQ135_CO2_B);
+        *ppm_co2 = mq135_ratio_to_ppm(ratio, params_float(&sensor_params, PARAM_MQ135_CO2_A),
+                                      params_float(&sensor_params, PARAM_MQ135_CO2_B));
     }
     return true;
 }
 
+// Sample values: gas_raw (-1 when the ADC read failed), nh3, co, co2, rs,
+// ratio; ok means the ppm conversion succeeded.
+static bool mq135_driver_start(void *ctx, int64_t now_us, int64_t *poll_us) {
+    *poll_us = now_us;
+    return adc_handle != NULL;
+}
+
+static sensor_step_t mq135_driver_poll(void *ctx, int64_t now_us, int64_t *poll_us, sensor_sample_t *out) {
+    int raw = mq135_read_raw();
+    out->values[0] = (float)raw;
+    out->ok = mq135_raw_to_ppm(raw, &out->values[1], &out->values[2], &out->values[3], &out->values[4],
+                               &out->values[5]);
+    return SENSOR_STEP_DONE;
+}
+
+static const sensor_driver_t MQ135_DRIVER = {
+    "mq135", 0, mq135_driver_start, mq135_driver_poll, NULL,
+};
+
+static void sensor_publish(const sensor_reading_t *reading, sensor_report_t report, int64_t now_us) {
+    if (!mqtt_client || !MQTT_TOPIC_SENSOR || strlen(MQTT_TOPIC_SENSOR) == 0) {
+        return;
+    }
+    char payload[240];
+    int len = sensor_payload_format(payload, sizeof(payload), reading);
+    len = sensor_payload_tag(payload, sizeof(payload), len, sensor_report_name(report));
+    if (len <= 0 || len >= (int)sizeof(payload)) {
+        metrics_counter_inc(METRIC_MQTT_PAYLOAD_TRUNCATED);
+        ESP_LOGW(TAG, "Sensor payload needs %d of %u bytes, not published", len, (unsigned)sizeof(payload));
+        return;
+    }
+    // QoS 1 for alerts: the client keeps them in its outbox across a
+    // reconnect instead of dropping them.
+    if (esp_mqtt_client_publish(mqtt_client, MQTT_TOPIC_SENSOR, payload, len, sensor_report_qos(report), 0) < 0) {
+        metrics_counter_inc(METRIC_MQTT_PUBLISH_FAILURES);
+        return;
+    }
+    metrics_counter_inc(METRIC_MQTT_SENSOR_PUBLISHES);
+    sensor_report_published(reading, now_us);
+    ESP_LOGD(TAG, "MQTT sensor publish: %s", payload);
+}
+
 static void sensor_task(void *pvParameters) {
+    params_refresh(&sensor_params);
     dht11_prepare_pin();
     if (!adc_init()) {
         ESP_LOGW(TAG, "ADC init failed, MQ135 disabled");
@@ -505,61 +560,89 @@ static void sensor_task(void *pvParameters) {
         }
     }
 
+    // The DHT11 paces full samples (sensor_pub_ms); the MQ135 is polled
+    // every gas_poll_ms in between, and its latest values go out with the
+    // next full sample.
+    int dht_id = sensor_sched_register(&DHT11_DRIVER, params_int(&sensor_params, PARAM_SENSOR_PUBLISH_MS));
+    int gas_id = sensor_sched_register(&MQ135_DRIVER, params_int(&sensor_params, PARAM_GAS_POLL_MS));
+
+    int64_t last_summary_us = esp_timer_get_time();
+    sensor_reading_t reading = {};
+    reading.gas_raw = -1;
+    reading.nh3 = reading.co = reading.co2 = reading.rs = reading.ratio = -1.0f;
     while (true) {
         if (mqtt_event_group) {
             xEventGroupWaitBits(mqtt_event_group, MQTT_CONNECTED_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
         }
+        if (params_refresh(&sensor_params)) {
+            sensor_sched_set_period(dht_id, params_int(&sensor_params, PARAM_SENSOR_PUBLISH_MS));
+            sensor_sched_set_period(gas_id, params_int(&sensor_params, PARAM_GAS_POLL_MS));
+        }
 
-        int temperature = 0;
-        int humidity = 0;
-        bool dht_ok = dht11_read_median(&temperature, &humidity);
-        int gas_raw = mq135_read_raw();
-        float gas_nh3 = -1.0f;
-        float gas_co = -1.0f;
-        float gas_co2 = -1.0f;
-        float gas_rs = -1.0f;
-        float gas_ratio = -1.0f;
-        bool gas_ok = mq135_raw_to_ppm(gas_raw, &gas_nh3, &gas_co, &gas_co2, &gas_rs, &gas_ratio);
-
-        if (!dht_ok) {
+        sensor_sample_t sample;
+        sensor_sched_wait(&sample);
+
+        if (sample.sensor == gas_id) {
+            bool was_read = reading.gas_raw >= 0;
+            reading.gas_raw = (int)sample.values[0];
+            reading.gas_ok = sample.ok;
+            if (sample.ok) {
+                reading.nh3 = sample.values[1];
+                reading.co = sample.values[2];
+                reading.co2 = sample.values[3];
+                reading.rs = sample.values[4];
+                reading.ratio = sample.values[5];
+            } else {
+                reading.nh3 = reading.co = reading.co2 = reading.rs = reading.ratio = -1.0f;
+            }
+            if (reading.gas_raw < 0) {
+                metrics_counter_inc(METRIC_SENSOR_MQ135_FAILURES);
+                if (was_read) {
+                    ESP_LOGW(TAG, "MQ135 read failed");
+                }
+            }
+            sensor_report_t report = sensor_report_poll(&sensor_params, &reading, sample.t_us);
+            if (report != SENSOR_REPORT_NONE) {
+                ESP_LOGW(TAG, "Gas %s: ratio=%.3f co2=%.1f ppm", sensor_report_name(report), reading.ratio,
+                         reading.co2);
+                sensor_publish(&reading, report, sample.t_us);
+            }
+            continue;
+        }
+        if (sample.sensor != dht_id) {
+            continue;
+        }
+
+        metrics_histogram_observe(METRIC_SENSOR_READ_US, sample.duration_us);
+        reading.dht_ok = sample.ok;
+        if (sample.ok) {
+            reading.temperature = (int)sample.values[0];
+            reading.humidity = (int)sample.values[1];
+        } else {
+            metrics_counter_inc(METRIC_SENSOR_DHT11_FAILURES);
             ESP_LOGW(TAG, "DHT11 read failed");
         }
-        if (gas_raw < 0) {
-            ESP_LOGW(TAG, "MQ135 read failed");
+
+        int64_t now_us = sample.t_us;
+        sensor_report_t report = sensor_report_sample(&sensor_params, &reading, now_us);
+        if (report != SENSOR_REPORT_NONE) {
+            sensor_publish(&reading, report, now_us);
         }
 
-        if (mqtt_client && MQTT_TOPIC_SENSOR && strlen(MQTT_TOPIC_SENSOR) > 0) {
-            char payload[220];
-            if (dht_ok) {
-                if (gas_ok) {
-                    snprintf(payload, sizeof(payload),
-                             "{\"temperature\":%d,\"humidity\":%d,\"gas\":%.1f,\"gas_raw\":%d,"
-                             "\"nh3\":%.1f,\"co\":%.1f,\"co2\":%.1f,\"rs\":%.1f,\"ratio\":%.3f}",
-                             temperature, humidity, gas_co2, gas_raw, gas_nh3, gas_co, gas_co2, gas_rs, gas_ratio);
-                } else {
-                    snprintf(payload, sizeof(payload),
-                             "{\"temperature\":%d,\"humidity\":%d,\"gas\":null,\"gas_raw\":%d,"
-                             "\"nh3\":null,\"co\":null,\"co2\":null,\"rs\":null,\"ratio\":null}",
-                             temperature, humidity, gas_raw);
-                }
-            } else {
-                if (gas_ok) {
-                    snprintf(payload, sizeof(payload),
-                             "{\"temperature\":null,\"humidity\":null,\"gas\":%.1f,\"gas_raw\":%d,"
-                             "\"nh3\":%.1f,\"co\":%.1f,\"co2\":%.1f,\"rs\":%.1f,\"ratio\":%.3f}",
-                             gas_co2, gas_raw, gas_nh3, gas_co, gas_co2, gas_rs, gas_ratio);
+        sensor_agg_push(&reading, (uint32_t)(now_us / 1000000));
+        if (now_us - last_summary_us >= (int64_t)params_int(&sensor_params, PARAM_SUMMARY_PUBLISH_MS) * 1000) {
+            last_summary_us = now_us;
+            if (mqtt_client && MQTT_TOPIC_SUMMARY && strlen(MQTT_TOPIC_SUMMARY) > 0) {
+                static char summary[SENSOR_AGG_JSON_MAX];
+                int len = sensor_agg_format_json(summary, sizeof(summary));
+                if (len > 0 && len < (int)sizeof(summary)) {
+                    esp_mqtt_client_publish(mqtt_client, MQTT_TOPIC_SUMMARY, summary, len, 0, 0);
                 } else {
-                    snprintf(payload, sizeof(payload),
-                             "{\"temperature\":null,\"humidity\":null,\"gas\":null,\"gas_raw\":%d,"
-                             "\"nh3\":null,\"co\":null,\"co2\":null,\"rs\":null,\"ratio\":null}",
-                             gas_raw);
+                    metrics_counter_inc(METRIC_MQTT_PAYLOAD_TRUNCATED);
+                    ESP_LOGW(TAG, "Summary needs %d of %u bytes, not published", len, (unsigned)sizeof(summary));
                 }
             }
-            esp_mqtt_client_publish(mqtt_client, MQTT_TOPIC_SENSOR, payload, 0, 0, 0);
-            ESP_LOGI(TAG, "MQTT sensor publish: %s", payload);
         }
-
-        vTaskDelay(pdMS_TO_TICKS(SENSOR_PUBLISH_MS));
     }
 }
 
@@ -569,6 +652,8 @@ static void audio_close_socket(void) {
         close(audio_sock);
         audio_sock = -1;
     }
+    audio_rx_len = 0;
+    audio_flow_reset();
 }
 
 static void audio_init(void) {
@@ -588,6 +673,7 @@ static bool audio_connect(void) {
     if (audio_sock >= 0) {
         return true;
     }
+    int64_t start_us = esp_timer_get_time();
     audio_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
     if (audio_sock < 0) {
         ESP_LOGE(TAG, "Unable to create TCP socket");
@@ -601,7 +687,10 @@ static bool audio_connect(void) {
     setsockopt(audio_sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
     setsockopt(audio_sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
 
-    if (connect(audio_sock, (struct sockaddr *)&audio_target, sizeof(audio_target)) != 0) {
+    bool ok = connect(audio_sock, (struct sockaddr *)&audio_target, sizeof(audio_target)) == 0;
+    audio_deadline_account(DEADLINE_CAUSE_NET, esp_timer_get_time() - start_us);
+    if (!ok) {
+        metrics_counter_inc(METRIC_TCP_CONNECT_FAILURES);
         ESP_LOGW(TAG, "TCP connect failed");
         audio_close_socket();
         return false;
@@ -613,49 +702,140 @@ static bool audio_send_packet(const uint8_t *data, size_t len) {
     if (!audio_connect()) {
         return false;
     }
+    int64_t start_us = esp_timer_get_time();
     size_t sent = 0;
     while (sent < len) {
         int r = send(audio_sock, data + sent, len - sent, 0);
         if (r <= 0) {
+            audio_deadline_account(DEADLINE_CAUSE_NET, esp_timer_get_time() - start_us);
+            metrics_counter_inc(METRIC_TCP_SEND_FAILURES);
             ESP_LOGW(TAG, "TCP send failed");
             audio_close_socket();
             return false;
         }
         sent += r;
     }
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+    audio_deadline_account(DEADLINE_CAUSE_NET, elapsed_us);
+    metrics_histogram_observe(METRIC_TCP_SEND_US, (uint32_t)elapsed_us);
     return true;
 }
 
-static void tcp_send_start(void) {
-    static const uint8_t msg[] = {'S', 'T', 'R', 'T'};
-    audio_send_packet(msg, sizeof(msg));
+// Reads the credits the server sent, without blocking.
+static void audio_poll_credit(void) {
+    while (audio_sock >= 0) {
+        int r = recv(audio_sock, audio_rx + audio_rx_len, sizeof(audio_rx) - audio_rx_len, MSG_DONTWAIT);
+        if (r <= 0) {
+            return; // nothing pending; a closed connection fails the next send
+        }
+        audio_rx_len += r;
+        size_t pos = 0;
+        audio_msg_t msg;
+        size_t used;
+        while ((used = audio_stream_parse(audio_rx + pos, audio_rx_len - pos, &msg)) > 0) {
+            if (msg.type == AUDIO_MSG_CRED) {
+                audio_flow_credit(msg.value);
+            }
+            pos += used;
+        }
+        memmove(audio_rx, audio_rx + pos, audio_rx_len - pos);
+        audio_rx_len -= pos;
+    }
+}
+
+// Sends as much of the backlog as the credit allows. False when the
+// connection failed or no credit came for AUDIO_CREDIT_STALL_MS; the
+// socket is closed then.
+static bool audio_flush_backlog(void) {
+    audio_poll_credit();
+    size_t len;
+    uint16_t payload;
+    const uint8_t *packet;
+    while ((packet = audio_flow_peek(&len, &payload)) && audio_flow_can_send(payload)) {
+        if (!audio_send_packet(packet, len)) {
+            return false;
+        }
+        audio_flow_sent(payload);
+        audio_flow_pop();
+        metrics_counter_inc(METRIC_AUDIO_PACKETS);
+        metrics_counter_add(METRIC_AUDIO_BYTES, payload);
+    }
+    if (audio_flow_stalled_us(esp_timer_get_time()) > (int64_t)AUDIO_CREDIT_STALL_MS * 1000) {
+        metrics_counter_inc(METRIC_TCP_CREDIT_TIMEOUTS);
+        ESP_LOGW(TAG, "No audio credit for %d ms", AUDIO_CREDIT_STALL_MS);
+        audio_credit_timeout = true;
+        audio_close_socket();
+        return false;
+    }
+    return true;
+}
+
+// STRT and the session's wake/start times go out in one segment.
+static void tcp_send_start(uint32_t session, int64_t wake_us) {
+    uint8_t msg[AUDIO_STREAM_TAG_LEN + 2 * AUDIO_STREAM_TIME_LEN];
+    uint8_t *end = audio_stream_put_tag(msg, "STRT");
+#if CONFIG_SMART_HOME_AUDIO_TIMESTAMPS
+    end = audio_stream_put_time(end, AUDIO_TIME_WAKE, session, wake_us);
+    end = audio_stream_put_time(end, AUDIO_TIME_START, session, esp_timer_get_time());
+#else
+    (void)session;
+    (void)wake_us;
+#endif
+    audio_send_packet(msg, end - msg);
+}
+
+static void tcp_send_stop(uint32_t next_seq) {
+    uint8_t msg[AUDIO_STREAM_TIME_LEN + AUDIO_STREAM_TAG_LEN];
+    uint8_t *end = msg;
+#if CONFIG_SMART_HOME_AUDIO_TIMESTAMPS
+    end = audio_stream_put_time(end, AUDIO_TIME_STOP, next_seq, esp_timer_get_time());
+#else
+    (void)next_seq;
+#endif
+    end = audio_stream_put_tag(end, "STOP");
+    audio_send_packet(msg, end - msg);
 }
 
-static void tcp_send_stop(void) {
-    static const uint8_t msg[] = {'S', 'T', 'O', 'P'};
+// Tells the server to discard the session: the command was handled locally.
+static void tcp_send_cancel(void) {
+    uint8_t msg[AUDIO_STREAM_TAG_LEN];
+    audio_stream_put_tag(msg, "CANC");
     audio_send_packet(msg, sizeof(msg));
 }
 
-static bool tcp_send_audio(const int16_t *pcm, uint16_t bytes, uint32_t seq, uint8_t *scratch, size_t scratch_size) {
-    if (bytes == 0 || !pcm) {
+// PCM is aggregated in place after the prefix (TIME + AUD0 header), so
+// sending needs no copy. capture_us is the DMA time of the first block.
+// Out of credit, the packet is copied to the backlog (or dropped) and the
+// call still succeeds: the session degrades instead of failing.
+static bool tcp_send_audio(uint8_t *packet, uint16_t bytes, uint32_t seq, int64_t capture_us) {
+    if (bytes == 0 || !packet) {
         return true;
     }
-    const size_t packet_size = (size_t)bytes + UDP_AUDIO_HEADER;
-    if (!scratch || scratch_size < packet_size) {
+#if CONFIG_SMART_HOME_AUDIO_TIMESTAMPS
+    audio_stream_put_time(packet, AUDIO_TIME_AUDIO, seq, capture_us);
+#else
+    (void)capture_us;
+#endif
+#if CONFIG_SMART_HOME_AUDIO_LOG_MEL
+    audio_stream_put_mel0(packet + AUDIO_PACKET_PREFIX - UDP_AUDIO_HEADER, seq, bytes);
+#else
+    audio_stream_put_aud0(packet + AUDIO_PACKET_PREFIX - UDP_AUDIO_HEADER, seq, bytes);
+#endif
+    size_t len = (size_t)bytes + AUDIO_PACKET_PREFIX;
+    if (!audio_flush_backlog()) {
+        return false;
+    }
+    if (audio_flow_backlog_bytes() > 0 || !audio_flow_can_send(bytes)) {
+        audio_flow_enqueue(packet, len, bytes);
+        return true;
+    }
+    if (!audio_send_packet(packet, len)) {
         return false;
     }
-    scratch[0] = 'A';
-    scratch[1] = 'U';
-    scratch[2] = 'D';
-    scratch[3] = '0';
-    scratch[4] = (uint8_t)(seq & 0xff);
-    scratch[5] = (uint8_t)((seq >> 8) & 0xff);
-    scratch[6] = (uint8_t)((seq >> 16) & 0xff);
-    scratch[7] = (uint8_t)((seq >> 24) & 0xff);
-    scratch[8] = (uint8_t)(bytes & 0xff);
-    scratch[9] = (uint8_t)((bytes >> 8) & 0xff);
-    memcpy(&scratch[10], pcm, bytes);
-    return audio_send_packet(scratch, packet_size);
+    audio_flow_sent(bytes);
+    metrics_counter_inc(METRIC_AUDIO_PACKETS);
+    metrics_counter_add(METRIC_AUDIO_BYTES, bytes);
+    return true;
 }
 
 static esp_err_t i2c_master_init(void) {
@@ -753,24 +933,44 @@ static void lcd_write_line(uint8_t row, const char *text) {
     }
 }
 
-static void lcd_lock(void) {
-    if (lcd_mutex) {
-        xSemaphoreTake(lcd_mutex, portMAX_DELAY);
-    }
-}
-
-static void lcd_unlock(void) {
-    if (lcd_mutex) {
-        xSemaphoreGive(lcd_mutex);
-    }
+// The latest requested screen. Callers only copy it in; display_task on
+// the network core does the I2C writes, so audio_task never waits on the
+// bus. Screens posted faster than the LCD takes them collapse to the last.
+typedef struct {
+    char lines[2][17];
+} lcd_screen_t;
+
+static lcd_screen_t lcd_pending;
+static portMUX_TYPE lcd_pending_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t display_task_handle = NULL;
+
+static void lcd_copy_line(char *dst, const char *text) {
+    size_t len = text ? strnlen(text, 16) : 0;
+    memcpy(dst, text, len);
+    dst[len] = '\0';
 }
 
 static void lcd_show_status(const char *line1, const char *line2) {
     if (!lcd_ready) return;
-    lcd_lock();
-    lcd_write_line(0, line1);
-    lcd_write_line(1, line2);
-    lcd_unlock();
+    int64_t start_us = esp_timer_get_time();
+    portENTER_CRITICAL(&lcd_pending_lock);
+    lcd_copy_line(lcd_pending.lines[0], line1);
+    lcd_copy_line(lcd_pending.lines[1], line2);
+    portEXIT_CRITICAL(&lcd_pending_lock);
+    xTaskNotifyGive(display_task_handle);
+    audio_deadline_account(DEADLINE_CAUSE_LCD, esp_timer_get_time() - start_us);
+}
+
+static void display_task(void *pvParameters) {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        lcd_screen_t screen;
+        portENTER_CRITICAL(&lcd_pending_lock);
+        screen = lcd_pending;
+        portEXIT_CRITICAL(&lcd_pending_lock);
+        lcd_write_line(0, screen.lines[0]);
+        lcd_write_line(1, screen.lines[1]);
+    }
 }
 
 static void lcd_show_idle(void) {
@@ -787,12 +987,6 @@ static void lcd_show_listening(int dots) {
 }
 
 static void lcd_init(void) {
-    lcd_mutex = xSemaphoreCreateMutex();
-    if (!lcd_mutex) {
-        ESP_LOGW(TAG, "LCD mutex alloc failed");
-        return;
-    }
-
     uint8_t addr = lcd_detect_addr();
     if (addr == 0) {
         ESP_LOGW(TAG, "LCD I2C device not found");
@@ -811,7 +1005,6 @@ static void lcd_init(void) {
         ESP_LOGW(TAG, "LCD device add failed: %d", (int)err);
         return;
     }
-    lcd_ready = true;
 
     vTaskDelay(pdMS_TO_TICKS(50));
     lcd_write4bits(0x30, false);
@@ -827,23 +1020,53 @@ static void lcd_init(void) {
     lcd_command(0x0C); // display on, cursor off
     lcd_command(0x06); // entry mode
     lcd_command(0x01); // clear
+    lcd_ready = task_plan_create(TASK_ID_DISPLAY, display_task, NULL, &display_task_handle);
+}
+
+// The control publish goes through the event bus so audio_task never
+// touches the MQTT client.
+static void local_action_execute(const char *action, uint32_t session, int latency_ms) {
+    if (!action) {
+        return;
+    }
+    if (LOCAL_LIGHT_GPIO >= 0) {
+        if (strcmp(action, "LIGHT_ON") == 0) {
+            gpio_set_level((gpio_num_t)LOCAL_LIGHT_GPIO, 1);
+        } else if (strcmp(action, "LIGHT_OFF") == 0) {
+            gpio_set_level((gpio_num_t)LOCAL_LIGHT_GPIO, 0);
+        }
+    }
+    event_bus_post(APP_EVENT_LOCAL_COMMAND, session, latency_ms, action);
 }
 
 static void esp_sr_init(void) {
-    srmodel_list_t *models = esp_srmodel_init("model");
+    srmodel_list_t *models = sr_models_init("model");
     if (!models) {
         ESP_LOGE(TAG, "ESP-SR models not found (flash srmodels.bin)");
         return;
     }
 
-    afe_config_t *afe_config = afe_config_init("M", models, AFE_TYPE_SR, AFE_MODE_LOW_COST);
+    afe_profile_t profile;
+    afe_profile_defaults(&profile);
+    if (afe_profile_load(&profile)) {
+        ESP_LOGI(TAG, "AFE profile overridden from NVS");
+    }
+#if CONFIG_SMART_HOME_AFE_BENCHMARK
+    afe_profile_benchmark(models, &profile, CONFIG_SMART_HOME_AFE_BENCHMARK_FRAMES);
+#endif
+
+    int64_t stage_us = esp_timer_get_time();
+    afe_config_t *afe_config = afe_config_init("M", models, AFE_TYPE_SR, profile.mode);
     if (!afe_config) {
         ESP_LOGE(TAG, "Failed to init AFE config");
         return;
     }
-    afe_config->vad_init = true;
-    afe_config->wakenet_init = true;
+    afe_profile_apply(&profile, afe_config);
+    sr_models_afe_select(afe_config, &profile);
+    afe_profile_log("AFE profile", &profile);
+    sr_models_stage_done(SR_STAGE_AFE_CONFIG, stage_us);
 
+    stage_us = esp_timer_get_time();
     afe_handle = (esp_afe_sr_iface_t *)esp_afe_handle_from_config(afe_config);
     if (!afe_handle) {
         ESP_LOGE(TAG, "Failed to create AFE handle");
@@ -854,57 +1077,25 @@ static void esp_sr_init(void) {
         ESP_LOGE(TAG, "Failed to create AFE data");
         return;
     }
+    sr_models_stage_done(SR_STAGE_AFE_CREATE, stage_us);
+    // MultiNet is only needed after a wake word; load it once WakeNet runs.
+    sr_models_defer(local_commands_init);
     ESP_LOGI(TAG, "ESP-SR initialized");
 }
 
-static void setup_i2s(void) {
-    i2s_chan_config_t chan_cfg = {};
-    chan_cfg.id = I2S_PORT;
-    chan_cfg.role = I2S_ROLE_MASTER;
-    chan_cfg.dma_desc_num = 16;
-    chan_cfg.dma_frame_num = 256;
-    chan_cfg.auto_clear = true;
-    chan_cfg.auto_clear_before_cb = false;
-    chan_cfg.allow_pd = false;
-    chan_cfg.intr_priority = 0;
-
-    ESP_ERROR_CHECK(i2s_new_channel(&chan_cfg, NULL, &rx_handle));
-
-    i2s_std_config_t std_cfg;
-    memset(&std_cfg, 0, sizeof(std_cfg));
-    std_cfg.clk_cfg.sample_rate_hz = SAMPLE_RATE;
-    std_cfg.clk_cfg.clk_src = I2S_CLK_SRC_DEFAULT;
-#if SOC_I2S_HW_VERSION_2
-    std_cfg.clk_cfg.ext_clk_freq_hz = 0;
-#endif
-    std_cfg.clk_cfg.mclk_multiple = I2S_MCLK_MULTIPLE_256;
-    std_cfg.clk_cfg.bclk_div = 8;
-
-    std_cfg.slot_cfg.data_bit_width = I2S_DATA_BIT_WIDTH_32BIT;
-    std_cfg.slot_cfg.slot_bit_width = I2S_SLOT_BIT_WIDTH_AUTO;
-    std_cfg.slot_cfg.slot_mode = I2S_SLOT_MODE_MONO;
-    std_cfg.slot_cfg.slot_mask = I2S_STD_SLOT_LEFT;
-    std_cfg.slot_cfg.ws_width = I2S_DATA_BIT_WIDTH_32BIT;
-    std_cfg.slot_cfg.ws_pol = false;
-    std_cfg.slot_cfg.bit_shift = true;
-#if SOC_I2S_HW_VERSION_1
-    std_cfg.slot_cfg.msb_right = false;
-#else
-    std_cfg.slot_cfg.left_align = true;
-    std_cfg.slot_cfg.big_endian = false;
-    std_cfg.slot_cfg.bit_order_lsb = false;
-#endif
-    std_cfg.gpio_cfg.mclk = I2S_GPIO_UNUSED;
-    std_cfg.gpio_cfg.bclk = I2S_SCK;
-    std_cfg.gpio_cfg.ws = I2S_WS;
-    std_cfg.gpio_cfg.dout = I2S_GPIO_UNUSED;
-    std_cfg.gpio_cfg.din = I2S_SD;
-    std_cfg.gpio_cfg.invert_flags.mclk_inv = false;
-    std_cfg.gpio_cfg.invert_flags.bclk_inv = false;
-    std_cfg.gpio_cfg.invert_flags.ws_inv = false;
-
-    ESP_ERROR_CHECK(i2s_channel_init_std_mode(rx_handle, &std_cfg));
-    ESP_ERROR_CHECK(i2s_channel_enable(rx_handle));
+// Sizes every audio buffer once the AFE chunk size is known. I2S data is
+// read in place from the driver's DMA blocks; the per-frame buffers stay
+// in internal RAM.
+static bool audio_memory_init(int feed_chunk) {
+    size_t feed_bytes = mem_arena_round(feed_chunk * sizeof(int16_t));
+    // Sized for the largest aggregation the agg_frames parameter allows.
+    size_t packet_bytes =
+        mem_arena_round(feed_chunk * params_max_int(PARAM_AGG_FRAMES) * sizeof(int16_t) + AUDIO_PACKET_PREFIX);
+    if (!mem_arena_reserve(MEM_REGION_FAST, feed_bytes + packet_bytes)) {
+        return false;
+    }
+    mem_arena_log();
+    return true;
 }
 
 static void audio_task(void *pvParameters) {
@@ -913,18 +1104,41 @@ static void audio_task(void *pvParameters) {
     }
 
     int feed_chunk = afe_handle->get_feed_chunksize(afe_data);
-    int32_t *i2s_buf = (int32_t *)malloc(feed_chunk * sizeof(int32_t));
-    int16_t *feed_buf = (int16_t *)malloc(feed_chunk * sizeof(int16_t));
-    int agg_capacity_samples = feed_chunk * UDP_AGG_FRAMES;
-    int16_t *agg_buf = (int16_t *)malloc(agg_capacity_samples * sizeof(int16_t));
-    uint8_t *udp_buf = (uint8_t *)malloc(agg_capacity_samples * sizeof(int16_t) + UDP_AUDIO_HEADER);
-    if (!i2s_buf || !feed_buf || !agg_buf || !udp_buf) {
+    int16_t *feed_buf = (int16_t *)mem_arena_alloc(MEM_REGION_FAST, feed_chunk * sizeof(int16_t));
+    params_snapshot_t audio_params = {};
+    params_refresh(&audio_params);
+    int agg_capacity_samples = feed_chunk * params_int(&audio_params, PARAM_AGG_FRAMES);
+    // The packet buffer is sized for this; used while the server is behind.
+    const int agg_max_samples = feed_chunk * params_max_int(PARAM_AGG_FRAMES);
+    // One packet: each is sent or copied to the backlog before the next.
+    uint8_t *packet =
+        (uint8_t *)mem_arena_alloc(MEM_REGION_FAST, agg_max_samples * sizeof(int16_t) + AUDIO_PACKET_PREFIX);
+    if (!feed_buf || !packet) {
         ESP_LOGE(TAG, "Audio buffer alloc failed");
         vTaskDelete(NULL);
         return;
     }
+    int16_t *agg_buf = (int16_t *)(packet + AUDIO_PACKET_PREFIX);
 
-    uint32_t log_tick = 0;
+    audio_frame_ops_t frame_ops;
+    if (audio_frame_select(&frame_ops, AUDIO_INPUT_S24_IN_32, feed_chunk,
+                           params_int(&audio_params, PARAM_AUDIO_GAIN_SHIFT))) {
+        ESP_LOGI(TAG, "Frame kernels specialised for %d-sample chunks", feed_chunk);
+    } else {
+        ESP_LOGW(TAG, "No frame kernels for %d-sample chunks, using the generic loops", feed_chunk);
+    }
+
+    audio_agc_init(&audio_agc, 256 << params_int(&audio_params, PARAM_AUDIO_GAIN_SHIFT));
+#if CONFIG_SMART_HOME_AUDIO_LOG_MEL
+    if (!log_mel_init()) {
+        ESP_LOGE(TAG, "log-mel init failed");
+        vTaskDelete(NULL);
+        return;
+    }
+#endif
+
+    uint32_t agc_limited_seen = 0;
+    uint32_t agc_clip_seen = 0;
     uint32_t timeout_tick = 0;
     static bool showing_wake = false;
     static TickType_t wake_tick = 0;
@@ -935,51 +1149,92 @@ static void audio_task(void *pvParameters) {
     static TickType_t pending_idle_tick = 0;
     static int listening_dots = 0;
     static uint32_t audio_seq = 0;
+    static int64_t session_wake_us = 0;
+    static uint32_t audio_session = 0;
+    static bool draining = false; // recording over, backlog still going out before STOP
     int agg_samples = 0;
+    int64_t agg_capture_us = 0;
     int frame_ms = (feed_chunk * 1000) / SAMPLE_RATE;
     if (frame_ms <= 0) frame_ms = 30;
     int silence_frames = 0;
+    audio_deadline_init((uint32_t)(((int64_t)feed_chunk * 1000000) / SAMPLE_RATE));
 
     while (true) {
-        size_t bytes_read = 0;
-        esp_err_t r = i2s_channel_read(rx_handle, i2s_buf, feed_chunk * sizeof(int32_t),
-                                       &bytes_read, pdMS_TO_TICKS(100));
-        if (r != ESP_OK && r != ESP_ERR_TIMEOUT) {
-            ESP_LOGW(TAG, "I2S read error: %d bytes=%d", (int)r, (int)bytes_read);
-            vTaskDelay(pdMS_TO_TICKS(10));
-            continue;
+        // Closes the previous chunk; every path through the loop ends here.
+        audio_deadline_end();
+        // Frame boundary. Parameter updates are picked up only between
+        // sessions, so a recording runs start to end on one set.
+        if (!recording && params_refresh(&audio_params)) {
+            agg_capacity_samples = feed_chunk * params_int(&audio_params, PARAM_AGG_FRAMES);
+            audio_frame_select(&frame_ops, AUDIO_INPUT_S24_IN_32, feed_chunk,
+                               params_int(&audio_params, PARAM_AUDIO_GAIN_SHIFT));
         }
-        if (r == ESP_ERR_TIMEOUT && (timeout_tick++ % 50) == 0) {
-            ESP_LOGW(TAG, "I2S read timeout (bytes=%d)", (int)bytes_read);
-        }
-        if (bytes_read == 0) {
-            vTaskDelay(pdMS_TO_TICKS(10));
+        // Sleeps until the DMA ISR completes a block; the timeout only
+        // catches a stalled clock.
+        i2s_block_t block;
+        if (!i2s_capture_acquire(&block, pdMS_TO_TICKS(I2S_STALL_MS))) {
+            audio_deadline_dropped(DEADLINE_CAUSE_I2S);
+            metrics_counter_inc(METRIC_I2S_STALLS);
+            if ((timeout_tick++ % 50) == 0) {
+                ESP_LOGW(TAG, "I2S capture stalled");
+            }
             continue;
         }
+        audio_deadline_begin(block.timestamp_us);
 
-        int samples = bytes_read / (int)sizeof(int32_t);
-        for (int i = 0; i < samples; i++) {
-            int32_t v = i2s_buf[i] >> 8; // 24-bit in 32-bit
-            int32_t s = v >> 8;          // 24-bit -> 16-bit
-            s <<= AUDIO_GAIN_SHIFT;
-            if (s > 32767) s = 32767;
-            if (s < -32768) s = -32768;
-            feed_buf[i] = (int16_t)s;
-        }
+        int samples = block.count < feed_chunk ? block.count : feed_chunk;
+        const int32_t *i2s_buf = block.samples;
+#if CONFIG_SMART_HOME_AUDIO_AGC
+        audio_agc_process(&audio_agc, &frame_ops, i2s_buf, feed_buf, samples);
+#else
+        frame_ops.convert(i2s_buf, feed_buf, samples, params_int(&audio_params, PARAM_AUDIO_GAIN_SHIFT));
+#endif
+        // The DMA block is no longer needed once converted.
+        i2s_capture_release(&block);
         if (samples < feed_chunk) {
             memset(&feed_buf[samples], 0, (feed_chunk - samples) * sizeof(int16_t));
         }
 
+        int64_t afe_start_us = esp_timer_get_time();
         afe_handle->feed(afe_data, feed_buf);
         afe_fetch_result_t *res = afe_handle->fetch(afe_data);
+        audio_deadline_account(DEADLINE_CAUSE_AFE, esp_timer_get_time() - afe_start_us);
+        sr_models_wake_ready();
         TickType_t now = xTaskGetTickCount();
+        if (draining) {
+            if (!audio_flush_backlog()) {
+                draining = false;
+                event_bus_post(APP_EVENT_NET_ERROR, audio_session, (int32_t)audio_seq,
+                               audio_credit_timeout ? "credit" : "send");
+                power_profile_session_end();
+            } else if (audio_flow_backlog_bytes() == 0) {
+                draining = false;
+                tcp_send_stop(audio_seq);
+                audio_close_socket();
+                power_profile_session_end();
+            }
+        }
         if (res && res->wakeup_state == WAKENET_DETECTED) {
             ESP_LOGI(TAG, "Wake word detected!");
             lcd_show_status("WAKE WORD,", "DETECTED");
             showing_wake = true;
             wake_tick = now;
             if (!recording) {
+                if (draining) {
+                    // The new session needs the connection: the previous
+                    // one ends without the rest of its backlog.
+                    ESP_LOGW(TAG, "Dropping %u backlogged audio bytes", (unsigned)audio_flow_backlog_bytes());
+                    draining = false;
+                    audio_close_socket();
+                    power_profile_session_end();
+                }
+                session_wake_us = esp_timer_get_time();
+                event_bus_post(APP_EVENT_WAKE, ++audio_session, 0, NULL);
+                // Radio and CPU at full power before the connect.
+                power_profile_session_begin();
                 if (!audio_connect()) {
+                    event_bus_post(APP_EVENT_NET_ERROR, audio_session, 0, "connect");
+                    power_profile_session_end();
                     lcd_show_status("NET ERROR", "TCP CONNECT");
                     pending_idle = true;
                     pending_idle_tick = now;
@@ -990,9 +1245,19 @@ static void audio_task(void *pvParameters) {
                 record_start_tick = now;
                 silence_frames = 0;
                 pending_idle = false;
-                tcp_send_start();
+                audio_seq = 0;
+                audio_credit_timeout = false;
+                agg_capacity_samples = feed_chunk * params_int(&audio_params, PARAM_AGG_FRAMES);
+#if CONFIG_SMART_HOME_AUDIO_LOG_MEL
+                log_mel_reset();
+#endif
+                tcp_send_start(audio_session, session_wake_us);
+                metrics_counter_inc(METRIC_AUDIO_SESSIONS);
+                int32_t wake_to_stream_ms = (int32_t)((esp_timer_get_time() - session_wake_us) / 1000);
+                event_bus_post(APP_EVENT_RECORD_START, audio_session, wake_to_stream_ms, NULL);
+                power_profile_note_wake_to_stream((uint32_t)wake_to_stream_ms);
                 gpio_set_level(LED_PIN, 1);
-            } else {
+                local_commands_begin(session_wake_us);
             }
         }
 
@@ -1006,20 +1271,8 @@ static void audio_task(void *pvParameters) {
             const int16_t *energy_src = res->data ? res->data : feed_buf;
             int energy_samples = res->data ? (res->data_size / (int)sizeof(int16_t)) : feed_chunk;
             if (energy_samples > 0) {
-                int64_t acc = 0;
-                int step = 4;
-                int count = energy_samples / step;
-                if (count <= 0) {
-                    step = 1;
-                    count = energy_samples;
-                }
-                for (int i = 0; i < energy_samples; i += step) {
-                    int32_t s = energy_src[i];
-                    if (s < 0) s = -s;
-                    acc += s;
-                }
-                int avg = (int)(acc / count);
-                energy_speech = avg > ENERGY_THRESHOLD;
+                int32_t avg = frame_ops.energy(energy_src, energy_samples);
+                energy_speech = avg > params_int(&audio_params, PARAM_ENERGY_THRESHOLD);
             }
             if (res->vad_state == VAD_SPEECH || energy_speech) {
                 silence_frames = 0;
@@ -1028,18 +1281,46 @@ static void audio_task(void *pvParameters) {
             }
         }
 
+        if (recording && res && res->data &&
+            local_commands_feed(res->data, res->data_size / (int)sizeof(int16_t)) == LOCAL_CMD_MATCHED) {
+            local_action_execute(local_commands_action(), audio_session, local_commands_latency_ms());
+            local_commands_cancel();
+            recording = false;
+            agg_samples = 0;
+            tcp_send_cancel();
+            audio_close_socket();
+            event_bus_post(APP_EVENT_RECORD_STOP, audio_session,
+                           (int32_t)((esp_timer_get_time() - session_wake_us) / 1000), "local");
+            power_profile_session_end();
+            gpio_set_level(LED_PIN, 0);
+            lcd_show_status("DONE", local_commands_action());
+            pending_idle = true;
+            pending_idle_tick = now;
+        }
+
         if (recording) {
             int silence_ms = silence_frames * frame_ms;
-            if (silence_ms > SILENCE_TIMEOUT_MS ||
-                (now - record_start_tick) > pdMS_TO_TICKS(MAX_RECORD_MS)) {
+            int silence_timeout_ms = params_int(&audio_params, PARAM_SILENCE_TIMEOUT_MS);
+            if (silence_ms > silence_timeout_ms ||
+                (now - record_start_tick) > pdMS_TO_TICKS(params_int(&audio_params, PARAM_MAX_RECORD_MS))) {
+                const char *reason = silence_ms > silence_timeout_ms ? "silence" : "max_length";
                 recording = false;
                 if (agg_samples > 0) {
-                    tcp_send_audio(agg_buf, (uint16_t)(agg_samples * sizeof(int16_t)),
-                                   audio_seq++, udp_buf, agg_capacity_samples * sizeof(int16_t) + UDP_AUDIO_HEADER);
+                    tcp_send_audio(packet, (uint16_t)(agg_samples * sizeof(int16_t)), audio_seq++, agg_capture_us);
                     agg_samples = 0;
                 }
-                tcp_send_stop();
-                audio_close_socket();
+                // With a backlog, STOP goes out once it has drained.
+                if (audio_flow_backlog_bytes() > 0 && audio_sock >= 0) {
+                    draining = true;
+                } else {
+                    tcp_send_stop(audio_seq);
+                    audio_close_socket();
+                    power_profile_session_end();
+                }
+                local_commands_cancel();
+                local_commands_note_streamed(session_wake_us, esp_timer_get_time());
+                event_bus_post(APP_EVENT_RECORD_STOP, audio_session,
+                               (int32_t)((esp_timer_get_time() - session_wake_us) / 1000), reason);
                 gpio_set_level(LED_PIN, 0);
                 lcd_show_status("JASON", "PROCESSING...");
                 pending_idle = true;
@@ -1060,9 +1341,14 @@ static void audio_task(void *pvParameters) {
             }
         }
 
-        if ((log_tick++ % 50) == 0) {
-            ESP_LOGI(TAG, "Streaming audio chunks (samples=%d)", feed_chunk);
-        }
+        // The AGC keeps running totals; the counters take the increments.
+        metrics_counter_inc(METRIC_AUDIO_CHUNKS);
+        metrics_counter_add(METRIC_AUDIO_AGC_LIMITED, audio_agc.limited_frames - agc_limited_seen);
+        metrics_counter_add(METRIC_AUDIO_CLIP_SAMPLES, audio_agc.clip_samples - agc_clip_seen);
+        agc_limited_seen = audio_agc.limited_frames;
+        agc_clip_seen = audio_agc.clip_samples;
+        metrics_gauge_set(METRIC_AUDIO_AGC_GAIN_Q8, audio_agc.gain_q8);
+        metrics_gauge_set(METRIC_AUDIO_PEAK, audio_agc.last_peak);
 
         if (recording && audio_sock >= 0 && res) {
             const int16_t *payload = feed_buf;
@@ -1072,40 +1358,89 @@ static void audio_task(void *pvParameters) {
                 payload_bytes = res->data_size;
             }
             int payload_samples = payload_bytes / (int)sizeof(int16_t);
+            // Backlogged packets go out as credits arrive, not only with the
+            // next packet. While the server is behind, larger packets.
+            bool send_failed = audio_flow_backlog_bytes() > 0 && !audio_flush_backlog();
+            if (audio_flow_backlog_bytes() > 0 && agg_capacity_samples < agg_max_samples) {
+                agg_capacity_samples = agg_max_samples;
+                ESP_LOGW(TAG, "Audio server behind, aggregating %d frames", params_max_int(PARAM_AGG_FRAMES));
+            }
+#if CONFIG_SMART_HOME_AUDIO_LOG_MEL
+            // agg_buf holds whole mel frames; the packet goes out once the
+            // next chunk's frames might not fit.
+            if (agg_samples == 0) {
+                agg_capture_us = block.timestamp_us;
+            }
+            int64_t mel_start_us = esp_timer_get_time();
+            agg_samples += log_mel_push(payload, payload_samples, &agg_buf[agg_samples]) * LOG_MEL_BINS;
+            audio_deadline_account(DEADLINE_CAUSE_MEL, esp_timer_get_time() - mel_start_us);
+            if (!send_failed &&
+                agg_samples + log_mel_max_frames(payload_samples) * LOG_MEL_BINS > agg_capacity_samples) {
+                send_failed = !tcp_send_audio(packet, (uint16_t)(agg_samples * sizeof(int16_t)), audio_seq++,
+                                              agg_capture_us);
+                agg_samples = 0;
+            }
+#else
             int copied = 0;
-            while (copied < payload_samples) {
+            while (!send_failed && copied < payload_samples) {
                 int space = agg_capacity_samples - agg_samples;
                 int to_copy = payload_samples - copied;
                 if (to_copy > space) {
                     to_copy = space;
                 }
+                if (agg_samples == 0) {
+                    agg_capture_us = block.timestamp_us;
+                }
                 memcpy(&agg_buf[agg_samples], &payload[copied], to_copy * sizeof(int16_t));
                 agg_samples += to_copy;
                 copied += to_copy;
                 if (agg_samples == agg_capacity_samples) {
-                    if (!tcp_send_audio(agg_buf, (uint16_t)(agg_samples * sizeof(int16_t)),
-                                        audio_seq++, udp_buf, agg_capacity_samples * sizeof(int16_t) + UDP_AUDIO_HEADER)) {
-                        recording = false;
-                        audio_close_socket();
-                        gpio_set_level(LED_PIN, 0);
-                        lcd_show_status("NET ERROR", "TCP SEND");
-                        pending_idle = true;
-                        pending_idle_tick = now;
-                        agg_samples = 0;
+                    send_failed = !tcp_send_audio(packet, (uint16_t)(agg_samples * sizeof(int16_t)), audio_seq++,
+                                                  agg_capture_us);
+                    agg_samples = 0;
+                    if (send_failed) {
                         break;
                     }
-                    agg_samples = 0;
                 }
             }
+#endif
+            if (send_failed) {
+                recording = false;
+                audio_close_socket();
+                local_commands_cancel();
+                event_bus_post(APP_EVENT_NET_ERROR, audio_session, (int32_t)audio_seq,
+                               audio_credit_timeout ? "credit" : "send");
+                power_profile_session_end();
+                gpio_set_level(LED_PIN, 0);
+                lcd_show_status("NET ERROR", audio_credit_timeout ? "NO CREDIT" : "TCP SEND");
+                pending_idle = true;
+                pending_idle_tick = now;
+            }
         }
     }
 }
 
 extern "C" void app_main(void) {
     nvs_flash_init();
+    task_plan_init();
+    params_init();
+    // Sensor history and the audio backlog are large and touched rarely:
+    // PSRAM, in one reservation.
+    bool psram = mem_arena_reserve(MEM_REGION_SPIRAM, sensor_agg_memory_bytes() + audio_flow_memory_bytes());
+    if (!psram || !sensor_agg_init()) {
+        ESP_LOGW(TAG, "Sensor aggregates disabled");
+    }
+    if (!psram || !audio_flow_init()) {
+        ESP_LOGW(TAG, "No audio backlog: audio beyond the server's credit is dropped");
+    }
     gpio_reset_pin(LED_PIN);
     gpio_set_direction(LED_PIN, GPIO_MODE_OUTPUT);
     gpio_set_level(LED_PIN, 0);
+    if (LOCAL_LIGHT_GPIO >= 0) {
+        gpio_reset_pin((gpio_num_t)LOCAL_LIGHT_GPIO);
+        gpio_set_direction((gpio_num_t)LOCAL_LIGHT_GPIO, GPIO_MODE_OUTPUT);
+        gpio_set_level((gpio_num_t)LOCAL_LIGHT_GPIO, 0);
+    }
     if (i2c_master_init() == ESP_OK) {
         lcd_init();
         lcd_show_status("SMART HOME", "BOOTING...");
@@ -1113,17 +1448,42 @@ extern "C" void app_main(void) {
         ESP_LOGW(TAG, "I2C init failed");
     }
 
-    if (!wifi_init_sta()) {
+    if (!wifi_manager_start(WIFI_SSID, WIFI_PASS)) {
         ESP_LOGE(TAG, "WiFi init failed. Aborting.");
         lcd_show_status("WIFI", "FAILED");
         return;
     }
-    mqtt_init();
-    audio_init();
-    setup_i2s();
+    power_profile_init();
+    // Model loading overlaps with association and DHCP, and wake word
+    // detection starts before the network is up.
     esp_sr_init();
+    audio_init();
+    if (afe_handle && afe_data) {
+        int feed_chunk = afe_handle->get_feed_chunksize(afe_data);
+        if (!audio_memory_init(feed_chunk)) {
+            ESP_LOGE(TAG, "Audio memory reservation failed");
+        }
+        // One DMA block per AFE chunk so blocks feed the AFE directly.
+        if (!i2s_capture_init(I2S_SCK, I2S_WS, I2S_SD, SAMPLE_RATE, feed_chunk)) {
+            ESP_LOGE(TAG, "I2S capture init failed");
+        }
+    }
     ESP_LOGI(TAG, "INMP411 analysis ready");
+    task_plan_create(TASK_ID_AUDIO, audio_task, NULL, NULL);
+
+    if (!wifi_manager_wait(pdMS_TO_TICKS(CONFIG_SMART_HOME_WIFI_READY_TIMEOUT_MS))) {
+        ESP_LOGW(TAG, "No IP yet, continuing; MQTT and audio will connect once WiFi is up");
+        lcd_show_status("WIFI", "CONNECTING...");
+    }
+    mqtt_init();
+    params_mqtt_start(mqtt_client, MQTT_TOPIC_PARAMS);
+    ota_update_mqtt_start(mqtt_client, MQTT_TOPIC_OTA);
+#if CONFIG_SMART_HOME_METRICS_HTTP
+    metrics_http_start(CONFIG_SMART_HOME_METRICS_PORT);
+#endif
     lcd_show_idle();
-    xTaskCreate(audio_task, "audio_task", 8192, NULL, 5, NULL);
-    xTaskCreate(sensor_task, "sensor_task", 4096, NULL, 4, NULL);
+    event_bus_start(mqtt_client, MQTT_TOPIC_WAKE, MQTT_TOPIC_CONTROL);
+    task_plan_create(TASK_ID_SENSOR, sensor_task, NULL, NULL);
+    task_monitor_start(mqtt_client, MQTT_TOPIC_STATUS);
+    app_console_start();
 }
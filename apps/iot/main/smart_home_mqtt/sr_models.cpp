@@ -0,0 +1,257 @@
+#include "sr_models.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "nvs.h"
+
+#include "metrics.h"
+#include "task_plan.h"
+
+static const char *TAG = "sr_models";
+
+static const char *SR_NVS_NS = "srmodels";
+static const char *SR_NVS_KEY_INDEX = "index";
+
+// srmodels.bin index, as written by ESP-SR's movemodel.py (see
+// check_models.py): u32 model count, then per model a 32-byte name, u32
+// file count and per file a 32-byte name, u32 offset and u32 size.
+static const int SR_NAME_LEN = 32;
+static const int SR_MODELS_MAX = 8;
+static const int SR_FILES_MAX = 16;
+static const size_t SR_INDEX_MAP_BYTES = 0x10000; // one MMU page
+static const int SR_DEFER_MAX = 2;
+
+static const char *STAGE_NAMES[SR_STAGE_COUNT] = {
+    "partition_map", "index_check", "model_parse", "afe_config", "afe_create", "deferred",
+};
+
+typedef struct {
+    uint32_t address;
+    uint32_t size;
+    uint32_t index_len;
+    uint32_t index_crc;
+    uint32_t model_count;
+    char names[SR_MODELS_MAX][SR_NAME_LEN];
+} sr_index_cache_t;
+
+static sr_index_cache_t index_info;
+static bool index_cached = false;
+static srmodel_list_t *model_list = NULL;
+
+static std::atomic<int32_t> stage_us[SR_STAGE_COUNT];
+static std::atomic<int32_t> wake_ready_ms{-1};
+static char skipped[2][SR_NAME_LEN];
+static int skipped_count = 0;
+static sr_models_loader_t deferred[SR_DEFER_MAX];
+static int deferred_count = 0;
+
+static uint32_t read_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool name_valid(const uint8_t *p) {
+    if (p[0] == '\0') {
+        return false;
+    }
+    return memchr(p, '\0', SR_NAME_LEN) != NULL;
+}
+
+// Returns the index length, or 0 when it does not fit the mapped bytes or
+// points outside the partition. Fills the model names into info.
+static uint32_t index_walk(const uint8_t *base, size_t mapped, uint32_t part_size, sr_index_cache_t *info) {
+    if (mapped < 4) {
+        return 0;
+    }
+    uint32_t count = read_u32(base);
+    if (count == 0 || count > (uint32_t)SR_MODELS_MAX) {
+        ESP_LOGE(TAG, "Model count %lu out of range", (unsigned long)count);
+        return 0;
+    }
+    size_t off = 4;
+    for (uint32_t m = 0; m < count; m++) {
+        if (off + SR_NAME_LEN + 4 > mapped || !name_valid(base + off)) {
+            return 0;
+        }
+        memcpy(info->names[m], base + off, SR_NAME_LEN);
+        uint32_t files = read_u32(base + off + SR_NAME_LEN);
+        off += SR_NAME_LEN + 4;
+        if (files == 0 || files > (uint32_t)SR_FILES_MAX || off + files * (SR_NAME_LEN + 8) > mapped) {
+            ESP_LOGE(TAG, "Model %s: bad file table", info->names[m]);
+            return 0;
+        }
+        for (uint32_t f = 0; f < files; f++, off += SR_NAME_LEN + 8) {
+            uint32_t start = read_u32(base + off + SR_NAME_LEN);
+            uint32_t size = read_u32(base + off + SR_NAME_LEN + 4);
+            if (!name_valid(base + off) || start > part_size || size > part_size - start) {
+                ESP_LOGE(TAG, "Model %s: file %lu outside the partition", info->names[m], (unsigned long)f);
+                return 0;
+            }
+        }
+    }
+    info->model_count = count;
+    return (uint32_t)off;
+}
+
+static bool index_cache_load(sr_index_cache_t *out) {
+    nvs_handle_t handle;
+    if (nvs_open(SR_NVS_NS, NVS_READONLY, &handle) != ESP_OK) {
+        return false;
+    }
+    size_t len = sizeof(*out);
+    esp_err_t err = nvs_get_blob(handle, SR_NVS_KEY_INDEX, out, &len);
+    nvs_close(handle);
+    return err == ESP_OK && len == sizeof(*out);
+}
+
+static void index_cache_store(const sr_index_cache_t *info) {
+    nvs_handle_t handle;
+    if (nvs_open(SR_NVS_NS, NVS_READWRITE, &handle) != ESP_OK) {
+        return;
+    }
+    if (nvs_set_blob(handle, SR_NVS_KEY_INDEX, info, sizeof(*info)) == ESP_OK) {
+        nvs_commit(handle);
+    }
+    nvs_close(handle);
+}
+
+void sr_models_stage_done(sr_stage_t stage, int64_t start_us) {
+    if (stage >= SR_STAGE_COUNT) {
+        return;
+    }
+    int32_t us = (int32_t)(esp_timer_get_time() - start_us);
+    stage_us[stage].store(us, std::memory_order_relaxed);
+    metrics_gauge_set((metric_gauge_t)(METRIC_SR_PARTITION_MAP_US + stage), us);
+    ESP_LOGI(TAG, "%s: %ld us", STAGE_NAMES[stage], (long)us);
+}
+
+srmodel_list_t *sr_models_init(const char *partition_label) {
+    int64_t start_us = esp_timer_get_time();
+    const esp_partition_t *part =
+        esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, partition_label);
+    if (!part) {
+        ESP_LOGE(TAG, "No '%s' partition", partition_label);
+        return NULL;
+    }
+    size_t map_bytes = part->size < SR_INDEX_MAP_BYTES ? part->size : SR_INDEX_MAP_BYTES;
+    const void *map = NULL;
+    esp_partition_mmap_handle_t map_handle;
+    if (esp_partition_mmap(part, 0, map_bytes, ESP_PARTITION_MMAP_DATA, &map, &map_handle) != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot map the '%s' index", partition_label);
+        return NULL;
+    }
+    sr_models_stage_done(SR_STAGE_PARTITION_MAP, start_us);
+
+    // The cache is keyed on the index bytes, so the CRC runs over the
+    // length the cache recorded; a changed image changes the CRC.
+    start_us = esp_timer_get_time();
+    const uint8_t *base = (const uint8_t *)map;
+    sr_index_cache_t cache;
+    index_cached = index_cache_load(&cache) && cache.address == part->address && cache.size == part->size &&
+                   cache.index_len <= map_bytes &&
+                   esp_rom_crc32_le(0, base, cache.index_len) == cache.index_crc;
+    if (index_cached) {
+        index_info = cache;
+    } else {
+        memset(&index_info, 0, sizeof(index_info));
+        uint32_t len = index_walk(base, map_bytes, part->size, &index_info);
+        if (len == 0) {
+            esp_partition_munmap(map_handle);
+            ESP_LOGE(TAG, "Invalid model index in '%s' (flash srmodels.bin)", partition_label);
+            return NULL;
+        }
+        index_info.address = part->address;
+        index_info.size = part->size;
+        index_info.index_len = len;
+        index_info.index_crc = esp_rom_crc32_le(0, base, len);
+        index_cache_store(&index_info);
+    }
+    esp_partition_munmap(map_handle);
+    sr_models_stage_done(SR_STAGE_INDEX_CHECK, start_us);
+    ESP_LOGI(TAG, "%lu models, index %s", (unsigned long)index_info.model_count,
+             index_cached ? "cached" : "checked");
+
+    start_us = esp_timer_get_time();
+    model_list = esp_srmodel_init(partition_label);
+    sr_models_stage_done(SR_STAGE_MODEL_PARSE, start_us);
+    return model_list;
+}
+
+void sr_models_afe_select(afe_config_t *config, const afe_profile_t *profile) {
+    if (!config || !profile) {
+        return;
+    }
+    skipped_count = 0;
+    if (!profile->vad_init && config->vad_model_name) {
+        snprintf(skipped[skipped_count++], SR_NAME_LEN, "%s", config->vad_model_name);
+        config->vad_model_name = NULL;
+    }
+    if (!profile->ns_init && config->ns_model_name) {
+        snprintf(skipped[skipped_count++], SR_NAME_LEN, "%s", config->ns_model_name);
+        config->ns_model_name = NULL;
+    }
+    for (int i = 0; i < skipped_count; i++) {
+        ESP_LOGI(TAG, "Not loading %s (disabled in the AFE profile)", skipped[i]);
+    }
+}
+
+void sr_models_defer(sr_models_loader_t loader) {
+    if (!loader || deferred_count >= SR_DEFER_MAX) {
+        return;
+    }
+    deferred[deferred_count++] = loader;
+}
+
+static void sr_loader_task(void *arg) {
+    int64_t start_us = esp_timer_get_time();
+    for (int i = 0; i < deferred_count; i++) {
+        deferred[i](model_list);
+    }
+    sr_models_stage_done(SR_STAGE_DEFERRED, start_us);
+    vTaskDelete(NULL);
+}
+
+void sr_models_wake_ready(void) {
+    if (wake_ready_ms.load(std::memory_order_relaxed) >= 0) {
+        return;
+    }
+    int32_t ms = (int32_t)(esp_timer_get_time() / 1000);
+    wake_ready_ms.store(ms, std::memory_order_relaxed);
+    metrics_gauge_set(METRIC_SR_WAKE_READY_MS, ms);
+    ESP_LOGI(TAG, "Wake word ready %ld ms after boot", (long)ms);
+    if (deferred_count > 0 && model_list) {
+        task_plan_create(TASK_ID_SR_LOADER, sr_loader_task, NULL, NULL);
+    }
+}
+
+int sr_models_format_json(char *buf, size_t len) {
+    int n = snprintf(buf, len, "{\"wake_ready_ms\":%ld,\"index_cached\":%s,\"stages_us\":{",
+                     (long)wake_ready_ms.load(std::memory_order_relaxed), index_cached ? "true" : "false");
+    for (int i = 0; i < SR_STAGE_COUNT && n < (int)len; i++) {
+        n += snprintf(buf + n, len - n, "%s\"%s\":%ld", i ? "," : "", STAGE_NAMES[i],
+                      (long)stage_us[i].load(std::memory_order_relaxed));
+    }
+    if (n < (int)len) {
+        n += snprintf(buf + n, len - n, "},\"models\":[");
+    }
+    for (uint32_t i = 0; i < index_info.model_count && n < (int)len; i++) {
+        n += snprintf(buf + n, len - n, "%s\"%s\"", i ? "," : "", index_info.names[i]);
+    }
+    if (n < (int)len) {
+        n += snprintf(buf + n, len - n, "],\"skipped\":[");
+    }
+    for (int i = 0; i < skipped_count && n < (int)len; i++) {
+        n += snprintf(buf + n, len - n, "%s\"%s\"", i ? "," : "", skipped[i]);
+    }
+    if (n < (int)len) {
+        n += snprintf(buf + n, len - n, "]}");
+    }
+    return n;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "afe_profile.h"
+
+// ESP-SR model startup, timed stage by stage. Durations are logged,
+// exported as gauges (metrics.h) and included in the status JSON, together
+// with time-to-wake-ready: boot to the first AFE fetch in audio_task.
+//
+// Before ESP-SR touches the partition, only the srmodels.bin index (model
+// and file names, offsets, sizes) is mapped and checked against the
+// partition bounds, so a missing or truncated image fails with a clear log
+// instead of inside esp_srmodel_init. The checked index is cached in NVS
+// ("srmodels") keyed by partition address, size and the index CRC; a
+// matching boot skips the walk. ESP-SR maps the partition itself and
+// reads model data in place.
+//
+// Models are loaded only for what the AFE profile runs: the names of
+// disabled stages (VADNet with vad off, NSNet with ns off) are cleared from
+// the AFE config. Loads that are not needed to detect the wake word
+// (MultiNet for local commands) are deferred with sr_models_defer() and run
+// on a background task once the wake word detector is live.
+typedef enum {
+    SR_STAGE_PARTITION_MAP = 0, // find the partition, map the index
+    SR_STAGE_INDEX_CHECK,       // validate the index or match the cache
+    SR_STAGE_MODEL_PARSE,       // esp_srmodel_init
+    SR_STAGE_AFE_CONFIG,        // afe_config_init and the profile
+    SR_STAGE_AFE_CREATE,        // create_from_config: WakeNet (+ VADNet/NSNet)
+    SR_STAGE_DEFERRED,          // deferred loads, after wake-ready
+    SR_STAGE_COUNT,
+} sr_stage_t;
+
+// Stages PARTITION_MAP to MODEL_PARSE. NULL when the partition or its
+// index is missing or invalid.
+srmodel_list_t *sr_models_init(const char *partition_label);
+
+// Records now - start_us as the stage's duration.
+void sr_models_stage_done(sr_stage_t stage, int64_t start_us);
+
+void sr_models_afe_select(afe_config_t *config, const afe_profile_t *profile);
+
+typedef bool (*sr_models_loader_t)(srmodel_list_t *models);
+void sr_models_defer(sr_models_loader_t loader);
+
+// Called by audio_task after its first AFE fetch.
+void sr_models_wake_ready(void);
+
+int sr_models_format_json(char *buf, size_t len);
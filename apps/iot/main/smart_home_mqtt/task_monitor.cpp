@@ -0,0 +1,163 @@
+#include "task_monitor.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sdkconfig.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "audio_deadline.h"
+#include "event_bus.h"
+#include "i2s_capture.h"
+#include "local_commands.h"
+#include "log_mel.h"
+#include "mem_arena.h"
+#include "ota_update.h"
+#include "power_profile.h"
+#include "sr_models.h"
+#include "task_plan.h"
+#include "wifi_manager.h"
+
+static const char *TAG = "task_monitor";
+
+static const int TASK_MONITOR_PERIOD_MS = 5000;
+static const int TASK_MONITOR_MAX_TASKS = 32;
+
+static esp_mqtt_client_handle_t monitor_client = NULL;
+static const char *monitor_topic = NULL;
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+
+typedef struct {
+    UBaseType_t number;
+    uint32_t runtime;
+} task_sample_t;
+
+// Module sections of the status payload, in order; a module adds a row.
+typedef struct {
+    const char *key;
+    int (*format)(char *buf, size_t len);
+} status_section_t;
+
+static const status_section_t STATUS_SECTIONS[] = {
+    {"audio_deadline", audio_deadline_format_json},
+    {"mem", mem_arena_format_json},
+    {"local_cmd", local_commands_format_json},
+    {"wifi", wifi_manager_format_json},
+    {"power", power_profile_format_json},
+    {"sr", sr_models_format_json},
+    {"ota", ota_update_format_json},
+    {"i2s", i2s_capture_format_json},
+#if CONFIG_SMART_HOME_AUDIO_LOG_MEL
+    {"log_mel", log_mel_format_json},
+#endif
+};
+
+static TaskStatus_t task_status[TASK_MONITOR_MAX_TASKS];
+static task_sample_t prev_samples[TASK_MONITOR_MAX_TASKS];
+static int prev_count = 0;
+static char monitor_payload[4096];
+
+static uint32_t prev_runtime_of(UBaseType_t number, bool *found) {
+    for (int i = 0; i < prev_count; i++) {
+        if (prev_samples[i].number == number) {
+            *found = true;
+            return prev_samples[i].runtime;
+        }
+    }
+    *found = false;
+    return 0;
+}
+
+static void task_monitor_task(void *pvParameters) {
+    uint32_t prev_total = 0;
+    while (true) {
+        vTaskDelay(pdMS_TO_TICKS(TASK_MONITOR_PERIOD_MS));
+
+        uint32_t total = 0;
+        int count = (int)uxTaskGetSystemState(task_status, TASK_MONITOR_MAX_TASKS, &total);
+        if (count == 0) {
+            ESP_LOGW(TAG, "Task table larger than %d entries", TASK_MONITOR_MAX_TASKS);
+            continue;
+        }
+        uint32_t total_delta = total - prev_total;
+        prev_total = total;
+
+        int len = snprintf(monitor_payload, sizeof(monitor_payload),
+                           "{\"uptime_ms\":%lu,\"heap_internal\":%u,\"heap_psram\":%u",
+                           (unsigned long)pdTICKS_TO_MS(xTaskGetTickCount()),
+                           (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+                           (unsigned)heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+        for (size_t i = 0; i < sizeof(STATUS_SECTIONS) / sizeof(STATUS_SECTIONS[0]); i++) {
+            if (len < (int)sizeof(monitor_payload)) {
+                len += snprintf(monitor_payload + len, sizeof(monitor_payload) - len, ",\"%s\":",
+                                STATUS_SECTIONS[i].key);
+            }
+            if (len < (int)sizeof(monitor_payload)) {
+                len += STATUS_SECTIONS[i].format(monitor_payload + len, sizeof(monitor_payload) - len);
+            }
+        }
+        if (len < (int)sizeof(monitor_payload)) {
+            len += snprintf(monitor_payload + len, sizeof(monitor_payload) - len,
+                            ",\"events_dropped\":%lu,\"tasks\":[", (unsigned long)event_bus_dropped());
+        }
+        uint32_t idle_pct10[2] = {0, 0};
+        for (int i = 0; i < count && len < (int)sizeof(monitor_payload); i++) {
+            const TaskStatus_t *t = &task_status[i];
+            bool found = false;
+            uint32_t prev = prev_runtime_of(t->xTaskNumber, &found);
+            uint32_t delta = found ? t->ulRunTimeCounter - prev : 0;
+            // Percent of a single core, so IDLE0/IDLE1 read as per-core idle.
+            uint32_t pct10 = total_delta > 0 ? (uint32_t)(((uint64_t)delta * 1000) / total_delta) : 0;
+            int core = t->xCoreID == tskNO_AFFINITY ? -1 : (int)t->xCoreID;
+            for (int c = 0; c < 2; c++) {
+                if (t->xHandle == xTaskGetIdleTaskHandleForCore(c)) {
+                    idle_pct10[c] = pct10;
+                }
+            }
+            len += snprintf(monitor_payload + len, sizeof(monitor_payload) - len,
+                            "%s{\"name\":\"%s\",\"core\":%d,\"prio\":%u,\"cpu\":%lu.%lu,\"stack_free\":%lu}",
+                            i > 0 ? "," : "", t->pcTaskName, core, (unsigned)t->uxCurrentPriority,
+                            (unsigned long)(pct10 / 10), (unsigned long)(pct10 % 10),
+                            (unsigned long)t->usStackHighWaterMark);
+        }
+        if (len < (int)sizeof(monitor_payload)) {
+            len += snprintf(monitor_payload + len, sizeof(monitor_payload) - len, "]}");
+        }
+
+        if (prev_count > 0) {
+            power_profile_note_idle(idle_pct10[0], idle_pct10[1], TASK_MONITOR_PERIOD_MS);
+        }
+        prev_count = count;
+        for (int i = 0; i < count; i++) {
+            prev_samples[i].number = task_status[i].xTaskNumber;
+            prev_samples[i].runtime = task_status[i].ulRunTimeCounter;
+        }
+
+        if (len >= (int)sizeof(monitor_payload)) {
+            ESP_LOGW(TAG, "Status payload truncated");
+            continue;
+        }
+        if (monitor_client && monitor_topic && strlen(monitor_topic) > 0) {
+            esp_mqtt_client_publish(monitor_client, monitor_topic, monitor_payload, len, 0, 0);
+        }
+        ESP_LOGD(TAG, "%s", monitor_payload);
+    }
+}
+
+void task_monitor_start(esp_mqtt_client_handle_t client, const char *topic) {
+    monitor_client = client;
+    monitor_topic = topic;
+    task_plan_create(TASK_ID_MONITOR, task_monitor_task, NULL, NULL);
+}
+
+#else
+
+void task_monitor_start(esp_mqtt_client_handle_t client, const char *topic) {
+    ESP_LOGW(TAG, "Enable FREERTOS_USE_TRACE_FACILITY and FREERTOS_GENERATE_RUN_TIME_STATS for task stats");
+}
+
+#endif
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "mqtt_client.h"
+
+// Samples uxTaskGetSystemState periodically and publishes per-task CPU
+// share, stack high-water marks and the audio deadline histogram as JSON
+// on the status topic.
+void task_monitor_start(esp_mqtt_client_handle_t client, const char *topic);
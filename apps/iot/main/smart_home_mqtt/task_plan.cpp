@@ -0,0 +1,69 @@
+#include "task_plan.h"
+
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "nvs.h"
+
+static const char *TAG = "task_plan";
+
+// Single source of truth for task placement. The AFE, console and metrics
+// HTTP tasks are created by their libraries; their entries are handed over
+// as config. task_plan_init() applies the NVS overrides in place at boot.
+static task_spec_t plan[TASK_ID_COUNT] = {
+    // name            stack  prio                             core
+    {"audio_task",     8192,  6,                               TASK_CORE_AUDIO},
+    {"afe",            0,     CONFIG_SMART_HOME_AFE_PRIORITY,  CONFIG_SMART_HOME_AFE_CORE},
+    {"sensor_task",    4096,  4,                               TASK_CORE_NET},
+    {"task_monitor",   4096,  2,                               TASK_CORE_NET},
+    {"console",        4096,  2,                               TASK_CORE_NET},
+    {"event_bus",      3072,  5,                               TASK_CORE_NET},
+    {"httpd",          4096,  2,                               TASK_CORE_NET},
+    {"sr_loader",      6144,  1,                               TASK_CORE_NET}, // one-shot, after wake-ready
+    {"ota",            6144,  1,                               TASK_CORE_NET}, // one-shot, per update
+    {"power",          3072,  2,                               TASK_CORE_NET}, // applies power profiles
+    {"display",        3072,  2,                               TASK_CORE_NET}, // LCD writes
+};
+
+void task_plan_init(void) {
+    nvs_handle_t handle;
+    if (nvs_open(TASK_PLAN_AFE_NVS_NS, NVS_READONLY, &handle) != ESP_OK) {
+        return;
+    }
+    task_spec_t *afe = &plan[TASK_ID_AFE];
+    bool changed = false;
+    uint8_t u8 = 0;
+    if (nvs_get_u8(handle, "core", &u8) == ESP_OK && u8 <= 1) {
+        afe->core = u8;
+        changed = true;
+    }
+    if (nvs_get_u8(handle, "prio", &u8) == ESP_OK && u8 > 0 && u8 < configMAX_PRIORITIES) {
+        afe->priority = u8;
+        changed = true;
+    }
+    nvs_close(handle);
+    if (changed) {
+        ESP_LOGI(TAG, "%s from NVS: core=%d prio=%d", afe->name, (int)afe->core, (int)afe->priority);
+    }
+}
+
+const task_spec_t *task_plan_get(task_id_t id) {
+    if (id < 0 || id >= TASK_ID_COUNT) {
+        return NULL;
+    }
+    return &plan[id];
+}
+
+bool task_plan_create(task_id_t id, TaskFunction_t fn, void *arg, TaskHandle_t *out) {
+    const task_spec_t *spec = task_plan_get(id);
+    // Entries with stack 0 belong to tasks a library creates.
+    if (!spec || !fn || spec->stack == 0) {
+        return false;
+    }
+    if (xTaskCreatePinnedToCore(fn, spec->name, spec->stack, arg, spec->priority, out, spec->core) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create %s", spec->name);
+        return false;
+    }
+    ESP_LOGI(TAG, "%s: core=%d prio=%d stack=%u", spec->name, (int)spec->core,
+             (int)spec->priority, (unsigned)spec->stack);
+    return true;
+}
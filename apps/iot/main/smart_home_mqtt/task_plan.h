@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Core 1 is reserved for capture and the ESP-SR AFE; Wi-Fi, lwIP and MQTT
+// are pinned to core 0 in sdkconfig, so everything else lives there too.
+#define TASK_CORE_AUDIO 1
+#define TASK_CORE_NET 0
+
+typedef enum {
+    TASK_ID_AUDIO = 0,
+    TASK_ID_AFE,
+    TASK_ID_SENSOR,
+    TASK_ID_MONITOR,
+    TASK_ID_CONSOLE,
+    TASK_ID_EVENTS,
+    TASK_ID_METRICS,
+    TASK_ID_SR_LOADER,
+    TASK_ID_OTA,
+    TASK_ID_POWER,
+    TASK_ID_DISPLAY,
+    TASK_ID_COUNT,
+} task_id_t;
+
+typedef struct {
+    const char *name;
+    uint32_t stack;   // 0 for tasks created by a library
+    UBaseType_t priority;
+    BaseType_t core;
+} task_spec_t;
+
+// The AFE's core and priority default to CONFIG_SMART_HOME_AFE_CORE and
+// _PRIORITY; the u8 keys "core" and "prio" in the "afe" NVS namespace
+// (shared with afe_profile.h) override them per board. task_plan_init()
+// reads them, so call it after nvs_flash_init() and before the first
+// task_plan_get(); every lookup then sees the same placement.
+#define TASK_PLAN_AFE_NVS_NS "afe"
+void task_plan_init(void);
+
+const task_spec_t *task_plan_get(task_id_t id);
+bool task_plan_create(task_id_t id, TaskFunction_t fn, void *arg, TaskHandle_t *out);
@@ -0,0 +1,358 @@
+#include "wifi_manager.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+
+#include "sdkconfig.h"
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/event_groups.h"
+#include "nvs.h"
+
+static const char *TAG = "wifi_mgr";
+
+static const char *WIFI_NVS_NS = "wifi";
+static const char *WIFI_NVS_KEY_AP = "ap";
+static const char *WIFI_NVS_KEY_LEASE = "lease";
+
+static const int WIFI_CONNECTED_BIT = BIT0;
+
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t valid;
+} wifi_ap_cache_t;
+
+typedef struct {
+    uint32_t ip;
+    uint32_t netmask;
+    uint32_t gw;
+    uint32_t dns;
+} wifi_lease_cache_t;
+
+typedef enum {
+    WIFI_IP_DHCP = 0,
+    WIFI_IP_LEASE,  // cached DHCP lease applied statically
+    WIFI_IP_STATIC, // Kconfig
+} wifi_ip_mode_t;
+
+static const char *IP_MODE_NAMES[] = {"dhcp", "lease", "static"};
+
+static EventGroupHandle_t wifi_events = NULL;
+static esp_netif_t *sta_netif = NULL;
+static wifi_config_t sta_config = {};
+static wifi_ap_cache_t ap_cache = {};
+static wifi_lease_cache_t lease_cache = {};
+static esp_timer_handle_t retry_timer = NULL;
+
+// Event loop task only.
+static bool fast_path = false;
+static wifi_ip_mode_t ip_mode = WIFI_IP_DHCP;
+static uint32_t backoff_ms = 0;
+static int64_t outage_start_us = 0;
+
+static std::atomic<uint32_t> boot_to_ip_ms{0};
+static std::atomic<uint32_t> last_connect_ms{0};
+static std::atomic<uint32_t> connects{0};
+static std::atomic<uint32_t> disconnects{0};
+static std::atomic<uint32_t> fast_hits{0};
+static std::atomic<uint32_t> fast_misses{0};
+static std::atomic<uint32_t> last_reason{0};
+static std::atomic<uint32_t> current_backoff_ms{0};
+
+static bool wifi_cache_load(void) {
+    nvs_handle_t handle;
+    if (nvs_open(WIFI_NVS_NS, NVS_READONLY, &handle) != ESP_OK) {
+        return false;
+    }
+    size_t len = sizeof(ap_cache);
+    if (nvs_get_blob(handle, WIFI_NVS_KEY_AP, &ap_cache, &len) != ESP_OK || len != sizeof(ap_cache)) {
+        memset(&ap_cache, 0, sizeof(ap_cache));
+    }
+    len = sizeof(lease_cache);
+    if (nvs_get_blob(handle, WIFI_NVS_KEY_LEASE, &lease_cache, &len) != ESP_OK || len != sizeof(lease_cache)) {
+        memset(&lease_cache, 0, sizeof(lease_cache));
+    }
+    nvs_close(handle);
+    return ap_cache.valid && ap_cache.channel > 0;
+}
+
+// Only writes when something changed, to spare the flash.
+static void wifi_cache_save(const wifi_ap_cache_t *ap, const wifi_lease_cache_t *lease) {
+    bool ap_changed = ap && memcmp(ap, &ap_cache, sizeof(ap_cache)) != 0;
+    bool lease_changed = lease && memcmp(lease, &lease_cache, sizeof(lease_cache)) != 0;
+    if (!ap_changed && !lease_changed) {
+        return;
+    }
+    nvs_handle_t handle;
+    if (nvs_open(WIFI_NVS_NS, NVS_READWRITE, &handle) != ESP_OK) {
+        return;
+    }
+    if (ap_changed && nvs_set_blob(handle, WIFI_NVS_KEY_AP, ap, sizeof(*ap)) == ESP_OK) {
+        ap_cache = *ap;
+    }
+    if (lease_changed && nvs_set_blob(handle, WIFI_NVS_KEY_LEASE, lease, sizeof(*lease)) == ESP_OK) {
+        lease_cache = *lease;
+    }
+    nvs_commit(handle);
+    nvs_close(handle);
+}
+
+static void wifi_apply_ip(uint32_t ip, uint32_t netmask, uint32_t gw, uint32_t dns) {
+    esp_netif_dhcpc_stop(sta_netif);
+    esp_netif_ip_info_t info = {};
+    info.ip.addr = ip;
+    info.netmask.addr = netmask;
+    info.gw.addr = gw;
+    esp_netif_set_ip_info(sta_netif, &info);
+    if (dns != 0) {
+        esp_netif_dns_info_t dns_info = {};
+        dns_info.ip.u_addr.ip4.addr = dns;
+        dns_info.ip.type = ESP_IPADDR_TYPE_V4;
+        esp_netif_set_dns_info(sta_netif, ESP_NETIF_DNS_MAIN, &dns_info);
+    }
+}
+
+static bool wifi_static_config(uint32_t *ip, uint32_t *netmask, uint32_t *gw, uint32_t *dns) {
+    const char *ip_str = CONFIG_SMART_HOME_WIFI_STATIC_IP;
+    if (!ip_str || strlen(ip_str) == 0) {
+        return false;
+    }
+    esp_ip4_addr_t a = {}, m = {}, g = {}, d = {};
+    if (esp_netif_str_to_ip4(ip_str, &a) != ESP_OK ||
+        esp_netif_str_to_ip4(CONFIG_SMART_HOME_WIFI_STATIC_NETMASK, &m) != ESP_OK ||
+        esp_netif_str_to_ip4(CONFIG_SMART_HOME_WIFI_STATIC_GATEWAY, &g) != ESP_OK) {
+        ESP_LOGW(TAG, "Static IP config invalid, using DHCP");
+        return false;
+    }
+    // DNS defaults to the gateway.
+    if (esp_netif_str_to_ip4(CONFIG_SMART_HOME_WIFI_STATIC_DNS, &d) != ESP_OK) {
+        d = g;
+    }
+    *ip = a.addr;
+    *netmask = m.addr;
+    *gw = g.addr;
+    *dns = d.addr;
+    return true;
+}
+
+// Directed connect: no scan, straight to the cached AP on its channel.
+static void wifi_use_cached_ap(void) {
+    sta_config.sta.bssid_set = true;
+    memcpy(sta_config.sta.bssid, ap_cache.bssid, sizeof(ap_cache.bssid));
+    sta_config.sta.channel = ap_cache.channel;
+    sta_config.sta.scan_method = WIFI_FAST_SCAN;
+    esp_wifi_set_config(WIFI_IF_STA, &sta_config);
+}
+
+static void wifi_use_full_scan(void) {
+    sta_config.sta.bssid_set = false;
+    sta_config.sta.channel = 0;
+    sta_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+    sta_config.sta.sort_method = WIFI_CONNECT_AP_BY_SIGNAL;
+    esp_wifi_set_config(WIFI_IF_STA, &sta_config);
+}
+
+static void wifi_retry_cb(void *arg) {
+    esp_wifi_connect();
+}
+
+static void wifi_schedule_retry(void) {
+    uint32_t delay_ms = backoff_ms;
+    backoff_ms = backoff_ms == 0 ? CONFIG_SMART_HOME_WIFI_BACKOFF_MIN_MS : backoff_ms * 2;
+    if (backoff_ms > CONFIG_SMART_HOME_WIFI_BACKOFF_MAX_MS) {
+        backoff_ms = CONFIG_SMART_HOME_WIFI_BACKOFF_MAX_MS;
+    }
+    current_backoff_ms.store(delay_ms, std::memory_order_relaxed);
+    if (delay_ms == 0 || !retry_timer) {
+        esp_wifi_connect();
+        return;
+    }
+    esp_timer_stop(retry_timer);
+    esp_timer_start_once(retry_timer, (uint64_t)delay_ms * 1000);
+}
+
+static void wifi_on_got_ip(const ip_event_got_ip_t *event) {
+    int64_t now = esp_timer_get_time();
+    uint32_t connect_ms = (uint32_t)((now - outage_start_us) / 1000);
+    last_connect_ms.store(connect_ms, std::memory_order_relaxed);
+    if (boot_to_ip_ms.load(std::memory_order_relaxed) == 0) {
+        boot_to_ip_ms.store((uint32_t)(now / 1000), std::memory_order_relaxed);
+    }
+    connects.fetch_add(1, std::memory_order_relaxed);
+    if (fast_path) {
+        fast_hits.fetch_add(1, std::memory_order_relaxed);
+    }
+    backoff_ms = 0;
+    current_backoff_ms.store(0, std::memory_order_relaxed);
+    ESP_LOGI(TAG, "IP " IPSTR " in %lu ms (%s, %s), boot to IP %lu ms", IP2STR(&event->ip_info.ip),
+             (unsigned long)connect_ms, fast_path ? "cached AP" : "scan", IP_MODE_NAMES[ip_mode],
+             (unsigned long)boot_to_ip_ms.load(std::memory_order_relaxed));
+
+    wifi_ap_record_t ap;
+    wifi_ap_cache_t new_ap = {};
+    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+        memcpy(new_ap.bssid, ap.bssid, sizeof(new_ap.bssid));
+        new_ap.channel = ap.primary;
+        new_ap.valid = 1;
+    }
+    wifi_lease_cache_t new_lease = lease_cache;
+    if (ip_mode == WIFI_IP_DHCP) {
+        new_lease.ip = event->ip_info.ip.addr;
+        new_lease.netmask = event->ip_info.netmask.addr;
+        new_lease.gw = event->ip_info.gw.addr;
+        esp_netif_dns_info_t dns = {};
+        new_lease.dns = esp_netif_get_dns_info(sta_netif, ESP_NETIF_DNS_MAIN, &dns) == ESP_OK
+                            ? dns.ip.u_addr.ip4.addr : 0;
+    }
+    wifi_cache_save(new_ap.valid ? &new_ap : NULL, &new_lease);
+    fast_path = false;
+    xEventGroupSetBits(wifi_events, WIFI_CONNECTED_BIT);
+}
+
+static void wifi_on_disconnected(const wifi_event_sta_disconnected_t *event) {
+    bool was_connected = (xEventGroupGetBits(wifi_events) & WIFI_CONNECTED_BIT) != 0;
+    xEventGroupClearBits(wifi_events, WIFI_CONNECTED_BIT);
+    disconnects.fetch_add(1, std::memory_order_relaxed);
+    last_reason.store(event ? event->reason : 0, std::memory_order_relaxed);
+    if (was_connected) {
+        outage_start_us = esp_timer_get_time();
+    }
+    if (fast_path) {
+        // Scan right away. The cache stays: one failed attempt may just be
+        // a busy AP, and the next good connect overwrites whatever changed.
+        ESP_LOGW(TAG, "Cached AP connect failed (reason %u), falling back to scan",
+                 (unsigned)(event ? event->reason : 0));
+        fast_path = false;
+        fast_misses.fetch_add(1, std::memory_order_relaxed);
+        if (ip_mode == WIFI_IP_LEASE) {
+            esp_netif_dhcpc_start(sta_netif);
+            ip_mode = WIFI_IP_DHCP;
+        }
+        wifi_use_full_scan();
+        esp_wifi_connect();
+        return;
+    }
+    // A fast connect leaves the config locked to the cached BSSID and
+    // channel. The first retry after a drop may use it; once that fails,
+    // scan so a moved AP or a vanished mesh node is still found.
+    if (!was_connected && sta_config.sta.bssid_set) {
+        ESP_LOGI(TAG, "Retrying with a full scan");
+        wifi_use_full_scan();
+    }
+    wifi_schedule_retry();
+}
+
+static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data) {
+    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
+        outage_start_us = esp_timer_get_time();
+        esp_wifi_connect();
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        wifi_on_disconnected((const wifi_event_sta_disconnected_t *)event_data);
+    } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
+        wifi_on_got_ip((const ip_event_got_ip_t *)event_data);
+    }
+}
+
+bool wifi_manager_start(const char *ssid, const char *password) {
+    if (!ssid || !password || strlen(ssid) == 0 || strlen(password) == 0) {
+        ESP_LOGE(TAG, "WiFi credentials not set. Configure SMART_HOME_WIFI_SSID/PASSWORD.");
+        return false;
+    }
+
+    wifi_events = xEventGroupCreate();
+    if (!wifi_events) {
+        return false;
+    }
+    esp_netif_init();
+    esp_event_loop_create_default();
+    sta_netif = esp_netif_create_default_wifi_sta();
+
+    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    esp_wifi_init(&cfg);
+
+    esp_timer_create_args_t timer_args = {};
+    timer_args.callback = wifi_retry_cb;
+    timer_args.name = "wifi_retry";
+    if (esp_timer_create(&timer_args, &retry_timer) != ESP_OK) {
+        retry_timer = NULL;
+    }
+
+    esp_event_handler_instance_t instance_any_id;
+    esp_event_handler_instance_t instance_got_ip;
+    esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL, &instance_any_id);
+    esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_event_handler, NULL, &instance_got_ip);
+
+    strncpy((char *)sta_config.sta.ssid, ssid, sizeof(sta_config.sta.ssid) - 1);
+    sta_config.sta.ssid[sizeof(sta_config.sta.ssid) - 1] = '\0';
+    strncpy((char *)sta_config.sta.password, password, sizeof(sta_config.sta.password) - 1);
+    sta_config.sta.password[sizeof(sta_config.sta.password) - 1] = '\0';
+    sta_config.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
+
+    esp_wifi_set_mode(WIFI_MODE_STA);
+
+    bool cached = wifi_cache_load();
+#if CONFIG_SMART_HOME_WIFI_FAST_CONNECT
+    fast_path = cached;
+#endif
+    if (fast_path) {
+        wifi_use_cached_ap();
+    } else {
+        wifi_use_full_scan();
+    }
+
+    uint32_t ip = 0, netmask = 0, gw = 0, dns = 0;
+    if (wifi_static_config(&ip, &netmask, &gw, &dns)) {
+        ip_mode = WIFI_IP_STATIC;
+        wifi_apply_ip(ip, netmask, gw, dns);
+    }
+#if CONFIG_SMART_HOME_WIFI_REUSE_LEASE
+    else if (fast_path && lease_cache.ip != 0) {
+        ip_mode = WIFI_IP_LEASE;
+        wifi_apply_ip(lease_cache.ip, lease_cache.netmask, lease_cache.gw, lease_cache.dns);
+    }
+#endif
+    ESP_LOGI(TAG, "Connecting: %s, ip %s", fast_path ? "cached AP" : "full scan", IP_MODE_NAMES[ip_mode]);
+    esp_wifi_start();
+    return true;
+}
+
+bool wifi_manager_wait(TickType_t wait) {
+    if (!wifi_events) {
+        return false;
+    }
+    return (xEventGroupWaitBits(wifi_events, WIFI_CONNECTED_BIT, pdFALSE, pdFALSE, wait) & WIFI_CONNECTED_BIT) != 0;
+}
+
+bool wifi_manager_connected(void) {
+    return wifi_events && (xEventGroupGetBits(wifi_events) & WIFI_CONNECTED_BIT) != 0;
+}
+
+uint32_t wifi_manager_boot_to_ip_ms(void) {
+    return boot_to_ip_ms.load(std::memory_order_relaxed);
+}
+
+int wifi_manager_format_json(char *buf, size_t len) {
+    bool connected = wifi_manager_connected();
+    esp_netif_ip_info_t info = {};
+    if (connected && esp_netif_get_ip_info(sta_netif, &info) != ESP_OK) {
+        info.ip.addr = 0;
+    }
+    return snprintf(buf, len,
+                    "{\"connected\":%s,\"boot_to_ip_ms\":%lu,\"last_connect_ms\":%lu,\"ip\":\"" IPSTR "\","
+                    "\"ip_mode\":\"%s\",\"connects\":%lu,\"disconnects\":%lu,\"fast_hits\":%lu,\"fast_misses\":%lu,"
+                    "\"backoff_ms\":%lu,\"last_reason\":%lu}",
+                    connected ? "true" : "false", (unsigned long)boot_to_ip_ms.load(std::memory_order_relaxed),
+                    (unsigned long)last_connect_ms.load(std::memory_order_relaxed), IP2STR(&info.ip),
+                    IP_MODE_NAMES[ip_mode],
+                    (unsigned long)connects.load(std::memory_order_relaxed),
+                    (unsigned long)disconnects.load(std::memory_order_relaxed),
+                    (unsigned long)fast_hits.load(std::memory_order_relaxed),
+                    (unsigned long)fast_misses.load(std::memory_order_relaxed),
+                    (unsigned long)current_backoff_ms.load(std::memory_order_relaxed),
+                    (unsigned long)last_reason.load(std::memory_order_relaxed));
+}
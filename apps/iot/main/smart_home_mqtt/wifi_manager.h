@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+
+// Station connection manager. The AP's BSSID/channel and the DHCP lease
+// from the last good connection are cached in NVS; on boot the manager
+// tries a directed connect to that AP (optionally reusing the lease) and
+// falls back to a full scan + DHCP if it fails. A failed directed connect
+// leaves the cache alone; it is only rewritten once a connect succeeds on
+// a different AP, channel or lease. Reconnects back off exponentially;
+// after a drop only the first retry is directed, later ones scan. A
+// static IP from Kconfig replaces DHCP entirely.
+bool wifi_manager_start(const char *ssid, const char *password);
+bool wifi_manager_wait(TickType_t wait);
+bool wifi_manager_connected(void);
+
+// Boot-to-IP time for this boot, 0 until the first IP.
+uint32_t wifi_manager_boot_to_ip_ms(void);
+int wifi_manager_format_json(char *buf, size_t len);
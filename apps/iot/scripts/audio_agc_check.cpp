@@ -0,0 +1,258 @@
+// Host check for the fixed-point AGC (main/smart_home_mqtt/audio_agc.cpp)
+// on synthetic I2S input, through the same frame kernels audio_task uses.
+// For every chunk size (two specialised, one generic):
+//   converge   quiet and loud tones settle on target_peak within 2%
+//   attack     a loud onset is cut to the target in the same block
+//   release    the gain rises by at most (desired - gain) >> release_shift
+//              per block and ramps monotonically inside the block
+//   no clip    full-scale bursts (+32767 and -32768) after maximum gain
+//              never exceed the limiter ceiling or saturate an output,
+//              also with target_peak above the ceiling
+//   floor      gain stays within min_gain_q8..max_gain_q8, silence below
+//              the noise floor holds it, and init clamps the start gain
+//
+// Build: g++ -O2 -std=c++17 -I../main/smart_home_mqtt audio_agc_check.cpp
+//            ../main/smart_home_mqtt/audio_agc.cpp ../main/smart_home_mqtt/audio_frame.cpp
+//            -o audio_agc_check
+//
+//   audio_agc_check           run the checks, exit status 1 on failure
+//   audio_agc_check --trace   also print the gain per block
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "audio_agc.h"
+#include "audio_frame.h"
+
+static const int CHUNKS[] = {512, 480, 320}; // 320 has no specialisation
+static const double SAMPLE_RATE = 16000.0;
+static const int SETTLE_BLOCKS = 200;
+
+static bool trace = false;
+static int failures = 0;
+
+static void fail(int chunk, const char *what, int block, long got, long want) {
+    if (failures++ < 20) {
+        printf("FAIL chunk %d %s block %d: got %ld want %ld\n", chunk, what, block, got, want);
+    }
+}
+
+// 16-bit amplitude -> INMP441 style 24 bits left-justified in 32.
+static int32_t to_i2s(int32_t s16) {
+    return (int32_t)((uint32_t)s16 << 16);
+}
+
+struct tone_t {
+    double amplitude; // 16-bit scale, may exceed full scale (clipped)
+    double hz;
+    double phase;
+};
+
+static void make_block(tone_t *tone, std::vector<int32_t> &in, std::vector<int16_t> &in16) {
+    for (size_t i = 0; i < in.size(); i++) {
+        double v = round(tone->amplitude * sin(tone->phase));
+        tone->phase += 2.0 * M_PI * tone->hz / SAMPLE_RATE;
+        if (v > 32767) v = 32767;
+        if (v < -32768) v = -32768;
+        in16[i] = (int16_t)v;
+        in[i] = to_i2s((int32_t)v);
+    }
+}
+
+static int32_t block_peak(const std::vector<int16_t> &buf) {
+    int32_t peak = 0;
+    for (int16_t s : buf) {
+        peak = std::max(peak, std::abs((int32_t)s));
+    }
+    return peak;
+}
+
+// The gain the AGC steers to for a block peak, before the release limit.
+static int32_t desired_gain(const audio_agc_t &agc, int32_t peak) {
+    int32_t desired = (int32_t)(((int64_t)agc.target_peak << 8) / peak);
+    if (desired > agc.max_gain_q8) desired = agc.max_gain_q8;
+    if (desired < agc.min_gain_q8) desired = agc.min_gain_q8;
+    return desired;
+}
+
+struct runner_t {
+    int chunk;
+    audio_frame_ops_t ops;
+    audio_agc_t agc;
+    std::vector<int32_t> in;
+    std::vector<int16_t> in16;
+    std::vector<int16_t> out;
+    int block = 0;
+
+    explicit runner_t(int n) : chunk(n), in(n), in16(n), out(n) {
+        audio_frame_select(&ops, AUDIO_INPUT_S24_IN_32, chunk, 0);
+        audio_agc_init(&agc, 256);
+    }
+
+    // Runs one block and checks the invariants that hold for every block.
+    int32_t step(tone_t *tone) {
+        make_block(tone, in, in16);
+        int32_t prev = agc.gain_q8;
+        uint32_t clips_before = agc.clip_samples;
+        int32_t peak = block_peak(in16);
+        int32_t gain = audio_agc_process(&agc, &ops, in.data(), out.data(), chunk);
+        int32_t out_peak = block_peak(out);
+        if (trace) {
+            printf("chunk %d block %4d peak %5d gain %4d -> %4d out %5d\n", chunk, block, peak, prev, gain,
+                   out_peak);
+        }
+
+        if (gain < agc.min_gain_q8 || gain > agc.max_gain_q8) {
+            fail(chunk, "gain outside min..max", block, gain, prev);
+        }
+        if (agc.clip_samples != clips_before) {
+            fail(chunk, "saturated output samples", block, (long)(agc.clip_samples - clips_before), 0);
+        }
+        if (out_peak > agc.limit) {
+            fail(chunk, "output above the limiter ceiling", block, out_peak, agc.limit);
+        }
+        if (peak <= agc.noise_floor && gain != prev) {
+            fail(chunk, "gain moved below the noise floor", block, gain, prev);
+        }
+        if (gain > prev) {
+            // Release: bounded per block, and a ramp from prev to gain.
+            int32_t bound = std::max<int32_t>(1, (desired_gain(agc, peak) - prev) >> agc.release_shift);
+            if (gain - prev > bound) {
+                fail(chunk, "release faster than release_shift", block, gain - prev, bound);
+            }
+            for (int i = 0; i < chunk; i++) {
+                int32_t lo = (std::abs((int32_t)in16[i]) * prev) >> 8;
+                int32_t hi = (std::abs((int32_t)in16[i]) * gain) >> 8;
+                int32_t a = std::abs((int32_t)out[i]);
+                if (a + 1 < lo || a > hi + 1) {
+                    fail(chunk, "ramp outside prev..gain", block, a, hi);
+                    break;
+                }
+            }
+        } else if (peak > agc.noise_floor) {
+            // Attack: the full reduction lands in this block.
+            int32_t want = desired_gain(agc, peak);
+            if ((int64_t)peak * want > ((int64_t)agc.limit << 8)) {
+                want = (int32_t)(((int64_t)agc.limit << 8) / peak);
+            }
+            if (gain != want) {
+                fail(chunk, "attack not applied in the block", block, gain, want);
+            }
+        }
+        block++;
+        return out_peak;
+    }
+};
+
+static void check_converges(int chunk, double amplitude, const char *what) {
+    runner_t r(chunk);
+    tone_t tone = {amplitude, 1000.0, 0.0};
+    int32_t out_peak = 0;
+    for (int b = 0; b < SETTLE_BLOCKS; b++) {
+        out_peak = r.step(&tone);
+    }
+    int32_t target = r.agc.target_peak;
+    if (std::abs(out_peak - target) > target / 50) {
+        fail(chunk, what, r.block, out_peak, target);
+    }
+}
+
+static void check_attack_and_clip(int chunk) {
+    runner_t r(chunk);
+    tone_t quiet = {200.0, 440.0, 0.0};
+    for (int b = 0; b < SETTLE_BLOCKS; b++) {
+        r.step(&quiet);
+    }
+    if (r.agc.gain_q8 != r.agc.max_gain_q8) {
+        fail(chunk, "quiet tone did not reach max gain", r.block, r.agc.gain_q8, r.agc.max_gain_q8);
+    }
+    // A square-ish burst far over full scale: +32767 and -32768 every cycle.
+    tone_t burst = {1e6, 500.0, 0.0};
+    int32_t first = r.step(&burst);
+    if (first > r.agc.target_peak + r.agc.target_peak / 50) {
+        fail(chunk, "onset above target after attack", r.block - 1, first, r.agc.target_peak);
+    }
+    for (int b = 0; b < 20; b++) {
+        r.step(&burst);
+    }
+    if (r.agc.input_clip_samples == 0) {
+        fail(chunk, "full-scale input not counted", r.block, 0, 1);
+    }
+    // Back to quiet: the release climbs from the burst gain again.
+    for (int b = 0; b < 50; b++) {
+        r.step(&quiet);
+    }
+
+    // With the target above the ceiling only the limiter stops the burst.
+    runner_t l(chunk);
+    l.agc.target_peak = 32000;
+    for (int b = 0; b < SETTLE_BLOCKS; b++) {
+        l.step(&quiet);
+    }
+    for (int b = 0; b < 20; b++) {
+        l.step(&burst);
+    }
+    if (l.agc.limited_frames == 0) {
+        fail(chunk, "limiter never engaged", l.block, 0, 1);
+    }
+}
+
+static void check_floor_and_hold(int chunk) {
+    audio_agc_t agc;
+    audio_agc_init(&agc, 1);
+    if (agc.gain_q8 != agc.min_gain_q8) {
+        fail(chunk, "init below min_gain not clamped", 0, agc.gain_q8, agc.min_gain_q8);
+    }
+    audio_agc_init(&agc, 1 << 20);
+    if (agc.gain_q8 != agc.max_gain_q8) {
+        fail(chunk, "init above max_gain not clamped", 0, agc.gain_q8, agc.max_gain_q8);
+    }
+
+    // A low target makes a loud tone want less than min_gain_q8.
+    runner_t r(chunk);
+    r.agc.target_peak = 2000;
+    tone_t loud = {30000.0, 1000.0, 0.0};
+    for (int b = 0; b < 10; b++) {
+        r.step(&loud);
+    }
+    if (r.agc.gain_q8 != r.agc.min_gain_q8) {
+        fail(chunk, "gain floor", r.block, r.agc.gain_q8, r.agc.min_gain_q8);
+    }
+
+    // Silence and hiss under the noise floor hold whatever gain there was.
+    runner_t s(chunk);
+    tone_t mid = {4000.0, 1000.0, 0.0};
+    for (int b = 0; b < SETTLE_BLOCKS; b++) {
+        s.step(&mid);
+    }
+    int32_t held = s.agc.gain_q8;
+    tone_t hiss = {(double)s.agc.noise_floor, 3000.0, 0.0};
+    for (int b = 0; b < 50; b++) {
+        s.step(&hiss);
+    }
+    if (s.agc.gain_q8 != held) {
+        fail(chunk, "gain not held under the noise floor", s.block, s.agc.gain_q8, held);
+    }
+}
+
+int main(int argc, char **argv) {
+    trace = argc > 1 && strcmp(argv[1], "--trace") == 0;
+    if (argc > 1 && !trace) {
+        fprintf(stderr, "usage: %s [--trace]\n", argv[0]);
+        return 2;
+    }
+    for (int chunk : CHUNKS) {
+        int before = failures;
+        check_converges(chunk, 2000.0, "quiet tone did not converge"); // +18 dB
+        check_converges(chunk, 28000.0, "loud tone did not converge"); // -5 dB
+        check_attack_and_clip(chunk);
+        check_floor_and_hold(chunk);
+        printf("chunk %4d %s\n", chunk, failures == before ? "ok" : "FAIL");
+    }
+    printf("%s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,263 @@
+// Host check and benchmark for the audio frame kernels
+// (main/smart_home_mqtt/audio_frame.cpp). The baseline is the per-chunk
+// code audio_task ran before the kernels: runtime-bounded loops with
+// branches for saturation and a 64-bit energy accumulator. Every
+// specialisation, and the generic fallback, must match it bit for bit on
+// quiet, loud (clipping) and short blocks; then both are timed.
+//
+// Build: g++ -O2 -std=c++17 -I../main/smart_home_mqtt audio_frame_bench.cpp
+//            ../main/smart_home_mqtt/audio_frame.cpp ../main/smart_home_mqtt/audio_agc.cpp
+//            -o audio_frame_bench
+//
+//   audio_frame_bench           check and time, exit status 1 on a mismatch
+//   audio_frame_bench --check   check only
+//
+// Host timings only show the relative effect of constant trip counts and
+// branch-free saturation; the Xtensa numbers differ (CLAMPS, no SIMD).
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "audio_agc.h"
+#include "audio_frame.h"
+
+static const int CHUNKS[] = {512, 480, 320}; // 320 has no specialisation
+static const int BLOCKS = 64;
+static const int ROUNDS = 2000;
+
+// ---- baseline: the loops audio_task and audio_agc_process used to run ----
+
+__attribute__((noinline)) static void base_convert(const int32_t *in, int16_t *out, int samples, int gain_shift) {
+    for (int i = 0; i < samples; i++) {
+        int32_t v = in[i] >> 8;
+        int32_t s = v >> 8;
+        s <<= gain_shift;
+        if (s > 32767) s = 32767;
+        if (s < -32768) s = -32768;
+        out[i] = (int16_t)s;
+    }
+}
+
+__attribute__((noinline)) static int base_energy(const int16_t *src, int samples) {
+    int64_t acc = 0;
+    int step = 4;
+    int count = samples / step;
+    if (count <= 0) {
+        step = 1;
+        count = samples;
+    }
+    for (int i = 0; i < samples; i += step) {
+        int32_t s = src[i];
+        if (s < 0) s = -s;
+        acc += s;
+    }
+    return (int)(acc / count);
+}
+
+__attribute__((noinline)) static int32_t base_agc(audio_agc_t *agc, const int32_t *in, int16_t *out, int samples) {
+    int32_t peak = 0;
+    uint32_t input_clips = 0;
+    for (int i = 0; i < samples; i++) {
+        int32_t s = in[i] >> 16;
+        out[i] = (int16_t)s;
+        int32_t a = s < 0 ? -s : s;
+        if (a > peak) peak = a;
+        if (a >= 32767) input_clips++;
+    }
+    int32_t prev_gain = agc->gain_q8;
+    int32_t gain = prev_gain;
+    bool limited = false;
+    if (peak > agc->noise_floor) {
+        int32_t desired = (int32_t)(((int64_t)agc->target_peak << 8) / peak);
+        if (desired > agc->max_gain_q8) desired = agc->max_gain_q8;
+        if (desired < agc->min_gain_q8) desired = agc->min_gain_q8;
+        if (desired > gain) {
+            gain += (desired - gain) >> agc->release_shift;
+            if (gain == prev_gain) gain++;
+        } else {
+            gain = desired;
+        }
+        if ((int64_t)peak * gain > ((int64_t)agc->limit << 8)) {
+            gain = (int32_t)(((int64_t)agc->limit << 8) / peak);
+            limited = true;
+        }
+    }
+    int32_t step_q16 = 0;
+    int32_t g_q16 = gain << 8;
+    if (gain > prev_gain) {
+        step_q16 = ((gain - prev_gain) << 8) / samples;
+        g_q16 = prev_gain << 8;
+    }
+    uint32_t clips = 0;
+    for (int i = 0; i < samples; i++) {
+        g_q16 += step_q16;
+        int32_t s = (int32_t)(((int64_t)out[i] * g_q16) >> 16);
+        if (s > 32767) {
+            s = 32767;
+            clips++;
+        } else if (s < -32768) {
+            s = -32768;
+            clips++;
+        }
+        out[i] = (int16_t)s;
+    }
+    agc->gain_q8 = gain;
+    agc->last_peak = peak;
+    agc->frames++;
+    agc->clip_samples += clips;
+    agc->input_clip_samples += input_clips;
+    if (limited) {
+        agc->limited_frames++;
+    }
+    return gain;
+}
+
+// ---- signals ----
+
+// Blocks alternate between quiet speech-like noise, loud bursts that clip
+// at high gain shifts, full-scale samples and silence, so the AGC ramps,
+// limits and holds.
+static std::vector<int32_t> make_i2s(int chunk) {
+    std::mt19937 rng(chunk);
+    std::vector<int32_t> v((size_t)chunk * BLOCKS);
+    for (int b = 0; b < BLOCKS; b++) {
+        int level = (b % 4 == 0) ? 300 : (b % 4 == 1) ? 8000 : (b % 4 == 2) ? 32767 : 0;
+        std::uniform_int_distribution<int32_t> d(-level, level);
+        for (int i = 0; i < chunk; i++) {
+            int32_t s16 = level ? d(rng) : 0;
+            // 24 significant bits, low byte of the slot zero.
+            int32_t s24 = s16 * 256 + (int32_t)(rng() & 0xff);
+            v[(size_t)b * chunk + i] = (int32_t)((uint32_t)s24 << 8);
+        }
+    }
+    return v;
+}
+
+// ---- checks ----
+
+static bool check_chunk(int chunk, const std::vector<int32_t> &i2s) {
+    bool ok = true;
+    std::vector<int16_t> a(chunk), b(chunk);
+    for (int g = 0; g <= AUDIO_FRAME_MAX_GAIN_SHIFT; g++) {
+        audio_frame_ops_t ops;
+        audio_frame_select(&ops, AUDIO_INPUT_S24_IN_32, chunk, g);
+        for (int blk = 0; blk < BLOCKS; blk++) {
+            // Every 8th block is short, as after an I2S underrun.
+            int n = blk % 8 == 7 ? chunk - 37 : chunk;
+            const int32_t *in = &i2s[(size_t)blk * chunk];
+            base_convert(in, a.data(), n, g);
+            ops.convert(in, b.data(), n, g);
+            if (memcmp(a.data(), b.data(), n * sizeof(int16_t)) != 0) {
+                printf("convert mismatch: chunk %d gain %d block %d\n", chunk, g, blk);
+                ok = false;
+            }
+            for (int e : {n, n / 4, 3, 1}) {
+                if (base_energy(a.data(), e) != ops.energy(a.data(), e)) {
+                    printf("energy mismatch: chunk %d block %d samples %d\n", chunk, blk, e);
+                    ok = false;
+                }
+            }
+        }
+    }
+
+    audio_frame_ops_t ops;
+    audio_frame_select(&ops, AUDIO_INPUT_S24_IN_32, chunk, 2);
+    audio_agc_t base_state, state;
+    audio_agc_init(&base_state, 256 << 2);
+    audio_agc_init(&state, 256 << 2);
+    for (int blk = 0; blk < BLOCKS; blk++) {
+        int n = blk % 8 == 7 ? chunk - 37 : chunk;
+        const int32_t *in = &i2s[(size_t)blk * chunk];
+        int32_t ga = base_agc(&base_state, in, a.data(), n);
+        int32_t gb = audio_agc_process(&state, &ops, in, b.data(), n);
+        if (ga != gb || memcmp(a.data(), b.data(), n * sizeof(int16_t)) != 0 ||
+            base_state.clip_samples != state.clip_samples ||
+            base_state.input_clip_samples != state.input_clip_samples ||
+            base_state.limited_frames != state.limited_frames) {
+            printf("agc mismatch: chunk %d block %d\n", chunk, blk);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// ---- timing ----
+
+static volatile int64_t sink;
+
+template <typename F>
+static double ns_per_chunk(F &&fn) {
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int blk = 0; blk < BLOCKS; blk++) {
+            fn(blk);
+        }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / ((double)ROUNDS * BLOCKS);
+}
+
+static void row(const char *stage, int chunk, int gain, double base, double kern) {
+    printf("%-8s %6d %5d %12.1f %12.1f %8.2fx\n", stage, chunk, gain, base, kern, base / kern);
+}
+
+static void bench_chunk(int chunk, const std::vector<int32_t> &i2s) {
+    std::vector<int16_t> out(chunk);
+    for (int g = 0; g <= AUDIO_FRAME_MAX_GAIN_SHIFT; g += 2) {
+        audio_frame_ops_t ops;
+        audio_frame_select(&ops, AUDIO_INPUT_S24_IN_32, chunk, g);
+        double b = ns_per_chunk([&](int blk) {
+            base_convert(&i2s[(size_t)blk * chunk], out.data(), chunk, g);
+            sink = out[blk % chunk];
+        });
+        double k = ns_per_chunk([&](int blk) {
+            ops.convert(&i2s[(size_t)blk * chunk], out.data(), chunk, g);
+            sink = out[blk % chunk];
+        });
+        row("convert", chunk, g, b, k);
+    }
+
+    audio_frame_ops_t ops;
+    audio_frame_select(&ops, AUDIO_INPUT_S24_IN_32, chunk, 2);
+    audio_agc_t state;
+    audio_agc_init(&state, 256 << 2);
+    double b = ns_per_chunk([&](int blk) { sink = base_agc(&state, &i2s[(size_t)blk * chunk], out.data(), chunk); });
+    audio_agc_init(&state, 256 << 2);
+    double k = ns_per_chunk(
+        [&](int blk) { sink = audio_agc_process(&state, &ops, &i2s[(size_t)blk * chunk], out.data(), chunk); });
+    row("agc", chunk, -1, b, k);
+
+    base_convert(i2s.data(), out.data(), chunk, 2);
+    b = ns_per_chunk([&](int) { sink = base_energy(out.data(), chunk); });
+    k = ns_per_chunk([&](int) { sink = ops.energy(out.data(), chunk); });
+    row("energy", chunk, -1, b, k);
+}
+
+int main(int argc, char **argv) {
+    bool check_only = argc > 1 && strcmp(argv[1], "--check") == 0;
+    if (argc > 1 && !check_only) {
+        fprintf(stderr, "usage: %s [--check]\n", argv[0]);
+        return 2;
+    }
+
+    bool ok = true;
+    for (int chunk : CHUNKS) {
+        audio_frame_ops_t ops;
+        bool specialised = audio_frame_select(&ops, AUDIO_INPUT_S24_IN_32, chunk, 0);
+        bool chunk_ok = check_chunk(chunk, make_i2s(chunk));
+        printf("chunk %4d %-12s bit-exact %s\n", chunk, specialised ? "specialised" : "generic", chunk_ok ? "ok" : "FAIL");
+        ok &= chunk_ok;
+    }
+    if (!check_only) {
+        printf("\n%-8s %6s %5s %12s %12s %9s\n", "stage", "chunk", "gain", "baseline_ns", "kernel_ns", "speedup");
+        for (int chunk : CHUNKS) {
+            bench_chunk(chunk, make_i2s(chunk));
+        }
+    }
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+
+typedef void *httpd_handle_t;
+typedef struct httpd_req {
+    void *user_ctx;
+} httpd_req_t;
+typedef enum { HTTP_GET = 1 } httpd_method_t;
+
+typedef struct {
+    uint16_t server_port;
+    uint16_t max_uri_handlers;
+    size_t stack_size;
+    unsigned task_priority;
+    BaseType_t core_id;
+} httpd_config_t;
+#define HTTPD_DEFAULT_CONFIG() httpd_config_t{80, 8, 4096, 5, 0x7fffffff}
+
+typedef struct {
+    const char *uri;
+    httpd_method_t method;
+    esp_err_t (*handler)(httpd_req_t *req);
+    void *user_ctx;
+} httpd_uri_t;
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config);
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri);
+esp_err_t httpd_resp_set_type(httpd_req_t *req, const char *type);
+esp_err_t httpd_resp_send_chunk(httpd_req_t *req, const char *buf, ssize_t len);
@@ -0,0 +1,9 @@
+#pragma once
+
+// Logging goes to the check's esp_log_host(), which can count warnings.
+void esp_log_host(char level, const char *tag, const char *fmt, ...);
+
+#define ESP_LOGE(tag, fmt, ...) esp_log_host('E', tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) esp_log_host('W', tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) esp_log_host('I', tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) esp_log_host('D', tag, fmt, ##__VA_ARGS__)
@@ -0,0 +1,3 @@
+#pragma once
+
+typedef struct esp_mqtt_client *esp_mqtt_client_handle_t;
@@ -0,0 +1,388 @@
+// Local stand-in for the audio server that measures end-to-end latency of
+// the firmware's TCP audio stream (see main/smart_home_mqtt/audio_stream.h).
+//
+// Build: g++ -O2 -std=c++17 -I../main/smart_home_mqtt latency_server.cpp -o latency_server
+//
+//   latency_server [--port 3334] [--sessions N] [--json report.json] [--label name]
+//
+// Point AUDIO_UDP_HOST/PORT of the board at this machine. Every connection
+// is one session; the report is printed after N sessions or on Ctrl-C.
+//
+// With CONFIG_SMART_HOME_AUDIO_TIMESTAMPS the device clock is mapped onto
+// the host clock with offset = min(arrival - t_us) over the session's TIME
+// frames, so the device-to-host figures below exclude the smallest one-way
+// network delay (~1 ms on a quiet LAN) and are comparable between runs.
+//
+//   wake_to_first_byte  wake detected -> first AUD0 at the server (or MEL0)
+//   wake_to_stream      wake detected -> STRT sent (device clock only)
+//   capture_to_arrival  DMA block captured -> its AUD0 at the server
+//   jitter              |arrival delta - device delta| between AUD0s
+//                       (without timestamps: vs the packet's audio length)
+//   stop_to_receipt     STOP decided -> STOP at the server
+//   connect_to_strt     TCP accept -> STRT (host clock only)
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "audio_stream.h"
+
+static const int SAMPLE_RATE = 16000;
+static const int MAX_CLIENTS = 64;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static int64_t host_now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+struct Session {
+    int fd = -1;
+    std::string peer;
+    std::vector<uint8_t> buf;
+
+    int64_t accept_us = 0;
+    int64_t strt_arrival = 0;
+    bool have_offset = false;
+    int64_t offset_us = 0; // host = device + offset
+
+    int64_t wake_dev = -1;
+    int64_t start_dev = -1;
+    int64_t stop_dev = -1;
+    int64_t stop_arrival = 0;
+    bool stopped = false;
+    bool cancelled = false;
+
+    // TIME(audio) waiting for its AUD0.
+    bool pending_capture = false;
+    uint32_t pending_seq = 0;
+    int64_t pending_capture_dev = 0;
+
+    int64_t first_aud_arrival = 0;
+    int64_t prev_arrival = 0;
+    int64_t prev_dev = -1;
+    uint32_t prev_samples = 0;
+    bool have_seq = false;
+    uint32_t expected_seq = 0;
+
+    // Raw per-packet samples, resolved once the offset is final.
+    std::vector<std::pair<int64_t, int64_t>> capture_pairs; // (arrival, capture_dev)
+    std::vector<double> jitter_ms;
+
+    uint32_t packets = 0;
+    uint64_t audio_bytes = 0;
+    uint32_t gaps = 0;
+    uint32_t lost = 0;
+    uint32_t reordered = 0;
+    uint32_t junk_bytes = 0;
+};
+
+struct Metric {
+    const char* name;
+    std::vector<double> values;
+};
+
+struct Report {
+    Metric wake_to_first_byte{"wake_to_first_byte_ms", {}};
+    Metric wake_to_stream{"wake_to_stream_ms", {}};
+    Metric capture_to_arrival{"capture_to_arrival_ms", {}};
+    Metric jitter{"jitter_ms", {}};
+    Metric stop_to_receipt{"stop_to_receipt_ms", {}};
+    Metric connect_to_strt{"connect_to_strt_ms", {}};
+    uint32_t sessions = 0;
+    uint32_t cancelled = 0;
+    uint32_t incomplete = 0;
+    uint32_t timestamped = 0;
+    uint32_t packets = 0;
+    uint64_t audio_bytes = 0;
+    uint32_t gaps = 0;
+    uint32_t lost = 0;
+    uint32_t reordered = 0;
+    uint32_t junk_bytes = 0;
+
+    Metric* all[6] = {&wake_to_first_byte, &wake_to_stream, &capture_to_arrival,
+                      &jitter, &stop_to_receipt, &connect_to_strt};
+};
+
+static void note_offset(Session& s, int64_t arrival, int64_t t_dev) {
+    int64_t off = arrival - t_dev;
+    if (!s.have_offset || off < s.offset_us) {
+        s.offset_us = off;
+        s.have_offset = true;
+    }
+}
+
+static void on_time(Session& s, const audio_msg_t& m, int64_t arrival) {
+    note_offset(s, arrival, m.t_us);
+    switch (m.kind) {
+    case AUDIO_TIME_WAKE: s.wake_dev = m.t_us; break;
+    case AUDIO_TIME_START: s.start_dev = m.t_us; break;
+    case AUDIO_TIME_AUDIO:
+        s.pending_capture = true;
+        s.pending_seq = m.value;
+        s.pending_capture_dev = m.t_us;
+        break;
+    case AUDIO_TIME_STOP: s.stop_dev = m.t_us; break;
+    default: break;
+    }
+}
+
+static void on_aud0(Session& s, const audio_msg_t& m, int64_t arrival) {
+    // MEL0 frames stand for AUDIO_STREAM_MEL_HOP samples each.
+    uint32_t samples = m.type == AUDIO_MSG_MEL0 ? m.len / (2 * AUDIO_STREAM_MEL_BINS) * AUDIO_STREAM_MEL_HOP : m.len / 2;
+    if (s.have_seq && m.value != s.expected_seq) {
+        if (m.value > s.expected_seq) {
+            s.gaps++;
+            s.lost += m.value - s.expected_seq;
+        } else {
+            s.reordered++;
+        }
+    }
+    s.have_seq = true;
+    s.expected_seq = m.value + 1;
+
+    int64_t dev = -1;
+    if (s.pending_capture && s.pending_seq == m.value) {
+        dev = s.pending_capture_dev;
+        s.capture_pairs.emplace_back(arrival, dev);
+    }
+    s.pending_capture = false;
+
+    if (s.packets == 0) {
+        s.first_aud_arrival = arrival;
+    } else {
+        double arrival_delta = (arrival - s.prev_arrival) / 1000.0;
+        double expected_delta = (dev >= 0 && s.prev_dev >= 0) ? (dev - s.prev_dev) / 1000.0
+                                                              : s.prev_samples * 1000.0 / SAMPLE_RATE;
+        s.jitter_ms.push_back(arrival_delta > expected_delta ? arrival_delta - expected_delta
+                                                             : expected_delta - arrival_delta);
+    }
+    s.prev_arrival = arrival;
+    s.prev_dev = dev;
+    s.prev_samples = samples;
+    s.packets++;
+    s.audio_bytes += m.len;
+}
+
+// Consumes complete messages; everything read by one recv() shares its
+// arrival time.
+static void process(Session& s, int64_t arrival) {
+    size_t pos = 0;
+    while (pos < s.buf.size()) {
+        audio_msg_t m;
+        size_t used = audio_stream_parse(s.buf.data() + pos, s.buf.size() - pos, &m);
+        if (used == 0) break;
+        pos += used;
+        switch (m.type) {
+        case AUDIO_MSG_STRT: s.strt_arrival = arrival; break;
+        case AUDIO_MSG_TIME: on_time(s, m, arrival); break;
+        case AUDIO_MSG_AUD0:
+        case AUDIO_MSG_MEL0: on_aud0(s, m, arrival); break;
+        case AUDIO_MSG_STOP:
+            s.stopped = true;
+            s.stop_arrival = arrival;
+            break;
+        case AUDIO_MSG_CANC: s.cancelled = true; break;
+        default: s.junk_bytes++; break;
+        }
+    }
+    s.buf.erase(s.buf.begin(), s.buf.begin() + pos);
+}
+
+static void finish(Session& s, Report& r, bool verbose) {
+    r.sessions++;
+    r.packets += s.packets;
+    r.audio_bytes += s.audio_bytes;
+    r.gaps += s.gaps;
+    r.lost += s.lost;
+    r.reordered += s.reordered;
+    r.junk_bytes += s.junk_bytes;
+    if (s.cancelled) r.cancelled++;
+    if (!s.stopped && !s.cancelled) r.incomplete++;
+    if (s.strt_arrival > 0) r.connect_to_strt.values.push_back((s.strt_arrival - s.accept_us) / 1000.0);
+    r.jitter.values.insert(r.jitter.values.end(), s.jitter_ms.begin(), s.jitter_ms.end());
+
+    double w2fb = -1, s2r = -1;
+    if (s.have_offset) {
+        r.timestamped++;
+        if (s.wake_dev >= 0 && s.packets > 0) {
+            w2fb = (s.first_aud_arrival - s.offset_us - s.wake_dev) / 1000.0;
+            r.wake_to_first_byte.values.push_back(w2fb);
+        }
+        if (s.wake_dev >= 0 && s.start_dev >= 0) {
+            r.wake_to_stream.values.push_back((s.start_dev - s.wake_dev) / 1000.0);
+        }
+        for (const auto& p : s.capture_pairs) {
+            r.capture_to_arrival.values.push_back((p.first - s.offset_us - p.second) / 1000.0);
+        }
+        if (s.stopped && s.stop_dev >= 0) {
+            s2r = (s.stop_arrival - s.offset_us - s.stop_dev) / 1000.0;
+            r.stop_to_receipt.values.push_back(s2r);
+        }
+    }
+    if (verbose) {
+        printf("%s: %s packets=%u audio=%.2fs gaps=%u lost=%u wake_to_first_byte=%.1fms stop_to_receipt=%.1fms\n",
+               s.peer.c_str(), s.cancelled ? "CANC" : (s.stopped ? "STOP" : "closed"), s.packets,
+               s.audio_bytes / 2.0 / SAMPLE_RATE, s.gaps, s.lost, w2fb, s2r);
+        fflush(stdout);
+    }
+}
+
+// Nearest-rank percentile of a sorted vector.
+static double percentile(const std::vector<double>& v, double p) {
+    if (v.empty()) return 0;
+    size_t rank = (size_t)(p / 100.0 * v.size() + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > v.size()) rank = v.size();
+    return v[rank - 1];
+}
+
+static void print_report(Report& r, const char* label) {
+    printf("\n== latency report%s%s ==\n", label ? ": " : "", label ? label : "");
+    printf("sessions=%u timestamped=%u cancelled=%u incomplete=%u packets=%u audio=%.1fs gaps=%u lost=%u "
+           "reordered=%u junk=%u\n",
+           r.sessions, r.timestamped, r.cancelled, r.incomplete, r.packets, r.audio_bytes / 2.0 / SAMPLE_RATE,
+           r.gaps, r.lost, r.reordered, r.junk_bytes);
+    printf("%-24s %7s %9s %9s %9s %9s\n", "metric (ms)", "n", "p50", "p90", "p99", "max");
+    for (Metric* m : r.all) {
+        std::sort(m->values.begin(), m->values.end());
+        if (m->values.empty()) {
+            printf("%-24s %7s\n", m->name, "-");
+            continue;
+        }
+        printf("%-24s %7zu %9.2f %9.2f %9.2f %9.2f\n", m->name, m->values.size(), percentile(m->values, 50),
+               percentile(m->values, 90), percentile(m->values, 99), m->values.back());
+    }
+}
+
+static bool write_json(const Report& r, const char* path, const char* label) {
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    fprintf(f, "{\"label\":\"%s\",\"sessions\":%u,\"timestamped\":%u,\"cancelled\":%u,\"incomplete\":%u,"
+               "\"packets\":%u,\"audio_bytes\":%llu,\"gaps\":%u,\"lost\":%u,\"reordered\":%u,\"junk_bytes\":%u",
+            label ? label : "", r.sessions, r.timestamped, r.cancelled, r.incomplete, r.packets,
+            (unsigned long long)r.audio_bytes, r.gaps, r.lost, r.reordered, r.junk_bytes);
+    for (const Metric* m : r.all) {
+        const std::vector<double>& v = m->values;
+        fprintf(f, ",\"%s\":{\"n\":%zu,\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"max\":%.3f}", m->name, v.size(),
+                percentile(v, 50), percentile(v, 90), percentile(v, 99), v.empty() ? 0.0 : v.back());
+    }
+    fprintf(f, "}\n");
+    fclose(f);
+    return true;
+}
+
+static void on_signal(int) { stop_requested = 1; }
+
+static int usage(const char* argv0) {
+    fprintf(stderr, "usage: %s [--port 3334] [--sessions N] [--json report.json] [--label name] [--quiet]\n",
+            argv0);
+    return 2;
+}
+
+int main(int argc, char** argv) {
+    int port = 3334;
+    uint32_t max_sessions = 0;
+    const char* json_path = NULL;
+    const char* label = NULL;
+    bool verbose = true;
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        bool has_value = i + 1 < argc;
+        if (a == "--port" && has_value) port = atoi(argv[++i]);
+        else if (a == "--sessions" && has_value) max_sessions = (uint32_t)atoi(argv[++i]);
+        else if (a == "--json" && has_value) json_path = argv[++i];
+        else if (a == "--label" && has_value) label = argv[++i];
+        else if (a == "--quiet") verbose = false;
+        else return usage(argv[0]);
+    }
+
+    int lsock = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(lsock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((uint16_t)port);
+    if (bind(lsock, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(lsock, 16) != 0) {
+        perror("listen");
+        return 1;
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    printf("listening on :%d\n", port);
+    fflush(stdout);
+
+    Report report;
+    std::map<int, Session> sessions;
+    std::vector<uint8_t> chunk(64 * 1024);
+    while (!stop_requested && (max_sessions == 0 || report.sessions < max_sessions)) {
+        std::vector<struct pollfd> fds;
+        fds.push_back({lsock, POLLIN, 0});
+        for (auto& kv : sessions) fds.push_back({kv.first, POLLIN, 0});
+        if (poll(fds.data(), fds.size(), 500) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            break;
+        }
+        if ((fds[0].revents & POLLIN) && (int)sessions.size() < MAX_CLIENTS) {
+            struct sockaddr_in peer = {};
+            socklen_t plen = sizeof(peer);
+            int fd = accept(lsock, (struct sockaddr*)&peer, &plen);
+            if (fd >= 0) {
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                Session& s = sessions[fd];
+                s.fd = fd;
+                s.accept_us = host_now_us();
+                char ip[INET_ADDRSTRLEN];
+                inet_ntop(AF_INET, &peer.sin_addr, ip, sizeof(ip));
+                s.peer = std::string(ip) + ":" + std::to_string(ntohs(peer.sin_port));
+            }
+        }
+        for (size_t i = 1; i < fds.size(); i++) {
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            Session& s = sessions[fds[i].fd];
+            ssize_t n = recv(s.fd, chunk.data(), chunk.size(), 0);
+            int64_t arrival = host_now_us();
+            if (n > 0) {
+                s.buf.insert(s.buf.end(), chunk.begin(), chunk.begin() + n);
+                process(s, arrival);
+                continue;
+            }
+            if (n < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+            close(s.fd);
+            finish(s, report, verbose);
+            sessions.erase(fds[i].fd);
+        }
+    }
+    for (auto& kv : sessions) {
+        close(kv.first);
+        finish(kv.second, report, verbose);
+    }
+    close(lsock);
+
+    print_report(report, label);
+    if (json_path && !write_json(report, json_path, label)) {
+        return 1;
+    }
+    return 0;
+}
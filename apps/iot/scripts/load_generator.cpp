@@ -0,0 +1,751 @@
+// Multi-device load generator for the ingest path (audio_tcp.py and the
+// MQTT telemetry consumer). Each virtual device behaves like a board: it
+// wakes at random, opens one TCP audio connection per utterance and
+// streams it in real time with the firmware's framing (audio_stream.h),
+// and publishes the firmware's sensor JSON (sensor_payload.h) over a
+// minimal MQTT 3.1.1 client.
+//
+// Build: g++ -O2 -std=c++17 -I../main/smart_home_mqtt load_generator.cpp -o load_generator
+//
+//   load_generator [--devices 10] [--duration 60] [--audio 127.0.0.1:3334]
+//                  [--mqtt 127.0.0.1:1883|none] [--wake-per-min 2]
+//                  [--utterance-ms 3000] [--agg-frames 3] [--chunk-samples 512]
+//                  [--telemetry-ms 10000] [--topic sensor/temp_humid_msa_assign1]
+//                  [--qos 0|1] [--no-timestamps] [--seed 1] [--json report.json]
+//
+// Server backlog is measured from the client side, because the server
+// reports nothing back on the audio connection:
+//   drain_ms    after STOP the device half-closes and waits for the server
+//               to close its end, i.e. until the server has read the
+//               whole session (audio_tcp.py serves one connection at a time)
+//   queued_kb   bytes sent but not yet acknowledged (SIOCOUTQ) plus bytes
+//               the device could not hand to the kernel, sampled per second
+//   puback_ms   broker PUBACK latency with --qos 1
+// A device whose send backlog stays stuck for 2 s fails the session, like
+// the firmware's SO_SNDTIMEO.
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <linux/sockios.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "audio_stream.h"
+#include "sensor_payload.h"
+
+static const int SAMPLE_RATE = 16000;
+static const int64_t SEND_TIMEOUT_US = 2000000;    // firmware SO_SNDTIMEO
+static const int64_t CONNECT_TIMEOUT_US = 2000000;
+static const int64_t DRAIN_TIMEOUT_US = 60000000;
+static const int64_t MQTT_RETRY_US = 1000000;
+static const int MQTT_KEEPALIVE_S = 30;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static int64_t now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+struct Config {
+    int devices = 10;
+    double duration_s = 60;
+    std::string audio_host = "127.0.0.1";
+    int audio_port = 3334;
+    std::string mqtt_host = "127.0.0.1";
+    int mqtt_port = 1883;
+    bool mqtt = true;
+    double wake_per_min = 2;
+    int utterance_ms = 3000;
+    int agg_frames = 3;
+    int chunk_samples = 512;
+    int telemetry_ms = 10000;
+    std::string topic = "sensor/temp_humid_msa_assign1";
+    int qos = 0;
+    bool timestamps = true;
+    unsigned seed = 1;
+    const char* json_path = NULL;
+};
+
+struct Stats {
+    uint32_t wakes = 0;
+    uint32_t wakes_busy = 0; // wake while the device was still streaming
+    uint32_t sessions = 0;
+    uint32_t sessions_done = 0;
+    uint32_t connect_fail = 0;
+    uint32_t send_fail = 0;
+    uint32_t drain_timeouts = 0;
+    uint32_t late_packets = 0; // packet due while the previous one was still queued
+    uint64_t audio_packets = 0;
+    uint64_t audio_bytes = 0;
+    uint32_t mqtt_connects = 0;
+    uint32_t mqtt_connect_fail = 0;
+    uint32_t mqtt_disconnects = 0;
+    uint64_t mqtt_publishes = 0;
+    uint64_t mqtt_acks = 0;
+    uint64_t mqtt_bytes = 0;
+    std::vector<double> connect_ms;
+    std::vector<double> drain_ms;
+    std::vector<double> queued_kb;
+    std::vector<double> puback_ms;
+};
+
+enum AudioState { AUDIO_IDLE, AUDIO_CONNECTING, AUDIO_STREAMING, AUDIO_DRAINING };
+enum MqttState { MQTT_DOWN, MQTT_CONNECTING, MQTT_WAIT_CONNACK, MQTT_UP };
+
+struct Device {
+    int id = 0;
+    int64_t clock_offset = 0; // device esp_timer = host - offset
+    std::mt19937 rng;
+
+    AudioState astate = AUDIO_IDLE;
+    int afd = -1;
+    int64_t next_wake = 0;
+    int64_t wake_us = 0;
+    int64_t phase_start = 0;
+    int64_t next_packet = 0;
+    uint32_t session = 0;
+    uint32_t seq = 0;
+    int samples_left = 0;
+    std::vector<uint8_t> aout;
+    int64_t stuck_since = 0;
+
+    MqttState mstate = MQTT_DOWN;
+    int mfd = -1;
+    int64_t mqtt_retry_at = 0;
+    int64_t mqtt_connect_start = 0;
+    int64_t next_telemetry = 0;
+    int64_t next_ping = 0;
+    uint16_t next_pid = 1;
+    std::map<uint16_t, int64_t> inflight;
+    std::vector<uint8_t> mout;
+    std::vector<uint8_t> min;
+    sensor_reading_t reading = {};
+};
+
+static Config cfg;
+static Stats st;
+static std::vector<int16_t> pcm_source;
+static struct sockaddr_in audio_addr;
+static struct sockaddr_in mqtt_addr;
+
+static bool resolve(const std::string& host, int port, struct sockaddr_in* out) {
+    struct addrinfo hints = {}, *res = NULL;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host.c_str(), NULL, &hints, &res) != 0 || !res) return false;
+    *out = *(struct sockaddr_in*)res->ai_addr;
+    out->sin_port = htons((uint16_t)port);
+    freeaddrinfo(res);
+    return true;
+}
+
+static int connect_nonblocking(const struct sockaddr_in* addr) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, (const struct sockaddr*)addr, sizeof(*addr)) != 0 && errno != EINPROGRESS) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool connect_finished_ok(int fd) {
+    int err = 0;
+    socklen_t len = sizeof(err);
+    return getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && err == 0;
+}
+
+// Hands as much of out to the kernel as it takes; false on a socket error.
+static bool flush(int fd, std::vector<uint8_t>& out, uint64_t* counter) {
+    size_t sent = 0;
+    while (sent < out.size()) {
+        ssize_t n = send(fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += (size_t)n;
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) break;
+        return false;
+    }
+    out.erase(out.begin(), out.begin() + sent);
+    if (counter) *counter += sent;
+    return true;
+}
+
+static double exp_interval_s(Device& d, double mean_s) {
+    std::exponential_distribution<double> dist(1.0 / mean_s);
+    return dist(d.rng);
+}
+
+// ---- audio ----
+
+static void schedule_wake(Device& d, int64_t now) {
+    d.next_wake = cfg.wake_per_min > 0 ? now + (int64_t)(exp_interval_s(d, 60.0 / cfg.wake_per_min) * 1e6) : INT64_MAX;
+}
+
+static void audio_reset(Device& d, int64_t now) {
+    if (d.afd >= 0) close(d.afd);
+    d.afd = -1;
+    d.aout.clear();
+    d.astate = AUDIO_IDLE;
+    schedule_wake(d, now);
+}
+
+static int packet_samples() {
+    return cfg.chunk_samples * cfg.agg_frames;
+}
+
+static void audio_append_packet(Device& d, int64_t capture_host_us) {
+    int samples = std::min(packet_samples(), d.samples_left);
+    uint16_t bytes = (uint16_t)(samples * sizeof(int16_t));
+    size_t at = d.aout.size();
+    size_t prefix = (cfg.timestamps ? AUDIO_STREAM_TIME_LEN : 0) + AUDIO_STREAM_AUD0_LEN;
+    d.aout.resize(at + prefix + bytes);
+    uint8_t* p = d.aout.data() + at;
+    if (cfg.timestamps) {
+        p = audio_stream_put_time(p, AUDIO_TIME_AUDIO, d.seq, capture_host_us - d.clock_offset);
+    }
+    p = audio_stream_put_aud0(p, d.seq, bytes);
+    size_t src = ((size_t)d.seq * samples) % (pcm_source.size() - samples);
+    memcpy(p, &pcm_source[src], bytes);
+    d.seq++;
+    d.samples_left -= samples;
+    st.audio_packets++;
+}
+
+static void audio_on_wake(Device& d, int64_t now) {
+    st.wakes++;
+    if (d.astate != AUDIO_IDLE) {
+        st.wakes_busy++;
+        return;
+    }
+    d.wake_us = now;
+    d.session++;
+    d.afd = connect_nonblocking(&audio_addr);
+    if (d.afd < 0) {
+        st.connect_fail++;
+        audio_reset(d, now);
+        return;
+    }
+    d.phase_start = now;
+    d.astate = AUDIO_CONNECTING;
+}
+
+static void audio_on_connected(Device& d, int64_t now) {
+    st.sessions++;
+    st.connect_ms.push_back((now - d.phase_start) / 1000.0);
+    uint8_t msg[AUDIO_STREAM_TAG_LEN + 2 * AUDIO_STREAM_TIME_LEN];
+    uint8_t* end = audio_stream_put_tag(msg, "STRT");
+    if (cfg.timestamps) {
+        end = audio_stream_put_time(end, AUDIO_TIME_WAKE, d.session, d.wake_us - d.clock_offset);
+        end = audio_stream_put_time(end, AUDIO_TIME_START, d.session, now - d.clock_offset);
+    }
+    d.aout.insert(d.aout.end(), msg, end);
+    std::uniform_real_distribution<double> spread(0.7, 1.3);
+    d.samples_left = (int)(cfg.utterance_ms * spread(d.rng) * SAMPLE_RATE / 1000);
+    d.seq = 0;
+    d.stuck_since = 0;
+    // First packet once AGG frames of audio have been captured.
+    d.next_packet = now + (int64_t)packet_samples() * 1000000 / SAMPLE_RATE;
+    d.astate = AUDIO_STREAMING;
+}
+
+static void audio_finish_stream(Device& d, int64_t now) {
+    uint8_t msg[AUDIO_STREAM_TIME_LEN + AUDIO_STREAM_TAG_LEN];
+    uint8_t* end = msg;
+    if (cfg.timestamps) end = audio_stream_put_time(end, AUDIO_TIME_STOP, d.seq, now - d.clock_offset);
+    end = audio_stream_put_tag(end, "STOP");
+    d.aout.insert(d.aout.end(), msg, end);
+    d.phase_start = now;
+    d.astate = AUDIO_DRAINING;
+}
+
+static void audio_timers(Device& d, int64_t now) {
+    switch (d.astate) {
+    case AUDIO_IDLE:
+        if (now >= d.next_wake) audio_on_wake(d, now);
+        break;
+    case AUDIO_CONNECTING:
+        if (now - d.phase_start > CONNECT_TIMEOUT_US) {
+            st.connect_fail++;
+            audio_reset(d, now);
+        }
+        break;
+    case AUDIO_STREAMING:
+        while (d.astate == AUDIO_STREAMING && now >= d.next_packet) {
+            if (!d.aout.empty()) st.late_packets++;
+            int64_t period = (int64_t)packet_samples() * 1000000 / SAMPLE_RATE;
+            audio_append_packet(d, d.next_packet - period);
+            d.next_packet += period;
+            if (d.samples_left <= 0) audio_finish_stream(d, now);
+        }
+        break;
+    case AUDIO_DRAINING:
+        if (d.aout.empty() && now - d.phase_start > DRAIN_TIMEOUT_US) {
+            st.drain_timeouts++;
+            audio_reset(d, now);
+        }
+        break;
+    }
+    if ((d.astate == AUDIO_STREAMING || d.astate == AUDIO_DRAINING) && !d.aout.empty()) {
+        if (d.stuck_since == 0) d.stuck_since = now;
+        if (now - d.stuck_since > SEND_TIMEOUT_US) {
+            st.send_fail++;
+            audio_reset(d, now);
+        }
+    }
+}
+
+static void audio_io(Device& d, short revents, int64_t now) {
+    if (d.astate == AUDIO_CONNECTING) {
+        if (!(revents & (POLLOUT | POLLERR | POLLHUP))) return;
+        if (!connect_finished_ok(d.afd)) {
+            st.connect_fail++;
+            audio_reset(d, now);
+            return;
+        }
+        audio_on_connected(d, now);
+    }
+    if (revents & POLLIN) {
+        uint8_t sink[512];
+        ssize_t n = recv(d.afd, sink, sizeof(sink), 0);
+        if (n == 0 && d.astate == AUDIO_DRAINING && d.aout.empty()) {
+            // Server closed its end: everything up to STOP has been read.
+            st.sessions_done++;
+            st.drain_ms.push_back((now - d.phase_start) / 1000.0);
+            audio_reset(d, now);
+            return;
+        }
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+            st.send_fail++;
+            audio_reset(d, now);
+            return;
+        }
+    }
+    if (!d.aout.empty()) {
+        if (!flush(d.afd, d.aout, &st.audio_bytes)) {
+            st.send_fail++;
+            audio_reset(d, now);
+            return;
+        }
+        if (d.aout.empty()) {
+            d.stuck_since = 0;
+            if (d.astate == AUDIO_DRAINING) {
+                shutdown(d.afd, SHUT_WR);
+                d.phase_start = now;
+            }
+        }
+    }
+}
+
+static double audio_queued_kb(const Device& d) {
+    int outq = 0;
+    if (d.afd < 0 || ioctl(d.afd, SIOCOUTQ, &outq) != 0) outq = 0;
+    return (outq + d.aout.size()) / 1024.0;
+}
+
+// ---- minimal MQTT 3.1.1 ----
+
+static void mqtt_put_len(std::vector<uint8_t>& out, size_t len) {
+    do {
+        uint8_t b = len % 128;
+        len /= 128;
+        out.push_back(len > 0 ? (b | 0x80) : b);
+    } while (len > 0);
+}
+
+static void mqtt_put_str(std::vector<uint8_t>& out, const std::string& s) {
+    out.push_back((uint8_t)(s.size() >> 8));
+    out.push_back((uint8_t)(s.size() & 0xff));
+    out.insert(out.end(), s.begin(), s.end());
+}
+
+static void mqtt_reset(Device& d, int64_t now, bool failed_connect) {
+    if (d.mfd >= 0) close(d.mfd);
+    if (failed_connect) st.mqtt_connect_fail++;
+    else if (d.mstate == MQTT_UP) st.mqtt_disconnects++;
+    d.mfd = -1;
+    d.mstate = MQTT_DOWN;
+    d.mout.clear();
+    d.min.clear();
+    d.inflight.clear();
+    d.mqtt_retry_at = now + MQTT_RETRY_US;
+}
+
+static void mqtt_send_connect(Device& d) {
+    std::vector<uint8_t> body;
+    mqtt_put_str(body, "MQTT");
+    body.push_back(4);    // protocol level 3.1.1
+    body.push_back(0x02); // clean session
+    body.push_back(0);
+    body.push_back(MQTT_KEEPALIVE_S);
+    mqtt_put_str(body, "loadgen-" + std::to_string(d.id));
+    d.mout.push_back(0x10);
+    mqtt_put_len(d.mout, body.size());
+    d.mout.insert(d.mout.end(), body.begin(), body.end());
+}
+
+// Sensor values drift like a real room; a few readings fail.
+static void mqtt_publish_telemetry(Device& d, int64_t now) {
+    std::uniform_int_distribution<int> step(-1, 1);
+    std::uniform_int_distribution<int> fail(0, 99);
+    sensor_reading_t& r = d.reading;
+    r.temperature = std::min(40, std::max(10, r.temperature + step(d.rng)));
+    r.humidity = std::min(95, std::max(20, r.humidity + step(d.rng)));
+    r.gas_raw = std::min(4095, std::max(0, r.gas_raw + 10 * step(d.rng)));
+    r.dht_ok = fail(d.rng) >= 3;
+    r.gas_ok = fail(d.rng) >= 2;
+    r.ratio = 1.0f + r.gas_raw / 4096.0f;
+    r.rs = 10000.0f * r.ratio;
+    r.co2 = 110.47f * powf(r.ratio, -2.862f);
+    r.nh3 = 102.2f * powf(r.ratio, -2.473f);
+    r.co = 605.18f * powf(r.ratio, -3.937f);
+
+    char payload[220];
+    int n = sensor_payload_format(payload, sizeof(payload), &r);
+    std::vector<uint8_t> body;
+    mqtt_put_str(body, cfg.topic);
+    if (cfg.qos > 0) {
+        uint16_t pid = d.next_pid++;
+        if (d.next_pid == 0) d.next_pid = 1;
+        body.push_back((uint8_t)(pid >> 8));
+        body.push_back((uint8_t)(pid & 0xff));
+        d.inflight[pid] = now;
+    }
+    body.insert(body.end(), payload, payload + n);
+    d.mout.push_back((uint8_t)(0x30 | (cfg.qos > 0 ? 0x02 : 0)));
+    mqtt_put_len(d.mout, body.size());
+    d.mout.insert(d.mout.end(), body.begin(), body.end());
+    st.mqtt_publishes++;
+}
+
+static void mqtt_handle_input(Device& d, int64_t now) {
+    size_t pos = 0;
+    while (d.min.size() - pos >= 2) {
+        size_t len = 0, mult = 1, i = pos + 1;
+        bool complete = false;
+        while (i < d.min.size() && i < pos + 5) {
+            uint8_t b = d.min[i++];
+            len += (b & 0x7f) * mult;
+            mult *= 128;
+            if (!(b & 0x80)) {
+                complete = true;
+                break;
+            }
+        }
+        if (!complete || d.min.size() < i + len) break;
+        uint8_t type = d.min[pos] >> 4;
+        const uint8_t* body = d.min.data() + i;
+        if (type == 2 && len >= 2) { // CONNACK
+            if (body[1] != 0) {
+                mqtt_reset(d, now, true);
+                return;
+            }
+            d.mstate = MQTT_UP;
+            st.mqtt_connects++;
+            std::uniform_int_distribution<int> phase(0, cfg.telemetry_ms);
+            d.next_telemetry = now + (int64_t)phase(d.rng) * 1000;
+            d.next_ping = now + MQTT_KEEPALIVE_S * 500000LL;
+        } else if (type == 4 && len >= 2) { // PUBACK
+            uint16_t pid = (uint16_t)((body[0] << 8) | body[1]);
+            auto it = d.inflight.find(pid);
+            if (it != d.inflight.end()) {
+                st.puback_ms.push_back((now - it->second) / 1000.0);
+                st.mqtt_acks++;
+                d.inflight.erase(it);
+            }
+        }
+        pos = i + len;
+    }
+    d.min.erase(d.min.begin(), d.min.begin() + pos);
+}
+
+static void mqtt_timers(Device& d, int64_t now) {
+    switch (d.mstate) {
+    case MQTT_DOWN:
+        if (now >= d.mqtt_retry_at) {
+            d.mfd = connect_nonblocking(&mqtt_addr);
+            if (d.mfd < 0) {
+                mqtt_reset(d, now, true);
+                return;
+            }
+            d.mqtt_connect_start = now;
+            d.mstate = MQTT_CONNECTING;
+        }
+        break;
+    case MQTT_CONNECTING:
+    case MQTT_WAIT_CONNACK:
+        if (now - d.mqtt_connect_start > CONNECT_TIMEOUT_US) mqtt_reset(d, now, true);
+        break;
+    case MQTT_UP:
+        if (now >= d.next_telemetry) {
+            mqtt_publish_telemetry(d, now);
+            d.next_telemetry += (int64_t)cfg.telemetry_ms * 1000;
+        }
+        if (now >= d.next_ping) {
+            d.mout.push_back(0xc0);
+            d.mout.push_back(0x00);
+            d.next_ping = now + MQTT_KEEPALIVE_S * 500000LL;
+        }
+        break;
+    }
+}
+
+static void mqtt_io(Device& d, short revents, int64_t now) {
+    if (d.mstate == MQTT_CONNECTING) {
+        if (!(revents & (POLLOUT | POLLERR | POLLHUP))) return;
+        if (!connect_finished_ok(d.mfd)) {
+            mqtt_reset(d, now, true);
+            return;
+        }
+        mqtt_send_connect(d);
+        d.mstate = MQTT_WAIT_CONNACK;
+    }
+    if (revents & POLLIN) {
+        uint8_t buf[1024];
+        ssize_t n = recv(d.mfd, buf, sizeof(buf), 0);
+        if (n <= 0 && !(n < 0 && (errno == EAGAIN || errno == EINTR))) {
+            mqtt_reset(d, now, d.mstate != MQTT_UP);
+            return;
+        }
+        if (n > 0) {
+            d.min.insert(d.min.end(), buf, buf + n);
+            mqtt_handle_input(d, now);
+            if (d.mstate == MQTT_DOWN) return;
+        }
+    }
+    if (!d.mout.empty() && !flush(d.mfd, d.mout, &st.mqtt_bytes)) {
+        mqtt_reset(d, now, false);
+    }
+}
+
+// ---- report ----
+
+static double percentile(std::vector<double>& v, double p) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    size_t rank = (size_t)(p / 100.0 * v.size() + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > v.size()) rank = v.size();
+    return v[rank - 1];
+}
+
+struct NamedMetric {
+    const char* name;
+    std::vector<double>* values;
+};
+
+static void print_report(double elapsed_s) {
+    printf("\n== load report: %d devices, %.0fs, wake %.1f/min, utterance %d ms, agg %d x %d, telemetry %d ms, "
+           "qos %d ==\n",
+           cfg.devices, elapsed_s, cfg.wake_per_min, cfg.utterance_ms, cfg.agg_frames, cfg.chunk_samples,
+           cfg.telemetry_ms, cfg.qos);
+    printf("audio: sessions=%u done=%u wakes=%u busy=%u connect_fail=%u send_fail=%u drain_timeout=%u late=%u\n",
+           st.sessions, st.sessions_done, st.wakes, st.wakes_busy, st.connect_fail, st.send_fail, st.drain_timeouts,
+           st.late_packets);
+    printf("audio: %.1f kB/s, %.1f packets/s (%.2f realtime streams)\n", st.audio_bytes / 1024.0 / elapsed_s,
+           st.audio_packets / elapsed_s, st.audio_bytes / elapsed_s / (SAMPLE_RATE * 2));
+    if (cfg.mqtt) {
+        printf("mqtt: connects=%u connect_fail=%u disconnects=%u publishes=%llu acks=%llu %.1f msg/s %.1f kB/s\n",
+               st.mqtt_connects, st.mqtt_connect_fail, st.mqtt_disconnects, (unsigned long long)st.mqtt_publishes,
+               (unsigned long long)st.mqtt_acks, st.mqtt_publishes / elapsed_s, st.mqtt_bytes / 1024.0 / elapsed_s);
+    }
+    NamedMetric metrics[] = {{"connect_ms", &st.connect_ms},
+                             {"drain_ms", &st.drain_ms},
+                             {"queued_kb", &st.queued_kb},
+                             {"puback_ms", &st.puback_ms}};
+    printf("%-12s %7s %9s %9s %9s %9s\n", "metric", "n", "p50", "p90", "p99", "max");
+    for (NamedMetric& m : metrics) {
+        if (m.values->empty()) {
+            printf("%-12s %7s\n", m.name, "-");
+            continue;
+        }
+        printf("%-12s %7zu %9.2f %9.2f %9.2f %9.2f\n", m.name, m.values->size(), percentile(*m.values, 50),
+               percentile(*m.values, 90), percentile(*m.values, 99), percentile(*m.values, 100));
+    }
+
+    if (!cfg.json_path) return;
+    FILE* f = fopen(cfg.json_path, "w");
+    if (!f) {
+        perror(cfg.json_path);
+        return;
+    }
+    fprintf(f, "{\"devices\":%d,\"elapsed_s\":%.1f,\"wake_per_min\":%.2f,\"utterance_ms\":%d,\"agg_frames\":%d,"
+               "\"chunk_samples\":%d,\"telemetry_ms\":%d,\"qos\":%d,\"sessions\":%u,\"sessions_done\":%u,"
+               "\"connect_fail\":%u,\"send_fail\":%u,\"drain_timeouts\":%u,\"late_packets\":%u,"
+               "\"audio_kBps\":%.2f,\"mqtt_connect_fail\":%u,\"mqtt_disconnects\":%u,\"mqtt_msgps\":%.2f",
+            cfg.devices, elapsed_s, cfg.wake_per_min, cfg.utterance_ms, cfg.agg_frames, cfg.chunk_samples,
+            cfg.telemetry_ms, cfg.qos, st.sessions, st.sessions_done, st.connect_fail, st.send_fail,
+            st.drain_timeouts, st.late_packets, st.audio_bytes / 1024.0 / elapsed_s, st.mqtt_connect_fail,
+            st.mqtt_disconnects, st.mqtt_publishes / elapsed_s);
+    for (NamedMetric& m : metrics) {
+        fprintf(f, ",\"%s\":{\"n\":%zu,\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"max\":%.3f}", m.name,
+                m.values->size(), percentile(*m.values, 50), percentile(*m.values, 90), percentile(*m.values, 99),
+                percentile(*m.values, 100));
+    }
+    fprintf(f, "}\n");
+    fclose(f);
+}
+
+static void on_signal(int) { stop_requested = 1; }
+
+static bool parse_host_port(const char* arg, std::string* host, int* port) {
+    std::string s = arg;
+    size_t colon = s.rfind(':');
+    if (colon == std::string::npos) return false;
+    *host = s.substr(0, colon);
+    *port = atoi(s.c_str() + colon + 1);
+    return *port > 0;
+}
+
+static int usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s [--devices N] [--duration S] [--audio host:port] [--mqtt host:port|none]\n"
+            "          [--wake-per-min R] [--utterance-ms MS] [--agg-frames N] [--chunk-samples N]\n"
+            "          [--telemetry-ms MS] [--topic T] [--qos 0|1] [--no-timestamps] [--seed N] [--json FILE]\n",
+            argv0);
+    return 2;
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        bool v = i + 1 < argc;
+        if (a == "--devices" && v) cfg.devices = atoi(argv[++i]);
+        else if (a == "--duration" && v) cfg.duration_s = atof(argv[++i]);
+        else if (a == "--audio" && v) {
+            if (!parse_host_port(argv[++i], &cfg.audio_host, &cfg.audio_port)) return usage(argv[0]);
+        } else if (a == "--mqtt" && v) {
+            std::string m = argv[++i];
+            cfg.mqtt = m != "none";
+            if (cfg.mqtt && !parse_host_port(m.c_str(), &cfg.mqtt_host, &cfg.mqtt_port)) return usage(argv[0]);
+        } else if (a == "--wake-per-min" && v) cfg.wake_per_min = atof(argv[++i]);
+        else if (a == "--utterance-ms" && v) cfg.utterance_ms = atoi(argv[++i]);
+        else if (a == "--agg-frames" && v) cfg.agg_frames = atoi(argv[++i]);
+        else if (a == "--chunk-samples" && v) cfg.chunk_samples = atoi(argv[++i]);
+        else if (a == "--telemetry-ms" && v) cfg.telemetry_ms = atoi(argv[++i]);
+        else if (a == "--topic" && v) cfg.topic = argv[++i];
+        else if (a == "--qos" && v) cfg.qos = atoi(argv[++i]) > 0 ? 1 : 0;
+        else if (a == "--no-timestamps") cfg.timestamps = false;
+        else if (a == "--seed" && v) cfg.seed = (unsigned)atoi(argv[++i]);
+        else if (a == "--json" && v) cfg.json_path = argv[++i];
+        else return usage(argv[0]);
+    }
+    if (cfg.devices <= 0 || cfg.agg_frames <= 0 || cfg.chunk_samples <= 0 || cfg.telemetry_ms <= 0 ||
+        packet_samples() * 2 > 0xffff) {
+        fprintf(stderr, "invalid sizes (AUD0 payload is limited to 64 KiB)\n");
+        return 2;
+    }
+    if (!resolve(cfg.audio_host, cfg.audio_port, &audio_addr) ||
+        (cfg.mqtt && !resolve(cfg.mqtt_host, cfg.mqtt_port, &mqtt_addr))) {
+        fprintf(stderr, "cannot resolve target\n");
+        return 1;
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    // Ten seconds of a 300 Hz tone at the AGC's working level.
+    pcm_source.resize(SAMPLE_RATE * 10);
+    for (size_t i = 0; i < pcm_source.size(); i++) {
+        pcm_source[i] = (int16_t)(4000 * sin(2 * M_PI * 300 * i / SAMPLE_RATE));
+    }
+
+    int64_t start = now_us();
+    std::vector<Device> devices(cfg.devices);
+    std::mt19937 seeder(cfg.seed);
+    for (int i = 0; i < cfg.devices; i++) {
+        Device& d = devices[i];
+        d.id = i;
+        d.rng.seed(seeder());
+        d.clock_offset = start - (int64_t)(d.rng() % 100000000);
+        d.reading.temperature = 24;
+        d.reading.humidity = 55;
+        d.reading.gas_raw = 900;
+        schedule_wake(d, start);
+        std::uniform_int_distribution<int> ramp(0, 1000);
+        d.mqtt_retry_at = cfg.mqtt ? start + (int64_t)ramp(d.rng) * 1000 : INT64_MAX;
+    }
+
+    int64_t end = start + (int64_t)(cfg.duration_s * 1e6);
+    int64_t next_sample = start + 1000000;
+    std::vector<struct pollfd> fds;
+    std::vector<std::pair<int, bool>> owners; // device index, is_audio
+    while (!stop_requested) {
+        int64_t now = now_us();
+        if (now >= end) break;
+        for (Device& d : devices) {
+            audio_timers(d, now);
+            if (cfg.mqtt) mqtt_timers(d, now);
+        }
+        if (now >= next_sample) {
+            for (Device& d : devices) {
+                if (d.astate == AUDIO_STREAMING || d.astate == AUDIO_DRAINING) st.queued_kb.push_back(audio_queued_kb(d));
+            }
+            next_sample += 1000000;
+        }
+
+        fds.clear();
+        owners.clear();
+        for (int i = 0; i < cfg.devices; i++) {
+            Device& d = devices[i];
+            if (d.afd >= 0) {
+                short ev = POLLIN;
+                if (d.astate == AUDIO_CONNECTING || !d.aout.empty()) ev |= POLLOUT;
+                fds.push_back({d.afd, ev, 0});
+                owners.emplace_back(i, true);
+            }
+            if (d.mfd >= 0) {
+                short ev = POLLIN;
+                if (d.mstate == MQTT_CONNECTING || !d.mout.empty()) ev |= POLLOUT;
+                fds.push_back({d.mfd, ev, 0});
+                owners.emplace_back(i, false);
+            }
+        }
+        if (poll(fds.data(), fds.size(), 5) < 0 && errno != EINTR) {
+            perror("poll");
+            break;
+        }
+        now = now_us();
+        for (size_t i = 0; i < fds.size(); i++) {
+            Device& d = devices[owners[i].first];
+            // Timers may have pushed data since poll() was armed; flush it too.
+            short revents = fds[i].revents;
+            if (owners[i].second) {
+                if (d.afd == fds[i].fd && (revents || !d.aout.empty())) audio_io(d, revents, now);
+            } else {
+                if (d.mfd == fds[i].fd && (revents || !d.mout.empty())) mqtt_io(d, revents, now);
+            }
+        }
+    }
+
+    double elapsed_s = (now_us() - start) / 1e6;
+    for (Device& d : devices) {
+        if (d.afd >= 0) close(d.afd);
+        if (d.mfd >= 0) close(d.mfd);
+    }
+    print_report(elapsed_s);
+    return 0;
+}
@@ -0,0 +1,223 @@
+// Host reference for the firmware's fixed-point log-mel front end
+// (main/smart_home_mqtt/log_mel.cpp). Runs the firmware code and an
+// independent double-precision model on the same signals and compares
+// them bin by bin.
+//
+// Build: g++ -O2 -std=c++17 -I../main/smart_home_mqtt log_mel_check.cpp ../main/smart_home_mqtt/log_mel.cpp
+//            -o log_mel_check
+//
+//   log_mel_check             accuracy check, exit status 1 on failure
+//   log_mel_check --bench     frames per second of the fixed-point path
+//   log_mel_check --dump f.raw  print frames for a 16 kHz int16 raw file
+//
+// Only bins within DYNAMIC_RANGE_DB of the frame's loudest bin are judged:
+// below that the Q15 FFT's rounding floor dominates, and Whisper clamps
+// its log-mel to 80 dB under the maximum anyway. This checks the C FFT;
+// the esp-dsp path scales every stage and is coarser on quiet bins.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "log_mel.h"
+
+static const double DYNAMIC_RANGE_DB = 50.0;
+static const double MAX_ERR_DB = 0.5;   // any judged bin
+static const double MEAN_ERR_DB = 0.05; // over all judged bins of a signal
+
+// ---- double-precision model ----
+
+static double slaney_hz_to_mel(double hz) {
+    if (hz < 1000.0) return 3.0 * hz / 200.0;
+    return 15.0 + 27.0 * std::log(hz / 1000.0) / std::log(6.4);
+}
+
+static double slaney_mel_to_hz(double mel) {
+    if (mel < 15.0) return 200.0 * mel / 3.0;
+    return 1000.0 * std::exp((mel - 15.0) * std::log(6.4) / 27.0);
+}
+
+struct Reference {
+    std::vector<std::vector<double>> filters; // [bin][fft bin]
+    std::vector<double> window;
+
+    Reference() {
+        const int spectrum = LOG_MEL_FFT_SIZE / 2 + 1;
+        window.resize(LOG_MEL_WINDOW);
+        for (int i = 0; i < LOG_MEL_WINDOW; i++) window[i] = 0.5 - 0.5 * std::cos(2 * M_PI * i / LOG_MEL_WINDOW);
+        std::vector<double> edges(LOG_MEL_BINS + 2);
+        double top = slaney_hz_to_mel(LOG_MEL_SAMPLE_RATE / 2.0);
+        for (int i = 0; i < LOG_MEL_BINS + 2; i++) edges[i] = slaney_mel_to_hz(top * i / (LOG_MEL_BINS + 1));
+        filters.assign(LOG_MEL_BINS, std::vector<double>(spectrum, 0.0));
+        for (int m = 0; m < LOG_MEL_BINS; m++) {
+            double norm = 2.0 / (edges[m + 2] - edges[m]);
+            for (int k = 0; k < spectrum; k++) {
+                double hz = (double)k * LOG_MEL_SAMPLE_RATE / LOG_MEL_FFT_SIZE;
+                double w = std::min((hz - edges[m]) / (edges[m + 1] - edges[m]),
+                                    (edges[m + 2] - hz) / (edges[m + 2] - edges[m + 1]));
+                filters[m][k] = std::max(0.0, w) * norm;
+            }
+        }
+    }
+
+    static void fft(std::vector<std::complex<double>>& a) {
+        size_t n = a.size();
+        for (size_t i = 1, j = 0; i < n; i++) {
+            size_t bit = n >> 1;
+            for (; j & bit; bit >>= 1) j ^= bit;
+            j ^= bit;
+            if (i < j) std::swap(a[i], a[j]);
+        }
+        for (size_t len = 2; len <= n; len <<= 1) {
+            std::complex<double> wl = std::polar(1.0, -2 * M_PI / len);
+            for (size_t i = 0; i < n; i += len) {
+                std::complex<double> w = 1;
+                for (size_t k = 0; k < len / 2; k++, w *= wl) {
+                    std::complex<double> t = a[i + k + len / 2] * w;
+                    a[i + k + len / 2] = a[i + k] - t;
+                    a[i + k] += t;
+                }
+            }
+        }
+    }
+
+    // log2 mel power of one frame, same units as the firmware output / 256.
+    std::vector<double> frame(const int16_t* x) const {
+        std::vector<std::complex<double>> a(LOG_MEL_FFT_SIZE, 0.0);
+        for (int i = 0; i < LOG_MEL_WINDOW; i++) a[i] = x[i] * window[i];
+        fft(a);
+        std::vector<double> out(LOG_MEL_BINS);
+        for (int m = 0; m < LOG_MEL_BINS; m++) {
+            double acc = 0;
+            for (size_t k = 0; k < filters[m].size(); k++) acc += filters[m][k] * std::norm(a[k]);
+            out[m] = std::log2(std::max(acc, 1e-12));
+        }
+        return out;
+    }
+};
+
+// ---- signals ----
+
+static std::vector<int16_t> make_signal(const std::string& name, int samples, std::mt19937& rng) {
+    std::vector<int16_t> s(samples);
+    std::normal_distribution<double> noise(0.0, 1.0);
+    auto clip = [](double v) { return (int16_t)std::max(-32768.0, std::min(32767.0, std::round(v))); };
+    for (int i = 0; i < samples; i++) {
+        double t = (double)i / LOG_MEL_SAMPLE_RATE;
+        double v = 0;
+        if (name == "tone_1k_-6dB") v = 16384 * std::sin(2 * M_PI * 1000 * t);
+        else if (name == "tone_250_-30dB") v = 1036 * std::sin(2 * M_PI * 250 * t);
+        else if (name == "tone_6k_-60dB") v = 33 * std::sin(2 * M_PI * 6000 * t);
+        else if (name == "chirp_-12dB") v = 8192 * std::sin(2 * M_PI * (50 * t + 3950 * t * t / 2));
+        else if (name == "white_-20dB") v = 3277 * noise(rng);
+        else if (name == "quiet_noise") v = 4 * noise(rng);
+        else if (name == "speechlike") {
+            // Harmonic stack at 120 Hz with a 4 Hz syllable envelope.
+            double env = 0.5 + 0.5 * std::sin(2 * M_PI * 4 * t);
+            for (int h = 1; h <= 30; h++) v += std::sin(2 * M_PI * 120 * h * t) / h;
+            v = 6000 * env * v + 200 * noise(rng);
+        } else if (name == "clipped_square") v = (std::sin(2 * M_PI * 440 * t) >= 0 ? 32767 : -32768);
+        s[i] = clip(v);
+    }
+    return s;
+}
+
+static int run_check() {
+    if (!log_mel_init()) {
+        fprintf(stderr, "log_mel_init failed\n");
+        return 1;
+    }
+    Reference ref;
+    std::mt19937 rng(7);
+    const char* names[] = {"tone_1k_-6dB", "tone_250_-30dB", "tone_6k_-60dB", "chirp_-12dB",
+                           "white_-20dB",  "quiet_noise",    "speechlike",    "clipped_square"};
+    const double db_per_log2 = 10.0 * std::log10(2.0);
+    bool ok = true;
+    printf("%-16s %7s %8s %9s %9s\n", "signal", "frames", "judged", "mean_dB", "max_dB");
+    for (const char* name : names) {
+        std::vector<int16_t> sig = make_signal(name, LOG_MEL_SAMPLE_RATE, rng);
+        log_mel_reset();
+        // Odd push sizes exercise the history buffer.
+        std::vector<int16_t> out;
+        int16_t frame_out[LOG_MEL_BINS * 8];
+        for (size_t pos = 0; pos < sig.size();) {
+            int n = std::min<int>(509, (int)(sig.size() - pos));
+            int f = log_mel_push(&sig[pos], n, frame_out);
+            out.insert(out.end(), frame_out, frame_out + f * LOG_MEL_BINS);
+            pos += n;
+        }
+        int nframes = (int)out.size() / LOG_MEL_BINS;
+        double sum = 0, worst = 0;
+        long judged = 0;
+        for (int fi = 0; fi < nframes; fi++) {
+            std::vector<double> want = ref.frame(&sig[fi * LOG_MEL_HOP]);
+            double top = *std::max_element(want.begin(), want.end());
+            for (int m = 0; m < LOG_MEL_BINS; m++) {
+                if ((top - want[m]) * db_per_log2 > DYNAMIC_RANGE_DB) continue;
+                double err = std::fabs(out[fi * LOG_MEL_BINS + m] / 256.0 - want[m]) * db_per_log2;
+                sum += err;
+                worst = std::max(worst, err);
+                judged++;
+            }
+        }
+        double mean = judged ? sum / judged : 0;
+        bool pass = judged > 0 && worst <= MAX_ERR_DB && mean <= MEAN_ERR_DB;
+        ok = ok && pass;
+        printf("%-16s %7d %8ld %9.3f %9.3f %s\n", name, nframes, judged, mean, worst, pass ? "" : "FAIL");
+    }
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+static int run_bench() {
+    log_mel_init();
+    std::mt19937 rng(1);
+    std::vector<int16_t> sig = make_signal("speechlike", LOG_MEL_SAMPLE_RATE * 60, rng);
+    std::vector<int16_t> out(LOG_MEL_BINS * log_mel_max_frames(512));
+    log_mel_reset();
+    auto t0 = std::chrono::steady_clock::now();
+    long nframes = 0;
+    for (size_t pos = 0; pos + 512 <= sig.size(); pos += 512) nframes += log_mel_push(&sig[pos], 512, out.data());
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    printf("%ld frames in %.3f s: %.0f frames/s, %.2f us/frame (%.0fx real time)\n", nframes, s, nframes / s,
+           s * 1e6 / nframes, nframes * (double)LOG_MEL_HOP / LOG_MEL_SAMPLE_RATE / s);
+    return 0;
+}
+
+static int run_dump(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return 1;
+    }
+    log_mel_init();
+    int16_t pcm[512];
+    int16_t out[LOG_MEL_BINS * 8];
+    size_t n;
+    while ((n = fread(pcm, sizeof(int16_t), 512, f)) > 0) {
+        int frames = log_mel_push(pcm, (int)n, out);
+        for (int fi = 0; fi < frames; fi++) {
+            for (int m = 0; m < LOG_MEL_BINS; m++) printf("%s%.2f", m ? " " : "", out[fi * LOG_MEL_BINS + m] / 256.0);
+            printf("\n");
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) return run_bench();
+    if (argc > 2 && strcmp(argv[1], "--dump") == 0) return run_dump(argv[2]);
+    if (argc > 1) {
+        fprintf(stderr, "usage: %s [--bench | --dump pcm16.raw]\n", argv[0]);
+        return 2;
+    }
+    return run_check();
+}
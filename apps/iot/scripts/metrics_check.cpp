@@ -0,0 +1,309 @@
+// Host check for the /metrics exporter (main/smart_home_mqtt/metrics.cpp)
+// behind a recording stand-in for esp_http_server. Scrapes twice, once
+// with known values and once with every counter, gauge and bucket at its
+// widest, and checks the Prometheus text:
+//   - every chunk is one whole family that fits METRICS_CHUNK_MAX, and
+//     the exporter logged no truncation
+//   - HELP/TYPE once per family, families contiguous, names and help
+//     texts within METRICS_NAME_MAX / METRICS_HELP_MAX
+//   - counters sum both cores; histogram buckets are cumulative, +Inf
+//     equals _count, and _sum survives totals past 2^32 us
+//
+// Build: g++ -O2 -std=c++17 -Ihost_stubs -I../main/smart_home_mqtt metrics_check.cpp
+//            ../main/smart_home_mqtt/metrics.cpp -o metrics_check
+//
+//   metrics_check           run the checks, exit status 1 on failure
+//   metrics_check --print   also print the first scrape
+
+#include <cinttypes>
+#include <climits>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "metrics.h"
+#include "task_plan.h"
+
+// ---- stand-ins for the ESP-IDF calls metrics.cpp makes ----
+
+static esp_err_t (*handler)(httpd_req_t *req) = NULL;
+static std::vector<std::string> chunks;
+static bool response_done = false;
+static int warnings = 0;
+static int core = 0;
+
+void esp_log_host(char level, const char *tag, const char *fmt, ...) {
+    if (level != 'W' && level != 'E') {
+        return;
+    }
+    warnings++;
+    va_list args;
+    va_start(args, fmt);
+    printf("%c %s: ", level, tag);
+    vprintf(fmt, args);
+    printf("\n");
+    va_end(args);
+}
+
+BaseType_t xPortGetCoreID(void) {
+    return core;
+}
+
+uint32_t esp_get_free_heap_size(void) {
+    return 123456;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void) {
+    return 100000;
+}
+
+int64_t esp_timer_get_time(void) {
+    return 3600LL * 1000000;
+}
+
+const task_spec_t *task_plan_get(task_id_t id) {
+    static const task_spec_t spec = {"httpd", 4096, 2, 0};
+    return id == TASK_ID_METRICS ? &spec : NULL;
+}
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config) {
+    *handle = (httpd_handle_t)config;
+    return ESP_OK;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t, const httpd_uri_t *uri) {
+    handler = uri->handler;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *, const char *) {
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t *, const char *buf, ssize_t len) {
+    if (!buf) {
+        response_done = true;
+    } else {
+        chunks.push_back(std::string(buf, len));
+    }
+    return ESP_OK;
+}
+
+// ---- checks ----
+
+static int failures = 0;
+
+static void fail(const std::string &what) {
+    if (failures++ < 20) {
+        printf("FAIL %s\n", what.c_str());
+    }
+}
+
+static std::string scrape() {
+    chunks.clear();
+    response_done = false;
+    warnings = 0;
+    httpd_req_t req = {};
+    if (handler(&req) != ESP_OK || !response_done) {
+        fail("handler did not finish the response");
+    }
+    std::string text;
+    for (const std::string &c : chunks) {
+        if (c.size() >= METRICS_CHUNK_MAX) {
+            fail("chunk of " + std::to_string(c.size()) + " bytes fills the buffer");
+        }
+        if (c.empty() || c.back() != '\n' || c.compare(0, 7, "# HELP ") != 0) {
+            fail("chunk is not one whole family: " + c.substr(0, 60));
+        }
+        text += c;
+    }
+    if (warnings) {
+        fail("exporter logged " + std::to_string(warnings) + " warnings");
+    }
+    return text;
+}
+
+static std::vector<std::string> split_lines(const std::string &text) {
+    std::vector<std::string> lines;
+    size_t start = 0;
+    for (size_t end; (end = text.find('\n', start)) != std::string::npos; start = end + 1) {
+        lines.push_back(text.substr(start, end - start));
+    }
+    return lines;
+}
+
+// Families, their types and the samples by full series name.
+struct exposition_t {
+    std::map<std::string, std::string> types;
+    std::map<std::string, std::string> samples;
+    std::vector<std::string> bucket_order; // histogram bucket series in output order
+};
+
+static exposition_t parse(const std::string &text) {
+    exposition_t e;
+    std::set<std::string> closed;
+    std::string family;
+    for (const std::string &line : split_lines(text)) {
+        if (line.compare(0, 7, "# HELP ") == 0) {
+            size_t sp = line.find(' ', 7);
+            std::string name = line.substr(7, sp - 7);
+            std::string help = sp == std::string::npos ? "" : line.substr(sp + 1);
+            if (name.size() > METRICS_NAME_MAX) {
+                fail("name longer than METRICS_NAME_MAX: " + name);
+            }
+            if (help.empty() || help.size() > METRICS_HELP_MAX) {
+                fail("help missing or longer than METRICS_HELP_MAX: " + name);
+            }
+            if (closed.count(name) || e.types.count(name)) {
+                fail("family split or repeated: " + name);
+            }
+            if (!family.empty()) {
+                closed.insert(family);
+            }
+            family = name;
+        } else if (line.compare(0, 7, "# TYPE ") == 0) {
+            size_t sp = line.find(' ', 7);
+            std::string name = line.substr(7, sp - 7);
+            if (name != family) {
+                fail("TYPE without its HELP: " + name);
+            }
+            e.types[name] = line.substr(sp + 1);
+        } else {
+            size_t sp = line.rfind(' ');
+            std::string series = line.substr(0, sp);
+            if (series.compare(0, family.size(), family) != 0) {
+                fail("sample outside its family: " + line);
+            }
+            if (e.samples.count(series)) {
+                fail("duplicate series: " + series);
+            }
+            e.samples[series] = line.substr(sp + 1);
+            if (series.find("_bucket{") != std::string::npos) {
+                e.bucket_order.push_back(series);
+            }
+        }
+    }
+    return e;
+}
+
+static void check_histograms(const exposition_t &e) {
+    for (const auto &t : e.types) {
+        if (t.second != "histogram") {
+            continue;
+        }
+        const std::string &name = t.first;
+        uint64_t prev = 0;
+        int buckets = 0;
+        for (const std::string &series : e.bucket_order) {
+            if (series.compare(0, name.size() + 8, name + "_bucket{") != 0) {
+                continue;
+            }
+            uint64_t v = strtoull(e.samples.at(series).c_str(), NULL, 10);
+            if (v < prev) {
+                fail("buckets not cumulative: " + series);
+            }
+            prev = v;
+            buckets++;
+        }
+        if (buckets != METRICS_HISTOGRAM_BUCKETS) {
+            fail("bucket count of " + name);
+        }
+        auto inf = e.samples.find(name + "_bucket{le=\"+Inf\"}");
+        auto count = e.samples.find(name + "_count");
+        if (inf == e.samples.end() || count == e.samples.end() || inf->second != count->second) {
+            fail("+Inf bucket and _count differ for " + name);
+        }
+        if (!e.samples.count(name + "_sum")) {
+            fail("no _sum for " + name);
+        }
+    }
+}
+
+static void expect_sample(const exposition_t &e, const std::string &series, const std::string &want) {
+    auto it = e.samples.find(series);
+    if (it == e.samples.end()) {
+        fail("missing " + series);
+    } else if (it->second != want) {
+        fail(series + " is " + it->second + ", want " + want);
+    }
+}
+
+int main(int argc, char **argv) {
+    bool print = argc > 1 && strcmp(argv[1], "--print") == 0;
+    if (!metrics_http_start(9100) || !handler) {
+        printf("FAIL metrics_http_start\n");
+        return 1;
+    }
+
+    // Known values, spread over both cores.
+    for (int i = 0; i < 1000; i++) {
+        core = i & 1;
+        metrics_counter_add(METRIC_AUDIO_BYTES, 640);
+        metrics_counter_inc(METRIC_TCP_SEND_FAILURES);
+    }
+    // 2000 x 5 s = 1e10 us, well past 2^32.
+    for (int i = 0; i < 2000; i++) {
+        core = i & 1;
+        metrics_histogram_observe(METRIC_SENSOR_READ_US, 5000000);
+    }
+    core = 0;
+    metrics_histogram_observe(METRIC_TCP_SEND_US, 700);
+    metrics_histogram_observe(METRIC_TCP_SEND_US, 300000);
+    metrics_gauge_set(METRIC_AUDIO_AGC_GAIN_Q8, 512);
+
+    std::string text = scrape();
+    if (print) {
+        fputs(text.c_str(), stdout);
+    }
+    exposition_t e = parse(text);
+    check_histograms(e);
+    expect_sample(e, "smart_home_audio_bytes_total", "640000");
+    expect_sample(e, "smart_home_tcp_failures_total{op=\"send\"}", "1000");
+    expect_sample(e, "smart_home_tcp_failures_total{op=\"connect\"}", "0");
+    expect_sample(e, "smart_home_sensor_read_seconds_sum", "10000.000000");
+    expect_sample(e, "smart_home_sensor_read_seconds_count", "2000");
+    expect_sample(e, "smart_home_tcp_send_seconds_bucket{le=\"0.001\"}", "1");
+    expect_sample(e, "smart_home_tcp_send_seconds_bucket{le=\"0.2\"}", "1");
+    expect_sample(e, "smart_home_tcp_send_seconds_bucket{le=\"+Inf\"}", "2");
+    expect_sample(e, "smart_home_audio_agc_gain_q8", "512");
+    expect_sample(e, "smart_home_uptime_seconds", "3600");
+    size_t families = e.types.size();
+
+    // Widest values: counters just under the wrap, negative gauges, every
+    // bucket and the sums far from zero.
+    for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+        uint32_t have = metrics_counter_get((metric_counter_t)i);
+        metrics_counter_add((metric_counter_t)i, UINT32_MAX - 9 - have);
+    }
+    for (int i = 0; i < METRIC_GAUGE_COUNT; i++) {
+        metrics_gauge_set((metric_gauge_t)i, INT32_MIN);
+    }
+    for (int i = 0; i < METRIC_HISTOGRAM_COUNT; i++) {
+        for (int k = 0; k < 4000; k++) {
+            core = k & 1;
+            metrics_histogram_observe((metric_histogram_t)i, k % 2 ? UINT32_MAX : 1000 * k);
+        }
+    }
+    std::string wide = scrape();
+    exposition_t w = parse(wide);
+    check_histograms(w);
+    if (w.types.size() != families) {
+        fail("family count changed between scrapes");
+    }
+    size_t largest = 0;
+    for (const std::string &c : chunks) {
+        largest = c.size() > largest ? c.size() : largest;
+    }
+
+    printf("%zu families, largest chunk %zu of %d bytes\n", families, largest, METRICS_CHUNK_MAX);
+    printf("%s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,514 @@
+// Delta generator for the firmware's streaming OTA (format in
+// main/smart_home_mqtt/ota_delta.h). Produces the delta between the
+// image a board runs and a new build, and checks it by applying it with
+// the firmware's own decoder.
+//
+// Build: g++ -O2 -std=c++17 -I../main/smart_home_mqtt ota_delta.cpp
+//            ../main/smart_home_mqtt/ota_delta.cpp -o ota_delta
+//
+//   ota_delta old.bin new.bin out.delta   write the delta
+//   ota_delta --apply old.bin in.delta out.bin
+//   ota_delta --check [old.bin new.bin]   generate, apply in random-sized
+//                                         pieces and compare; without
+//                                         files on synthetic images.
+//                                         Exit status 1 on failure.
+//
+// Serve the delta over HTTPS with a certificate the board's CA bundle
+// accepts (plain HTTP needs SMART_HOME_OTA_ALLOW_HTTP) and publish its URL
+// to <ota topic>/set; old.bin must be the exact build the board runs.
+//
+// Matching is greedy: a 12-byte hash finds an exact seed in the old
+// image, then the match is extended with its offset kept while at most
+// MISS_MAX of the last MISS_WINDOW bytes differ. Those differences
+// (relocated addresses, mostly) go out as ADD runs, unmatched bytes as
+// INSERT. There is no entropy coder, so the delta is smaller than the
+// image only by what the old image already holds.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ota_delta.h"
+
+typedef std::vector<uint8_t> bytes;
+
+static const size_t SEED = 12;
+static const int HASH_BITS = 20;
+static const int CHAIN_LIMIT = 64;
+static const size_t MIN_MATCH = 24;  // shorter matches cost more than an INSERT
+static const size_t MISS_WINDOW = 32;
+static const size_t MISS_MAX = 12;
+static const size_t RUN_BREAK = 4;   // equal bytes worth a new run header
+
+// ---- SHA-256 (FIPS 180-4) ----
+
+static const uint32_t SHA_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static uint32_t ror(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+static void sha256_block(uint32_t h[8], const uint8_t *p) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 | (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ror(w[i - 15], 7) ^ ror(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ror(w[i - 2], 17) ^ ror(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], k = h[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = k + (ror(e, 6) ^ ror(e, 11) ^ ror(e, 25)) + ((e & f) ^ (~e & g)) + SHA_K[i] + w[i];
+        uint32_t t2 = (ror(a, 2) ^ ror(a, 13) ^ ror(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        k = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    h[0] += a, h[1] += b, h[2] += c, h[3] += d, h[4] += e, h[5] += f, h[6] += g, h[7] += k;
+}
+
+static void sha256(const bytes &data, uint8_t out[32]) {
+    uint32_t h[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    size_t full = data.size() / 64 * 64;
+    for (size_t i = 0; i < full; i += 64) {
+        sha256_block(h, &data[i]);
+    }
+    uint8_t tail[128] = {};
+    size_t rest = data.size() - full;
+    if (rest) {
+        memcpy(tail, data.data() + full, rest);
+    }
+    tail[rest] = 0x80;
+    size_t tail_len = rest < 56 ? 64 : 128;
+    uint64_t bits = (uint64_t)data.size() * 8;
+    for (int i = 0; i < 8; i++) {
+        tail[tail_len - 1 - i] = (uint8_t)(bits >> (8 * i));
+    }
+    for (size_t i = 0; i < tail_len; i += 64) {
+        sha256_block(h, tail + i);
+    }
+    for (int i = 0; i < 8; i++) {
+        out[4 * i] = (uint8_t)(h[i] >> 24);
+        out[4 * i + 1] = (uint8_t)(h[i] >> 16);
+        out[4 * i + 2] = (uint8_t)(h[i] >> 8);
+        out[4 * i + 3] = (uint8_t)h[i];
+    }
+}
+
+// ---- generator ----
+
+static void put_u32(bytes &out, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back((uint8_t)(v >> (8 * i)));
+    }
+}
+
+static void put_u16(bytes &out, uint16_t v) {
+    out.push_back((uint8_t)v);
+    out.push_back((uint8_t)(v >> 8));
+}
+
+static uint32_t seed_hash(const uint8_t *p) {
+    uint64_t h = 0;
+    for (size_t i = 0; i < SEED; i++) {
+        h = h * 0x100000001b3ULL + p[i];
+    }
+    return (uint32_t)(h >> (64 - HASH_BITS)) & ((1u << HASH_BITS) - 1);
+}
+
+struct Stats {
+    size_t copy = 0, add = 0, add_diff = 0, insert = 0;
+};
+
+class Generator {
+public:
+    Generator(const bytes &old_img, const bytes &new_img) : old_(old_img), new_(new_img) {
+        head_.assign(1u << HASH_BITS, UINT32_MAX);
+        next_.assign(old_.size(), UINT32_MAX);
+        for (size_t i = 0; i + SEED <= old_.size(); i++) {
+            uint32_t h = seed_hash(&old_[i]);
+            next_[i] = head_[h];
+            head_[h] = (uint32_t)i;
+        }
+    }
+
+    bytes run(Stats *stats) {
+        bytes out(OTA_DELTA_MAGIC, OTA_DELTA_MAGIC + 4);
+        put_u32(out, (uint32_t)old_.size());
+        put_u32(out, (uint32_t)new_.size());
+        uint8_t digest[32];
+        sha256(old_, digest);
+        out.insert(out.end(), digest, digest + 32);
+        sha256(new_, digest);
+        out.insert(out.end(), digest, digest + 32);
+
+        size_t p = 0;
+        size_t pending = 0; // start of bytes not matched yet
+        int64_t offset = 0; // old position - new position of the last match
+        bool aligned = false;
+        while (p < new_.size()) {
+            if (aligned) {
+                size_t len = extend(p, offset);
+                if (len >= MIN_MATCH) {
+                    emit_insert(out, pending, p, stats);
+                    emit_match(out, p, (size_t)(p + offset), len, stats);
+                    p += len;
+                    pending = p;
+                    continue;
+                }
+            }
+            size_t old_pos;
+            if (seed(p, &old_pos)) {
+                int64_t o = (int64_t)old_pos - (int64_t)p;
+                if (!aligned || o != offset) {
+                    offset = o;
+                    aligned = true;
+                    continue;
+                }
+            }
+            p++;
+        }
+        emit_insert(out, pending, p, stats);
+        out.push_back('E');
+        return out;
+    }
+
+private:
+    // Longest exact match for new[p..] among the seeds hashing like it.
+    bool seed(size_t p, size_t *old_pos) {
+        if (p + SEED > new_.size()) {
+            return false;
+        }
+        size_t best = 0;
+        int chain = 0;
+        for (uint32_t c = head_[seed_hash(&new_[p])]; c != UINT32_MAX && chain < CHAIN_LIMIT; c = next_[c], chain++) {
+            size_t n = 0;
+            while (p + n < new_.size() && c + n < old_.size() && new_[p + n] == old_[c + n]) {
+                n++;
+            }
+            if (n > best) {
+                best = n;
+                *old_pos = c;
+            }
+        }
+        return best >= SEED;
+    }
+
+    // Bytes from p that follow the old image at the given offset closely
+    // enough for ADD, ending on a matching byte.
+    size_t extend(size_t p, int64_t offset) {
+        if ((int64_t)p + offset < 0) {
+            return 0;
+        }
+        size_t o = (size_t)((int64_t)p + offset);
+        size_t limit = std::min(new_.size() - p, o < old_.size() ? old_.size() - o : 0);
+        size_t last_match = 0;
+        size_t misses = 0;
+        std::vector<uint8_t> window(MISS_WINDOW, 0);
+        for (size_t i = 0; i < limit; i++) {
+            bool miss = new_[p + i] != old_[o + i];
+            misses += miss - window[i % MISS_WINDOW];
+            window[i % MISS_WINDOW] = miss;
+            if (misses > MISS_MAX) {
+                break;
+            }
+            if (!miss) {
+                last_match = i + 1;
+            }
+        }
+        return last_match;
+    }
+
+    void emit_insert(bytes &out, size_t from, size_t to, Stats *stats) {
+        if (to <= from) {
+            return;
+        }
+        out.push_back('I');
+        put_u32(out, (uint32_t)(to - from));
+        out.insert(out.end(), new_.begin() + from, new_.begin() + to);
+        stats->insert += to - from;
+    }
+
+    void emit_match(bytes &out, size_t p, size_t o, size_t len, Stats *stats) {
+        if (memcmp(&new_[p], &old_[o], len) == 0) {
+            out.push_back('C');
+            put_u32(out, (uint32_t)o);
+            put_u32(out, (uint32_t)len);
+            stats->copy += len;
+            return;
+        }
+        out.push_back('A');
+        put_u32(out, (uint32_t)o);
+        put_u32(out, (uint32_t)len);
+        size_t i = 0;
+        while (i < len) {
+            size_t same = 0;
+            while (i + same < len && same < 0xFFFF && new_[p + i + same] == old_[o + i + same]) {
+                same++;
+            }
+            // Differing bytes up to the next stretch of RUN_BREAK equal
+            // ones; shorter equal gaps ride along as zero diffs.
+            size_t j = i + same;
+            size_t n = 0;
+            while (j + n < len && n < 0xFFFF) {
+                size_t eq = 0;
+                while (eq < RUN_BREAK && j + n + eq < len && new_[p + j + n + eq] == old_[o + j + n + eq]) {
+                    eq++;
+                }
+                if (eq == RUN_BREAK || j + n + eq == len) {
+                    break;
+                }
+                n += eq + 1;
+            }
+            if (n > 0xFFFF) {
+                n = 0xFFFF;
+            }
+            put_u16(out, (uint16_t)same);
+            put_u16(out, (uint16_t)n);
+            for (size_t k = 0; k < n; k++) {
+                out.push_back((uint8_t)(new_[p + j + k] - old_[o + j + k]));
+            }
+            stats->add_diff += n;
+            i = j + n;
+        }
+        stats->add += len;
+    }
+
+    const bytes &old_;
+    const bytes &new_;
+    std::vector<uint32_t> head_;
+    std::vector<uint32_t> next_;
+};
+
+// ---- applying, with the firmware decoder ----
+
+struct ApplyCtx {
+    const bytes *old_img;
+    bool quiet;
+    bytes out;
+    ota_delta_header_t header;
+};
+
+static bool apply_begin(void *ctx, const ota_delta_header_t *header) {
+    ApplyCtx *c = (ApplyCtx *)ctx;
+    uint8_t digest[32];
+    sha256(*c->old_img, digest);
+    if (header->old_size != c->old_img->size() || memcmp(digest, header->old_sha256, 32) != 0) {
+        if (!c->quiet) {
+            fprintf(stderr, "delta was made against a different old image\n");
+        }
+        return false;
+    }
+    c->header = *header;
+    c->out.reserve(header->new_size);
+    return true;
+}
+
+static bool apply_read_old(void *ctx, uint32_t off, uint8_t *buf, size_t len) {
+    ApplyCtx *c = (ApplyCtx *)ctx;
+    memcpy(buf, c->old_img->data() + off, len);
+    return true;
+}
+
+static bool apply_write_new(void *ctx, const uint8_t *buf, size_t len) {
+    ApplyCtx *c = (ApplyCtx *)ctx;
+    c->out.insert(c->out.end(), buf, buf + len);
+    return true;
+}
+
+// Feeds the delta in pieces of 1..max_piece bytes, as a network would.
+static bool apply(const bytes &old_img, const bytes &delta, size_t max_piece, bytes *out, bool quiet = false) {
+    ApplyCtx ctx;
+    ctx.old_img = &old_img;
+    ctx.quiet = quiet;
+    ota_delta_io_t io = {apply_begin, apply_read_old, apply_write_new, &ctx};
+    static ota_delta_t d;
+    ota_delta_init(&d, &io);
+    std::mt19937 rng((uint32_t)delta.size());
+    size_t pos = 0;
+    ota_delta_status_t status = OTA_DELTA_MORE;
+    while (pos < delta.size() && status == OTA_DELTA_MORE) {
+        size_t n = std::min(delta.size() - pos, (size_t)(rng() % max_piece) + 1);
+        status = ota_delta_feed(&d, &delta[pos], n);
+        pos += n;
+    }
+    if (status != OTA_DELTA_DONE) {
+        if (!quiet) {
+            if (status == OTA_DELTA_MORE) {
+                fprintf(stderr, "delta truncated at %zu bytes\n", pos);
+            } else {
+                fprintf(stderr, "decoder: %s at delta byte %zu\n", ota_delta_status_name(status), pos);
+            }
+        }
+        return false;
+    }
+    uint8_t digest[32];
+    sha256(ctx.out, digest);
+    if (memcmp(digest, ctx.header.new_sha256, 32) != 0) {
+        fprintf(stderr, "new image SHA-256 mismatch\n");
+        return false;
+    }
+    *out = std::move(ctx.out);
+    return true;
+}
+
+// ---- files and checks ----
+
+static bool read_file(const char *path, bytes *out) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    uint8_t buf[65536];
+    size_t n;
+    out->clear();
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        out->insert(out->end(), buf, buf + n);
+    }
+    fclose(f);
+    return true;
+}
+
+static bool write_file(const char *path, const bytes &data) {
+    FILE *f = fopen(path, "wb");
+    if (!f || fwrite(data.data(), 1, data.size(), f) != data.size()) {
+        perror(path);
+        if (f) {
+            fclose(f);
+        }
+        return false;
+    }
+    return fclose(f) == 0;
+}
+
+static void report(const bytes &new_img, const bytes &delta, const Stats &s) {
+    printf("new %zu bytes, delta %zu bytes (%.1f%%): copy %zu, add %zu (%zu patched), insert %zu\n",
+           new_img.size(), delta.size(), 100.0 * delta.size() / (new_img.size() ? new_img.size() : 1), s.copy,
+           s.add, s.add_diff, s.insert);
+}
+
+static bool check_pair(const char *name, const bytes &old_img, const bytes &new_img) {
+    Stats stats;
+    bytes delta = Generator(old_img, new_img).run(&stats);
+    printf("%-10s ", name);
+    report(new_img, delta, stats);
+    bool ok = true;
+    for (size_t piece : {(size_t)1, (size_t)7, (size_t)1460, (size_t)65536}) {
+        bytes out;
+        if (!apply(old_img, delta, piece, &out) || out != new_img) {
+            printf("  mismatch with pieces up to %zu bytes\n", piece);
+            ok = false;
+        }
+    }
+    // A delta must not apply to a different base.
+    bytes other = old_img;
+    if (!other.empty()) {
+        other[other.size() / 2] ^= 1;
+        bytes out;
+        if (apply(other, delta, 4096, &out, true)) {
+            printf("  applied to the wrong base\n");
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// Code-like synthetic images: the new one shifts a stretch by an insert,
+// relocates 4-byte "addresses" and deletes and replaces blocks.
+static bool check_synthetic(void) {
+    std::mt19937 rng(49);
+    bytes old_img(1 << 20);
+    for (size_t i = 0; i < old_img.size(); i++) {
+        old_img[i] = (uint8_t)(i % 64 < 48 ? rng() % 16 : rng());
+    }
+    bytes new_img(old_img.begin(), old_img.begin() + 200000);
+    bytes inserted(3000);
+    for (auto &b : inserted) {
+        b = (uint8_t)rng();
+    }
+    new_img.insert(new_img.end(), inserted.begin(), inserted.end());
+    new_img.insert(new_img.end(), old_img.begin() + 200000, old_img.begin() + 600000);
+    new_img.insert(new_img.end(), old_img.begin() + 650000, old_img.end());
+    for (size_t i = 203000; i + 4 <= new_img.size(); i += 24) {
+        new_img[i] += 0x0c; // relocated address
+    }
+    for (size_t i = 0; i < 20; i++) {
+        new_img[rng() % new_img.size()] = (uint8_t)rng();
+    }
+
+    bool ok = true;
+    ok &= check_pair("identical", old_img, old_img);
+    ok &= check_pair("edited", old_img, new_img);
+    ok &= check_pair("empty", old_img, bytes());
+    ok &= check_pair("unrelated", bytes(4096, 0x55), inserted);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 2 && strcmp(argv[1], "--check") == 0 && (argc == 2 || argc == 4)) {
+        bool ok;
+        if (argc == 2) {
+            ok = check_synthetic();
+        } else {
+            bytes old_img, new_img;
+            if (!read_file(argv[2], &old_img) || !read_file(argv[3], &new_img)) {
+                return 1;
+            }
+            ok = check_pair("images", old_img, new_img);
+        }
+        printf("%s\n", ok ? "PASS" : "FAIL");
+        return ok ? 0 : 1;
+    }
+    if (argc == 5 && strcmp(argv[1], "--apply") == 0) {
+        bytes old_img, delta, out;
+        if (!read_file(argv[2], &old_img) || !read_file(argv[3], &delta)) {
+            return 1;
+        }
+        if (!apply(old_img, delta, 4096, &out) || !write_file(argv[4], out)) {
+            return 1;
+        }
+        printf("wrote %zu bytes\n", out.size());
+        return 0;
+    }
+    if (argc == 4 && argv[1][0] != '-') {
+        bytes old_img, new_img;
+        if (!read_file(argv[1], &old_img) || !read_file(argv[2], &new_img)) {
+            return 1;
+        }
+        Stats stats;
+        bytes delta = Generator(old_img, new_img).run(&stats);
+        if (!write_file(argv[3], delta)) {
+            return 1;
+        }
+        report(new_img, delta, stats);
+        return 0;
+    }
+    fprintf(stderr,
+            "usage: %s old.bin new.bin out.delta\n"
+            "       %s --apply old.bin in.delta out.bin\n"
+            "       %s --check [old.bin new.bin]\n",
+            argv[0], argv[0], argv[0]);
+    return 2;
+}
@@ -0,0 +1,208 @@
+// Host check for the sensor summary aggregates
+// (main/smart_home_mqtt/sensor_agg.cpp) against a brute-force reference.
+// After every push each window is recomputed from the retained samples:
+// min and max must match exactly, mean to float rounding, and p50 / p95
+// must lie in the histogram bin of the exact order statistic (one linear
+// bin, or 6/64 decade for the ppm channels). Failed readings, bursts that
+// outrun the ring and long gaps are mixed in. Finally the ring is filled
+// with extreme readings and the summary must fit SENSOR_AGG_JSON_MAX.
+//
+// Build: g++ -O2 -std=c++17 -I../main/smart_home_mqtt sensor_agg_check.cpp
+//            ../main/smart_home_mqtt/sensor_agg.cpp -o sensor_agg_check
+//
+//   sensor_agg_check          run the checks, exit status 1 on failure
+//   sensor_agg_check --json   also print the worst-case summary
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "sensor_agg.h"
+
+static const int PUSHES = 6000;
+static const uint32_t WINDOW_SECONDS[SENSOR_AGG_WINDOWS] = {60, 900, 3600};
+static const char *WINDOW_NAMES[SENSOR_AGG_WINDOWS] = {"1m", "15m", "1h"};
+static const char *METRIC_NAMES[SENSOR_METRIC_COUNT] = {"temperature", "humidity", "gas_raw", "nh3", "co", "co2"};
+
+// Histogram bin width per metric, matching METRICS[] in sensor_agg.cpp.
+static const double BIN_WIDTH[SENSOR_METRIC_COUNT] = {
+    64.0 / SENSOR_AGG_BINS, 100.0 / SENSOR_AGG_BINS, 4096.0 / SENSOR_AGG_BINS,
+    6.0 / SENSOR_AGG_BINS,  6.0 / SENSOR_AGG_BINS,   6.0 / SENSOR_AGG_BINS,
+};
+static const bool LOG_SCALE[SENSOR_METRIC_COUNT] = {false, false, false, true, true, true};
+
+struct sample_t {
+    uint32_t t_s;
+    float values[SENSOR_METRIC_COUNT];
+};
+
+static std::vector<sample_t> history;
+static int failures = 0;
+
+static void fail(const char *what, int push, int w, int m, double got, double want) {
+    if (failures++ < 20) {
+        printf("FAIL push %d %s %s %s: got %.6g want %.6g\n", push, WINDOW_NAMES[w], METRIC_NAMES[m], what, got,
+               want);
+    }
+}
+
+static sample_t to_sample(const sensor_reading_t &r, uint32_t t_s) {
+    sample_t s;
+    s.t_s = t_s;
+    s.values[SENSOR_METRIC_TEMPERATURE] = r.dht_ok ? (float)r.temperature : NAN;
+    s.values[SENSOR_METRIC_HUMIDITY] = r.dht_ok ? (float)r.humidity : NAN;
+    s.values[SENSOR_METRIC_GAS_RAW] = r.gas_raw >= 0 ? (float)r.gas_raw : NAN;
+    s.values[SENSOR_METRIC_NH3] = r.gas_ok ? r.nh3 : NAN;
+    s.values[SENSOR_METRIC_CO] = r.gas_ok ? r.co : NAN;
+    s.values[SENSOR_METRIC_CO2] = r.gas_ok ? r.co2 : NAN;
+    return s;
+}
+
+// The newest SENSOR_AGG_CAPACITY samples, less those older than the window;
+// the newest sample always counts.
+static size_t window_start(int w) {
+    size_t newest = history.size() - 1;
+    size_t start = history.size() > SENSOR_AGG_CAPACITY ? history.size() - SENSOR_AGG_CAPACITY : 0;
+    while (start < newest && history[newest].t_s - history[start].t_s >= WINDOW_SECONDS[w]) {
+        start++;
+    }
+    return start;
+}
+
+static void check_quantile(const char *what, int push, int w, int m, const std::vector<float> &sorted, float q,
+                           float got) {
+    size_t rank = (size_t)ceilf(q * (float)sorted.size());
+    double want = sorted[rank == 0 ? 0 : rank - 1];
+    double err = LOG_SCALE[m] ? fabs(log10(got) - log10(want)) : fabs(got - want);
+    if (!(err <= BIN_WIDTH[m] * 1.001)) {
+        fail(what, push, w, m, got, want);
+    }
+}
+
+static void check_windows(int push) {
+    for (int w = 0; w < SENSOR_AGG_WINDOWS; w++) {
+        size_t start = window_start(w);
+        for (int m = 0; m < SENSOR_METRIC_COUNT; m++) {
+            std::vector<float> values;
+            double sum = 0.0;
+            for (size_t i = start; i < history.size(); i++) {
+                float v = history[i].values[m];
+                if (!std::isnan(v)) {
+                    values.push_back(v);
+                    sum += v;
+                }
+            }
+            sensor_agg_stats_t st;
+            bool ok = sensor_agg_get(w, (sensor_metric_t)m, &st);
+            if (ok != !values.empty() || st.n != values.size()) {
+                fail("n", push, w, m, st.n, (double)values.size());
+                continue;
+            }
+            if (values.empty()) {
+                continue;
+            }
+            std::sort(values.begin(), values.end());
+            if (st.min != values.front()) {
+                fail("min", push, w, m, st.min, values.front());
+            }
+            if (st.max != values.back()) {
+                fail("max", push, w, m, st.max, values.back());
+            }
+            double mean = sum / values.size();
+            if (fabs(st.mean - mean) > 1e-4 * std::max(1.0, fabs(mean))) {
+                fail("mean", push, w, m, st.mean, mean);
+            }
+            check_quantile("p50", push, w, m, values, 0.50f, st.p50);
+            check_quantile("p95", push, w, m, values, 0.95f, st.p95);
+        }
+    }
+}
+
+static float log_uniform(std::mt19937 &rng, float lo_exp, float hi_exp) {
+    std::uniform_real_distribution<float> e(lo_exp, hi_exp);
+    return powf(10.0f, e(rng));
+}
+
+int main(int argc, char **argv) {
+    bool print_json = argc > 1 && strcmp(argv[1], "--json") == 0;
+    if (!sensor_agg_init()) {
+        printf("FAIL sensor_agg_init\n");
+        return 1;
+    }
+
+    // Readings stay inside the histogram ranges so the bin bound holds;
+    // out-of-range values only land in the edge bins and get clamped.
+    std::mt19937 rng(12345);
+    std::uniform_int_distribution<int> temp(-10, 53), humidity(0, 99), gas_raw(0, 4095), pct(0, 99);
+    uint32_t t_s = 100;
+    for (int push = 0; push < PUSHES; push++) {
+        int phase = (push / 500) % 4;
+        int roll = pct(rng);
+        if (phase == 0) {
+            t_s += 10; // default period
+        } else if (phase == 1) {
+            t_s += 1; // faster than the ring covers in an hour
+        } else if (phase == 2) {
+            t_s += 1 + pct(rng); // jittery, some samples alone in the 1 m window
+        } else {
+            t_s += roll < 3 ? 4000 : 7; // gaps longer than every window
+        }
+
+        sensor_reading_t r = {};
+        r.dht_ok = pct(rng) >= 10;
+        r.temperature = temp(rng);
+        r.humidity = humidity(rng);
+        r.gas_ok = pct(rng) >= 15;
+        r.gas_raw = pct(rng) < 5 ? -1 : gas_raw(rng);
+        // A slowly drifting baseline with spikes, like a real room.
+        float base = 400.0f * (1.0f + 0.5f * sinf(push * 0.01f));
+        r.co2 = roll < 5 ? log_uniform(rng, -1.9f, 3.9f) : base * log_uniform(rng, -0.05f, 0.05f);
+        r.co = log_uniform(rng, -1.9f, 1.0f);
+        r.nh3 = log_uniform(rng, -1.9f, 3.9f);
+
+        sensor_agg_push(&r, t_s);
+        history.push_back(to_sample(r, t_s));
+        check_windows(push);
+    }
+    printf("%d pushes, %d mismatches\n", PUSHES, failures);
+
+    // Worst case for the summary size: every metric valid, every value far
+    // outside the clamp, the ring full and spans as long as they get.
+    t_s = 4000000000u;
+    for (int i = 0; i < SENSOR_AGG_CAPACITY; i++) {
+        bool neg = i % 3 != 0; // keeps the mean negative too
+        sensor_reading_t r = {};
+        r.dht_ok = true;
+        r.gas_ok = true;
+        r.temperature = neg ? INT_MIN : INT_MAX;
+        r.humidity = neg ? INT_MIN : INT_MAX;
+        r.gas_raw = INT_MAX;
+        r.nh3 = neg ? -FLT_MAX : FLT_MAX;
+        r.co = neg ? -FLT_MAX : FLT_MAX;
+        r.co2 = -FLT_MAX;
+        t_s += 10;
+        sensor_agg_push(&r, t_s);
+    }
+    static char json[SENSOR_AGG_JSON_MAX];
+    int len = sensor_agg_format_json(json, sizeof(json));
+    printf("worst-case summary %d of %d bytes\n", len, SENSOR_AGG_JSON_MAX);
+    if (print_json) {
+        printf("%s\n", json);
+    }
+    if (len < 0 || len >= SENSOR_AGG_JSON_MAX) {
+        printf("FAIL summary does not fit SENSOR_AGG_JSON_MAX\n");
+        failures++;
+    } else if (strstr(json, "inf") || strstr(json, "nan")) {
+        printf("FAIL summary has a non-finite value\n");
+        failures++;
+    }
+
+    printf("%s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,268 @@
+// Host check for the sensor report policy
+// (main/smart_home_mqtt/sensor_report.cpp), driven like sensor_task does:
+// a full sample every sensor_pub_ms, MQ135 polls in between, and
+// sensor_report_published() after every report that is not NONE. One
+// timeline walks through:
+//   - first sample, deadbands (absolute and relative), a failed read, and
+//     the heartbeat for an unchanged reading
+//   - ratio and CO2 alerts with their 10% hysteresis: no clear inside the
+//     band, and the alert re-arms only at the original threshold
+//   - a slope alert held for one sample period after the drop stops
+//   - a failed MQ135 read during an alert keeps it and breaks the slope
+// Every report must have QoS 1 exactly when it is an alert or a clear,
+// and the report counters (a fake metrics_counter_add) must match.
+//
+// Build: g++ -O2 -std=c++17 -Ihost_stubs -I../main/smart_home_mqtt sensor_report_check.cpp
+//            ../main/smart_home_mqtt/sensor_report.cpp -o sensor_report_check
+//
+//   sensor_report_check           run the checks, exit status 1 on failure
+//   sensor_report_check --trace   also print every decision
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "metrics.h"
+#include "sensor_report.h"
+
+static uint32_t counters[METRIC_COUNTER_COUNT];
+
+void metrics_counter_add(metric_counter_t id, uint32_t n) {
+    counters[id] += n;
+}
+
+static const metric_counter_t REPORT_METRIC[] = {
+    METRIC_SENSOR_REPORTS_SUPPRESSED, METRIC_SENSOR_REPORTS_CHANGE, METRIC_SENSOR_REPORTS_HEARTBEAT,
+    METRIC_SENSOR_REPORTS_ALERT,      METRIC_SENSOR_REPORTS_CLEAR,
+};
+
+static const int64_t SAMPLE_US = 10000000; // sensor_pub_ms
+static const int64_t HEARTBEAT_US = 60000000;
+
+static bool trace = false;
+static int failures = 0;
+static int64_t now_us = 0;
+static uint32_t expected[5];
+
+// The defaults from the PARAMS table in params.cpp.
+static params_snapshot_t defaults() {
+    params_snapshot_t p = {};
+    p.values[PARAM_SENSOR_PUBLISH_MS].i = (int32_t)(SAMPLE_US / 1000);
+    p.values[PARAM_REPORT_HEARTBEAT_MS].i = (int32_t)(HEARTBEAT_US / 1000);
+    p.values[PARAM_DEADBAND_TEMP].f = 1.0f;
+    p.values[PARAM_DEADBAND_HUMIDITY].f = 2.0f;
+    p.values[PARAM_DEADBAND_GAS_RAW].f = 20.0f;
+    p.values[PARAM_DEADBAND_PPM_ABS].f = 1.0f;
+    p.values[PARAM_DEADBAND_PPM_REL].f = 0.10f;
+    p.values[PARAM_GAS_POLL_MS].i = 1000;
+    p.values[PARAM_ALERT_RATIO].f = 1.0f;
+    p.values[PARAM_ALERT_PPM].f = 1000.0f;
+    p.values[PARAM_ALERT_SLOPE].f = 0.10f;
+    return p;
+}
+
+static params_snapshot_t params;
+
+static sensor_reading_t clean_air() {
+    sensor_reading_t r = {};
+    r.dht_ok = true;
+    r.temperature = 22;
+    r.humidity = 45;
+    r.gas_ok = true;
+    r.gas_raw = 900;
+    r.nh3 = 2.0f;
+    r.co = 1.5f;
+    r.co2 = 420.0f;
+    r.rs = 36000.0f;
+    r.ratio = 3.6f;
+    return r;
+}
+
+static void check(const char *what, sensor_report_t got, sensor_report_t want) {
+    if (trace) {
+        printf("%8.1f s %-10s %-9s %s\n", now_us / 1e6, what, sensor_report_name(got),
+               got == want ? "" : "<- unexpected");
+    }
+    if (got != want) {
+        failures++;
+        printf("FAIL %.1f s %s: got %s want %s\n", now_us / 1e6, what, sensor_report_name(got),
+               sensor_report_name(want));
+    }
+    int qos = sensor_report_qos(got);
+    if (qos != (got == SENSOR_REPORT_ALERT || got == SENSOR_REPORT_CLEAR ? 1 : 0)) {
+        failures++;
+        printf("FAIL %.1f s %s: %s at QoS %d\n", now_us / 1e6, what, sensor_report_name(got), qos);
+    }
+}
+
+static void sample(const char *what, const sensor_reading_t &r, sensor_report_t want) {
+    sensor_report_t got = sensor_report_sample(&params, &r, now_us);
+    expected[got]++;
+    check(what, got, want);
+    if (got != SENSOR_REPORT_NONE) {
+        sensor_report_published(&r, now_us);
+    }
+}
+
+// Polls never publish unless the alert changes state, and count only then.
+static void poll(const char *what, const sensor_reading_t &r, sensor_report_t want) {
+    sensor_report_t got = sensor_report_poll(&params, &r, now_us);
+    if (got != SENSOR_REPORT_NONE) {
+        expected[got]++;
+        sensor_report_published(&r, now_us);
+    }
+    check(what, got, want);
+}
+
+static void check_deadbands() {
+    sensor_reading_t r = clean_air();
+    sample("first", r, SENSOR_REPORT_CHANGE);
+    now_us += SAMPLE_US;
+    sample("same", r, SENSOR_REPORT_NONE);
+
+    now_us += SAMPLE_US;
+    r.temperature = 23; // exactly the 1.0 deadband: not a change
+    sample("temp+1", r, SENSOR_REPORT_NONE);
+    now_us += SAMPLE_US;
+    r.temperature = 24;
+    sample("temp+2", r, SENSOR_REPORT_CHANGE);
+
+    now_us += SAMPLE_US;
+    r.co2 = 455.0f; // +35 of 420: inside 10%
+    sample("co2+8%", r, SENSOR_REPORT_NONE);
+    now_us += SAMPLE_US;
+    r.co2 = 470.0f; // +50: outside
+    sample("co2+12%", r, SENSOR_REPORT_CHANGE);
+
+    now_us += SAMPLE_US;
+    r.dht_ok = false;
+    sample("dht fail", r, SENSOR_REPORT_CHANGE);
+    now_us += SAMPLE_US;
+    sample("dht fail", r, SENSOR_REPORT_NONE);
+    now_us += SAMPLE_US;
+    r.dht_ok = true;
+    sample("dht ok", r, SENSOR_REPORT_CHANGE);
+
+    // Unchanged until the heartbeat is due.
+    int64_t last_publish = now_us;
+    while (now_us + SAMPLE_US - last_publish < HEARTBEAT_US) {
+        now_us += SAMPLE_US;
+        sample("quiet", r, SENSOR_REPORT_NONE);
+    }
+    now_us += SAMPLE_US;
+    sample("hb", r, SENSOR_REPORT_HEARTBEAT);
+}
+
+// Ratio threshold 1.0, clear above 1.1; CO2 threshold 1000, clear below 900.
+static void check_hysteresis() {
+    params.values[PARAM_ALERT_SLOPE].f = 0.0f; // levels only
+    sensor_reading_t r = clean_air();
+    int64_t poll_us = 1000000;
+
+    now_us += poll_us;
+    r.ratio = 0.95f;
+    poll("ratio<1", r, SENSOR_REPORT_ALERT);
+    now_us += poll_us;
+    r.ratio = 1.05f;
+    poll("in band", r, SENSOR_REPORT_NONE);
+    now_us += SAMPLE_US;
+    sample("held", r, SENSOR_REPORT_ALERT); // every sample while it holds
+    now_us += poll_us;
+    r.ratio = 1.12f;
+    poll("ratio>1.1", r, SENSOR_REPORT_CLEAR);
+    now_us += poll_us;
+    r.ratio = 1.02f;
+    poll("re-arm", r, SENSOR_REPORT_NONE); // below the clear level, above the threshold
+    now_us += poll_us;
+    r.ratio = 0.98f;
+    poll("ratio<1", r, SENSOR_REPORT_ALERT);
+    now_us += poll_us;
+    r.ratio = 3.6f;
+    poll("clean", r, SENSOR_REPORT_CLEAR);
+
+    now_us += poll_us;
+    r.co2 = 1050.0f;
+    poll("co2>1000", r, SENSOR_REPORT_ALERT);
+    now_us += poll_us;
+    r.co2 = 950.0f;
+    poll("in band", r, SENSOR_REPORT_NONE);
+    now_us += poll_us;
+    r.co2 = 880.0f;
+    poll("co2<900", r, SENSOR_REPORT_CLEAR);
+    now_us += poll_us;
+    r.co2 = 980.0f;
+    poll("re-arm", r, SENSOR_REPORT_NONE);
+    now_us += SAMPLE_US;
+    r.co2 = 420.0f;
+    sample("clean", r, SENSOR_REPORT_CHANGE);
+    params = defaults();
+}
+
+// A drop faster than 10%/s alerts and holds for one sensor_pub_ms after
+// the last steep poll, even with the level back inside the thresholds.
+static void check_slope() {
+    params.values[PARAM_ALERT_RATIO].f = 0.0f;
+    params.values[PARAM_ALERT_PPM].f = 0.0f;
+    sensor_reading_t r = clean_air();
+    int64_t poll_us = 1000000;
+
+    now_us += poll_us;
+    r.ratio = 3.6f;
+    poll("steady", r, SENSOR_REPORT_NONE);
+    now_us += poll_us;
+    r.ratio = 3.3f; // 8%/s
+    poll("-8%/s", r, SENSOR_REPORT_NONE);
+    now_us += poll_us;
+    r.ratio = 2.8f; // 15%/s
+    poll("-15%/s", r, SENSOR_REPORT_ALERT);
+    int64_t trigger_us = now_us;
+    r.ratio = 2.7f;
+    while (now_us + poll_us < trigger_us + SAMPLE_US) {
+        now_us += poll_us;
+        poll("hold", r, SENSOR_REPORT_NONE);
+    }
+    now_us = trigger_us + SAMPLE_US;
+    poll("expired", r, SENSOR_REPORT_CLEAR);
+
+    // A failed read in an alert keeps it and forgets the last ratio, so
+    // the next good read cannot make a slope out of the gap.
+    now_us += poll_us;
+    r.ratio = 2.6f;
+    poll("steady", r, SENSOR_REPORT_NONE);
+    now_us += poll_us;
+    r.ratio = 2.0f; // 23%/s
+    poll("-23%/s", r, SENSOR_REPORT_ALERT);
+    trigger_us = now_us;
+    now_us += poll_us;
+    sensor_reading_t failed = r;
+    failed.gas_ok = false;
+    poll("mq fail", failed, SENSOR_REPORT_NONE);
+    now_us += poll_us;
+    r.ratio = 1.0f; // half of 2.0 two seconds ago, but that ratio is gone
+    poll("after gap", r, SENSOR_REPORT_NONE);
+    now_us = trigger_us + SAMPLE_US;
+    poll("expired", r, SENSOR_REPORT_CLEAR);
+    params = defaults();
+}
+
+int main(int argc, char **argv) {
+    trace = argc > 1 && strcmp(argv[1], "--trace") == 0;
+    params = defaults();
+    now_us = 5000000;
+    check_deadbands();
+    check_hysteresis();
+    check_slope();
+
+    for (int report = 0; report < 5; report++) {
+        if (counters[REPORT_METRIC[report]] != expected[report]) {
+            failures++;
+            printf("FAIL %s counter %u, want %u\n", sensor_report_name((sensor_report_t)report),
+                   (unsigned)counters[REPORT_METRIC[report]], (unsigned)expected[report]);
+        }
+    }
+    printf("%u change, %u heartbeat, %u alert, %u clear, %u suppressed\n", (unsigned)expected[1],
+           (unsigned)expected[2], (unsigned)expected[3], (unsigned)expected[4], (unsigned)expected[0]);
+    printf("%s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,241 @@
+// Host check for the sensor scheduler (main/smart_home_mqtt/sensor_sched.cpp)
+// with mock sensors on a simulated clock. The sleep between steps follows
+// sensor_sched_wait() at the firmware's 100 Hz tick, and every driver call
+// costs simulated time like the real bus work would.
+//
+// Build: g++ -O2 -std=c++17 -I../main/smart_home_mqtt sensor_sched_check.cpp
+//            ../main/smart_home_mqtt/sensor_sched.cpp -o sensor_sched_check
+//
+//   sensor_sched_check           run the checks, exit status 1 on failure
+//   sensor_sched_check --trace   also print every sample
+//
+// Mocks:
+//   dht     DHT11-like: median of 3 reads 1.2 s apart, each behind an 18 ms
+//           start pulse, 5 ms of bit-banging per read, 1 s between reads
+//   gas     MQ135-like: instant ADC read every second (500 ms from 120 s)
+//   slow    750 ms conversion (DS18B20-like) every 5 s
+//   flaky   start fails every third time, every 2 s
+// The consumer stalls for 25 s at 180 s; afterwards every sensor must run
+// once, not replay the missed periods.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "sensor_sched.h"
+
+static const int64_t TICK_US = 10000;
+static const int64_t RUN_US = 240000000;
+static const int64_t PERIOD_CHANGE_US = 120000000;
+static const int64_t STALL_AT_US = 180000000;
+static const int64_t STALL_US = 25000000;
+
+static int64_t sim_now = 0;
+
+// ---- mocks ----
+
+struct DhtMock {
+    int reads = 0;
+    bool pulsing = false;
+    int64_t pulse_us = 0;
+    std::vector<int64_t> read_times;
+    int64_t shortest_pulse_us = INT64_MAX;
+};
+
+static void dht_pulse(DhtMock* m, int64_t now_us, int64_t* poll_us) {
+    m->pulsing = true;
+    m->pulse_us = sim_now;
+    *poll_us = now_us + 18000;
+}
+
+static bool dht_start(void* ctx, int64_t now_us, int64_t* poll_us) {
+    DhtMock* m = (DhtMock*)ctx;
+    m->reads = 0;
+    dht_pulse(m, now_us, poll_us);
+    return true;
+}
+
+static sensor_step_t dht_poll(void* ctx, int64_t now_us, int64_t* poll_us, sensor_sample_t* out) {
+    DhtMock* m = (DhtMock*)ctx;
+    if (!m->pulsing) {
+        dht_pulse(m, now_us, poll_us);
+        return SENSOR_STEP_PENDING;
+    }
+    m->shortest_pulse_us = std::min(m->shortest_pulse_us, sim_now - m->pulse_us);
+    m->read_times.push_back(sim_now);
+    sim_now += 5000;
+    m->pulsing = false;
+    if (++m->reads < 3) {
+        *poll_us = now_us + 1200000 - 18000;
+        return SENSOR_STEP_PENDING;
+    }
+    out->ok = true;
+    out->values[0] = 22.0f;
+    return SENSOR_STEP_DONE;
+}
+
+static bool gas_start(void*, int64_t now_us, int64_t* poll_us) {
+    *poll_us = now_us;
+    return true;
+}
+
+static sensor_step_t gas_poll(void*, int64_t, int64_t*, sensor_sample_t* out) {
+    sim_now += 100;
+    out->ok = true;
+    return SENSOR_STEP_DONE;
+}
+
+static bool slow_start(void*, int64_t now_us, int64_t* poll_us) {
+    sim_now += 200;
+    *poll_us = now_us + 750000;
+    return true;
+}
+
+static sensor_step_t slow_poll(void*, int64_t, int64_t*, sensor_sample_t* out) {
+    sim_now += 1000;
+    out->ok = true;
+    return SENSOR_STEP_DONE;
+}
+
+static bool flaky_start(void* ctx, int64_t now_us, int64_t* poll_us) {
+    int* starts = (int*)ctx;
+    *poll_us = now_us + 20000;
+    return ++*starts % 3 != 0;
+}
+
+static sensor_step_t flaky_poll(void*, int64_t, int64_t*, sensor_sample_t* out) {
+    out->ok = true;
+    return SENSOR_STEP_DONE;
+}
+
+// ---- checks ----
+
+struct Stats {
+    const char* name;
+    int64_t period_us;
+    std::vector<int64_t> starts; // t_us - duration_us
+    int ok = 0;
+    int failed = 0;
+
+    Stats(const char* n, int64_t period) : name(n), period_us(period) {}
+};
+
+static bool expect(bool cond, const char* what) {
+    printf("%-58s %s\n", what, cond ? "ok" : "FAIL");
+    return cond;
+}
+
+int main(int argc, char** argv) {
+    bool trace = argc > 1 && strcmp(argv[1], "--trace") == 0;
+    if (argc > 1 && !trace) {
+        fprintf(stderr, "usage: %s [--trace]\n", argv[0]);
+        return 2;
+    }
+
+    DhtMock dht;
+    int flaky_starts = 0;
+    const sensor_driver_t drivers[] = {
+        {"dht", 1000, dht_start, dht_poll, &dht},
+        {"gas", 0, gas_start, gas_poll, nullptr},
+        {"slow", 0, slow_start, slow_poll, nullptr},
+        {"flaky", 0, flaky_start, flaky_poll, &flaky_starts},
+    };
+    std::vector<Stats> stats = {{"dht", 10000000}, {"gas", 1000000}, {"slow", 5000000}, {"flaky", 2000000}};
+    for (size_t i = 0; i < stats.size(); i++) {
+        if (sensor_sched_register(&drivers[i], (uint32_t)(stats[i].period_us / 1000)) != (int)i) {
+            fprintf(stderr, "register failed\n");
+            return 1;
+        }
+    }
+
+    bool period_changed = false;
+    bool stalled = false;
+    int64_t max_gas_gap_us = 0;
+    int64_t max_gas_gap_at = 0;
+    int wakeups = 0;
+    while (sim_now < RUN_US) {
+        if (!period_changed && sim_now >= PERIOD_CHANGE_US) {
+            period_changed = true;
+            sensor_sched_set_period(1, 500);
+        }
+        if (!stalled && sim_now >= STALL_AT_US) {
+            stalled = true;
+            sim_now += STALL_US;
+        }
+        sensor_sample_t s;
+        int64_t next_us = 0;
+        if (sensor_sched_step(sim_now, &s, &next_us)) {
+            Stats& st = stats[s.sensor];
+            int64_t start = s.t_us - s.duration_us;
+            if (s.sensor == 1 && !st.starts.empty() && !(start > STALL_AT_US && st.starts.back() < STALL_AT_US)) {
+                int64_t gap = start - st.starts.back();
+                if (gap > max_gas_gap_us) {
+                    max_gas_gap_us = gap;
+                    max_gas_gap_at = start;
+                }
+            }
+            st.starts.push_back(start);
+            (s.ok ? st.ok : st.failed)++;
+            if (trace) {
+                printf("%10.3f s  %-5s %s  %7.1f ms\n", s.t_us / 1e6, st.name, s.ok ? "ok  " : "fail",
+                       s.duration_us / 1e3);
+            }
+            sim_now += 50; // consumer
+            continue;
+        }
+        // sensor_sched_wait(): pdMS_TO_TICKS truncates, at least one tick,
+        // and the first tick ends at the next tick boundary.
+        int64_t wait_us = next_us - sim_now;
+        int64_t ticks = wait_us > 0 ? ((wait_us + 999) / 1000) * 1000 / TICK_US : 0;
+        ticks = std::max<int64_t>(ticks, 1);
+        sim_now = (sim_now / TICK_US + ticks) * TICK_US;
+        wakeups++;
+    }
+
+    printf("%-6s %8s %6s %6s %14s %14s\n", "sensor", "samples", "ok", "failed", "mean_gap_ms", "max_late_ms");
+    for (Stats& st : stats) {
+        double gaps = 0;
+        int64_t late = 0;
+        int n = 0;
+        for (size_t i = 1; i < st.starts.size(); i++) {
+            int64_t gap = st.starts[i] - st.starts[i - 1];
+            if (st.starts[i - 1] < STALL_AT_US && st.starts[i] > STALL_AT_US) continue;
+            int64_t period = &st == &stats[1] && st.starts[i - 1] >= PERIOD_CHANGE_US ? 500000 : st.period_us;
+            gaps += gap;
+            n++;
+            late = std::max(late, gap - period);
+        }
+        printf("%-6s %8zu %6d %6d %14.1f %14.1f\n", st.name, st.starts.size(), st.ok, st.failed,
+               n ? gaps / n / 1e3 : 0.0, late / 1e3);
+    }
+    printf("wakeups %d, longest gas gap %.1f ms at %.3f s\n\n", wakeups, max_gas_gap_us / 1e3, max_gas_gap_at / 1e6);
+
+    bool ok = true;
+    ok &= expect(dht.shortest_pulse_us >= 18000, "dht start pulse >= 18 ms");
+    int64_t min_read_gap = INT64_MAX;
+    for (size_t i = 1; i < dht.read_times.size(); i++) {
+        min_read_gap = std::min(min_read_gap, dht.read_times[i] - dht.read_times[i - 1]);
+    }
+    ok &= expect(min_read_gap >= 1000000, "dht reads >= 1 s apart, also across measurements");
+    // A gas read can wait behind one tick and one 5 ms DHT read at most.
+    ok &= expect(max_gas_gap_us <= 1000000 + TICK_US + 5000 + 1000, "gas keeps its period during dht measurements");
+
+    auto count_between = [](const Stats& st, int64_t from, int64_t to) {
+        return std::count_if(st.starts.begin(), st.starts.end(), [&](int64_t t) { return t >= from && t < to; });
+    };
+    ok &= expect(count_between(stats[1], PERIOD_CHANGE_US + 1000000, STALL_AT_US) >= 2 * 58,
+                 "gas period change to 500 ms takes effect");
+    bool no_burst = true;
+    for (const Stats& st : stats) {
+        no_burst &= count_between(st, STALL_AT_US + STALL_US, STALL_AT_US + STALL_US + 100000) <= 1;
+    }
+    ok &= expect(no_burst, "after a 25 s stall each sensor runs once, no catch-up");
+    ok &= expect(stats[3].failed > 0 && stats[3].failed * 3 >= (int)stats[3].starts.size() - 1,
+                 "failed starts come out as ok == false samples");
+    ok &= expect(std::abs((int)stats[0].starts.size() - 22) <= 1 && std::abs((int)stats[2].starts.size() - 44) <= 1,
+                 "dht and slow sample counts match their periods");
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,279 @@
+// Host decoder for the INMP411 UART stream (see serial_frame.h).
+//
+// Build: g++ -O2 -std=c++17 -I../../.. serial_frame_decoder.cpp -o serial_frame_decoder
+//
+//   serial_frame_decoder <capture.bin|/dev/ttyUSBx> [out.wav]
+//       decode a capture or a live port (1 Mbaud, raw) and write the
+//       audio between STRT and STOP to a WAV file
+//   serial_frame_decoder --bench [frames]
+//       encode+decode throughput
+//   serial_frame_decoder --corrupt [frames] [errors_per_mb]
+//       flip, drop and insert random bytes and check that every frame the
+//       decoder accepts is intact and the decoder recovers after each hit
+//       (exit status 1 on failure)
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "serial_frame.h"
+
+static const int SAMPLE_RATE = 16000;
+static const int FRAME_BYTES = 512; // 256 mono int16 samples, as the sketch sends
+
+static const char* type_name(uint8_t type) {
+    switch (type) {
+    case SF_TYPE_STRT: return "STRT";
+    case SF_TYPE_AUD0: return "AUD0";
+    case SF_TYPE_STOP: return "STOP";
+    case SF_TYPE_RDY: return "RDY!";
+    default: return "????";
+    }
+}
+
+static void write_wav_header(FILE* f, uint32_t data_bytes) {
+    uint32_t riff = 36 + data_bytes;
+    uint32_t fmt_len = 16, rate = SAMPLE_RATE, byte_rate = SAMPLE_RATE * 2;
+    uint16_t pcm = 1, channels = 1, align = 2, bits = 16;
+    fseek(f, 0, SEEK_SET);
+    fwrite("RIFF", 1, 4, f);
+    fwrite(&riff, 4, 1, f);
+    fwrite("WAVEfmt ", 1, 8, f);
+    fwrite(&fmt_len, 4, 1, f);
+    fwrite(&pcm, 2, 1, f);
+    fwrite(&channels, 2, 1, f);
+    fwrite(&rate, 4, 1, f);
+    fwrite(&byte_rate, 4, 1, f);
+    fwrite(&align, 2, 1, f);
+    fwrite(&bits, 2, 1, f);
+    fwrite("data", 1, 4, f);
+    fwrite(&data_bytes, 4, 1, f);
+}
+
+static int open_input(const char* path) {
+    int fd = open(path, O_RDONLY | O_NOCTTY);
+    if (fd < 0) return -1;
+    if (strncmp(path, "/dev/", 5) == 0) {
+        struct termios tio;
+        if (tcgetattr(fd, &tio) == 0) {
+            cfmakeraw(&tio);
+#ifdef B1000000
+            cfsetispeed(&tio, B1000000);
+            cfsetospeed(&tio, B1000000);
+#endif
+            tio.c_cc[VMIN] = 1;
+            tio.c_cc[VTIME] = 0;
+            tcsetattr(fd, TCSANOW, &tio);
+        }
+    }
+    return fd;
+}
+
+static int run_decode(const char* path, const char* wav_path) {
+    int fd = open_input(path);
+    if (fd < 0) {
+        perror(path);
+        return 1;
+    }
+    FILE* wav = NULL;
+    uint32_t wav_bytes = 0;
+    bool recording = false;
+
+    static sf_decoder_t dec;
+    sf_decoder_init(&dec);
+    uint8_t chunk[4096];
+    ssize_t n;
+    while ((n = read(fd, chunk, sizeof(chunk))) > 0) {
+        for (ssize_t i = 0; i < n; i++) {
+            sf_frame_t f;
+            if (!sf_decoder_push(&dec, chunk[i], &f)) continue;
+            if (f.type == SF_TYPE_STRT) {
+                recording = true;
+                printf("%s seq=%u\n", type_name(f.type), f.seq);
+                if (wav_path && !wav) {
+                    wav = fopen(wav_path, "wb");
+                    if (wav) write_wav_header(wav, 0);
+                }
+            } else if (f.type == SF_TYPE_STOP) {
+                recording = false;
+                printf("%s seq=%u\n", type_name(f.type), f.seq);
+            } else if (f.type == SF_TYPE_RDY) {
+                // tx_drops, dma_overruns, buf_overruns, queue_drops (older firmware sends fewer)
+                uint32_t counters[4] = {0, 0, 0, 0};
+                memcpy(counters, f.payload, f.len < sizeof(counters) ? f.len : sizeof(counters));
+                printf("%s seq=%u tx_drops=%u dma_overruns=%u buf_overruns=%u queue_drops=%u\n", type_name(f.type),
+                       f.seq, counters[0], counters[1], counters[2], counters[3]);
+            } else if (f.type == SF_TYPE_AUD0 && recording && wav) {
+                fwrite(f.payload, 1, f.len, wav);
+                wav_bytes += f.len;
+            }
+        }
+    }
+    close(fd);
+    if (wav) {
+        write_wav_header(wav, wav_bytes);
+        fclose(wav);
+    }
+    printf("bytes=%llu frames=%u crc_err=%u cobs_err=%u lost=%u audio=%u B\n", (unsigned long long)dec.bytes,
+           dec.frames, dec.crc_errors, dec.cobs_errors, dec.lost_frames, wav_bytes);
+    return 0;
+}
+
+// Deterministic payload for frame i, with a zero run so COBS stuffing is
+// exercised.
+static void make_payload(int i, uint8_t* out) {
+    std::mt19937 rng((uint32_t)i + 1);
+    for (int k = 0; k < FRAME_BYTES; k++) out[k] = (uint8_t)rng();
+    memset(out + (i % 7) * 16, 0, 16);
+}
+
+// Builds a stream of AUD0 frames, recording where each frame starts.
+static std::vector<uint8_t> build_stream(int frames, std::vector<size_t>* offsets) {
+    std::vector<uint8_t> stream;
+    uint8_t payload[FRAME_BYTES];
+    uint8_t enc[SF_MAX_ENCODED];
+    for (int i = 0; i < frames; i++) {
+        make_payload(i, payload);
+        size_t n = sf_encode(SF_TYPE_AUD0, (uint16_t)i, payload, FRAME_BYTES, enc);
+        if (offsets) offsets->push_back(stream.size());
+        stream.insert(stream.end(), enc, enc + n);
+    }
+    return stream;
+}
+
+static int run_bench(int frames) {
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<uint8_t> stream = build_stream(frames, NULL);
+    auto t1 = std::chrono::steady_clock::now();
+
+    static sf_decoder_t dec;
+    sf_decoder_init(&dec);
+    uint64_t payload_bytes = 0;
+    for (uint8_t b : stream) {
+        sf_frame_t f;
+        if (sf_decoder_push(&dec, b, &f)) payload_bytes += f.len;
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    double enc_s = std::chrono::duration<double>(t1 - t0).count();
+    double dec_s = std::chrono::duration<double>(t2 - t1).count();
+    double raw_mb = (double)frames * FRAME_BYTES / 1e6;
+    printf("frames=%d wire=%zu B overhead=%.2f%%\n", frames, stream.size(),
+           100.0 * ((double)stream.size() / ((double)frames * FRAME_BYTES) - 1.0));
+    printf("encode: %.1f MB/s (incl. payload generation)\n", raw_mb / enc_s);
+    printf("decode: %.1f MB/s, %.0f frames/s, decoded=%u\n", (double)payload_bytes / 1e6 / dec_s,
+           dec.frames / dec_s, dec.frames);
+    // 1 Mbaud 8N1 carries 100 kB/s; audio needs 32 kB/s.
+    printf("link budget at 1 Mbaud: %.0f%% used by 16 kHz mono\n",
+           100.0 * 32000.0 * ((double)stream.size() / ((double)frames * FRAME_BYTES)) / 100000.0);
+    return dec.frames == (uint32_t)frames ? 0 : 1;
+}
+
+static int run_corrupt(int frames, int errors_per_mb) {
+    std::vector<size_t> offsets;
+    std::vector<uint8_t> clean = build_stream(frames, &offsets);
+    std::mt19937 rng(7);
+
+    // Corrupt at random positions; remember which frames were touched.
+    int hits = (int)((uint64_t)clean.size() * errors_per_mb / 1000000) + 1;
+    std::vector<bool> touched(frames, false);
+    std::vector<uint8_t> dirty;
+    dirty.reserve(clean.size() + hits);
+    std::vector<size_t> positions;
+    for (int i = 0; i < hits; i++) positions.push_back(rng() % clean.size());
+    std::sort(positions.begin(), positions.end());
+    size_t next = 0;
+    int flips = 0, drops = 0, inserts = 0;
+    for (size_t i = 0; i < clean.size(); i++) {
+        bool hit = false;
+        int kind = 0;
+        while (next < positions.size() && positions[next] == i) {
+            hit = true;
+            kind = (int)(rng() % 3);
+            next++;
+        }
+        if (hit) {
+            size_t frame = std::upper_bound(offsets.begin(), offsets.end(), i) - offsets.begin() - 1;
+            touched[frame] = true;
+            // A damaged delimiter also takes out the following frame.
+            if (clean[i] == 0 && frame + 1 < (size_t)frames) touched[frame + 1] = true;
+            if (kind == 0) {
+                dirty.push_back(clean[i] ^ (uint8_t)(1u << (rng() % 8)));
+                flips++;
+            } else if (kind == 1) {
+                drops++;
+            } else {
+                dirty.push_back((uint8_t)rng());
+                dirty.push_back(clean[i]);
+                inserts++;
+                if (frame + 1 < (size_t)frames) touched[frame + 1] = true;
+            }
+            continue;
+        }
+        dirty.push_back(clean[i]);
+    }
+
+    static sf_decoder_t dec;
+    sf_decoder_init(&dec);
+    std::vector<bool> seen(frames, false);
+    uint8_t expect[FRAME_BYTES];
+    int bad_accepts = 0;
+    for (uint8_t b : dirty) {
+        sf_frame_t f;
+        if (!sf_decoder_push(&dec, b, &f)) continue;
+        if (f.type != SF_TYPE_AUD0 || f.len != FRAME_BYTES || f.seq >= frames) {
+            bad_accepts++;
+            continue;
+        }
+        make_payload(f.seq, expect);
+        if (memcmp(f.payload, expect, FRAME_BYTES) != 0) {
+            bad_accepts++;
+            continue;
+        }
+        seen[f.seq] = true;
+    }
+
+    int untouched_lost = 0, touched_count = 0;
+    for (int i = 0; i < frames; i++) {
+        if (touched[i]) touched_count++;
+        else if (!seen[i]) untouched_lost++;
+    }
+    printf("frames=%d hits=%d (flip=%d drop=%d insert=%d) touched=%d\n", frames, hits, flips, drops, inserts,
+           touched_count);
+    printf("decoded=%u crc_err=%u cobs_err=%u lost(seq)=%u\n", dec.frames, dec.crc_errors, dec.cobs_errors,
+           dec.lost_frames);
+    printf("untouched frames lost=%d corrupted frames accepted=%d\n", untouched_lost, bad_accepts);
+    // CRC16 lets roughly 1 in 65536 damaged frames through; more than that
+    // or any collateral loss is a framing bug.
+    int allowed_bad = touched_count / 65536 + 1;
+    bool ok = untouched_lost == 0 && bad_accepts <= allowed_bad;
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <capture|tty> [out.wav] | --bench [frames] | --corrupt [frames] [errors_per_mb]\n",
+                argv[0]);
+        return 2;
+    }
+    std::string mode = argv[1];
+    if (mode == "--bench") {
+        return run_bench(argc > 2 ? atoi(argv[2]) : 200000);
+    }
+    if (mode == "--corrupt") {
+        int frames = argc > 2 ? atoi(argv[2]) : 50000;
+        if (frames > 65536) frames = 65536; // seq is 16-bit
+        return run_corrupt(frames, argc > 3 ? atoi(argv[3]) : 200);
+    }
+    return run_decode(argv[1], argc > 2 ? argv[2] : NULL);
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+// Framing for the INMP411 UART stream, shared by the sketch and the host
+// decoder (apps/iot/scripts/serial_frame_decoder.cpp).
+//
+// Frame before stuffing:  type:u8 | seq:u16 | len:u16 | payload | crc16
+// (little endian, CRC-16/CCITT-FALSE over type..payload). The frame is
+// COBS encoded and terminated by 0x00, so a receiver that loses or gains
+// bytes resynchronizes at the next delimiter and only that frame is lost.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SF_TYPE_STRT 1
+#define SF_TYPE_AUD0 2
+#define SF_TYPE_STOP 3
+#define SF_TYPE_RDY  4
+
+#define SF_HEADER_LEN 5
+#define SF_CRC_LEN 2
+#define SF_MAX_PAYLOAD 1024
+#define SF_MAX_RAW (SF_HEADER_LEN + SF_MAX_PAYLOAD + SF_CRC_LEN)
+// COBS adds one byte per 254 plus the leading code; +1 for the delimiter.
+#define SF_ENCODED_MAX(raw) ((raw) + (raw) / 254 + 2)
+#define SF_MAX_ENCODED SF_ENCODED_MAX(SF_MAX_RAW)
+
+static const uint16_t SF_CRC_NIBBLE[16] = {
+  0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+  0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+};
+
+static inline uint16_t sf_crc16_update(uint16_t crc, uint8_t b) {
+  crc = (uint16_t)((crc << 4) ^ SF_CRC_NIBBLE[((crc >> 12) ^ (b >> 4)) & 0x0f]);
+  crc = (uint16_t)((crc << 4) ^ SF_CRC_NIBBLE[((crc >> 12) ^ (b & 0x0f)) & 0x0f]);
+  return crc;
+}
+
+static inline uint16_t sf_crc16(const uint8_t* data, size_t len) {
+  uint16_t crc = 0xffff;
+  for (size_t i = 0; i < len; i++) crc = sf_crc16_update(crc, data[i]);
+  return crc;
+}
+
+// ---- Encoder: streams COBS output, no intermediate raw frame ----
+
+typedef struct {
+  uint8_t* out;
+  size_t pos;
+  size_t code_pos;
+  uint8_t code;
+  uint16_t crc;
+} sf_encoder_t;
+
+static inline void sf_enc_byte(sf_encoder_t* e, uint8_t b) {
+  if (b == 0) {
+    e->out[e->code_pos] = e->code;
+    e->code_pos = e->pos++;
+    e->code = 1;
+    return;
+  }
+  e->out[e->pos++] = b;
+  if (++e->code == 0xff) {
+    e->out[e->code_pos] = e->code;
+    e->code_pos = e->pos++;
+    e->code = 1;
+  }
+}
+
+static inline void sf_enc_data(sf_encoder_t* e, uint8_t b) {
+  e->crc = sf_crc16_update(e->crc, b);
+  sf_enc_byte(e, b);
+}
+
+// Writes the delimited frame into out (at least SF_ENCODED_MAX of the raw
+// size) and returns the number of bytes, 0 if len is too large.
+static inline size_t sf_encode(uint8_t type, uint16_t seq, const uint8_t* payload, uint16_t len, uint8_t* out) {
+  if (len > SF_MAX_PAYLOAD) return 0;
+  sf_encoder_t e;
+  e.out = out;
+  e.code_pos = 0;
+  e.pos = 1;
+  e.code = 1;
+  e.crc = 0xffff;
+  sf_enc_data(&e, type);
+  sf_enc_data(&e, (uint8_t)(seq & 0xff));
+  sf_enc_data(&e, (uint8_t)(seq >> 8));
+  sf_enc_data(&e, (uint8_t)(len & 0xff));
+  sf_enc_data(&e, (uint8_t)(len >> 8));
+  for (uint16_t i = 0; i < len; i++) sf_enc_data(&e, payload[i]);
+  uint16_t crc = e.crc;
+  sf_enc_byte(&e, (uint8_t)(crc & 0xff));
+  sf_enc_byte(&e, (uint8_t)(crc >> 8));
+  e.out[e.code_pos] = e.code;
+  e.out[e.pos++] = 0;
+  return e.pos;
+}
+
+// ---- Decoder: byte at a time, resyncs on 0x00 ----
+
+typedef struct {
+  uint8_t type;
+  uint16_t seq;
+  uint16_t len;
+  const uint8_t* payload;
+} sf_frame_t;
+
+typedef struct {
+  uint8_t enc[SF_MAX_ENCODED];
+  uint8_t raw[SF_MAX_RAW];
+  size_t enc_len;
+  int overflow;
+  int have_seq;
+  uint16_t next_seq;
+  uint32_t frames;
+  uint32_t crc_errors;
+  uint32_t cobs_errors;    // bad stuffing or truncated/oversized frame
+  uint32_t lost_frames;    // from seq gaps
+  uint64_t bytes;
+} sf_decoder_t;
+
+static inline void sf_decoder_init(sf_decoder_t* d) {
+  d->enc_len = 0;
+  d->overflow = 0;
+  d->have_seq = 0;
+  d->next_seq = 0;
+  d->frames = 0;
+  d->crc_errors = 0;
+  d->cobs_errors = 0;
+  d->lost_frames = 0;
+  d->bytes = 0;
+}
+
+static inline int sf_cobs_decode(const uint8_t* in, size_t n, uint8_t* out, size_t cap) {
+  size_t i = 0, o = 0;
+  while (i < n) {
+    uint8_t code = in[i++];
+    for (uint8_t k = 1; k < code; k++) {
+      if (i >= n || o >= cap) return -1;
+      out[o++] = in[i++];
+    }
+    if (code < 0xff && i < n) {
+      if (o >= cap) return -1;
+      out[o++] = 0;
+    }
+  }
+  return (int)o;
+}
+
+// Returns 1 and fills f when b completes a valid frame. f->payload points
+// into the decoder and is valid until the next call.
+static inline int sf_decoder_push(sf_decoder_t* d, uint8_t b, sf_frame_t* f) {
+  d->bytes++;
+  if (b != 0) {
+    if (d->enc_len < sizeof(d->enc)) {
+      d->enc[d->enc_len++] = b;
+    } else {
+      d->overflow = 1;
+    }
+    return 0;
+  }
+  size_t n = d->enc_len;
+  int overflow = d->overflow;
+  d->enc_len = 0;
+  d->overflow = 0;
+  if (n == 0) return 0; // back-to-back delimiters
+  int raw_len = overflow ? -1 : sf_cobs_decode(d->enc, n, d->raw, sizeof(d->raw));
+  if (raw_len < SF_HEADER_LEN + SF_CRC_LEN) {
+    d->cobs_errors++;
+    return 0;
+  }
+  uint16_t len = (uint16_t)(d->raw[3] | (d->raw[4] << 8));
+  if ((int)len != raw_len - SF_HEADER_LEN - SF_CRC_LEN) {
+    d->cobs_errors++;
+    return 0;
+  }
+  uint16_t crc = (uint16_t)(d->raw[raw_len - 2] | (d->raw[raw_len - 1] << 8));
+  if (crc != sf_crc16(d->raw, (size_t)raw_len - SF_CRC_LEN)) {
+    d->crc_errors++;
+    return 0;
+  }
+  uint16_t seq = (uint16_t)(d->raw[1] | (d->raw[2] << 8));
+  if (d->have_seq && seq != d->next_seq) {
+    d->lost_frames += (uint16_t)(seq - d->next_seq);
+  }
+  d->have_seq = 1;
+  d->next_seq = (uint16_t)(seq + 1);
+  d->frames++;
+  f->type = d->raw[0];
+  f->seq = seq;
+  f->len = len;
+  f->payload = d->raw + SF_HEADER_LEN;
+  return 1;
+}